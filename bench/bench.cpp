@@ -0,0 +1,820 @@
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../src/Auction.h"
+#include "../src/Book.h"
+#include "../src/Broker.h"
+#include "../src/Exchange.h"
+#include "../src/FairPrice.h"
+#include "../src/MarketData.h"
+#include "../src/Population.h"
+#include "../src/RiskEngine.h"
+#include "../src/RiskGate.h"
+#include "../src/Stats.h"
+#include "../src/StrategyScheduler.h"
+#include "../src/TradeStore.h"
+
+// Микро- и макро-бенчмарки стакана и биржи.
+// stock_bench [--filter substr] [--out results.json] [--quick]
+// Результаты - JSON: {"benchmarks": [{"name", "params", "ns_per_op", "ops_per_sec", "ops"}]}
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Result {
+	std::string name;
+	std::vector<std::pair<std::string, long long>> params;
+	double nsPerOp{};
+	double opsPerSec{};
+	long long ops{};
+};
+
+struct Options {
+	std::string filter;
+	std::string out;
+	bool quick = false;
+};
+
+Options opts;
+std::vector<Result> results;
+// чтобы компилятор не выбросил измеряемые чтения
+volatile double sinkHole = 0;
+
+bool enabled(const std::string& name) {
+	return opts.filter.empty() || name.find(opts.filter) != std::string::npos;
+}
+
+void report(Result r) {
+	std::cerr << r.name;
+	for (auto& [k, v] : r.params) std::cerr << " " << k << "=" << v;
+	std::cerr << "  " << r.nsPerOp << " ns/op  " << static_cast<long long>(r.opsPerSec) << " ops/s\n";
+	results.push_back(std::move(r));
+}
+
+// body(ops) выполняет ops операций; возвращает секунды чистого времени
+Result timeOps(const std::string& name, std::vector<std::pair<std::string, long long>> params,
+               long long ops, const std::function<double(long long)>& body) {
+	double best = 1e100;
+	const int reps = opts.quick ? 1 : 3;
+	for (int i = 0; i < reps; ++i)
+		best = std::min(best, body(ops));
+	Result r{name, std::move(params)};
+	r.ops = ops;
+	r.nsPerOp = best * 1e9 / static_cast<double>(ops);
+	r.opsPerSec = static_cast<double>(ops) / best;
+	return r;
+}
+
+double seconds(Clock::time_point from) {
+	return std::chrono::duration<double>(Clock::now() - from).count();
+}
+
+const char* bookName(BookKind kind) {
+	return kind == BookKind::Map ? "map" : "ladder";
+}
+
+// ===== OrderBook::addOrder при разной глубине =====
+void benchAddOrder() {
+	for (const BookKind kind : {BookKind::Map, BookKind::Ladder}) {
+		for (const long long depth : {10LL, 1000LL, 100000LL}) {
+			const std::string name = std::string("book.add_order.") + bookName(kind);
+			if (!enabled(name)) continue;
+			const long long ops = opts.quick ? 20000 : 200000;
+
+			report(timeOps(name, {{"depth", depth}}, ops, [&](long long n) {
+				auto book = makeBook(kind, 100);
+				std::mt19937 rng(1);
+				std::uniform_int_distribution<int> tick(9000, 9999);
+				std::size_t id = 1;
+				// покупки ниже 100, продажи выше - стакан не пересекается
+				for (long long i = 0; i < depth; ++i)
+					book->addOrder({1, OrderType::Limit, (i & 1) ? OrderSide::Buy : OrderSide::Sell, id++, 5,
+					                (i & 1) ? tick(rng) / 100.0 : 200 - tick(rng) / 100.0, 0});
+
+				const auto start = Clock::now();
+				for (long long i = 0; i < n; ++i)
+					book->addOrder({2, OrderType::Limit, (i & 1) ? OrderSide::Buy : OrderSide::Sell, id++, 5,
+					                (i & 1) ? tick(rng) / 100.0 : 200 - tick(rng) / 100.0, 0});
+				return seconds(start);
+			}));
+		}
+	}
+}
+
+// ===== проход агрессивной заявки по уровням: tryMatchOne против matchAll =====
+void benchSweep() {
+	for (const BookKind kind : {BookKind::Map, BookKind::Ladder}) {
+		for (const bool batched : {false, true}) {
+			const std::string name = std::string(batched ? "book.match_all." : "book.try_match_one.") + bookName(kind);
+			if (!enabled(name)) continue;
+			const long long levels = opts.quick ? 2000 : 20000;
+			const long long perLevel = 4;
+
+			report(timeOps(name, {{"levels", levels}, {"orders_per_level", perLevel}}, levels * perLevel, [&](long long n) {
+				auto book = makeBook(kind, 100);
+				std::size_t id = 1;
+				for (long long l = 0; l < levels; ++l)
+					for (long long k = 0; k < perLevel; ++k)
+						book->addOrder({2, OrderType::Limit, OrderSide::Sell, id++, 1, 100 + l / 100.0, 0});
+				book->addOrder({1, OrderType::Limit, OrderSide::Buy, id++, static_cast<int>(n), 1e6, 0});
+
+				std::vector<Trade> buf(256);
+				long long done = 0;
+				const auto start = Clock::now();
+				if (batched) {
+					for (std::size_t k; (k = book->matchAll(0, buf)) > 0;) done += static_cast<long long>(k);
+				} else {
+					for (Trade tr; book->tryMatchOne(0, tr);) ++done;
+				}
+				const double s = seconds(start);
+				if (done != n) std::cerr << "sweep mismatch: " << done << " != " << n << "\n";
+				return s;
+			}));
+		}
+	}
+}
+
+// ===== bestBidPrice под конкуренцией с писателем и другими читателями =====
+void benchBestBidContention() {
+	for (const int readers : {1, 2, 4}) {
+		for (const bool snapshot : {false, true}) {
+			const std::string name = snapshot ? "exchange.quote_snapshot" : "exchange.best_bid_price";
+			if (!enabled(name)) continue;
+			const long long perReader = opts.quick ? 50000 : 500000;
+
+			report(timeOps(name, {{"readers", readers}}, perReader * readers, [&](long long) {
+				Exchange ex;
+				ex.setFee(0.0, 0);
+				ex.setConsoleOutput(false);
+				ex.submitOrder({1, OrderType::Limit, OrderSide::Buy,  0, 5, 99, 0});
+				ex.submitOrder({2, OrderType::Limit, OrderSide::Sell, 0, 5, 101, 0});
+				std::thread loop([&] { ex.runLoop(); });
+
+				// писатель постоянно двигает стакан
+				std::atomic<bool> alive{true};
+				std::thread writer([&] {
+					for (int i = 0; alive; ++i)
+						ex.submitOrder({3 + (i & 1), OrderType::Limit, (i & 1) ? OrderSide::Buy : OrderSide::Sell,
+						                0, 1, 100, 0});
+				});
+
+				std::atomic<int> ready{0};
+				std::vector<std::thread> ts;
+				std::vector<double> secs(readers);
+				for (int r = 0; r < readers; ++r)
+					ts.emplace_back([&, r] {
+						++ready;
+						while (ready < readers) std::this_thread::yield();
+						double sink = 0;
+						const auto start = Clock::now();
+						for (long long i = 0; i < perReader; ++i) {
+							if (snapshot) {
+								sink += ex.quote().bid;
+							} else {
+								double bid{};
+								ex.bestBidPrice(bid);
+								sink += bid;
+							}
+						}
+						secs[r] = seconds(start);
+						sinkHole = sink;
+					});
+				for (auto& t : ts) t.join();
+				alive = false;
+				writer.join();
+				ex.stop();
+				loop.join();
+
+				double worst = 0;
+				for (double s : secs) worst = std::max(worst, s);
+				return worst;
+			}));
+		}
+	}
+}
+
+// ===== fairPriceEstimate при 10^3..10^7 сделок =====
+void benchFairPrice() {
+	const long long maxTrades = opts.quick ? 100000 : 10000000;
+	for (long long trades = 1000; trades <= maxTrades; trades *= 10) {
+		std::mt19937 rng(5);
+		std::uniform_real_distribution<double> price(95, 105);
+		std::vector<Trade> history(static_cast<std::size_t>(trades));
+		for (long long i = 0; i < trades; ++i)
+			history[static_cast<std::size_t>(i)] = {1, 2, price(rng), 1 + static_cast<int>(i % 7), static_cast<int>(i / 10)};
+
+		if (enabled("fair.on_trade")) {
+			report(timeOps("fair.on_trade", {{"trades", trades}}, trades, [&](long long) {
+				FairPrice fp(250, 0.05);
+				const auto start = Clock::now();
+				for (const Trade& t : history) fp.onTrade(t);
+				return seconds(start);
+			}));
+		}
+
+		FairPrice fp(250, 0.05);
+		for (const Trade& t : history) fp.onTrade(t);
+
+		if (enabled("fair.estimate")) {
+			const long long calls = 1000000;
+			report(timeOps("fair.estimate", {{"trades", trades}}, calls, [&](long long n) {
+				double sink = 0;
+				const auto start = Clock::now();
+				for (long long i = 0; i < n; ++i) sink += fp.value(FairPriceKind::Vwap);
+				const double s = seconds(start);
+				sinkHole = sink;
+				return s;
+			}));
+		}
+
+		// прежняя реализация: пересчёт по всему вектору сделок
+		if (enabled("fair.legacy_rescan")) {
+			const long long calls = std::max(1LL, 10000000LL / trades);
+			report(timeOps("fair.legacy_rescan", {{"trades", trades}}, calls, [&](long long n) {
+				double sink = 0;
+				const auto start = Clock::now();
+				for (long long i = 0; i < n; ++i) {
+					double sum = 0;
+					long long qty = 0;
+					for (const Trade& t : history) {
+						sum += t.price * t.quantity;
+						qty += t.quantity;
+					}
+					sink += sum / static_cast<double>(qty);
+				}
+				const double s = seconds(start);
+				sinkHole = sink;
+				return s;
+			}));
+		}
+	}
+}
+
+// ===== биржа целиком: N потоков PlayerBroker шлют заявки без пауз =====
+void benchExchangeEndToEnd() {
+	for (const BookKind kind : {BookKind::Map, BookKind::Ladder}) {
+		for (const int brokers : {1, 2, 4, 8}) {
+			const std::string name = std::string("exchange.player_flow.") + bookName(kind);
+			if (!enabled(name)) continue;
+			const long long perBroker = opts.quick ? 20000 : 100000;
+
+			Exchange ex(ExchangeConfig{.book = kind});
+			ex.setFee(0.0, 0);
+			ex.setConsoleOutput(false);
+			// затравочная сделка, чтобы у PlayerBroker была справедливая цена
+			ex.submitOrder({100, OrderType::Limit, OrderSide::Sell, 0, 1, 100, 0});
+			ex.submitOrder({101, OrderType::Limit, OrderSide::Buy,  0, 1, 100, 0});
+
+			std::vector<std::shared_ptr<PlayerBroker>> players;
+			for (int b = 0; b < brokers; ++b) {
+				players.push_back(std::make_shared<PlayerBroker>(b + 1, 1e9, 1000000, ex));
+				ex.registerBroker(players.back());
+			}
+
+			std::thread loop([&] { ex.runLoop(); });
+			while (ex.tradeCount() == 0) std::this_thread::yield();
+
+			const auto start = Clock::now();
+			std::vector<std::thread> ts;
+			for (int b = 0; b < brokers; ++b)
+				ts.emplace_back([&, b] {
+					for (long long i = 0; i < perBroker; ++i) players[b]->step(static_cast<int>(i));
+				});
+			for (auto& t : ts) t.join();
+			// брокеры ещё и снимают прежние заявки, так что ждём, пока цикл разберёт очередь целиком
+			ex.stop();
+			loop.join();
+			const double s = seconds(start);
+
+			Result r{name, {{"brokers", brokers}, {"trades", static_cast<long long>(ex.tradeCount())}}};
+			r.ops = perBroker * brokers;
+			r.nsPerOp = s * 1e9 / static_cast<double>(r.ops);
+			r.opsPerSec = static_cast<double>(r.ops) / s;
+			report(r);
+		}
+	}
+}
+
+// ===== много инструментов: поток заявок по тысячам символов, шардов 1..8 =====
+void benchShardedSymbols() {
+	const std::string name = "exchange.sharded_symbols";
+	if (!enabled(name)) return;
+	constexpr int kSymbols = 4096;
+	constexpr int kProducers = 4;
+	const long long perProducer = opts.quick ? 50000 : 500000;
+
+	for (const int shardCount : {1, 2, 4, 8}) {
+		Exchange ex(ExchangeConfig{.instruments = kSymbols, .shards = static_cast<std::size_t>(shardCount)});
+		ex.setFee(0.0, 0);
+		ex.setConsoleOutput(false);
+		std::thread loop([&] { ex.runLoop(); });
+
+		const auto start = Clock::now();
+		std::vector<std::thread> ts;
+		for (int p = 0; p < kProducers; ++p)
+			ts.emplace_back([&, p] {
+				std::mt19937 rng(p + 1);
+				std::uniform_int_distribution<int> sym(0, kSymbols - 1);
+				std::uniform_int_distribution<int> tick(-5, 5);
+				for (long long i = 0; i < perProducer; ++i)
+					ex.submitOrder({p + 1, OrderType::Limit, (i & 1) ? OrderSide::Buy : OrderSide::Sell, 0, 1,
+					                100 + tick(rng) / 100.0, 0, static_cast<Symbol>(sym(rng))});
+			});
+		for (auto& t : ts) t.join();
+		while (ex.ingressStats().drained < static_cast<std::size_t>(perProducer * kProducers))
+			std::this_thread::yield();
+		const double s = seconds(start);
+		ex.stop();
+		loop.join();
+
+		Result r{name, {{"symbols", kSymbols}, {"shards", shardCount}, {"producers", kProducers},
+		                {"trades", static_cast<long long>(ex.tradeCount())}}};
+		r.ops = perProducer * kProducers;
+		r.nsPerOp = s * 1e9 / static_cast<double>(r.ops);
+		r.opsPerSec = static_cast<double>(r.ops) / s;
+		report(r);
+	}
+}
+
+// ===== шаги стратегий: пул StrategyScheduler против потока на брокера =====
+class NoopBroker final : public Broker {
+public:
+	using Broker::Broker;
+	void step(int t) override { sinkHole = sinkHole + t; }
+};
+
+void benchScheduler() {
+	const auto window = std::chrono::milliseconds(opts.quick ? 100 : 500);
+
+	for (const int count : {100, 1000, 10000, 50000}) {
+		Exchange ex;
+		std::vector<std::shared_ptr<Broker>> brokers;
+		for (int id = 0; id < count; ++id) brokers.push_back(std::make_shared<NoopBroker>(id, 0, 0, ex));
+
+		if (enabled("scheduler.pool_steps")) {
+			StrategyScheduler sched(SchedulerConfig{.mode = ScheduleMode::RoundRobin});
+			for (auto& b : brokers) sched.add(b, std::chrono::microseconds(0));
+			const auto start = Clock::now();
+			sched.start();
+			std::this_thread::sleep_for(window);
+			sched.stop();
+			const double s = seconds(start);
+			Result r{"scheduler.pool_steps", {{"brokers", count}, {"threads", static_cast<long long>(sched.threadCount())}}};
+			r.ops = static_cast<long long>(sched.steps());
+			r.opsPerSec = static_cast<double>(r.ops) / s;
+			r.nsPerOp = s * 1e9 / static_cast<double>(std::max(1LL, r.ops));
+			report(r);
+		}
+
+		// прежняя модель из main.cpp: поток на брокера, step и sleep 20 мс;
+		// 10000 потоков ОС - как раз то, что заменяет пул, мерим до 1000
+		if (enabled("scheduler.thread_per_broker_20ms") && count <= 1000) {
+			std::atomic<bool> alive{true};
+			std::atomic<long long> total{0};
+			std::vector<std::thread> ts;
+			const auto start = Clock::now();
+			for (auto& b : brokers)
+				ts.emplace_back([&, b] {
+					long long n = 0;
+					while (alive.load(std::memory_order_relaxed)) {
+						b->step(static_cast<int>(n++));
+						std::this_thread::sleep_for(std::chrono::milliseconds(20));
+					}
+					total += n;
+				});
+			std::this_thread::sleep_for(window);
+			alive = false;
+			for (auto& t : ts) t.join();
+			const double s = seconds(start);
+			Result r{"scheduler.thread_per_broker_20ms", {{"brokers", count}, {"target_steps_per_sec", count * 50LL}}};
+			r.ops = total;
+			r.opsPerSec = static_cast<double>(r.ops) / s;
+			r.nsPerOp = s * 1e9 / static_cast<double>(std::max(1LL, r.ops));
+			report(r);
+		}
+
+		if (enabled("scheduler.pool_20ms")) {
+			StrategyScheduler sched;
+			for (auto& b : brokers) sched.add(b, std::chrono::milliseconds(20));
+			const auto start = Clock::now();
+			sched.start();
+			std::this_thread::sleep_for(window);
+			sched.stop();
+			const double s = seconds(start);
+			Result r{"scheduler.pool_20ms", {{"brokers", count}, {"target_steps_per_sec", count * 50LL},
+			                                 {"threads", static_cast<long long>(sched.threadCount())}}};
+			r.ops = static_cast<long long>(sched.steps());
+			r.opsPerSec = static_cast<double>(r.ops) / s;
+			r.nsPerOp = s * 1e9 / static_cast<double>(std::max(1LL, r.ops));
+			report(r);
+		}
+	}
+
+	// настоящие стратегии с шагом 20 мс: держит ли пул целевую частоту
+	if (enabled("scheduler.player_20ms")) {
+		for (const int count : {1000, 10000}) {
+			Exchange ex;
+			ex.setFee(0.0, 0);
+			ex.setConsoleOutput(false);
+			StrategyScheduler sched;
+			for (int id = 1; id <= count; ++id) {
+				auto p = std::make_shared<PlayerBroker>(id, 1e9, 1000000, ex);
+				ex.registerBroker(p);
+				sched.add(p, std::chrono::milliseconds(20));
+			}
+			std::thread loop([&] { ex.runLoop(); });
+			const auto start = Clock::now();
+			sched.start();
+			std::this_thread::sleep_for(std::chrono::milliseconds(opts.quick ? 200 : 1000));
+			sched.stop();
+			const double s = seconds(start);
+			ex.stop();
+			loop.join();
+
+			Result r{"scheduler.player_20ms", {{"brokers", count}, {"target_steps_per_sec", count * 50LL},
+			                                   {"trades", static_cast<long long>(ex.tradeCount())}}};
+			r.ops = static_cast<long long>(sched.steps());
+			r.opsPerSec = static_cast<double>(r.ops) / s;
+			r.nsPerOp = s * 1e9 / static_cast<double>(std::max(1LL, r.ops));
+			report(r);
+		}
+	}
+}
+
+// ===== L2-фид: цена публикации не зависит от числа подписчиков =====
+void benchFeed() {
+	const std::string name = "feed.publish";
+	if (!enabled(name)) return;
+	const long long events = opts.quick ? 200000 : 2000000;
+
+	for (const int consumers : {0, 1, 4, 16}) {
+		report(timeOps(name, {{"consumers", consumers}}, events, [&](long long n) {
+			FeedRing ring(1 << 16);
+			std::atomic<bool> alive{true};
+			std::vector<std::thread> ts;
+			for (int c = 0; c < consumers; ++c)
+				ts.emplace_back([&] {
+					DepthView view(ring);
+					while (alive.load(std::memory_order_relaxed))
+						if (view.poll(256) == 0) std::this_thread::yield();
+				});
+			const auto start = Clock::now();
+			for (long long i = 0; i < n; ++i)
+				ring.publish({0, 100 + static_cast<double>(i % 10), i % 7, 0, MdKind::Modify, OrderSide::Buy, 0});
+			const double s = seconds(start);
+			alive = false;
+			for (auto& t : ts) t.join();
+			return s;
+		}));
+	}
+}
+
+std::string toJson() {
+	std::ostringstream os;
+	os << "{\n  \"benchmarks\": [\n";
+	for (std::size_t i = 0; i < results.size(); ++i) {
+		const Result& r = results[i];
+		os << "    {\"name\": \"" << r.name << "\", \"params\": {";
+		for (std::size_t k = 0; k < r.params.size(); ++k)
+			os << (k ? ", " : "") << "\"" << r.params[k].first << "\": " << r.params[k].second;
+		os << "}, \"ns_per_op\": " << r.nsPerOp
+		   << ", \"ops_per_sec\": " << r.opsPerSec
+		   << ", \"ops\": " << r.ops << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+	}
+	os << "  ]\n}\n";
+	return os.str();
+}
+
+} // namespace
+
+// ===== TradeStore: запись с вытеснением и запрос узкого окна в длинной истории =====
+void benchTradeStore() {
+	const long long rows = opts.quick ? 1000000 : 10000000;
+
+	if (enabled("trades.append")) {
+		for (const int retention : {0, 1000}) {
+			report(timeOps("trades.append", {{"retention_ticks", retention}}, rows, [&](long long n) {
+				TradeStore store({.retentionTicks = retention});
+				std::vector<Trade> batch(256);
+				const auto start = Clock::now();
+				for (long long i = 0; i < n; i += 256) {
+					for (std::size_t k = 0; k < batch.size(); ++k)
+						batch[k] = {1, 2, 100.0 + static_cast<double>(k % 5), 1, static_cast<int>((i + k) / 100), 0};
+					store.append(batch);
+				}
+				return seconds(start);
+			}));
+		}
+	}
+
+	if (enabled("trades.query")) {
+		TradeStore store;
+		std::vector<Trade> batch(256);
+		for (long long i = 0; i < rows; i += 256) {
+			for (std::size_t k = 0; k < batch.size(); ++k)
+				batch[k] = {1, 2, 100.0, 1, static_cast<int>((i + k) / 100), 0};
+			store.append(batch);
+		}
+		const int lastTick = static_cast<int>(rows / 100);
+		const long long calls = opts.quick ? 10000 : 100000;
+		report(timeOps("trades.query", {{"rows", rows}, {"window_ticks", 10}}, calls, [&](long long n) {
+			const auto start = Clock::now();
+			for (long long i = 0; i < n; ++i) {
+				const int from = static_cast<int>(i * 7919 % (lastTick - 10));
+				sinkHole = sinkHole + static_cast<double>(store.query(from, from + 10).size());
+			}
+			return seconds(start);
+		}));
+	}
+}
+
+// ===== Оценка всех счетов по рынку: ядро по столбцам и полный пересчёт со съёмом балансов =====
+void benchRisk() {
+	const std::string name = "risk";
+	if (!enabled(name)) return;
+
+	for (const int accounts : {1000, 10000, 100000}) {
+		AccountTable table;
+		std::mt19937 rng(1);
+		std::uniform_int_distribution<int> inv(-100, 100);
+		for (int id = 0; id < accounts; ++id) table.open(id, toCash(10000 + id % 1000), inv(rng));
+		// ядро отдельно - по уже снятым столбцам всех блоков, без съёма балансов;
+		// инструмент один, так что позиции блоков склеиваются так же, как деньги
+		AccountColumns columns, block;
+		for (std::size_t c = 0; c < table.blockCount(); ++c) {
+			table.exportBlock(c, block);
+			columns.active.insert(columns.active.end(), block.active.begin(), block.active.end());
+			columns.cash.insert(columns.cash.end(), block.cash.begin(), block.cash.end());
+			columns.inventory.insert(columns.inventory.end(), block.inventory.begin(), block.inventory.end());
+			columns.startCash.insert(columns.startCash.end(), block.startCash.begin(), block.startCash.end());
+			columns.startInventory.insert(columns.startInventory.end(), block.startInventory.begin(), block.startInventory.end());
+		}
+		RiskColumns marks;
+		const std::array<double, 1> mark{100.0};
+		const long long passes = std::max(10LL, (opts.quick ? 2000000LL : 20000000LL) / accounts);
+
+		for (const RiskKernel kernel : {RiskKernel::Scalar, RiskKernel::Avx2}) {
+			if (resolveRiskKernel(kernel) != kernel) continue;
+			const long long kernelId = kernel == RiskKernel::Avx2 ? 1 : 0;
+			report(timeOps("risk.kernel", {{"accounts", accounts}, {"avx2", kernelId}}, passes, [&](long long n) {
+				const auto start = Clock::now();
+				for (long long i = 0; i < n; ++i)
+					sinkHole = sinkHole + markAccounts(kernel, columns, mark, marks).equity;
+				return seconds(start);
+			}));
+			report(timeOps("risk.update", {{"accounts", accounts}, {"avx2", kernelId}}, passes, [&](long long n) {
+				RiskEngine engine(kernel);
+				const auto start = Clock::now();
+				for (long long i = 0; i < n; ++i)
+					sinkHole = sinkHole + engine.update(table, mark, static_cast<int>(i)).sums.pnl;
+				return seconds(start);
+			}));
+		}
+	}
+}
+
+// ===== Предторговый контроль: цена проверки с резервом и её влияние на поток заявок =====
+void benchRiskGate() {
+	const long long orders = opts.quick ? 1000000 : 10000000;
+
+	if (enabled("risk.gate_admit")) {
+		AccountTable table;
+		table.open(1, toCash(1e12), 1'000'000'000);
+		RiskGate gate(table, {.maxOrderNotional = 1e9, .maxPosition = 1'000'000'000'000LL, .maxOpenOrders = 1 << 30});
+		// admit и снятие резерва - то, что заявка добавляет к пути submit и исполнения
+		report(timeOps("risk.gate_admit", {}, orders, [&](long long n) {
+			bool reserved = false;
+			const auto start = Clock::now();
+			for (long long i = 0; i < n; ++i) {
+				const Order o{1, OrderType::Limit, (i & 1) ? OrderSide::Buy : OrderSide::Sell, 0, 1, 100, 0};
+				if (gate.admit(o, toCash(100), 0, reserved) == RiskReject::None)
+					gate.release(1, 0, o.side, 1, toCash(100), true);
+			}
+			return seconds(start);
+		}));
+	}
+
+	if (enabled("exchange.submit_gate")) {
+		constexpr int kProducers = 4;
+		const long long perProducer = opts.quick ? 50000 : 500000;
+		for (const bool on : {false, true}) {
+			Exchange ex(ExchangeConfig{.riskEveryTicks = 0, .preTradeRisk = on});
+			ex.setFee(0.0, 0);
+			ex.setConsoleOutput(false);
+			std::vector<std::shared_ptr<Broker>> brokers;
+			for (int p = 0; p < kProducers; ++p) {
+				brokers.push_back(std::make_shared<PlayerBroker>(p + 1, 1e12, 1'000'000'000, ex));
+				ex.registerBroker(brokers.back());
+			}
+			std::thread loop([&] { ex.runLoop(); });
+
+			const auto start = Clock::now();
+			std::vector<std::thread> ts;
+			for (int p = 0; p < kProducers; ++p)
+				ts.emplace_back([&, p] {
+					for (long long i = 0; i < perProducer; ++i)
+						ex.submitOrder({p + 1, OrderType::Limit, (i & 1) ? OrderSide::Buy : OrderSide::Sell, 0, 1,
+						                (i & 1) ? 99.0 - static_cast<double>(i % 7) / 100 : 101.0, 0});
+				});
+			for (auto& t : ts) t.join();
+			while (ex.ingressStats().drained < static_cast<std::size_t>(perProducer * kProducers))
+				std::this_thread::yield();
+			const double s = seconds(start);
+			ex.stop();
+			loop.join();
+
+			Result r{"exchange.submit_gate", {{"gate", on ? 1 : 0}, {"producers", kProducers}}};
+			r.ops = perProducer * kProducers;
+			r.nsPerOp = s * 1e9 / static_cast<double>(r.ops);
+			r.opsPerSec = static_cast<double>(r.ops) / s;
+			report(r);
+		}
+	}
+}
+
+void benchStats() {
+	const long long ops = opts.quick ? 2000000 : 20000000;
+	// цена телеметрии на горячем пути; при -DSTOCK_STATS=OFF оба замера - пустой цикл
+	if (enabled("stats.count")) {
+		report(timeOps("stats.count", {}, ops, [&](long long n) {
+			const auto start = Clock::now();
+			for (long long i = 0; i < n; ++i) telemetry::count(StatCounter::Orders);
+			return seconds(start);
+		}));
+	}
+	if (enabled("stats.record")) {
+		report(timeOps("stats.record", {}, ops, [&](long long n) {
+			const auto start = Clock::now();
+			for (long long i = 0; i < n; ++i) telemetry::record(StatLatency::FairPrice, telemetry::now());
+			return seconds(start);
+		}));
+	}
+}
+
+// ===== популяция брокеров: столбцы и один цикл против объекта Broker на каждого =====
+void benchPopulation() {
+	for (const long long size : {1000LL, 100000LL}) {
+		const long long steps = std::max(1LL, (opts.quick ? 2000000 : 20000000) / size);
+		if (enabled("population.generate")) {
+			Exchange ex;
+			BrokerPopulation<PlayerStrategy> pop(ex, {.firstId = 1, .size = static_cast<std::size_t>(size)});
+			report(timeOps("population.generate", {{"brokers", size}}, steps * size, [&](long long n) {
+				const auto start = Clock::now();
+				for (long long t = 0; t < n / size; ++t) pop.generate(static_cast<int>(t));
+				return seconds(start);
+			}));
+		}
+
+		// шаг с отправкой в стакан (цикл биржи не запущен - заявки идут прямо в стакан)
+		const long long submitSteps = opts.quick ? 3 : 10;
+		if (enabled("population.step")) {
+			Exchange ex(ExchangeConfig{.preTradeRisk = false});
+			ex.setConsoleOutput(false);
+			BrokerPopulation<PlayerStrategy> pop(ex, {.firstId = 1, .size = static_cast<std::size_t>(size),
+			                                          .cash = 1e12, .inventory = 1'000'000'000});
+			report(timeOps("population.step", {{"brokers", size}}, submitSteps * size, [&](long long n) {
+				const auto start = Clock::now();
+				for (long long t = 0; t < n / size; ++t) pop.step(static_cast<int>(t));
+				return seconds(start);
+			}));
+		}
+		if (enabled("brokers.step")) {
+			Exchange ex(ExchangeConfig{.preTradeRisk = false});
+			ex.setConsoleOutput(false);
+			std::vector<std::shared_ptr<Broker>> brokers;
+			for (long long i = 0; i < size; ++i) {
+				brokers.push_back(std::make_shared<PlayerBroker>(static_cast<int>(i + 1), 1e12, 1'000'000'000, ex));
+				ex.registerBroker(brokers.back());
+			}
+			report(timeOps("brokers.step", {{"brokers", size}}, submitSteps * size, [&](long long n) {
+				const auto start = Clock::now();
+				for (long long t = 0; t < n / size; ++t)
+					for (const auto& b : brokers) b->step(static_cast<int>(t));
+				return seconds(start);
+			}));
+		}
+	}
+}
+
+// ===== снапшот: запись и восстановление стаканов с миллионами заявок =====
+void benchSnapshot() {
+	if (!enabled("snapshot.save") && !enabled("snapshot.restore")) return;
+	const long long orders = opts.quick ? 200000 : 2000000;
+	const std::string path = (std::filesystem::temp_directory_path() / "stock_bench.snap").string();
+	for (const BookKind kind : {BookKind::Map, BookKind::Ladder}) {
+		const ExchangeConfig config{.book = kind, .instruments = 4};
+		{
+			Exchange ex(config);
+			for (int id = 1; id <= 1000; ++id) ex.registerAccount(id, 1e12, 1'000'000'000);
+			// покупки на 50..99.99, продажи на 100.01..150: стакан не сводится
+			for (long long i = 0; i < orders; ++i) {
+				const bool buy = i & 1;
+				const double off = static_cast<double>(i % 5000) / 100;
+				ex.submitOrder({static_cast<int>(i % 1000) + 1, OrderType::Limit, buy ? OrderSide::Buy : OrderSide::Sell,
+				                0, 1 + static_cast<int>(i % 7), buy ? 99.99 - off : 100.01 + off, 0,
+				                static_cast<Symbol>(i % 4)});
+			}
+			if (enabled("snapshot.save"))
+				report(timeOps(std::string("snapshot.save.") + bookName(kind), {{"orders", orders}}, orders, [&](long long) {
+					const auto start = Clock::now();
+					ex.saveSnapshot(path);
+					return seconds(start);
+				}));
+			else
+				ex.saveSnapshot(path);
+		}
+		if (enabled("snapshot.restore"))
+			report(timeOps(std::string("snapshot.restore.") + bookName(kind), {{"orders", orders}}, orders, [&](long long) {
+				Exchange ex(config);
+				const auto start = Clock::now();
+				ex.loadSnapshot(path);
+				return seconds(start);
+			}));
+	}
+	std::filesystem::remove(path);
+}
+
+// ===== всплеск пересекающихся заявок: сведение после каждой против одного аукциона =====
+void benchAuction() {
+	for (const BookKind kind : {BookKind::Map, BookKind::Ladder}) {
+		for (const bool auction : {false, true}) {
+			const std::string name = std::string(auction ? "book.auction." : "book.continuous.") + bookName(kind);
+			if (!enabled(name)) continue;
+			const long long orders = opts.quick ? 20000 : 200000;
+			// вызов аукциона на каждую тысячу заявок - интервал с потоком заявок между вызовами
+			const long long batch = 1000;
+
+			report(timeOps(name, {{"orders", orders}, {"batch", auction ? batch : 1}}, orders, [&](long long n) {
+				auto book = makeBook(kind, 100);
+				std::mt19937 rng(7);
+				std::uniform_int_distribution<int> tick(9950, 10050), qty(1, 9), broker(1, 1000);
+				std::vector<Order> burst;
+				for (long long i = 0; i < n; ++i)
+					burst.push_back({broker(rng), OrderType::Limit, (i & 1) ? OrderSide::Buy : OrderSide::Sell,
+					                 static_cast<std::size_t>(i + 1), qty(rng), tick(rng) / 100.0, 0});
+
+				std::vector<Trade> buf(256);
+				std::vector<Trade> trades;
+				const auto start = Clock::now();
+				for (long long i = 0; i < n; ++i) {
+					book->addOrder(burst[static_cast<std::size_t>(i)]);
+					if (!auction)
+						while (book->matchAll(0, buf) == buf.size()) {}
+					else if ((i + 1) % batch == 0 || i + 1 == n)
+						book->auction(0, {}, trades);
+				}
+				const double s = seconds(start);
+				sinkHole = sinkHole + static_cast<double>(trades.size());
+				return s;
+			}));
+		}
+	}
+}
+
+int main(int argc, char** argv) {
+	for (int i = 1; i < argc; ++i) {
+		const std::string a = argv[i];
+		if (a == "--filter" && i + 1 < argc)   opts.filter = argv[++i];
+		else if (a == "--out" && i + 1 < argc) opts.out = argv[++i];
+		else if (a == "--quick")               opts.quick = true;
+		else {
+			std::cerr << "usage: " << argv[0] << " [--filter substr] [--out results.json] [--quick]\n";
+			return 2;
+		}
+	}
+
+	benchAddOrder();
+	benchSweep();
+	benchBestBidContention();
+	benchFairPrice();
+	benchExchangeEndToEnd();
+	benchShardedSymbols();
+	benchScheduler();
+	benchFeed();
+	benchTradeStore();
+	benchRisk();
+	benchRiskGate();
+	benchStats();
+	benchPopulation();
+	benchSnapshot();
+	benchAuction();
+
+	const std::string json = toJson();
+	if (opts.out.empty()) {
+		std::cout << json;
+	} else {
+		std::ofstream(opts.out) << json;
+	}
+}
@@ -1,10 +1,17 @@
+#include <iostream>
+#include <string>
 #include <thread>
-#include <atomic>
 #include <chrono>
 #include "src/Exchange.h"
 #include "src/Broker.h"
-
-int main() {
+#include "src/Simulation.h"
+#include "src/StrategyScheduler.h"
+#include "src/Stats.h"
+
+// stock_app              - 5 секунд торгов в реальном времени
+// stock_app --sim <сек>  - столько же рыночного времени на виртуальных часах, без пауз
+int main(int argc, char** argv) {
+	const bool simulate = argc >= 3 && std::string(argv[1]) == "--sim";
 	Exchange ex;
 	ex.setFee(0.5, 50);
 
@@ -18,35 +25,36 @@ int main() {
 	ex.registerBroker(analyst);
 	ex.registerBroker(big);
 
-
-
-	std::atomic<bool> alive{true};
+	if (simulate) {
+		// тик биржи 20 мс - 50 тиков на секунду рыночного времени
+		const int ticks = std::stoi(argv[2]) * 50;
+		ex.setConsoleOutput(false);
+		Simulation sim(ex);
+		for (const auto& br : std::initializer_list<std::shared_ptr<Broker>>{player2, player, analyst, big})
+			sim.add(br);
+
+		const auto start = std::chrono::steady_clock::now();
+		sim.run(ticks);
+		const std::chrono::duration<double> wall = std::chrono::steady_clock::now() - start;
+		std::cout << "SIM: ticks=" << ticks << " trades=" << ex.tradeCount() << " wall=" << wall.count() << "s\n";
+		printRiskReport(std::cout, ex.riskTotals());
+		return 0;
+	}
+
+	// все стратегии шагают раз в 20 мс на общем пуле потоков
+	StrategyScheduler scheduler;
+	for (const auto& br : std::initializer_list<std::shared_ptr<Broker>>{player2, player, analyst, big})
+		scheduler.add(br, std::chrono::milliseconds(20));
 
 	std::thread exchangeThread([&] { ex.runLoop(); });
-
-	auto brokerLoop = [&](const std::shared_ptr<Broker>& br){
-		int t = 0;
-		while (alive) {
-			br->step(t++);
-			std::this_thread::sleep_for(std::chrono::milliseconds(20));
-		}
-	};
-
-
-	std::thread t1(brokerLoop, player2);
-	std::thread t2(brokerLoop, player);
-	std::thread t3(brokerLoop, analyst);
-	std::thread t4(brokerLoop, big);
-
+	scheduler.start();
 
 	std::this_thread::sleep_for(std::chrono::seconds(5));
 
-	alive = false;
+	scheduler.stop();
 	ex.stop();
 
-	t1.join();
-	t2.join();
-	t3.join();
-	t4.join();
 	exchangeThread.join();
+
+	telemetry::print(std::cout, ex.stats());
 }
@@ -0,0 +1,202 @@
+#include "AccountTable.h"
+
+#include <algorithm>
+#include <cmath>
+
+Cash toCash(double value) {
+    return std::llround(value * static_cast<double>(kCashScale));
+}
+
+double fromCash(Cash value) {
+    return static_cast<double>(value) / static_cast<double>(kCashScale);
+}
+
+AccountTable::AccountTable(std::size_t symbols) : symbolCount(std::max<std::size_t>(symbols, 1)) {}
+
+AccountTable::~AccountTable() {
+    for (auto& c : chunks) {
+        Block* b = c.load(std::memory_order_relaxed);
+        if (!b) continue;
+        for (std::size_t s = 0; s < symbolCount; ++s) delete b->positions[s].load(std::memory_order_relaxed);
+        delete b;
+    }
+}
+
+AccountTable::Block* AccountTable::find(int id, std::size_t& row) const {
+    if (id < 0 || static_cast<std::size_t>(id) >= kMaxAccounts) return nullptr;
+    const auto i = static_cast<std::size_t>(id);
+    Block* b = chunks[i / kChunk].load(std::memory_order_acquire);
+    if (!b) return nullptr;
+    row = i % kChunk;
+    return b->accounts[row].active.load(std::memory_order_acquire) ? b : nullptr;
+}
+
+AccountTable::Positions& AccountTable::positions(Block& block, Symbol symbol) {
+    std::atomic<Positions*>& slot = block.positions[symbol];
+    Positions* p = slot.load(std::memory_order_acquire);
+    if (p) return *p;
+    // пишет обычно один шард инструмента, но open идёт из других потоков - публикация через CAS
+    auto fresh = std::make_unique<Positions>();
+    if (slot.compare_exchange_strong(p, fresh.get(), std::memory_order_acq_rel)) return *fresh.release();
+    return *p;
+}
+
+bool AccountTable::open(int id, Cash cash, long long inventory, Symbol symbol) {
+    if (id < 0 || static_cast<std::size_t>(id) >= kMaxAccounts || symbol >= symbolCount) return false;
+    const auto i = static_cast<std::size_t>(id);
+    const std::size_t row = i % kChunk;
+
+    std::lock_guard<std::mutex> lk(openMutex);
+    Block* b = chunks[i / kChunk].load(std::memory_order_relaxed);
+    if (!b) {
+        b = new Block(symbolCount);
+        chunks[i / kChunk].store(b, std::memory_order_release);
+    }
+    Account& a = b->accounts[row];
+    if (!a.active.load(std::memory_order_relaxed)) opened.fetch_add(1, std::memory_order_relaxed);
+    a.cash.store(cash, std::memory_order_relaxed);
+    a.startCash.store(cash, std::memory_order_relaxed);
+    for (std::size_t s = 0; s < symbolCount; ++s) {
+        if (Positions* p = b->positions[s].load(std::memory_order_acquire)) {
+            p->inventory[row].store(0, std::memory_order_relaxed);
+            p->startInventory[row].store(0, std::memory_order_relaxed);
+        }
+    }
+    if (inventory) {
+        Positions& p = positions(*b, symbol);
+        p.inventory[row].store(inventory, std::memory_order_relaxed);
+        p.startInventory[row].store(inventory, std::memory_order_relaxed);
+    }
+    a.active.store(true, std::memory_order_release);
+    // кто увидел новое поколение, должен увидеть и новый maxId
+    if (id > maxId.load(std::memory_order_relaxed)) maxId.store(id, std::memory_order_release);
+    openGeneration.fetch_add(1, std::memory_order_release);
+    return true;
+}
+
+void AccountTable::settle(int buyerId, int sellerId, Cash notional, int quantity, Symbol symbol) {
+    if (symbol >= symbolCount) return;
+    std::size_t row = 0;
+    if (Block* b = find(buyerId, row)) {
+        b->accounts[row].cash.fetch_sub(notional, std::memory_order_relaxed);
+        positions(*b, symbol).inventory[row].fetch_add(quantity, std::memory_order_relaxed);
+    }
+    if (Block* b = find(sellerId, row)) {
+        b->accounts[row].cash.fetch_add(notional, std::memory_order_relaxed);
+        positions(*b, symbol).inventory[row].fetch_sub(quantity, std::memory_order_relaxed);
+    }
+}
+
+void AccountTable::chargeAll(Cash fee) {
+    const int last = maxId.load(std::memory_order_acquire);
+    for (int c = 0; c <= last / static_cast<int>(kChunk); ++c) {
+        Block* b = chunks[static_cast<std::size_t>(c)].load(std::memory_order_acquire);
+        if (!b) continue;
+        for (Account& a : b->accounts)
+            if (a.active.load(std::memory_order_relaxed)) a.cash.fetch_sub(fee, std::memory_order_relaxed);
+    }
+}
+
+AccountSnapshot AccountTable::snapshot(int id, Symbol symbol) const {
+    Cash cash = 0;
+    long long inventory = 0;
+    if (!balance(id, cash, inventory, symbol)) return {};
+    return {true, fromCash(cash), inventory};
+}
+
+bool AccountTable::balance(int id, Cash& cash, long long& inventory, Symbol symbol) const {
+    std::size_t row = 0;
+    const Block* b = symbol < symbolCount ? find(id, row) : nullptr;
+    if (!b) return false;
+    cash = b->accounts[row].cash.load(std::memory_order_relaxed);
+    const Positions* p = b->positions[symbol].load(std::memory_order_acquire);
+    inventory = p ? p->inventory[row].load(std::memory_order_relaxed) : 0;
+    return true;
+}
+
+std::size_t AccountTable::blockCount() const {
+    const int last = maxId.load(std::memory_order_acquire);
+    return last < 0 ? 0 : static_cast<std::size_t>(last) / kChunk + 1;
+}
+
+void AccountTable::exportBlock(std::size_t index, AccountColumns& out) const {
+    out.active.resize(kChunk);
+    out.cash.resize(kChunk);
+    out.startCash.resize(kChunk);
+    out.inventory.resize(kChunk * symbolCount);
+    out.startInventory.resize(kChunk * symbolCount);
+    const Block* b = index < chunks.size() ? chunks[index].load(std::memory_order_acquire) : nullptr;
+    if (!b) {
+        std::fill(out.active.begin(), out.active.end(), 0);
+        for (auto* column : {&out.cash, &out.startCash, &out.inventory, &out.startInventory})
+            std::fill(column->begin(), column->end(), 0.0);
+        return;
+    }
+    // Указатели - в локальных: запись байта active иначе заставляет перечитывать их на каждой строке
+    std::uint8_t* active = out.active.data();
+    double* cash = out.cash.data();
+    double* startCash = out.startCash.data();
+    for (std::size_t k = 0; k < kChunk; ++k) {
+        const Account& a = b->accounts[k];
+        active[k] = a.active.load(std::memory_order_acquire);
+        cash[k] = static_cast<double>(a.cash.load(std::memory_order_relaxed));
+        startCash[k] = static_cast<double>(a.startCash.load(std::memory_order_relaxed));
+    }
+    // позиции инструмента лежат подряд - копия идёт по целым линиям
+    for (std::size_t s = 0; s < symbolCount; ++s) {
+        double* inventory = out.inventory.data() + s * kChunk;
+        double* startInventory = out.startInventory.data() + s * kChunk;
+        const Positions* p = b->positions[s].load(std::memory_order_acquire);
+        if (!p) {
+            std::fill(inventory, inventory + kChunk, 0.0);
+            std::fill(startInventory, startInventory + kChunk, 0.0);
+            continue;
+        }
+        for (std::size_t k = 0; k < kChunk; ++k) {
+            inventory[k] = static_cast<double>(p->inventory[k].load(std::memory_order_relaxed));
+            startInventory[k] = static_cast<double>(p->startInventory[k].load(std::memory_order_relaxed));
+        }
+    }
+}
+
+void AccountTable::exportRecords(std::vector<AccountRecord>& accounts, std::vector<PositionRecord>& positions) const {
+    const int last = maxId.load(std::memory_order_acquire);
+    for (int c = 0; c <= last / static_cast<int>(kChunk); ++c) {
+        const Block* b = chunks[static_cast<std::size_t>(c)].load(std::memory_order_acquire);
+        if (!b) continue;
+        for (std::size_t k = 0; k < kChunk; ++k) {
+            const Account& a = b->accounts[k];
+            if (!a.active.load(std::memory_order_acquire)) continue;
+            const int id = c * static_cast<int>(kChunk) + static_cast<int>(k);
+            accounts.push_back({id, 0, a.cash.load(std::memory_order_relaxed), a.startCash.load(std::memory_order_relaxed)});
+            for (std::size_t s = 0; s < symbolCount; ++s) {
+                const Positions* p = b->positions[s].load(std::memory_order_acquire);
+                if (!p) continue;
+                const long long inventory = p->inventory[k].load(std::memory_order_relaxed);
+                const long long start = p->startInventory[k].load(std::memory_order_relaxed);
+                if (inventory || start) positions.push_back({id, static_cast<std::uint16_t>(s), 0, inventory, start});
+            }
+        }
+    }
+}
+
+bool AccountTable::restore(const AccountRecord& r) {
+    if (!open(r.id, r.startCash, 0)) return false;
+    std::size_t row = 0;
+    find(r.id, row)->accounts[row].cash.store(r.cash, std::memory_order_relaxed);
+    return true;
+}
+
+bool AccountTable::restore(const PositionRecord& r) {
+    std::size_t row = 0;
+    Block* b = r.symbol < symbolCount ? find(r.id, row) : nullptr;
+    if (!b) return false;
+    Positions& p = positions(*b, r.symbol);
+    p.inventory[row].store(r.inventory, std::memory_order_relaxed);
+    p.startInventory[row].store(r.startInventory, std::memory_order_relaxed);
+    return true;
+}
+
+std::size_t AccountTable::size() const {
+    return opened.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,143 @@
+#ifndef ACCOUNTTABLE_H
+#define ACCOUNTTABLE_H
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "Order.h"
+
+// Деньги в целых миллионных долях: сложения в расчётах точные и атомарные.
+using Cash = std::int64_t;
+inline constexpr Cash kCashScale = 1'000'000;
+
+Cash toCash(double value);
+double fromCash(Cash value);
+
+// деньги счёта и позиция по одному инструменту
+struct AccountSnapshot {
+    bool registered{};
+    double cash{};
+    long long inventory{};
+};
+
+// Деньги счёта в исходных единицах, запись файла снапшота биржи.
+struct AccountRecord {
+    std::int32_t id{};
+    std::int32_t reserved{};
+    Cash cash{};
+    Cash startCash{};
+};
+static_assert(sizeof(AccountRecord) == 24);
+
+// Позиция счёта по инструменту, запись снапшота; нулевые не пишутся.
+struct PositionRecord {
+    std::int32_t id{};
+    std::uint16_t symbol{};
+    std::uint16_t reserved{};
+    std::int64_t inventory{};
+    std::int64_t startInventory{};
+};
+static_assert(sizeof(PositionRecord) == 24);
+
+// Балансы столбцами, для пакетных расчётов по всем брокерам (см. RiskEngine).
+// Строка - счёт по порядку id: у неоткрытых все поля нулевые и active = 0.
+// Деньги - в единицах Cash (целые миллионные доли), переводит в деньги тот, кто считает.
+// Позиции - size() строк инструмента 0, за ними столько же инструмента 1 и так далее.
+struct AccountColumns {
+    std::vector<std::uint8_t> active;
+    std::vector<double> cash;
+    std::vector<double> startCash;
+    std::vector<double> inventory;
+    std::vector<double> startInventory;
+
+    [[nodiscard]] std::size_t size() const { return cash.size(); }
+    [[nodiscard]] std::size_t symbols() const { return cash.empty() ? 0 : inventory.size() / cash.size(); }
+};
+
+// Счета брокеров, плоский массив по id. Деньги счёта - своя кэш-линия.
+// Позиции - отдельно по каждому инструменту, столбцом на блок счетов: инструмент сводит
+// один шард, и его записи не делят линий с записями других шардов.
+// Расчёт сделки и комиссия - атомарные сложения без мьютексов и счётчиков ссылок,
+// поэтому шарды могут одновременно проводить сделки одного брокера.
+// snapshot читает деньги и позицию за O(1), но не атомарно вместе: посреди
+// расчёта сделки они могут на мгновение расходиться.
+// Память выделяется блоками по kChunk счетов (позиции блока - при первой по инструменту)
+// и не освобождается до разрушения таблицы.
+class AccountTable final {
+public:
+    static constexpr std::size_t kChunk = 1024;
+    static constexpr std::size_t kMaxAccounts = std::size_t{1} << 20;
+
+    // symbols - инструменты 0..symbols-1, по которым ведутся позиции
+    explicit AccountTable(std::size_t symbols = 1);
+    AccountTable(const AccountTable&) = delete;
+    AccountTable& operator=(const AccountTable&) = delete;
+    ~AccountTable();
+
+    // Открыть (или переоткрыть) счёт с начальным балансом: деньги и позиция inventory по symbol,
+    // по остальным инструментам ноль. false - id вне [0, kMaxAccounts) или нет такого инструмента.
+    bool open(int id, Cash cash, long long inventory, Symbol symbol = 0);
+
+    // Сделка по symbol: покупатель платит, продавец получает. Незарегистрированная сторона пропускается.
+    void settle(int buyerId, int sellerId, Cash notional, int quantity, Symbol symbol = 0);
+
+    // Списать комиссию со всех открытых счетов.
+    void chargeAll(Cash fee);
+
+    [[nodiscard]] AccountSnapshot snapshot(int id, Symbol symbol = 0) const;
+    // то же без перевода в double; false - счёта или инструмента нет
+    bool balance(int id, Cash& cash, long long& inventory, Symbol symbol = 0) const;
+    // Блоки по kChunk счетов, от первого до блока последнего открытого id.
+    [[nodiscard]] std::size_t blockCount() const;
+    // Снять балансы блока в столбцы (kChunk строк, счета index * kChunk + строка, позиции по всем
+    // инструментам); память out переиспользуется. Каждое значение читается атомарно,
+    // но блок в целом - не снимок на один момент.
+    void exportBlock(std::size_t index, AccountColumns& out) const;
+    // все открытые счета и их ненулевые позиции по возрастанию id (дописываются в out)
+    void exportRecords(std::vector<AccountRecord>& accounts, std::vector<PositionRecord>& positions) const;
+    // открыть счёт с деньгами из снапшота, позиции - нулевые
+    bool restore(const AccountRecord& r);
+    // позиция открытого счёта из снапшота
+    bool restore(const PositionRecord& r);
+    // меняется при каждом open
+    [[nodiscard]] std::uint64_t generation() const { return openGeneration.load(std::memory_order_acquire); }
+    [[nodiscard]] std::size_t size() const;
+    [[nodiscard]] std::size_t symbols() const { return symbolCount; }
+
+private:
+    struct alignas(64) Account {
+        std::atomic<Cash> cash{0};
+        std::atomic<Cash> startCash{0};
+        std::atomic<bool> active{false};
+    };
+    static_assert(sizeof(Account) == 64);
+
+    // позиции блока счетов по одному инструменту
+    struct alignas(64) Positions {
+        std::array<std::atomic<long long>, kChunk> inventory{};
+        std::array<std::atomic<long long>, kChunk> startInventory{};
+    };
+
+    struct Block {
+        explicit Block(std::size_t symbols) : positions(new std::atomic<Positions*>[symbols]()) {}
+        std::array<Account, kChunk> accounts;
+        std::unique_ptr<std::atomic<Positions*>[]> positions;  // по инструменту, nullptr - позиций ещё нет
+    };
+
+    // блок открытого счёта и его строка в блоке; nullptr - счёта нет
+    [[nodiscard]] Block* find(int id, std::size_t& row) const;
+    // позиции блока по инструменту, выделяются при первой записи
+    Positions& positions(Block& block, Symbol symbol);
+
+    std::size_t symbolCount;
+    std::array<std::atomic<Block*>, kMaxAccounts / kChunk> chunks{};
+    std::atomic<int> maxId{-1};     // fee-цикл не обходит пустой хвост
+    std::atomic<std::size_t> opened{0};
+    std::atomic<std::uint64_t> openGeneration{0};
+    std::mutex openMutex;           // только для выделения блоков
+};
+
+#endif // ACCOUNTTABLE_H
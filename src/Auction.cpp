@@ -0,0 +1,125 @@
+#include "Auction.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+AuctionClearing clearingPrice(std::span<const BookLevel> bids, long long marketBid,
+                              std::span<const BookLevel> asks, long long marketAsk, double reference) {
+    if (bids.empty() && asks.empty()) {
+        // одни рыночные заявки: цены в стакане нет, сводятся по последней сделке, если она была
+        const long long volume = std::min(marketBid, marketAsk);
+        if (volume <= 0 || reference <= 0) return {};
+        return {reference, volume, std::llabs(marketBid - marketAsk)};
+    }
+    if (reference < 0) {
+        if (!bids.empty() && !asks.empty()) reference = (bids.front().price + asks.front().price) / 2;
+        else                                reference = bids.empty() ? asks.front().price : bids.front().price;
+    }
+
+    long long demand = marketBid;
+    for (const BookLevel& l : bids) demand += l.quantity;
+    long long supply = marketAsk;
+
+    AuctionClearing best;
+    double bestDistance = 0;
+    // цены по возрастанию: предложение по цене p копится, спрос убывает
+    auto b = bids.rbegin();
+    auto a = asks.begin();
+    while (b != bids.rend() || a != asks.end()) {
+        const double p = b == bids.rend() ? a->price
+                       : a == asks.end()  ? b->price
+                                          : std::min(a->price, b->price);
+        for (; a != asks.end() && a->price == p; ++a) supply += a->quantity;
+
+        const long long volume = std::min(demand, supply);
+        const long long imbalance = std::llabs(demand - supply);
+        const double distance = std::abs(p - reference);
+        if (volume > 0
+            && (volume > best.volume
+                || (volume == best.volume && (imbalance < best.imbalance
+                                              || (imbalance == best.imbalance && distance < bestDistance))))) {
+            best = {p, volume, imbalance};
+            bestDistance = distance;
+        }
+
+        // покупки по p ещё входят в спрос по p, по следующей цене - уже нет
+        for (; b != bids.rend() && b->price == p; ++b) demand -= b->quantity;
+    }
+    return best;
+}
+
+void takeLevel(std::span<AuctionFill> level, long long levelQuantity, long long& remaining,
+               AuctionAllocation allocation, std::vector<AuctionFill>& out) {
+    if (remaining <= 0 || level.empty()) return;
+    if (levelQuantity <= remaining) {
+        out.insert(out.end(), level.begin(), level.end());
+        remaining -= levelQuantity;
+        return;
+    }
+
+    if (allocation == AuctionAllocation::TimePriority) {
+        for (const AuctionFill& f : level) {
+            if (remaining == 0) break;
+            const int q = static_cast<int>(std::min<long long>(f.quantity, remaining));
+            out.push_back({f.id, f.brokerId, q});
+            remaining -= q;
+        }
+        return;
+    }
+
+    // пропорционально остаткам с округлением вниз; недостающие штуки - по одной, по времени.
+    // Каждая доля строго меньше остатка заявки, так что хватает одного прохода.
+    const std::size_t first = out.size();
+    long long left = remaining;
+    for (const AuctionFill& f : level) {
+        const auto share = static_cast<int>(static_cast<__int128>(remaining) * f.quantity / levelQuantity);
+        out.push_back({f.id, f.brokerId, share});
+        left -= share;
+    }
+    for (std::size_t k = 0; k < level.size() && left > 0; ++k)
+        if (out[first + k].quantity < level[k].quantity) {
+            ++out[first + k].quantity;
+            --left;
+        }
+    out.erase(std::remove_if(out.begin() + static_cast<std::ptrdiff_t>(first), out.end(),
+                             [](const AuctionFill& f) { return f.quantity == 0; }),
+              out.end());
+    remaining = 0;
+}
+
+namespace {
+
+std::size_t otherBroker(std::span<const AuctionFill> side, std::size_t from, int brokerId) {
+    for (std::size_t k = from; k < side.size(); ++k)
+        if (side[k].brokerId != brokerId) return k;
+    return side.size();
+}
+
+} // namespace
+
+std::size_t pairFills(std::span<AuctionFill> buys, std::span<AuctionFill> sells, double price,
+                      int currentTime, Symbol symbol, std::vector<Trade>& out) {
+    const std::size_t before = out.size();
+    std::size_t i = 0, j = 0;
+    while (i < buys.size() && j < sells.size()) {
+        if (buys[i].brokerId == sells[j].brokerId) {
+            // другой продавец, иначе другой покупатель; если нет обоих - дальше только этот брокер
+            if (const std::size_t k = otherBroker(sells, j + 1, buys[i].brokerId); k < sells.size())
+                std::swap(sells[j], sells[k]);
+            else if (const std::size_t k2 = otherBroker(buys, i + 1, sells[j].brokerId); k2 < buys.size())
+                std::swap(buys[i], buys[k2]);
+            else
+                break;
+        }
+        AuctionFill& b = buys[i];
+        AuctionFill& s = sells[j];
+        const int q = std::min(b.quantity, s.quantity);
+        out.push_back({b.brokerId, s.brokerId, price, q, currentTime, symbol, b.id, s.id});
+        b.quantity -= q;
+        s.quantity -= q;
+        if (b.quantity == 0) ++i;
+        if (s.quantity == 0) ++j;
+    }
+    return out.size() - before;
+}
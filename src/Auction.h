@@ -0,0 +1,66 @@
+#ifndef AUCTION_H
+#define AUCTION_H
+
+#include <cstddef>
+#include <span>
+#include <vector>
+#include "Book.h"
+#include "Order.h"
+
+// Периодический аукцион (call auction): заявки копятся интервал, затем все
+// пересекающиеся исполняются по одной цене, при которой объём сделок наибольший.
+// Здесь общая для обоих стаканов часть: поиск цены и распределение объёма;
+// обход уровней и снятие исполненного делает сам стакан (Book::auction).
+
+// Как делится объём на последнем, исполняемом не целиком, уровне стороны.
+// Уровни лучше него исполняются полностью при любом способе.
+enum class AuctionAllocation { TimePriority, ProRata };
+
+struct AuctionRule {
+    AuctionAllocation allocation = AuctionAllocation::TimePriority;
+    // при равных объёме и дисбалансе берётся цена, ближайшая к этой (последняя сделка);
+    // < 0 - к середине между лучшими лимитными ценами
+    double reference = -1.0;
+};
+
+struct AuctionClearing {
+    double price{};
+    long long volume{};         // 0 - стакан не пересечён
+    long long imbalance{};      // |спрос - предложение| по цене аукциона
+};
+
+// заявка стороны и объём, который ей достаётся (до распределения - весь её остаток)
+struct AuctionFill {
+    std::size_t id{};
+    int brokerId{};
+    int quantity{};
+};
+
+// Рабочие буферы одного стакана, чтобы аукцион не выделял память на каждом вызове.
+struct AuctionScratch {
+    std::vector<BookLevel> bids;
+    std::vector<BookLevel> asks;
+    std::vector<AuctionFill> buys;
+    std::vector<AuctionFill> sells;
+    std::vector<AuctionFill> level;
+};
+
+// Цена аукциона за один кумулятивный проход по уровням: bids и asks - лимитные уровни
+// от лучшего к худшему, marketBid/marketAsk - объём рыночных заявок сторон.
+// Критерии по порядку: наибольший объём, наименьший дисбаланс, близость к rule.reference.
+// Без лимитных уровней рыночные стороны сводятся по reference, а если её нет (<= 0) - не сводятся.
+AuctionClearing clearingPrice(std::span<const BookLevel> bids, long long marketBid,
+                              std::span<const BookLevel> asks, long long marketAsk, double reference);
+
+// Берёт из remaining объём для одного уровня: level - его заявки по времени
+// с полными остатками, levelQuantity - их сумма. Ненулевые доли дописываются в out.
+void takeLevel(std::span<AuctionFill> level, long long levelQuantity, long long& remaining,
+               AuctionAllocation allocation, std::vector<AuctionFill>& out);
+
+// Сводит доли сторон в сделки по цене price. Встречные доли одного брокера
+// не сводятся друг с другом: пара ищется дальше по списку, а объём, который
+// свести не с кем, остаётся в стакане. Возвращает число дописанных сделок.
+std::size_t pairFills(std::span<AuctionFill> buys, std::span<AuctionFill> sells, double price,
+                      int currentTime, Symbol symbol, std::vector<Trade>& out);
+
+#endif // AUCTION_H
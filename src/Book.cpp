@@ -0,0 +1,9 @@
+#include "Book.h"
+#include "LadderBook.h"
+#include "OrderBook.h"
+
+std::unique_ptr<Book> makeBook(BookKind kind, int ticksPerUnit, SelfTradePolicy selfTrade) {
+    if (kind == BookKind::Ladder)
+        return std::make_unique<LadderBook>(ticksPerUnit, selfTrade);
+    return std::make_unique<OrderBook>(selfTrade);
+}
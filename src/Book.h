@@ -0,0 +1,95 @@
+#ifndef BOOK_H
+#define BOOK_H
+
+#include <cstddef>
+#include <memory>
+#include <span>
+#include <vector>
+#include "Order.h"
+
+enum class BookKind { Map, Ladder };
+
+struct AuctionRule;
+
+// Что делать, когда лучшие встречные заявки принадлежат одному брокеру:
+// снять более старую (меньший id) или более новую из двух.
+enum class SelfTradePolicy { CancelOldest, CancelNewest };
+
+struct TopOfBook {
+    bool hasBid{};
+    bool hasAsk{};
+    double bid{};
+    double ask{};
+    long long bidSize{};        // суммарный объём на лучшем уровне
+    long long askSize{};
+};
+
+struct BookLevel {
+    double price{};
+    long long quantity{};       // суммарный объём уровня
+
+    bool operator==(const BookLevel&) const = default;
+};
+
+// Общий интерфейс стакана, чтобы Exchange мог переключаться между движками (A/B).
+class Book {
+public:
+    virtual ~Book() = default;
+
+    // false - стакан заявку не взял (объём <= 0, цена вне окна лестницы)
+    virtual bool addOrder(const Order& order) = 0;
+
+    // Пачка заявок в порядке exportOrders за один захват блокировки (восстановление из снапшота).
+    virtual void addOrders(std::span<const Order> orders) = 0;
+
+    virtual bool tryMatchOne(int currentTime, Trade& out) = 0;
+
+    // Сводит стакан до упора (или до out.size() сделок) за один захват блокировки.
+    // Возвращает число записанных в out сделок.
+    virtual std::size_t matchAll(int currentTime, std::span<Trade> out) = 0;
+
+    // Аукцион вместо непрерывного сведения (см. Auction.h): все пересекающиеся заявки
+    // исполняются по одной цене за один захват блокировки, сделки дописываются в out.
+    // Возвращает число сделок.
+    virtual std::size_t auction(int currentTime, const AuctionRule& rule, std::vector<Trade>& out) = 0;
+
+    // Снять заявку за O(1) по индексу id. false - заявки в стакане нет (исполнена или уже снята).
+    virtual bool cancelOrder(std::size_t id) = 0;
+
+    // Новые объём и цена. Уменьшение объёма без смены цены сохраняет место в очереди,
+    // иначе заявка встаёт в конец очереди своего уровня. newQty <= 0 снимает заявку.
+    // У рыночных заявок цена не меняется.
+    virtual bool replaceOrder(std::size_t id, int newQty, double newPrice) = 0;
+
+    virtual bool bestBidPrice(double& out) = 0;
+
+    virtual bool bestAskPrice(double& out) = 0;
+
+    // лучшие цены и объёмы обеих сторон за один захват блокировки
+    virtual TopOfBook top() = 0;
+
+    // До out.size() лучших ценовых уровней стороны, от лучшего к худшему; возвращает их число.
+    // Рыночные заявки ценовых уровней не образуют и сюда не попадают.
+    virtual std::size_t depth(OrderSide side, std::span<BookLevel> out) = 0;
+
+    // сколько заявок снято защитой от self-trade
+    virtual std::size_t selfTradeCancels() = 0;
+
+    // Дописать в out все стоящие заявки: покупки, затем продажи; на стороне рыночные,
+    // затем уровни от лучшего, внутри уровня - по очереди. addOrder в этом порядке
+    // восстанавливает стакан с теми же очередями (см. Exchange::saveSnapshot).
+    virtual void exportOrders(std::vector<Order>& out) = 0;
+
+    // Куда дописывать id заявок, которые стакан снял сам (защита от self-trade).
+    // nullptr - не записывать. Пишется под блокировкой стакана, читать - из потока матчинга.
+    void setCancelLog(std::vector<std::size_t>* log) { cancelLog = log; }
+
+protected:
+    std::vector<std::size_t>* cancelLog = nullptr;
+};
+
+// ticksPerUnit используется только лестничным стаканом: цена хранится как int64 тиков.
+std::unique_ptr<Book> makeBook(BookKind kind, int ticksPerUnit,
+                               SelfTradePolicy selfTrade = SelfTradePolicy::CancelOldest);
+
+#endif // BOOK_H
@@ -0,0 +1,80 @@
+#ifndef BROADCASTRING_H
+#define BROADCASTRING_H
+
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <type_traits>
+
+// Кольцо один писатель - много читателей, каждый читатель видит все сообщения.
+// Писатель не знает о читателях и никогда их не ждёт: отставший читатель
+// обнаруживает, что его сообщение затёрто, и сам догоняет (Gap).
+// Каждая ячейка - маленький seqlock: version = номер сообщения * 2, нечётный - идёт запись.
+// Сообщения нумеруются с 1.
+template <class T>
+class BroadcastRing final {
+    static_assert(std::is_trivially_copyable_v<T>);
+    static constexpr std::size_t kWords = (sizeof(T) + 7) / 8;
+
+    struct alignas(64) Slot {
+        std::atomic<std::uint64_t> version{0};
+        std::atomic<std::uint64_t> words[kWords]{};
+    };
+
+    std::unique_ptr<Slot[]> slots;
+    std::size_t mask;
+    alignas(64) std::atomic<std::uint64_t> published{0};    // номер последнего опубликованного
+
+public:
+    enum class Read { Ok, Empty, Gap };
+
+    explicit BroadcastRing(std::size_t capacity)
+        : slots(std::make_unique<Slot[]>(std::bit_ceil(capacity < 2 ? std::size_t{2} : capacity))),
+          mask(std::bit_ceil(capacity < 2 ? std::size_t{2} : capacity) - 1) {}
+
+    BroadcastRing(const BroadcastRing&) = delete;
+    BroadcastRing& operator=(const BroadcastRing&) = delete;
+
+    [[nodiscard]] std::size_t capacity() const { return mask + 1; }
+
+    // только писатель; возвращает номер сообщения
+    std::uint64_t publish(const T& v) {
+        std::uint64_t buf[kWords]{};
+        std::memcpy(buf, &v, sizeof(T));
+
+        const std::uint64_t n = published.load(std::memory_order_relaxed) + 1;
+        Slot& s = slots[n & mask];
+        s.version.store(2 * n - 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        for (std::size_t i = 0; i < kWords; ++i)
+            s.words[i].store(buf[i], std::memory_order_relaxed);
+        s.version.store(2 * n, std::memory_order_release);
+        published.store(n, std::memory_order_release);
+        return n;
+    }
+
+    [[nodiscard]] std::uint64_t lastPublished() const {
+        return published.load(std::memory_order_acquire);
+    }
+
+    // Empty - сообщения n ещё нет; Gap - оно уже затёрто, догонять с lastPublished()
+    Read read(std::uint64_t n, T& out) const {
+        const Slot& s = slots[n & mask];
+        const std::uint64_t v1 = s.version.load(std::memory_order_acquire);
+        if (v1 < 2 * n - 1) return Read::Empty;
+        if (v1 != 2 * n) return v1 == 2 * n - 1 ? Read::Empty : Read::Gap;
+
+        std::uint64_t buf[kWords];
+        for (std::size_t i = 0; i < kWords; ++i)
+            buf[i] = s.words[i].load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (s.version.load(std::memory_order_relaxed) != v1) return Read::Gap;
+
+        std::memcpy(&out, buf, sizeof(T));
+        return Read::Ok;
+    }
+};
+
+#endif // BROADCASTRING_H
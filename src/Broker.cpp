@@ -1,110 +1,74 @@
 #include "Broker.h"
 
+#include "CounterRng.h"
+
 Broker::Broker(int id, double cash, int inv, Exchange& ex)
-    : _id(id), _cash(cash), _inventory(inv), _exchange(ex) {}
+    : _id(id), _startCash(cash), _startInventory(inv), _exchange(ex) {}
 
 int Broker::id() const {
     return _id;
 }
 
-void Broker::applyTradeAsBuyer(double price, int qty) {
-    std::lock_guard<std::mutex> lk(_mx);
-    _cash -= price * qty;
-    _inventory += qty;
+void Broker::setFairPriceKind(FairPriceKind kind) {
+    _fairKind = kind;
+}
+
+double Broker::startCash() const {
+    return _startCash;
+}
+
+int Broker::startInventory() const {
+    return _startInventory;
+}
+
+double Broker::cash() const {
+    const AccountSnapshot a = _exchange.account(_id);
+    return a.registered ? a.cash : _startCash;
+}
+
+long long Broker::inventory() const {
+    const AccountSnapshot a = _exchange.account(_id);
+    return a.registered ? a.inventory : _startInventory;
 }
 
-void Broker::applyTradeAsSeller(double price, int qty) {
-    std::lock_guard<std::mutex> lk(_mx);
-    _cash += price * qty;
-    _inventory -= qty;
+AccountRisk Broker::risk() const {
+    return _exchange.accountRisk(_id);
 }
 
-void Broker::applyFee(double fee) {
-    std::lock_guard<std::mutex> lk(_mx);
-    _cash -= fee;
+void Broker::requote(const Order& o) {
+    if (_restingId) _exchange.cancelOrder(_restingId, _restingSymbol);
+    _restingId = _exchange.submitOrder(o);
+    _restingSymbol = o.symbol;
+}
+
+template <class Strategy>
+void Broker::stepWith(const Strategy& strategy, int currentTime, std::uint64_t key, std::uint64_t step) {
+    const QuoteSnapshot q = _exchange.quote();
+    std::int8_t side = 0;
+    double price = 0.0;
+    int quantity = 0;
+    strategy.generate({q, q.fairPrice(_fairKind), currentTime, step}, {&key, 1}, {{&side, 1}, {&price, 1}, {&quantity, 1}});
+    if (!side) return;
+    requote({_id, OrderType::Limit, side > 0 ? OrderSide::Buy : OrderSide::Sell, 0, quantity, price, currentTime});
 }
 
 // ===== PlayerBroker =====
+PlayerBroker::PlayerBroker(int id, double cash, int inv, Exchange& ex, std::uint64_t seed, PlayerStrategy strategy)
+    : Broker(id, cash, inv, ex), strategy(strategy), key(brokerKey(seed, id)) {}
+
 void PlayerBroker::step(int currentTime) {
-    double fair = _exchange.fairPriceEstimate();
-    if (fair <= 0) fair = 100.0;
-
-    bool buy;
-    {
-        std::lock_guard<std::mutex> lk(_mx);
-        if (hasRestingBuy && !hasRestingSell)
-            buy = true;
-        else if (hasRestingSell && !hasRestingBuy)
-            buy = false;
-        else
-            buy = (uni(rng) < 0.5);
-    }
-
-    const double shift = uni(rng) * 0.14 - 0.07;
-    const double price = fair * (1.0 + shift);
-    const int qty = 3 + static_cast<int>(uni(rng) * 8);
-
-    Order o;
-    o.brokerId = _id;
-    o.type = OrderType::Limit;
-    o.side = buy ? OrderSide::Buy : OrderSide::Sell;
-    o.quantity = qty;
-    o.price = price;
-    o.createdAt = currentTime;
-
-    _exchange.submitOrder(o);
+    stepWith(strategy, currentTime, key, steps++);
 }
 
 // ===== BigWinBroker =====
 BigWinBroker::BigWinBroker(int id, double cash, int inv, Exchange& ex, double threshold)
-    : Broker(id, cash, inv, ex), profitThreshold(threshold) {}
+    : Broker(id, cash, inv, ex), strategy{.threshold = threshold} {}
 
 void BigWinBroker::step(int currentTime) {
-    double fair = _exchange.fairPriceEstimate();
-    if (fair <= 0) return;
-
-    double bid{}, ask{};
-    if (!_exchange.bestBidPrice(bid) || !_exchange.bestAskPrice(ask))
-        return;
-
-    if (ask < fair * (1.0 - profitThreshold)) {
-        Order o{_id, OrderType::Limit, OrderSide::Buy, 0, 3, ask, currentTime};
-        _exchange.submitOrder(o);
-        return;
-    }
-
-    if (bid > fair * (1.0 + profitThreshold)) {
-        Order o{_id, OrderType::Limit, OrderSide::Sell, 0, 3, bid, currentTime};
-        _exchange.submitOrder(o);
-    }
+    stepWith(strategy, currentTime, 0, 0);
 }
 
 // ===== AnalystBroker =====
 void AnalystBroker::step(int currentTime) {
-    double fair = _exchange.fairPriceEstimate();
-    if (fair <= 0) return;
-
-    double bid{}, ask{};
-    if (!_exchange.bestBidPrice(bid) || !_exchange.bestAskPrice(ask))
-        return;
-
-    double mid = 0.5 * (bid + ask);
-
-    Order o;
-    o.brokerId = _id;
-    o.type = OrderType::Limit;
-    o.quantity = 2;
-    o.createdAt = currentTime;
-
-    if (mid < fair) {
-        o.side = OrderSide::Buy;
-        o.price = ask;
-    } else if (mid > fair) {
-        o.side = OrderSide::Sell;
-        o.price = bid;
-    } else {
-        return;
-    }
-
-    _exchange.submitOrder(o);
+    stepWith(strategy, currentTime, 0, 0);
 }
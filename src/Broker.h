@@ -1,20 +1,27 @@
 #pragma once
 
-#include <mutex>
-#include <random>
+#include <cstdint>
 #include "Exchange.h"
+#include "Strategy.h"
 
 class Broker {
 protected:
     int _id;
-    double _cash;
-    int _inventory;
+    double _startCash;
+    int _startInventory;
     Exchange& _exchange;
 
-    std::mutex _mx;
+    FairPriceKind _fairKind = FairPriceKind::Vwap;
 
-    bool hasRestingBuy  = false;
-    bool hasRestingSell = false;
+    // последняя выставленная заявка; трогает только поток, вызывающий step
+    size_t _restingId = 0;
+    Symbol _restingSymbol = 0;
+
+    // Держим в стакане не больше одной своей заявки: прежняя снимается перед новой.
+    void requote(const Order& o);
+    // шаг по правилу стратегии (см. Strategy.h) для одного брокера
+    template <class Strategy>
+    void stepWith(const Strategy& strategy, int currentTime, std::uint64_t key, std::uint64_t step);
 
 public:
     Broker(int id, double cash, int inv, Exchange& ex);
@@ -22,24 +29,35 @@ public:
 
     [[nodiscard]] int id() const;
 
-    void applyTradeAsBuyer(double price, int qty);
-    void applyTradeAsSeller(double price, int qty);
-    void applyFee(double fee);
+    // какой оценкой справедливой цены пользуется стратегия; задаётся до запуска
+    void setFairPriceKind(FairPriceKind kind);
+
+    // начальный баланс, с ним открывается счёт на бирже при registerBroker
+    [[nodiscard]] double startCash() const;
+    [[nodiscard]] int startInventory() const;
+
+    // текущий баланс по счёту биржи (до регистрации - начальный); позиция - по инструменту 0, которым торгует брокер
+    [[nodiscard]] double cash() const;
+    [[nodiscard]] long long inventory() const;
+    // капитал, PnL и экспозиция по последнему пересчёту риска биржи
+    [[nodiscard]] AccountRisk risk() const;
 
     virtual void step(int currentTime) = 0;
 };
 
 class PlayerBroker final : public Broker {
-    std::mt19937 rng;
-    std::uniform_real_distribution<double> uni;
+    PlayerStrategy strategy;
+    std::uint64_t key;          // у каждого брокера свой поток случайных чисел
+    std::uint64_t steps = 0;
 
 public:
-    using Broker::Broker;
+    // strategy - полоса цен и объёмы котировок (см. PlayerStrategy)
+    PlayerBroker(int id, double cash, int inv, Exchange& ex, std::uint64_t seed = 0, PlayerStrategy strategy = {});
     void step(int currentTime) override;
 };
 
 class BigWinBroker final : public Broker {
-    double profitThreshold;
+    BigWinStrategy strategy;
 
 public:
     BigWinBroker(int id, double cash, int inv, Exchange& ex, double threshold);
@@ -47,6 +65,8 @@ public:
 };
 
 class AnalystBroker final : public Broker {
+    AnalystStrategy strategy;
+
 public:
     using Broker::Broker;
     void step(int currentTime) override;
@@ -0,0 +1,96 @@
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include <cstdint>
+#include <string_view>
+#include "Book.h"
+#include "Order.h"
+
+// Order   - заявка в том виде, в каком она попала в стакан;
+// Match   - поток матчинга свёл стакан (matchAll до упора) на тике tick;
+// Cancel  - снятие заявки id;
+// Replace - новые quantity и price для заявки id.
+enum class CaptureKind : std::uint8_t { Order = 1, Match = 2, Cancel = 3, Replace = 4 };
+
+// Запись потока заявок для детерминированного воспроизведения, 48 байт.
+struct CaptureRecord final {
+    std::uint64_t seq{};
+    std::uint64_t id{};
+    double price{};
+    std::int32_t tick{};
+    std::int32_t brokerId{};
+    std::int32_t quantity{};
+    std::int32_t createdAt{};
+    CaptureKind kind{CaptureKind::Order};
+    OrderType type{OrderType::Limit};
+    OrderSide side{OrderSide::Buy};
+    std::uint8_t reserved{};
+    Symbol symbol{};
+    std::uint8_t reserved2[2]{};
+
+    [[nodiscard]] Order order() const {
+        return {brokerId, type, side, static_cast<std::size_t>(id), quantity, price, createdAt, symbol};
+    }
+};
+static_assert(sizeof(CaptureRecord) == 48);
+
+// Стакан биржи, писавшей поток, - в MappedFileHeader::meta файла записи:
+// воспроизведение строит такой же (шаг цены и правило самосделок).
+struct CaptureMeta final {
+    std::int32_t ticksPerUnit{};
+    BookKind book{};
+    SelfTradePolicy selfTrade{};
+};
+static_assert(sizeof(CaptureMeta) <= 32);
+
+inline constexpr std::string_view kCaptureMagic = "STKCAPT";
+inline constexpr std::uint32_t kCaptureVersion = 3;
+
+inline CaptureRecord captureOrder(std::uint64_t seq, int tick, const Order& o) {
+    CaptureRecord r;
+    r.seq = seq;
+    r.id = o.id;
+    r.price = o.price;
+    r.tick = tick;
+    r.brokerId = o.brokerId;
+    r.quantity = o.quantity;
+    r.createdAt = o.createdAt;
+    r.kind = CaptureKind::Order;
+    r.type = o.type;
+    r.side = o.side;
+    r.symbol = o.symbol;
+    return r;
+}
+
+inline CaptureRecord captureCancel(std::uint64_t seq, int tick, std::size_t id, Symbol symbol) {
+    CaptureRecord r;
+    r.seq = seq;
+    r.id = id;
+    r.tick = tick;
+    r.kind = CaptureKind::Cancel;
+    r.symbol = symbol;
+    return r;
+}
+
+inline CaptureRecord captureReplace(std::uint64_t seq, int tick, std::size_t id, int quantity, double price,
+                                    Symbol symbol) {
+    CaptureRecord r;
+    r.seq = seq;
+    r.id = id;
+    r.price = price;
+    r.tick = tick;
+    r.quantity = quantity;
+    r.kind = CaptureKind::Replace;
+    r.symbol = symbol;
+    return r;
+}
+
+inline CaptureRecord captureMatch(std::uint64_t seq, int tick) {
+    CaptureRecord r;
+    r.seq = seq;
+    r.tick = tick;
+    r.kind = CaptureKind::Match;
+    return r;
+}
+
+#endif // CAPTURE_H
@@ -0,0 +1,29 @@
+#ifndef COUNTERRNG_H
+#define COUNTERRNG_H
+
+#include <bit>
+#include <cstdint>
+
+// Счётчиковый генератор: число - чистая функция (ключ, номер), без состояния.
+// Поток брокера задаётся одним 64-битным ключом, и целую популяцию можно
+// разыграть одним циклом без зависимостей между итерациями.
+inline std::uint64_t counterRandom(std::uint64_t key, std::uint64_t counter) {
+    // финализатор splitmix64 от key + counter * phi
+    std::uint64_t z = key + counter * 0x9E3779B97F4A7C15ull;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+// [0, 1) из старших 52 бит - только целочисленные операции и вычитание,
+// без int64 -> double, которого нет в AVX2
+inline double unitRandom(std::uint64_t r) {
+    return std::bit_cast<double>((r >> 12) | 0x3FF0000000000000ull) - 1.0;
+}
+
+// ключ брокера: разные id и seed дают независимые потоки
+inline std::uint64_t brokerKey(std::uint64_t seed, int brokerId) {
+    return counterRandom(seed, static_cast<std::uint64_t>(static_cast<std::uint32_t>(brokerId)) + 1);
+}
+
+#endif // COUNTERRNG_H
@@ -1,39 +1,492 @@
 #include "Exchange.h"
 #include "Broker.h"
 
+#include <algorithm>
+#include <array>
 #include <thread>
 #include <chrono>
 #include <iostream>
+#include <span>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace {
+
+void cpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+    _mm_pause();
+#else
+    std::this_thread::yield();
+#endif
+}
+
+void pinCurrentThread(int cpu) {
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#else
+    (void)cpu;
+#endif
+}
+
+std::size_t instrumentsOf(const ExchangeConfig& config) {
+    return std::clamp<std::size_t>(config.instruments, 1, std::size_t{1} << 16);
+}
+
+// ширина секундной свечи в тиках биржевых часов
+int ticksPerSecond(std::chrono::milliseconds tick) {
+    return static_cast<int>(std::max<long long>(1, 1000 / std::max<long long>(1, tick.count())));
+}
+
+} // namespace
+
+Exchange::Instrument::Instrument(Symbol symbol, const ExchangeConfig& config)
+    : symbol(symbol),
+      book(makeBook(config.book, config.ticksPerUnit, config.selfTrade)),
+      fair(config.fairWindowTicks, config.fairEwmaAlpha),
+      trades({config.tradeRetentionTicks, ticksPerSecond(config.tick), config.barHistory}) {}
+
+Exchange::Shard::Shard(std::size_t index, std::size_t ingressCapacity)
+    : index(index), ingress(ingressCapacity), matchBuf(kMatchBatch) {}
+
+Exchange::Exchange(const ExchangeConfig& config)
+    : console(&std::cout),
+      accounts(instrumentsOf(config)),
+      gate(accounts, config.riskLimits),
+      preTradeRisk(config.preTradeRisk),
+      auctionEvery(config.matching == MatchingMode::Auction ? std::max(1, config.auctionTicks) : 0),
+      auctionAllocation(config.auctionAllocation),
+      wakeMode(config.wake),
+      tickInterval(config.tick.count() > 0 ? config.tick : std::chrono::milliseconds(1)),
+      spinCpu(config.spinCpu),
+      bookKind(config.book),
+      ticksPerUnit(config.ticksPerUnit),
+      selfTrade(config.selfTrade),
+      feedDepth(config.feedDepth),
+      feedSnapshotTicks(std::max(1, config.feedSnapshotTicks)),
+      risk(config.riskKernel),
+      riskMarks(instrumentsOf(config), 0.0),
+      riskEveryTicks(config.riskEveryTicks),
+      riskReportTicks(config.riskReportTicks),
+      statsDumpTicks(config.statsDumpTicks) {
+    const std::size_t instrumentTotal = instrumentsOf(config);
+    const std::size_t shardTotal = std::clamp<std::size_t>(config.shards, 1, instrumentTotal);
+
+    for (std::size_t i = 0; i < shardTotal; ++i) {
+        shards.push_back(std::make_unique<Shard>(i, config.ingressCapacity));
+        if (feedDepth) {
+            shards.back()->feed = std::make_unique<FeedRing>(config.feedCapacity);
+            shards.back()->depthBuf.resize(feedDepth);
+        }
+    }
+    for (std::size_t s = 0; s < instrumentTotal; ++s) {
+        instruments.push_back(std::make_unique<Instrument>(static_cast<Symbol>(s), config));
+        Shard& sh = *shards[s % shardTotal];
+        sh.instruments.push_back(instruments.back().get());
+        if (preTradeRisk) instruments.back()->book->setCancelLog(&sh.selfTradeCancelled);
+    }
+
+    for (auto& sh : shards)
+        sh->journal.setSink([this](const JournalRecord& r) {
+            if (!consoleOutput.load(std::memory_order_relaxed)) return;
+            std::lock_guard<ExchangeMutex> lk(consoleMutex);
+            printRecord(*console, r);
+        });
+}
 
 void Exchange::registerBroker(const std::shared_ptr<Broker>& b) {
-    std::lock_guard<std::mutex> lk(brokersMutex);
+    std::lock_guard<ExchangeMutex> lk(brokersMutex);
+    // счёт мог прийти из снапшота - тогда баланс остаётся его
+    Cash cash = 0;
+    long long inventory = 0;
+    if (!accounts.balance(b->id(), cash, inventory)
+        && !accounts.open(b->id(), toCash(b->startCash()), b->startInventory())) return;
     brokers[b->id()] = b;
 }
 
+bool Exchange::registerAccount(int brokerId, double cash, int inventory, Symbol symbol) {
+    return accounts.open(brokerId, toCash(cash), inventory, symbol);
+}
+
+AccountSnapshot Exchange::account(int brokerId, Symbol symbol) const {
+    return accounts.snapshot(brokerId, symbol);
+}
+
 size_t Exchange::genOrderId() {
     return nextId.fetch_add(1);
 }
 
-void Exchange::submitOrder(Order order) {
+Exchange::Instrument* Exchange::findInstrument(Symbol symbol) const {
+    return symbol < instruments.size() ? instruments[symbol].get() : nullptr;
+}
+
+Exchange::Shard& Exchange::shardFor(Symbol symbol) {
+    return *shards[symbol % shards.size()];
+}
+
+// Пока цикл матчинга не запущен, заявки кладутся в стакан напрямую
+// (так заполняют стакан до старта). Во время работы - только через очередь своего шарда.
+size_t Exchange::submitOrder(Order order) {
+    if (!findInstrument(order.symbol)) {
+        ingressRejected.fetch_add(1, std::memory_order_relaxed);
+        return 0;
+    }
+    if (order.id == 0)
+        order.id = genOrderId();
+    Request r{.order = order, .submittedAt = telemetry::now()};
+    if (!admit(r)) return 0;
+    enqueue(r);
+    telemetry::count(StatCounter::Orders);
+    return order.id;
+}
+
+bool Exchange::trySubmitOrder(Order order) {
+    if (!findInstrument(order.symbol)) {
+        ingressRejected.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
     if (order.id == 0)
         order.id = genOrderId();
-    book.addOrder(order);
+    Request r{.order = order, .submittedAt = telemetry::now()};
+    if (!admit(r)) return false;
+    if (pushIngress(r, false) || submitDirect(r)) {
+        telemetry::count(StatCounter::Orders);
+        return true;
+    }
+    if (r.reserved) gate.unadmit(order, r.unit);
+    ingressOverflows.fetch_add(1, std::memory_order_relaxed);
+    return false;
+}
+
+bool Exchange::admit(Request& request) {
+    if (!preTradeRisk) return true;
+    const Order& o = request.order;
+    request.unit = toCash(o.price);
+    if (o.type == OrderType::Market) {
+        const QuoteSnapshot q = quote(o.symbol);
+        double unit = o.side == OrderSide::Sell ? (q.hasBid ? q.bid : q.lastPrice) : q.lastPrice;
+        if (o.side == OrderSide::Buy && q.hasAsk) {
+            // покупка резервирует деньги по худшей цене, до которой она пройдёт по стакану;
+            // объём глубже kSweepLevels уровней - по последнему из них
+            std::array<BookLevel, kSweepLevels> levels;
+            const std::size_t n = findInstrument(o.symbol)->book->depth(OrderSide::Sell, levels);
+            long long left = o.quantity;
+            for (std::size_t i = 0; i < n && left > 0; ++i) {
+                unit = levels[i].price;
+                left -= levels[i].quantity;
+            }
+        }
+        request.unit = std::max<Cash>(toCash(unit), 0);
+    }
+    // окно частоты - по часам биржи, без системного вызова на заявку; до запуска - по steady_clock,
+    // если часы не ведёт advanceTick
+    const auto now = running.load(std::memory_order_relaxed) || virtualClock.load(std::memory_order_relaxed)
+        ? tickInterval * currentTick.load(std::memory_order_relaxed)
+        : std::chrono::steady_clock::now().time_since_epoch();
+    const auto second = std::chrono::duration_cast<std::chrono::seconds>(now).count();
+    return gate.admit(o, request.unit, second, request.reserved) == RiskReject::None;
+}
+
+void Exchange::setRiskLimits(int brokerId, const RiskLimits& limits) {
+    gate.setLimits(brokerId, limits);
+}
+
+RiskGateStats Exchange::riskGateStats() const {
+    return gate.stats();
 }
 
-bool Exchange::bestBidPrice(double& out) { return book.bestBidPrice(out); }
-bool Exchange::bestAskPrice(double& out) { return book.bestAskPrice(out); }
+bool Exchange::cancelOrder(size_t id, Symbol symbol) {
+    if (!findInstrument(symbol)) return false;
+    Request r{.order = {}, .kind = RequestKind::Cancel};
+    r.order.id = id;
+    r.order.symbol = symbol;
+    enqueue(r);
+    return true;
+}
 
-double Exchange::fairPriceEstimate() {
-    std::lock_guard<std::mutex> lk(tradesMutex);
-    if (allTrades.empty()) return -1.0;
+bool Exchange::replaceOrder(size_t id, int newQty, double newPrice, Symbol symbol) {
+    if (!findInstrument(symbol)) return false;
+    Request r{.order = {}, .kind = RequestKind::Replace};
+    r.order.id = id;
+    r.order.quantity = newQty;
+    r.order.price = newPrice;
+    r.order.symbol = symbol;
+    enqueue(r);
+    return true;
+}
+
+void Exchange::enqueue(const Request& request) {
+    // вход закрывается под directMutex, поэтому второй круг всегда кончается одним из двух
+    while (!pushIngress(request, true) && !submitDirect(request)) {}
+}
 
-    double sum = 0;
-    int qty = 0;
-    for (auto& t : allTrades) {
-        sum += t.price * t.quantity;
-        qty += t.quantity;
+bool Exchange::pushIngress(const Request& request, bool wait) {
+    // пара к закрытию входа в runLoop: либо он увидит нас в ingressProducers,
+    // либо мы увидим закрытый вход (оба seq_cst)
+    ingressProducers.fetch_add(1, std::memory_order_seq_cst);
+    if (!ingressOpen.load(std::memory_order_seq_cst)) {
+        ingressProducers.fetch_sub(1, std::memory_order_release);
+        return false;
     }
-    return qty ? sum / qty : -1.0;
+    Shard& sh = shardFor(request.order.symbol);
+    bool pushed = sh.ingress.tryPush(request);
+    for (; !pushed && wait; pushed = sh.ingress.tryPush(request)) {
+        ingressStalls.fetch_add(1, std::memory_order_relaxed);
+        wakeMatcher(sh);
+        std::this_thread::yield();
+    }
+    ingressProducers.fetch_sub(1, std::memory_order_release);
+    if (pushed) wakeMatcher(sh);
+    // полная очередь у trySubmitOrder: submitDirect откажет, пока вход открыт, - это переполнение
+    return pushed;
+}
+
+// false - вход в очереди открыт (цикл матчинга работает), запрос надо класть туда
+bool Exchange::submitDirect(const Request& request) {
+    std::lock_guard<ExchangeMutex> lk(directMutex);
+    if (ingressOpen.load(std::memory_order_relaxed)) return false;
+    apply(shardFor(request.order.symbol), request, virtualClock.load(std::memory_order_relaxed));
+    publishQuote(*instruments[request.order.symbol]);
+    return true;
+}
+
+void Exchange::apply(Shard& shard, const Request& request, bool live) {
+    const Order& o = request.order;
+    const int tick = currentTick.load(std::memory_order_relaxed);
+    Instrument& inst = *instruments[o.symbol];
+    if (live && inst.dirty && request.kind != RequestKind::New
+        && auctionEvery.load(std::memory_order_relaxed) == 0) {
+        if (capture) capture->pushWait(captureMatch(++captureSeq, tick));
+        matchInstrument(shard, inst, tick);
+    }
+    switch (request.kind) {
+        case RequestKind::New:
+            if (capture) capture->pushWait(captureOrder(++captureSeq, tick, o));
+            if (inst.book->addOrder(o)) {
+                if (request.reserved)
+                    shard.reservations.insert(o.id, {o.brokerId, o.quantity, request.unit, o.side,
+                                                     o.type == OrderType::Market, o.symbol});
+            } else {
+                // стакан не взял заявку - резерв и открытая заявка в RiskGate возвращаются сразу
+                if (request.reserved) gate.release(o.brokerId, o.symbol, o.side, o.quantity, request.unit, true);
+                ingressRejected.fetch_add(1, std::memory_order_relaxed);
+            }
+            if (request.submittedAt) telemetry::record(StatLatency::SubmitToBook, request.submittedAt);
+            break;
+        case RequestKind::Cancel:
+            if (capture) capture->pushWait(captureCancel(++captureSeq, tick, o.id, o.symbol));
+            if (inst.book->cancelOrder(o.id)) releaseReservation(shard, o.id, 0, true);
+            else ingressMissed.fetch_add(1, std::memory_order_relaxed);
+            break;
+        case RequestKind::Replace: {
+            Reservation* res = shard.reservations.find(o.id);
+            const Reservation before = res ? *res : Reservation{};
+            const Cash unit = before.market ? before.unit : toCash(o.price);
+            if (res && o.quantity > 0
+                && !gate.resize(before.brokerId, o.symbol, before.side, before.remaining, before.unit, o.quantity, unit)) {
+                // не хватает денег или бумаг под увеличенную заявку - она остаётся прежней
+                ingressRejected.fetch_add(1, std::memory_order_relaxed);
+                break;
+            }
+            if (capture) capture->pushWait(captureReplace(++captureSeq, tick, o.id, o.quantity, o.price, o.symbol));
+            const bool done = inst.book->replaceOrder(o.id, o.quantity, o.price);
+            if (!done) ingressMissed.fetch_add(1, std::memory_order_relaxed);
+            if (!res) break;
+            if (o.quantity <= 0) {
+                if (done) releaseReservation(shard, o.id, 0, true);
+            } else if (!done) {
+                gate.resize(before.brokerId, o.symbol, before.side, o.quantity, unit, before.remaining, before.unit, true);
+            } else {
+                res->remaining = o.quantity;
+                res->unit = unit;
+            }
+            break;
+        }
+    }
+    if (!inst.dirty) {
+        inst.dirty = true;
+        inst.dirtySince = telemetry::now();
+        shard.pending.push_back(&inst);
+    }
+}
+
+IngressStats Exchange::ingressStats() const {
+    return {ingressDrained.load(std::memory_order_relaxed),
+            ingressStalls.load(std::memory_order_relaxed),
+            ingressOverflows.load(std::memory_order_relaxed),
+            ingressRejected.load(std::memory_order_relaxed),
+            ingressMissed.load(std::memory_order_relaxed)};
+}
+
+std::size_t Exchange::instrumentCount() const {
+    return instruments.size();
+}
+
+std::size_t Exchange::shardCount() const {
+    return shards.size();
+}
+
+void Exchange::wakeMatcher(Shard& shard) {
+    if (wakeMode != WakeMode::Event) return;
+    // пара к барьеру в waitForWork: либо матчер увидит заявку, либо мы увидим, что он спит
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (shard.sleeping.load(std::memory_order_relaxed)) {
+        std::lock_guard<std::mutex> lk(shard.wakeMutex);
+        shard.wakeCv.notify_one();
+    }
+}
+
+void Exchange::waitForWork(Shard& shard, std::chrono::steady_clock::time_point deadline) {
+    switch (wakeMode) {
+        case WakeMode::Poll:
+            std::this_thread::sleep_until(deadline);
+            return;
+        case WakeMode::Event: {
+            std::unique_lock<std::mutex> lk(shard.wakeMutex);
+            shard.sleeping.store(true, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            shard.wakeCv.wait_until(lk, deadline, [&] {
+                return !shard.ingress.empty() || !running.load() || pauseRequested.load();
+            });
+            shard.sleeping.store(false, std::memory_order_relaxed);
+            return;
+        }
+        case WakeMode::Spin:
+            for (unsigned spins = 0; shard.ingress.empty() && running.load(std::memory_order_relaxed)
+                                     && !pauseRequested.load(std::memory_order_relaxed); ++spins) {
+                if ((spins & 63) == 0 && std::chrono::steady_clock::now() >= deadline) return;
+                if (spins < 4096) cpuRelax();
+                else              std::this_thread::yield();
+            }
+            return;
+    }
+}
+
+std::size_t Exchange::drainIngress(Shard& shard, bool live) {
+    std::size_t total = 0;
+    while (true) {
+        const std::size_t n = shard.ingress.drain([&](const Request& r) { apply(shard, r, live); }, kDrainBatch);
+        total += n;
+        if (n < kDrainBatch) break;
+    }
+    if (total) ingressDrained.fetch_add(total, std::memory_order_relaxed);
+    return total;
+}
+
+bool Exchange::bestBidPrice(double& out, Symbol symbol) {
+    const Instrument* inst = findInstrument(symbol);
+    return inst && inst->book->bestBidPrice(out);
+}
+
+bool Exchange::bestAskPrice(double& out, Symbol symbol) {
+    const Instrument* inst = findInstrument(symbol);
+    return inst && inst->book->bestAskPrice(out);
+}
+
+double Exchange::fairPriceEstimate(FairPriceKind kind, Symbol symbol) const {
+    const std::int64_t start = telemetry::now();
+    const Instrument* inst = findInstrument(symbol);
+    const double v = inst ? inst->fair.value(kind) : -1.0;
+    telemetry::record(StatLatency::FairPrice, start);
+    return v;
+}
+
+const FeedRing* Exchange::marketData(Symbol symbol) const {
+    if (!findInstrument(symbol)) return nullptr;
+    return shards[symbol % shards.size()]->feed.get();
+}
+
+std::size_t Exchange::tradeCount() const {
+    return tradesDone.load(std::memory_order_acquire);
+}
+
+StatsSnapshot Exchange::stats() const {
+    return telemetry::snapshot();
+}
+
+RiskTotals Exchange::riskTotals() const {
+    return risk.totals();
+}
+
+AccountRisk Exchange::accountRisk(int brokerId) const {
+    return risk.account(brokerId);
+}
+
+std::vector<Trade> Exchange::tradesBetween(int fromTick, int toTick, Symbol symbol) const {
+    const Instrument* inst = findInstrument(symbol);
+    return inst ? inst->trades.query(fromTick, toTick) : std::vector<Trade>{};
+}
+
+std::vector<Bar> Exchange::bars(BarPeriod period, Symbol symbol) const {
+    const Instrument* inst = findInstrument(symbol);
+    return inst ? inst->trades.bars(period) : std::vector<Bar>{};
+}
+
+std::size_t Exchange::selfTradeCancels() const {
+    std::size_t total = 0;
+    for (const auto& inst : instruments) total += inst->book->selfTradeCancels();
+    return total;
+}
+
+QuoteSnapshot Exchange::quote(Symbol symbol) const {
+    const Instrument* inst = findInstrument(symbol);
+    if (!inst) return {};
+    std::uint64_t version = 0;
+    QuoteSnapshot q = inst->quotes.load(&version);
+    q.sequence = version;
+    return q;
+}
+
+void Exchange::publishQuote(Instrument& inst) {
+    const TopOfBook tb = inst.book->top();
+
+    QuoteSnapshot q;
+    q.hasBid = tb.hasBid;
+    q.hasAsk = tb.hasAsk;
+    q.bid = tb.bid;
+    q.ask = tb.ask;
+    q.bidSize = tb.bidSize;
+    q.askSize = tb.askSize;
+    q.lastPrice = inst.lastPrice;
+    q.lastQuantity = inst.lastQuantity;
+    for (auto kind : {FairPriceKind::Vwap, FairPriceKind::WindowVwap, FairPriceKind::Ewma})
+        q.fair[static_cast<std::size_t>(kind)] = inst.fair.value(kind);
+    inst.quotes.store(q);
+}
+
+void Exchange::publishFeed(Shard& shard, MdEvent e) {
+    e.seq = shard.feed->lastPublished() + 1;
+    shard.feed->publish(e);
+}
+
+void Exchange::publishDepth(Shard& shard, Instrument& inst, int t) {
+    for (const OrderSide side : {OrderSide::Buy, OrderSide::Sell}) {
+        auto& published = side == OrderSide::Buy ? inst.feedBids : inst.feedAsks;
+        const std::size_t n = inst.book->depth(side, shard.depthBuf);
+        const auto now = std::span<const BookLevel>(shard.depthBuf).first(n);
+        diffLevels(side, published, now, [&](MdKind kind, const BookLevel& l) {
+            publishFeed(shard, {0, l.price, l.quantity, inst.symbol, kind, side, t});
+        });
+        published.assign(now.begin(), now.end());
+    }
+}
+
+// срез берётся из уже опубликованного состояния, стакан не блокируется
+void Exchange::publishSnapshot(Shard& shard, Instrument& inst, int t) {
+    publishFeed(shard, {0, 0, 0, inst.symbol, MdKind::SnapshotBegin, OrderSide::Buy, t});
+    for (const BookLevel& l : inst.feedBids)
+        publishFeed(shard, {0, l.price, l.quantity, inst.symbol, MdKind::SnapshotLevel, OrderSide::Buy, t});
+    for (const BookLevel& l : inst.feedAsks)
+        publishFeed(shard, {0, l.price, l.quantity, inst.symbol, MdKind::SnapshotLevel, OrderSide::Sell, t});
+    publishFeed(shard, {0, 0, 0, inst.symbol, MdKind::SnapshotEnd, OrderSide::Buy, t});
 }
 
 void Exchange::setFee(double fee, int everyTicks) {
@@ -41,55 +494,460 @@ void Exchange::setFee(double fee, int everyTicks) {
     feeEveryTicks = everyTicks;
 }
 
+bool Exchange::openJournal(const std::string& path) {
+    bool ok = true;
+    for (auto& sh : shards)
+        ok = sh->journal.open(sh->index ? path + "." + std::to_string(sh->index) : path,
+                              kJournalMagic, kJournalVersion) && ok;
+    return ok;
+}
+
+bool Exchange::openTradeSpill(const std::string& path) {
+    bool ok = true;
+    for (auto& sh : shards) {
+        const bool opened = sh->spill.open(sh->index ? path + "." + std::to_string(sh->index) : path,
+                                           kJournalMagic, kJournalVersion, sizeof(JournalRecord));
+        for (Instrument* inst : sh->instruments) inst->trades.setSpill(opened ? &sh->spill : nullptr);
+        ok = opened && ok;
+    }
+    return ok;
+}
+
+void Exchange::setConsoleOutput(bool enabled) {
+    consoleOutput = enabled;
+}
+
+void Exchange::setConsole(std::ostream& os) {
+    std::lock_guard<ExchangeMutex> lk(consoleMutex);
+    console = &os;
+}
+
+bool Exchange::openCapture(const std::string& path) {
+    // replay сводит один стакан, поток нескольких инструментов он не воспроизведёт
+    if (instruments.size() != 1) return false;
+    std::lock_guard<ExchangeMutex> lk(directMutex);
+    auto c = std::make_unique<Journal<CaptureRecord>>(kCaptureRing);
+    const CaptureMeta meta{ticksPerUnit, bookKind, selfTrade};
+    if (!c->open(path, kCaptureMagic, kCaptureVersion, std::as_bytes(std::span{&meta, 1}))) return false;
+    c->start();
+    capture = std::move(c);
+    captureSeq = 0;
+    return true;
+}
+
+void Exchange::setMatchingMode(MatchingMode mode, int everyTicks, AuctionAllocation allocation) {
+    auctionAllocation.store(allocation, std::memory_order_relaxed);
+    auctionEvery.store(mode == MatchingMode::Auction ? std::max(1, everyTicks) : 0, std::memory_order_relaxed);
+}
+
+MatchingMode Exchange::matchingMode() const {
+    return auctionEvery.load(std::memory_order_relaxed) ? MatchingMode::Auction : MatchingMode::Continuous;
+}
+
+void Exchange::setTradeSink(std::function<void(std::span<const Trade>)> sink) {
+    std::lock_guard<ExchangeMutex> lk(directMutex);
+    tradeSink = std::move(sink);
+}
+
+std::size_t Exchange::journalDropped() const {
+    std::size_t total = capture ? capture->droppedCount() : 0;
+    for (const auto& sh : shards) total += sh->journal.droppedCount() + sh->spill.lostRecords();
+    return total;
+}
+
 void Exchange::stop() {
     running = false;
+    for (auto& sh : shards) {
+        std::lock_guard<std::mutex> lk(sh->wakeMutex);
+        sh->wakeCv.notify_all();
+    }
+    {
+        std::lock_guard<std::mutex> lk(pauseMutex);
+        pauseCv.notify_all();
+    }
+    std::lock_guard<std::mutex> lk(monitorMutex);
+    monitorCv.notify_all();
 }
 
-void Exchange::runLoop() {
-    running = true;
-    int t = 0;
+bool Exchange::markPrice(Symbol symbol, double& out) const {
+    const QuoteSnapshot q = quote(symbol);
+    if (q.lastPrice > 0) {
+        out = q.lastPrice;
+    } else if (q.fairPrice(FairPriceKind::Vwap) > 0) {
+        out = q.fairPrice(FairPriceKind::Vwap);
+    } else if (q.hasBid && q.hasAsk) {
+        out = (q.bid + q.ask) / 2;
+    } else {
+        return false;
+    }
+    return true;
+}
 
+void Exchange::monitorLoop() {
+    int lastReport = -riskReportTicks;
+    int lastDump = 0;
+    const int step = riskEveryTicks > 0 ? riskEveryTicks : statsDumpTicks;
+    std::unique_lock<std::mutex> lk(monitorMutex);
     while (running.load()) {
-        while (true) {
-        	Trade tr;
-        	if (!book.tryMatchOne(t, tr)) break;
-
-        	// отменяем self-trade
-        	if (tr.buyerId == tr.sellerId) {
-        		// std::cerr << "buyerId = sellerId" << std::endl;
-        		continue;
-        	}
-
-	        {
-        		std::lock_guard<std::mutex> lk(tradesMutex);
-        		allTrades.push_back(tr);
-	        }
-
-        	std::cout << "[t=" << t << "] TRADE: buyer=" << tr.buyerId
-										<< " seller=" << tr.sellerId
-										<< " qty=" << tr.quantity
-										<< " price=" << tr.price
-										<< "\n";
-
-        	std::shared_ptr<Broker> buyer;
-        	std::shared_ptr<Broker> seller;
-	        {
-        		std::lock_guard<std::mutex> lk(brokersMutex);
-        		buyer = brokers[tr.buyerId];    // shared_ptr можно копировать
-        		seller = brokers[tr.sellerId];
-	        }
-
-        	if (buyer)  buyer->applyTradeAsBuyer(tr.price, tr.quantity);
-        	if (seller) seller->applyTradeAsSeller(tr.price, tr.quantity);
+        lk.unlock();
+        const int t = currentTick.load(std::memory_order_relaxed);
+        const bool report = riskReportTicks > 0 && t - lastReport >= riskReportTicks;
+        const bool dump = statsDumpTicks > 0 && t - lastDump >= statsDumpTicks;
+        monitorPass(t, report, dump);
+        if (report) lastReport = t;
+        if (dump) lastDump = t;
+        lk.lock();
+        monitorCv.wait_for(lk, tickInterval * step, [this] { return !running.load(); });
+    }
+}
+
+void Exchange::monitorPass(int t, bool report, bool dump) {
+    const bool print = consoleOutput.load(std::memory_order_relaxed);
+    bool marked = false;
+    if (riskEveryTicks > 0) {
+        // инструмент, который оценить не по чему, остаётся при прежней марке
+        for (std::size_t s = 0; s < riskMarks.size(); ++s) markPrice(static_cast<Symbol>(s), riskMarks[s]);
+        marked = std::any_of(riskMarks.begin(), riskMarks.end(), [](double m) { return m > 0; });
+    }
+    if (marked) {
+        const RiskTotals r = risk.update(accounts, riskMarks, t);
+        if (report && print) {
+            std::lock_guard<ExchangeMutex> out(consoleMutex);
+            printRiskReport(*console, r);
+        }
+    }
+    if (dump && print) {
+        const StatsSnapshot snap = telemetry::snapshot();
+        std::lock_guard<ExchangeMutex> out(consoleMutex);
+        telemetry::print(*console, snap);
+    }
+}
+
+void Exchange::settle(Shard& shard, Instrument& inst, std::span<const Trade> trades) {
+    const std::int64_t start = telemetry::now();
+    inst.trades.append(trades);
+    for (const Trade& tr : trades) {
+        inst.fair.onTrade(tr);
+        inst.lastPrice = tr.price;
+        inst.lastQuantity = tr.quantity;
+
+        if (journaling) shard.journal.push(toJournalRecord(tr));
+        if (shard.feed)
+            publishFeed(shard, {0, tr.price, tr.quantity, inst.symbol, MdKind::Trade, OrderSide::Buy, tr.executedAt});
+
+        // счета - атомарные записи плоской таблицы: ни мьютекса, ни shared_ptr
+        accounts.settle(tr.buyerId, tr.sellerId, toCash(tr.price * tr.quantity), tr.quantity, inst.symbol);
+        releaseReservation(shard, tr.buyOrderId, tr.quantity, false);
+        releaseReservation(shard, tr.sellOrderId, tr.quantity, false);
+    }
+    if (tradeSink) tradeSink(trades);
+    tradesDone.fetch_add(trades.size(), std::memory_order_release);
+    telemetry::count(StatCounter::Trades, trades.size());
+    telemetry::record(StatLatency::Settlement, start);
+}
+
+void Exchange::matchInstrument(Shard& shard, Instrument& inst, int t) {
+    // все сделки инструмента снимаются со стакана за один захват его мьютекса
+    for (std::size_t n = kMatchBatch, batch = 0; n == kMatchBatch; ++batch) {
+        n = inst.book->matchAll(t, shard.matchBuf);
+        if (n && batch == 0) telemetry::record(StatLatency::BookToTrade, inst.dirtySince);
+        if (n) settle(shard, inst, std::span(shard.matchBuf).first(n));
+    }
+    // заявки, снятые защитой от self-trade, больше ничего не держат
+    for (const std::size_t id : shard.selfTradeCancelled) releaseReservation(shard, id, 0, true);
+    shard.selfTradeCancelled.clear();
+}
+
+void Exchange::auctionInstrument(Shard& shard, Instrument& inst, int t) {
+    shard.auctionBuf.clear();
+    const AuctionRule rule{auctionAllocation.load(std::memory_order_relaxed), inst.lastPrice};
+    if (inst.book->auction(t, rule, shard.auctionBuf)) {
+        telemetry::record(StatLatency::BookToTrade, inst.dirtySince);
+        telemetry::count(StatCounter::Auctions);
+        settle(shard, inst, shard.auctionBuf);
+    }
+}
+
+void Exchange::releaseReservation(Shard& shard, std::size_t id, int qty, bool all) {
+    Reservation* r = shard.reservations.find(id);
+    if (!r) return;
+    const int n = all ? r->remaining : std::min(qty, r->remaining);
+    r->remaining -= n;
+    const bool closed = r->remaining == 0;
+    gate.release(r->brokerId, r->symbol, r->side, n, r->unit, closed);
+    if (closed) shard.reservations.erase(id);
+}
+
+void Exchange::matchPass(Shard& shard, int t, bool first) {
+    const bool drained = drainIngress(shard, true) > 0;
+    if (first) {
+        for (Instrument* inst : shard.instruments)
+            if (!inst->dirty) {
+                inst->dirty = true;
+                shard.pending.push_back(inst);
+            }
+    }
+    if (capture && (drained || first)) capture->pushWait(captureMatch(++captureSeq, t));
+
+    // стакан сводится только у инструментов, куда пришли заявки
+    const int every = auctionEvery.load(std::memory_order_relaxed);
+    for (Instrument* inst : shard.pending) {
+        if (every == 0) {
+            matchInstrument(shard, *inst, t);
+        } else if (!inst->auctionDue) {
+            // аукцион: заявки стоят в стакане до ближайшего тика, кратного every
+            if (shard.auctionQueue.empty())
+                shard.nextAuctionTick = std::max(shard.nextAuctionTick, (t + every - 1) / every * every);
+            inst->auctionDue = true;
+            shard.auctionQueue.push_back(inst);
+        }
+        publishQuote(*inst);
+        if (shard.feed) publishDepth(shard, *inst, t);
+        inst->dirty = false;
+    }
+    shard.pending.clear();
+
+    // не больше одного аукциона за тик; проход, пропустивший тик аукциона (часы runLoop
+    // шагнули через него), проводит аукцион сразу. После возврата в Continuous очередь сводится как обычно
+    if (!shard.auctionQueue.empty() && (every == 0 || t >= shard.nextAuctionTick)) {
+        if (every) shard.nextAuctionTick = (t / every + 1) * every;
+        for (Instrument* inst : shard.auctionQueue) {
+            if (every == 0) matchInstrument(shard, *inst, t);
+            else            auctionInstrument(shard, *inst, t);
+            inst->auctionDue = false;
+            publishQuote(*inst);
+            if (shard.feed) publishDepth(shard, *inst, t);
         }
-    		// комиссия
-        if (feeEveryTicks > 0 && t % feeEveryTicks == 0) {
-            std::lock_guard<std::mutex> lk(brokersMutex);
-            for (auto& [id, br] : brokers)
-                br->applyFee(feePerCycle);
+        shard.auctionQueue.clear();
+    }
+
+    // окно скользящего VWAP сдвигается и без сделок, раз за тик
+    if (t != shard.fairTick) {
+        shard.fairTick = t;
+        for (Instrument* inst : shard.instruments)
+            if (inst->fair.advance(t)) publishQuote(*inst);
+    }
+
+    // снапшоты по кругу: на каждом тике своя порция, за feedSnapshotTicks тиков - все инструменты
+    if (shard.feed && t != shard.snapshotTick) {
+        shard.snapshotTick = t;
+        const std::size_t total = shard.instruments.size();
+        const std::size_t perTick = (total + static_cast<std::size_t>(feedSnapshotTicks) - 1) / feedSnapshotTicks;
+        for (std::size_t k = 0; k < perTick; ++k)
+            publishSnapshot(shard, *shard.instruments[shard.snapshotCursor++ % total], t);
+    }
+}
+
+void Exchange::shardLoop(Shard& shard) {
+    if (wakeMode == WakeMode::Spin && spinCpu >= 0) pinCurrentThread(spinCpu + static_cast<int>(shard.index));
+
+    for (bool first = true; running.load(); first = false) {
+        matchPass(shard, currentTick.load(std::memory_order_relaxed), first);
+        if (pauseRequested.load(std::memory_order_relaxed)) pausePoint();
+        waitForWork(shard, std::chrono::steady_clock::now() + tickInterval);
+    }
+}
+
+void Exchange::runLoop() {
+    {
+        std::lock_guard<ExchangeMutex> lk(directMutex);
+        running = true;
+        ingressOpen = true;
+        virtualClock = false;
+    }
+    // часы продолжаются с тика, восстановленного loadSnapshot (у новой биржи - с 0)
+    int t = currentTick.load(std::memory_order_relaxed);
+    auto nextTick = std::chrono::steady_clock::now();
+    Shard& own = *shards.front();
+
+    if (wakeMode == WakeMode::Spin && spinCpu >= 0) pinCurrentThread(spinCpu);
+
+    // потоки матчинга не делают ввод-вывод сами
+    journaling = consoleOutput.load();
+    for (auto& sh : shards) journaling = journaling || sh->journal.isOpen();
+    if (journaling)
+        for (auto& sh : shards) sh->journal.start();
+
+    std::vector<std::thread> workers;
+    for (std::size_t i = 1; i < shards.size(); ++i)
+        workers.emplace_back([this, i] { shardLoop(*shards[i]); });
+    if (riskEveryTicks > 0 || statsDumpTicks > 0) workers.emplace_back([this] { monitorLoop(); });
+
+    for (bool first = true; running.load(); first = false) {
+        matchPass(own, t, first);
+
+        // t идёт по своим часам, а не по числу пробуждений
+        for (const auto now = std::chrono::steady_clock::now(); now >= nextTick; nextTick += tickInterval) {
+            // комиссия
+            if (feeEveryTicks > 0 && t % feeEveryTicks == 0)
+                accounts.chargeAll(toCash(feePerCycle));
+            currentTick.store(++t, std::memory_order_relaxed);
+        }
+
+        if (pauseRequested.load(std::memory_order_relaxed)) pausePoint();
+        waitForWork(own, nextTick);
+    }
+    for (auto& w : workers) w.join();
+    {
+        // хвост очередей не теряем: последний проход кладёт его в стаканы и сводит,
+        // чтобы после остановки не оставалось пересечённых стаканов и котировок
+        std::lock_guard<ExchangeMutex> lk(directMutex);
+        ingressOpen = false;
+        // кто успел увидеть вход открытым, докладывает в очередь; полную очередь разбираем сами,
+        // иначе он не дождётся места
+        while (ingressProducers.load(std::memory_order_seq_cst) != 0) {
+            for (auto& sh : shards) drainIngress(*sh, true);
+            std::this_thread::yield();
+        }
+        for (auto& sh : shards) matchPass(*sh, t, false);
+    }
+    for (auto& sh : shards) {
+        sh->journal.stop();
+        if (sh->spill.isOpen()) sh->spill.sync();
+    }
+}
+
+bool Exchange::advanceTick() {
+    std::lock_guard<ExchangeMutex> lk(directMutex);
+    if (ingressOpen.load(std::memory_order_relaxed)) return false;
+    const int t = currentTick.load(std::memory_order_relaxed);
+    const bool first = !virtualClock.exchange(true);
+
+    for (auto& sh : shards) matchPass(*sh, t, first);
+    // тот же порядок, что у runLoop и monitorLoop, только по номеру тика
+    const bool report = riskReportTicks > 0 && t % riskReportTicks == 0;
+    const bool dump = statsDumpTicks > 0 && t % statsDumpTicks == 0;
+    if ((riskEveryTicks > 0 && t % riskEveryTicks == 0) || dump) monitorPass(t, report, dump);
+    if (feeEveryTicks > 0 && t % feeEveryTicks == 0)
+        accounts.chargeAll(toCash(feePerCycle));
+    currentTick.store(t + 1, std::memory_order_relaxed);
+    return true;
+}
+
+int Exchange::tick() const {
+    return currentTick.load(std::memory_order_relaxed);
+}
+
+void Exchange::pausePoint() {
+    std::unique_lock<std::mutex> lk(pauseMutex);
+    ++pausedShards;
+    pauseCv.notify_all();
+    pauseCv.wait(lk, [this] { return !pauseRequested.load() || !running.load(); });
+    --pausedShards;
+}
+
+bool Exchange::pauseShards() {
+    pauseRequested = true;
+    for (auto& sh : shards) {
+        std::lock_guard<std::mutex> lk(sh->wakeMutex);
+        sh->wakeCv.notify_all();
+    }
+    std::unique_lock<std::mutex> lk(pauseMutex);
+    pauseCv.wait(lk, [this] { return pausedShards == shards.size() || !running.load(); });
+    return pausedShards == shards.size();
+}
+
+void Exchange::resumeShards() {
+    {
+        std::lock_guard<std::mutex> lk(pauseMutex);
+        pauseRequested = false;
+    }
+    pauseCv.notify_all();
+}
+
+void Exchange::captureSnapshot(SnapshotData& out) {
+    out.tick = currentTick.load(std::memory_order_relaxed);
+    out.nextId = nextId.load(std::memory_order_relaxed);
+    std::vector<Order> orders;
+    for (const auto& ip : instruments) {
+        Instrument& inst = *ip;
+        Shard& shard = shardFor(inst.symbol);
+        SnapshotInstrument rec{};
+        rec.symbol = inst.symbol;
+        rec.lastPrice = inst.lastPrice;
+        rec.lastQuantity = inst.lastQuantity;
+
+        orders.clear();
+        inst.book->exportOrders(orders);
+        rec.ordersBegin = out.orders.size();
+        rec.ordersCount = orders.size();
+        for (const Order& o : orders) {
+            SnapshotOrder so{.order = o};
+            if (const Reservation* r = shard.reservations.find(o.id)) {
+                so.unit = r->unit;
+                so.remaining = r->remaining;
+                so.reserved = 1;
+                so.market = r->market;
+            }
+            out.orders.push_back(so);
         }
 
-        ++t;
-        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        rec.windowBegin = out.window.size();
+        inst.fair.save(rec.fair, out.window);
+        rec.windowCount = out.window.size() - rec.windowBegin;
+        out.instruments.push_back(rec);
     }
+    accounts.exportRecords(out.accounts, out.positions);
+}
+
+bool Exchange::saveSnapshot(const std::string& path) {
+    SnapshotData data;
+    {
+        std::lock_guard<ExchangeMutex> lk(directMutex);
+        if (running.load()) {
+            const bool paused = pauseShards();
+            if (paused) captureSnapshot(data);
+            resumeShards();
+            if (!paused) return false;
+        } else {
+            captureSnapshot(data);
+        }
+    }
+    return writeSnapshot(path, data);
+}
+
+bool Exchange::loadSnapshot(const std::string& path) {
+    SnapshotReader reader;
+    if (!reader.open(path)) return false;
+    const auto insts = reader.section<SnapshotInstrument>(SnapshotSection::Instruments);
+    const auto orders = reader.section<SnapshotOrder>(SnapshotSection::Orders);
+    const auto window = reader.section<FairWindowEntry>(SnapshotSection::FairWindow);
+    const auto positions = reader.section<PositionRecord>(SnapshotSection::Positions);
+    for (const SnapshotInstrument& rec : insts)
+        if (!findInstrument(static_cast<Symbol>(rec.symbol)) || rec.ordersBegin + rec.ordersCount > orders.size()
+            || rec.windowBegin + rec.windowCount > window.size()) return false;
+    for (const PositionRecord& p : positions)
+        if (!findInstrument(p.symbol)) return false;
+
+    std::lock_guard<ExchangeMutex> lk(directMutex);
+    if (ingressOpen.load()) return false;
+    for (const AccountRecord& a : reader.section<AccountRecord>(SnapshotSection::Accounts)) accounts.restore(a);
+    for (const PositionRecord& p : positions) accounts.restore(p);
+
+    std::vector<Order> batch;
+    for (const SnapshotInstrument& rec : insts) {
+        Instrument& inst = *instruments[rec.symbol];
+        Shard& shard = shardFor(inst.symbol);
+        const auto own = orders.subspan(rec.ordersBegin, rec.ordersCount);
+        batch.clear();
+        for (const SnapshotOrder& so : own) batch.push_back(so.order);
+        inst.book->addOrders(batch);
+
+        shard.reservations.reserve(shard.reservations.size() + own.size());
+        for (const SnapshotOrder& so : own) {
+            if (!so.reserved) continue;
+            const Order& o = so.order;
+            shard.reservations.insert(o.id, {o.brokerId, so.remaining, so.unit, o.side, so.market != 0, o.symbol});
+            gate.restore(o.brokerId, o.symbol, o.side, so.remaining, so.unit);
+        }
+        inst.fair.restore(rec.fair, window.subspan(rec.windowBegin, rec.windowCount));
+        inst.lastPrice = rec.lastPrice;
+        inst.lastQuantity = rec.lastQuantity;
+        publishQuote(inst);
+    }
+
+    const SnapshotHeader& h = reader.header();
+    for (std::size_t cur = nextId.load(); cur < h.nextId && !nextId.compare_exchange_weak(cur, h.nextId);) {}
+    currentTick.store(h.tick, std::memory_order_relaxed);
+    return true;
 }
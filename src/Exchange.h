@@ -2,42 +2,381 @@
 #define EXCHANGE_H
 
 #include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <iosfwd>
+#include <memory>
 #include <mutex>
+#include <span>
+#include <string>
 #include <vector>
 #include <unordered_map>
-#include "OrderBook.h"
+#include "AccountTable.h"
+#include "Auction.h"
+#include "Book.h"
+#include "Capture.h"
+#include "FairPrice.h"
+#include "FlatIndex.h"
+#include "Journal.h"
+#include "JournalRecord.h"
+#include "MappedFile.h"
+#include "MarketData.h"
+#include "MpscRing.h"
+#include "QuoteSnapshot.h"
+#include "RiskEngine.h"
+#include "RiskGate.h"
+#include "Seqlock.h"
+#include "Snapshot.h"
+#include "Stats.h"
+#include "TradeStore.h"
 #include "Order.h"
 
 class Broker;
 
+// Как поток матчинга ждёт новых заявок:
+// Poll  - спит до следующего тика (как раньше, задержка до 20 мс);
+// Event - засыпает на condition_variable, submitOrder будит его сразу;
+// Spin  - крутится с pause-бэкоффом, опционально на закреплённом ядре.
+enum class WakeMode { Poll, Event, Spin };
+
+// Continuous - стакан сводится после каждой порции заявок (пара лучших заявок за раз);
+// Auction    - заявки копятся auctionTicks тиков, затем каждый стакан сводится
+//              аукционом по одной цене (см. Auction.h). Переключается и на ходу.
+enum class MatchingMode { Continuous, Auction };
+
+struct ExchangeConfig {
+    BookKind book = BookKind::Map;
+    int ticksPerUnit = 100;     // шаг цены 0.01 для лестничного стакана
+    int fairWindowTicks = 250;  // окно скользящего VWAP (5 с при тике 20 мс)
+    double fairEwmaAlpha = 0.05;
+    std::size_t ingressCapacity = 1 << 16;  // на каждый шард
+    WakeMode wake = WakeMode::Event;
+    std::chrono::milliseconds tick{20};    // часы t и комиссии
+    int spinCpu = -1;                       // ядро для WakeMode::Spin, -1 - не закреплять
+    SelfTradePolicy selfTrade = SelfTradePolicy::CancelOldest;
+    std::size_t instruments = 1;            // инструменты 0..instruments-1
+    std::size_t shards = 1;                 // потоков матчинга; инструмент s живёт в шарде s % shards
+    std::size_t feedDepth = 0;              // уровней на сторону в L2-фиде, 0 - фид выключен
+    std::size_t feedCapacity = 1 << 16;     // событий в кольце фида каждого шарда
+    int feedSnapshotTicks = 50;             // каждый инструмент получает снапшот раз в столько тиков
+    int tradeRetentionTicks = 0;            // история сделок в памяти, 0 - без ограничения
+    std::size_t barHistory = 1440;          // закрытых свечей каждого периода на инструмент
+    int riskEveryTicks = 1;                 // пересчёт оценки счетов по рынку, 0 - выключен
+    int riskReportTicks = 250;              // строка RISK в консоль, 0 - без отчёта
+    RiskKernel riskKernel = RiskKernel::Auto;
+    int statsDumpTicks = 0;                 // строки STATS/LATENCY (всего процесса) в консоль, 0 - без них
+    bool preTradeRisk = true;               // проверка и резерв денег/бумаг в submitOrder
+    MatchingMode matching = MatchingMode::Continuous;
+    int auctionTicks = 1;                   // интервал аукционов в тиках
+    AuctionAllocation auctionAllocation = AuctionAllocation::TimePriority;
+    RiskLimits riskLimits{};                // лимиты брокеров по умолчанию
+};
+
+struct IngressStats {
+    std::size_t drained{};      // заявок (и снятий/изменений) переложено из очереди в стакан
+    std::size_t stalls{};       // сколько раз submitOrder ждал места в очереди
+    std::size_t overflows{};    // отказов trySubmitOrder из-за переполнения
+    std::size_t rejected{};     // заявок на несуществующий инструмент и не взятых стаканом
+    std::size_t missed{};       // снятий/изменений, не нашедших заявку в стакане
+};
+
 class Exchange final {
-    OrderBook book;
+    static constexpr std::size_t kDrainBatch = 256;
+    static constexpr std::size_t kMatchBatch = 256;
+    static constexpr std::size_t kCaptureRing = 1 << 20;
+    static constexpr std::size_t kSweepLevels = 32;    // уровней, по которым оценивается рыночная покупка
+
+    // Что делает запрос из очереди: Cancel берёт из order id и symbol,
+    // Replace - ещё quantity и price.
+    enum class RequestKind : std::uint8_t { New, Cancel, Replace };
+
+    struct Request {
+        Order order;
+        Cash unit{};                // цена резерва за штуку (см. RiskGate)
+        std::int64_t submittedAt{}; // telemetry::now() в submitOrder
+        RequestKind kind = RequestKind::New;
+        bool reserved = false;      // заявка прошла RiskGate с резервом
+    };
+
+    // Резерв стоящей заявки; ведёт поток шарда.
+    struct Reservation {
+        int brokerId{};
+        int remaining{};
+        Cash unit{};
+        OrderSide side{};
+        bool market{};
+        Symbol symbol{};
+    };
+
+    // Стакан и рыночные данные одного инструмента; пишет только поток его шарда.
+    struct Instrument {
+        Instrument(Symbol symbol, const ExchangeConfig& config);
+
+        Symbol symbol;
+        std::unique_ptr<Book> book;
+        FairPrice fair;
+        Seqlock<QuoteSnapshot> quotes;
+        double lastPrice = -1.0;
+        int lastQuantity = 0;
+        bool dirty = false;     // есть новые заявки, стакан надо свести
+        bool auctionDue = false;    // стоит в очереди ближайшего аукциона шарда
+        std::int64_t dirtySince{};  // telemetry::now() первой несведённой заявки
+        TradeStore trades;      // история сделок и свечи
+
+        // верхние уровни в том виде, в каком они ушли в фид
+        std::vector<BookLevel> feedBids;
+        std::vector<BookLevel> feedAsks;
+    };
+
+    // Поток матчинга со своей очередью и непересекающимся набором инструментов.
+    struct Shard {
+        Shard(std::size_t index, std::size_t ingressCapacity);
+
+        std::size_t index;
+        MpscRing<Request> ingress;
+        std::vector<Instrument*> instruments;
+        std::vector<Instrument*> pending;   // инструменты с dirty == true
+        std::vector<Trade> matchBuf;        // сделки одного прохода matchAll
+        std::vector<Trade> auctionBuf;      // сделки одного аукциона
+        std::vector<Instrument*> auctionQueue;  // инструменты с заявками с прошлого аукциона
+        int nextAuctionTick = 0;    // ближайший тик аукциона; проход на нём или позже его проводит
+        int fairTick = -1;                  // тик, на котором сдвигались окна справедливой цены
+
+        FlatIndex<Reservation> reservations;
+        std::vector<std::size_t> selfTradeCancelled;    // id заявок, снятых стаканами шарда
+
+        // сделки, вытесненные из памяти TradeStore инструментов шарда
+        MappedFile spill;
+
+        // сделки уходят в журнал; файл и консоль обслуживает фоновый поток
+        Journal<JournalRecord> journal;
 
-    std::mutex tradesMutex;
-    std::vector<Trade> allTrades;
+        // L2-фид инструментов шарда; пишет только поток шарда
+        std::unique_ptr<FeedRing> feed;
+        std::vector<BookLevel> depthBuf;
+        std::size_t snapshotCursor = 0;
+        int snapshotTick = -1;
 
-    std::mutex brokersMutex;
+        std::mutex wakeMutex;
+        std::condition_variable wakeCv;
+        std::atomic<bool> sleeping{false};
+    };
+
+    std::vector<std::unique_ptr<Instrument>> instruments;
+    std::vector<std::unique_ptr<Shard>> shards;
+
+    std::atomic<std::size_t> ingressDrained{0};
+    std::atomic<std::size_t> ingressStalls{0};
+    std::atomic<std::size_t> ingressOverflows{0};
+    std::atomic<std::size_t> ingressRejected{0};
+    std::atomic<std::size_t> ingressMissed{0};
+
+    std::atomic<bool> consoleOutput{true};
+    std::ostream* console;         // std::cout, если не задан setConsole
+    bool journaling = false;
+    std::function<void(std::span<const Trade>)> tradeSink;
+    ExchangeMutex consoleMutex;    // журналы шардов печатают в один поток
+
+    // запись потока заявок в порядке применения к стакану (см. stock_replay)
+    std::unique_ptr<Journal<CaptureRecord>> capture;
+    std::uint64_t captureSeq = 0;
+
+    // прямые (до старта) записи в стакан и смена running идут под ней,
+    // поэтому у стакана и capture в каждый момент один писатель
+    ExchangeMutex directMutex;
+    // часы ведёт шард 0, остальные только читают
+    std::atomic<int> currentTick{0};
+    // часы двигает advanceTick, а не runLoop (см. Simulation)
+    std::atomic<bool> virtualClock{false};
+
+    // снапшот на ходу: потоки шардов встают на границе прохода, пока состояние копируется в память
+    std::atomic<bool> pauseRequested{false};
+    std::mutex pauseMutex;
+    std::condition_variable pauseCv;
+    std::size_t pausedShards = 0;
+
+    // брокеры только держатся живыми; деньги и позиции - в accounts
+    ExchangeMutex brokersMutex;
     std::unordered_map<int, std::shared_ptr<Broker>> brokers;
+    AccountTable accounts;
+    RiskGate gate;
+    bool preTradeRisk;
+
+    // 0 - непрерывный режим, иначе интервал аукционов в тиках
+    std::atomic<int> auctionEvery;
+    std::atomic<AuctionAllocation> auctionAllocation;
 
     std::atomic<bool> running{false};
+    // Заявки идут в очереди шардов, пока открыт вход; runLoop закрывает его под directMutex
+    // перед последним проходом и дожидается производителей, уже решивших класть в очередь.
+    // После этого всё идёт напрямую, как до старта, и в очередях ничего не застревает.
+    std::atomic<bool> ingressOpen{false};
+    std::atomic<int> ingressProducers{0};
     std::atomic<size_t> nextId{1};
+    std::atomic<std::size_t> tradesDone{0};
+
+    WakeMode wakeMode;
+    std::chrono::steady_clock::duration tickInterval;
+    int spinCpu;
+
+    // параметры стаканов, для заголовка capture
+    BookKind bookKind;
+    int ticksPerUnit;
+    SelfTradePolicy selfTrade;
+
+    std::size_t feedDepth;
+    int feedSnapshotTicks;
 
     double feePerCycle = 1.0;
     int feeEveryTicks = 50;
 
+    // оценка счетов по рынку и отчёты считаются в своём потоке, матчинг их не ждёт
+    RiskEngine risk;
+    std::vector<double> riskMarks;  // последняя марка каждого инструмента, 0 - ещё не оценён; пишет монитор
+    int riskEveryTicks;
+    int riskReportTicks;
+    int statsDumpTicks;
+    std::mutex monitorMutex;
+    std::condition_variable monitorCv;
+
 public:
+    explicit Exchange(const ExchangeConfig& config = {});
+
+    // открывает счёт брокера с его начальным балансом; id должен быть в [0, AccountTable::kMaxAccounts)
     void registerBroker(const std::shared_ptr<Broker>& b);
+    // счёт без объекта Broker (см. BrokerPopulation); позиция inventory - по symbol.
+    // false - id вне диапазона или нет такого инструмента
+    bool registerAccount(int brokerId, double cash, int inventory, Symbol symbol = 0);
+    // деньги брокера и его позиция по symbol за O(1), без блокировок
+    [[nodiscard]] AccountSnapshot account(int brokerId, Symbol symbol = 0) const;
 
     size_t genOrderId();
-    void submitOrder(Order order);
+    // инструмент берётся из order.symbol; возвращает id заявки (0 - инструмента нет)
+    size_t submitOrder(Order order);
+    bool trySubmitOrder(Order order);
+    // Снятие и изменение заявки (см. Book::replaceOrder). Идут через ту же очередь,
+    // что и заявки, поэтому применяются после всего, что брокер отправил раньше.
+    // false - нет такого инструмента.
+    bool cancelOrder(size_t id, Symbol symbol = 0);
+    bool replaceOrder(size_t id, int newQty, double newPrice, Symbol symbol = 0);
+    [[nodiscard]] IngressStats ingressStats() const;
 
-    bool bestBidPrice(double& out);
-    bool bestAskPrice(double& out);
-    double fairPriceEstimate();
+    // Предторговый контроль: лимиты брокера (0 - без ограничения) и резервы его открытых заявок.
+    // submitOrder возвращает 0, trySubmitOrder - false, если заявка не прошла.
+    void setRiskLimits(int brokerId, const RiskLimits& limits);
+    [[nodiscard]] RiskGateStats riskGateStats() const;
+    [[nodiscard]] const RiskGate& riskGate() const { return gate; }
+
+    [[nodiscard]] std::size_t instrumentCount() const;
+    [[nodiscard]] std::size_t shardCount() const;
+
+    bool bestBidPrice(double& out, Symbol symbol = 0);
+    bool bestAskPrice(double& out, Symbol symbol = 0);
+    double fairPriceEstimate(FairPriceKind kind = FairPriceKind::Vwap, Symbol symbol = 0) const;
+    // вершина стакана, последняя сделка и справедливая цена одним согласованным срезом, без мьютексов
+    [[nodiscard]] QuoteSnapshot quote(Symbol symbol = 0) const;
+    // кольцо L2-фида шарда, где живёт инструмент (см. DepthView); nullptr - фид выключен
+    [[nodiscard]] const FeedRing* marketData(Symbol symbol = 0) const;
+    [[nodiscard]] std::size_t tradeCount() const;
+    // Итоги последнего пересчёта риска: капитал, PnL, экспозиция и позиция рынка в целом.
+    // Позиция по каждому инструменту оценивается по его марке - последней сделке (см. markPrice).
+    [[nodiscard]] RiskTotals riskTotals() const;
+    [[nodiscard]] AccountRisk accountRisk(int brokerId) const;
+    // Счётчики и гистограммы задержек всего процесса, не только этой биржи: блоки телеметрии
+    // у потоков (см. Stats.h), то же, что telemetry::snapshot(). При STOCK_STATS=0 - нули.
+    [[nodiscard]] StatsSnapshot stats() const;
+    // сделки инструмента с executedAt в [fromTick, toTick), из ещё не вытесненной истории
+    [[nodiscard]] std::vector<Trade> tradesBetween(int fromTick, int toTick, Symbol symbol = 0) const;
+    // свечи OHLCV (секунда - 1000 мс по часам биржи), последняя - текущая
+    [[nodiscard]] std::vector<Bar> bars(BarPeriod period, Symbol symbol = 0) const;
+    [[nodiscard]] std::size_t selfTradeCancels() const;
 
     void setFee(double fee, int everyTicks);
+    // Непрерывный режим или аукционы раз в everyTicks тиков, в любой момент (открытие,
+    // всплеск нагрузки, закрытие). Накопленное к переключению в Continuous сводится сразу.
+    // В аукционе снятие/изменение заявки не сводит стакан до аукциона, а stock_replay
+    // воспроизводит записанный поток только как непрерывный.
+    void setMatchingMode(MatchingMode mode, int everyTicks = 1,
+                         AuctionAllocation allocation = AuctionAllocation::TimePriority);
+    [[nodiscard]] MatchingMode matchingMode() const;
+    // до runLoop: бинарный журнал сделок (см. stock_journal_dump);
+    // шард i > 0 пишет в "<path>.i"
+    bool openJournal(const std::string& path);
+    void setConsoleOutput(bool enabled);
+    // до runLoop: куда идут журнал сделок и строки RISK/STATS вместо std::cout,
+    // например свой поток у каждой из параллельных бирж; os должен пережить биржу
+    void setConsole(std::ostream& os);
+    // до runLoop: вытесненные по tradeRetentionTicks сделки дописываются в файл
+    // формата журнала сделок; шард i > 0 пишет в "<path>.i"
+    bool openTradeSpill(const std::string& path);
+    // до runLoop: запись всех заявок, дошедших до стакана (только один инструмент)
+    bool openCapture(const std::string& path);
+    // до runLoop: каждая пачка сделок отдаётся sink из потока шарда, уже после расчёта
+    // счетов (см. Gateway); sink не должен блокироваться надолго - он держит матчинг
+    void setTradeSink(std::function<void(std::span<const Trade>)> sink);
+    // записи журнала, capture и вытесненные сделки, не попавшие в файл
+    [[nodiscard]] std::size_t journalDropped() const;
     void stop();
+    // поток шарда 0; остальные шарды запускаются отсюда же и завершаются вместе с ним
     void runLoop();
+    // Снапшот стаканов (с резервами заявок), счетов, справедливых цен, nextId и тика (см. Snapshot.h).
+    // Во время runLoop потоки шардов встают на границе прохода только на время копирования
+    // в память, файл пишется уже без них; заявки, ещё лежащие в очередях, в снапшот не входят.
+    // false - не удалось записать файл или биржа останавливается.
+    bool saveSnapshot(const std::string& path);
+    // До runLoop, на биржу с тем же числом инструментов и без заявок. Счета, открытые
+    // из снапшота, registerBroker не сбрасывает. История сделок и свечи не восстанавливаются.
+    bool loadSnapshot(const std::string& path);
+
+    // Один тик без потоков и ожиданий, в вызывающем потоке: свести стаканы всех шардов,
+    // пересчитать риск, взять комиссию и перевести часы. Заявки между вызовами применяются
+    // сразу (как до старта), а при снятии/изменении стакан сначала сводится - как в runLoop.
+    // Журналы и фоновые потоки не используются. false - уже идёт runLoop.
+    bool advanceTick();
+    // номер текущего тика часов биржи
+    [[nodiscard]] int tick() const;
+
+private:
+    [[nodiscard]] Instrument* findInstrument(Symbol symbol) const;
+    Shard& shardFor(Symbol symbol);
+    void enqueue(const Request& request);
+    // положить в очередь шарда, если вход открыт (wait - ждать места); false - пробовать submitDirect
+    bool pushIngress(const Request& request, bool wait);
+    bool submitDirect(const Request& request);
+    // RiskGate для новой заявки; false - отказ
+    bool admit(Request& request);
+    // исполнение или снятие qty штук заявки id с резервом
+    void releaseReservation(Shard& shard, std::size_t id, int qty, bool all);
+    // live - запрос пришёл в работающий цикл: перед снятием/изменением стакан сводится,
+    // чтобы уже пересекающиеся заявки исполнились, как если бы матчинг шёл на каждой заявке
+    void apply(Shard& shard, const Request& request, bool live);
+    std::size_t drainIngress(Shard& shard, bool live);
+    void matchInstrument(Shard& shard, Instrument& inst, int t);
+    void auctionInstrument(Shard& shard, Instrument& inst, int t);
+    // один проход: очередь -> стаканы -> сделки -> котировки
+    void matchPass(Shard& shard, int t, bool first);
+    void settle(Shard& shard, Instrument& inst, std::span<const Trade> trades);
+    void publishQuote(Instrument& inst);
+    void publishFeed(Shard& shard, MdEvent e);
+    // события Add/Modify/Delete по изменившимся верхним уровням
+    void publishDepth(Shard& shard, Instrument& inst, int t);
+    void publishSnapshot(Shard& shard, Instrument& inst, int t);
+    void shardLoop(Shard& shard);
+    // последняя сделка инструмента, иначе VWAP, иначе середина спреда; false - оценить не по чему
+    bool markPrice(Symbol symbol, double& out) const;
+    // пересчёт риска и периодические отчёты
+    void monitorLoop();
+    // копия состояния для снапшота; вызывается, когда ни один шард не работает
+    void captureSnapshot(SnapshotData& out);
+    bool pauseShards();
+    void resumeShards();
+    // точка остановки потока шарда между проходами
+    void pausePoint();
+    // пересчёт оценки счетов; report/dump - строки RISK и STATS в консоль
+    void monitorPass(int t, bool report, bool dump);
+    void wakeMatcher(Shard& shard);
+    void waitForWork(Shard& shard, std::chrono::steady_clock::time_point deadline);
 };
 
 #endif
@@ -0,0 +1,80 @@
+#include "FairPrice.h"
+
+FairPrice::FairPrice(int windowTicks, double alpha)
+    : windowTicks(windowTicks > 0 ? windowTicks : 1), alpha(alpha) {}
+
+void FairPrice::onTrade(const Trade& tr) {
+    if (tr.quantity <= 0) return;
+
+    const double n = tr.price * tr.quantity;
+    notional += n;
+    quantity += tr.quantity;
+
+    window.push_back({tr.executedAt, n, tr.quantity});
+    windowNotional += n;
+    windowQuantity += tr.quantity;
+    trim(tr.executedAt);
+
+    ewma = hasEwma ? ewma + alpha * (tr.price - ewma) : tr.price;
+    hasEwma = true;
+
+    vwapValue.store(notional / static_cast<double>(quantity), std::memory_order_release);
+    publishWindow();
+    ewmaValue.store(ewma, std::memory_order_release);
+}
+
+bool FairPrice::trim(int now) {
+    bool trimmed = false;
+    while (!window.empty() && window.front().at <= now - windowTicks) {
+        windowNotional -= window.front().notional;
+        windowQuantity -= window.front().quantity;
+        window.pop_front();
+        trimmed = true;
+    }
+    // сбрасываем накопленную погрешность вычитаний
+    if (window.size() <= 1) {
+        windowNotional = window.empty() ? 0 : window.front().notional;
+        windowQuantity = window.empty() ? 0 : window.front().quantity;
+    }
+    return trimmed;
+}
+
+void FairPrice::publishWindow() {
+    windowValue.store(windowQuantity > 0 ? windowNotional / static_cast<double>(windowQuantity) : -1.0,
+                      std::memory_order_release);
+}
+
+bool FairPrice::advance(int now) {
+    if (!trim(now)) return false;
+    publishWindow();
+    return true;
+}
+
+double FairPrice::value(FairPriceKind kind) const {
+    switch (kind) {
+        case FairPriceKind::WindowVwap: return windowValue.load(std::memory_order_acquire);
+        case FairPriceKind::Ewma:       return ewmaValue.load(std::memory_order_acquire);
+        case FairPriceKind::Vwap:       break;
+    }
+    return vwapValue.load(std::memory_order_acquire);
+}
+
+void FairPrice::save(FairPriceState& state, std::vector<FairWindowEntry>& out) const {
+    state = {notional, quantity, windowNotional, windowQuantity, ewma, hasEwma};
+    for (const Entry& e : window) out.push_back({e.at, 0, e.notional, e.quantity});
+}
+
+void FairPrice::restore(const FairPriceState& state, std::span<const FairWindowEntry> entries) {
+    notional = state.notional;
+    quantity = state.quantity;
+    windowNotional = state.windowNotional;
+    windowQuantity = state.windowQuantity;
+    ewma = state.ewma;
+    hasEwma = state.hasEwma != 0;
+    window.clear();
+    for (const FairWindowEntry& e : entries) window.push_back({e.at, e.notional, e.quantity});
+
+    vwapValue.store(quantity > 0 ? notional / static_cast<double>(quantity) : -1.0, std::memory_order_release);
+    publishWindow();
+    ewmaValue.store(hasEwma ? ewma : -1.0, std::memory_order_release);
+}
@@ -0,0 +1,79 @@
+#ifndef FAIRPRICE_H
+#define FAIRPRICE_H
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <span>
+#include <vector>
+#include "Order.h"
+
+enum class FairPriceKind { Vwap, WindowVwap, Ewma };
+
+// Состояние писателя FairPrice без окна, в виде для файла снапшота (без дыр выравнивания).
+struct FairPriceState {
+    double notional{};
+    std::int64_t quantity{};
+    double windowNotional{};
+    std::int64_t windowQuantity{};
+    double ewma{};
+    std::uint64_t hasEwma{};
+};
+static_assert(sizeof(FairPriceState) == 48);
+
+// сделка в окне скользящего VWAP
+struct FairWindowEntry {
+    std::int32_t at{};
+    std::int32_t reserved{};
+    double notional{};
+    std::int64_t quantity{};
+};
+static_assert(sizeof(FairWindowEntry) == 24);
+
+// Оценки справедливой цены, обновляемые инкрементально на каждой сделке.
+// Пишет только поток матчинга (onTrade), читать можно из любых потоков
+// без блокировок: последние значения публикуются в атомиках.
+class FairPrice final {
+    struct Entry {
+        int at;
+        double notional;
+        long long quantity;
+    };
+
+    // состояние писателя
+    double notional = 0;
+    long long quantity = 0;
+    std::deque<Entry> window;
+    double windowNotional = 0;
+    long long windowQuantity = 0;
+    double ewma = 0;
+    bool hasEwma = false;
+
+    int windowTicks;
+    double alpha;
+
+    std::atomic<double> vwapValue{-1.0};
+    std::atomic<double> windowValue{-1.0};
+    std::atomic<double> ewmaValue{-1.0};
+
+    // выбросить из окна сделки не позже now - windowTicks; true - что-то выпало
+    bool trim(int now);
+    void publishWindow();
+
+public:
+    FairPrice(int windowTicks, double alpha);
+
+    void onTrade(const Trade& tr);
+    // Часы без сделок: из окна выпадают сделки старше now - windowTicks. Без них
+    // WindowVwap снова -1.0. true - окно изменилось (котировку надо переопубликовать).
+    bool advance(int now);
+
+    // -1.0, пока не было ни одной сделки
+    [[nodiscard]] double value(FairPriceKind kind) const;
+
+    // Снапшот: состояние и окно (дописывается в window). Только из потока писателя.
+    void save(FairPriceState& state, std::vector<FairWindowEntry>& window) const;
+    void restore(const FairPriceState& state, std::span<const FairWindowEntry> window);
+};
+
+#endif // FAIRPRICE_H
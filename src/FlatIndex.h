@@ -0,0 +1,91 @@
+#ifndef FLATINDEX_H
+#define FLATINDEX_H
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Открытая адресация с линейным пробированием: id заявки -> V.
+// Ключ 0 зарезервирован под пустую ячейку (genOrderId начинает с 1),
+// такие ключи не индексируются.
+// Удаление сдвигом назад, без надгробий, поэтому таблица не деградирует.
+template <class V>
+class FlatIndex final {
+    struct Slot {
+        std::size_t key{};
+        V value{};
+    };
+
+    std::vector<Slot> slots;
+    std::size_t mask{};
+    int shift{};
+    std::size_t count = 0;
+
+    [[nodiscard]] std::size_t home(std::size_t key) const {
+        return static_cast<std::size_t>((key * 0x9E3779B97F4A7C15ull) >> shift);
+    }
+
+    void rehash(std::size_t capacity) {
+        std::vector<Slot> old;
+        old.swap(slots);
+        slots.resize(capacity);
+        mask = capacity - 1;
+        shift = 64 - std::countr_zero(capacity);
+        count = 0;
+        for (const Slot& s : old)
+            if (s.key) insert(s.key, s.value);
+    }
+
+public:
+    explicit FlatIndex(std::size_t capacity = 1024) {
+        rehash(std::bit_ceil(capacity < 16 ? std::size_t{16} : capacity));
+    }
+
+    // место под n ключей без перестроек по ходу вставки
+    void reserve(std::size_t n) {
+        if (n * 2 > slots.size()) rehash(std::bit_ceil(n * 2));
+    }
+
+    // вставка или перезапись
+    void insert(std::size_t key, const V& value) {
+        if (!key) return;
+        if ((count + 1) * 2 > slots.size()) rehash(slots.size() * 2);
+        std::size_t i = home(key);
+        while (slots[i].key && slots[i].key != key) i = (i + 1) & mask;
+        if (!slots[i].key) ++count;
+        slots[i] = {key, value};
+    }
+
+    V* find(std::size_t key) {
+        if (!key) return nullptr;
+        for (std::size_t i = home(key); slots[i].key; i = (i + 1) & mask)
+            if (slots[i].key == key) return &slots[i].value;
+        return nullptr;
+    }
+
+    bool erase(std::size_t key) {
+        if (!key) return false;
+        std::size_t i = home(key);
+        while (slots[i].key != key) {
+            if (!slots[i].key) return false;
+            i = (i + 1) & mask;
+        }
+        for (std::size_t j = i;;) {
+            j = (j + 1) & mask;
+            if (!slots[j].key) break;
+            const std::size_t k = home(slots[j].key);
+            // элемент j остаётся, если его домашняя ячейка циклически в (i, j]
+            if (i <= j ? (i < k && k <= j) : (i < k || k <= j)) continue;
+            slots[i] = slots[j];
+            i = j;
+        }
+        slots[i].key = 0;
+        --count;
+        return true;
+    }
+
+    [[nodiscard]] std::size_t size() const { return count; }
+};
+
+#endif // FLATINDEX_H
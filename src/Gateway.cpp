@@ -0,0 +1,276 @@
+#include "Gateway.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <new>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace {
+
+void cpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+    _mm_pause();
+#else
+    std::this_thread::yield();
+#endif
+}
+
+void pinCurrentThread(int cpu) {
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#else
+    (void)cpu;
+#endif
+}
+
+bool validNew(const GatewayRequest& r) {
+    return r.quantity > 0
+        && (r.side == OrderSide::Buy || r.side == OrderSide::Sell)
+        && (r.type == OrderType::Limit || r.type == OrderType::Market);
+}
+
+} // namespace
+
+Gateway::Gateway(Exchange& exchange, const GatewayConfig& config)
+    : exchange(exchange),
+      config(config),
+      slotCount(std::clamp<std::size_t>(config.clients, 1, kGatewayMaxClients)),
+      fills(config.fillCapacity) {
+    for (auto& b : brokers) b.store(-1, std::memory_order_relaxed);
+    exchange.setTradeSink([this](std::span<const Trade> trades) { onTrades(trades); });
+}
+
+Gateway::~Gateway() {
+    stop();
+    exchange.setTradeSink({});
+}
+
+bool Gateway::start() {
+    if (running.load()) return true;
+
+    size = gatewaySegmentSize(slotCount);
+    shm_unlink(config.name.c_str());
+    const int fd = shm_open(config.name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0) return false;
+    if (ftruncate(fd, static_cast<off_t>(size)) != 0) {
+        ::close(fd);
+        shm_unlink(config.name.c_str());
+        return false;
+    }
+    void* p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, 0);
+    ::close(fd);
+    if (p == MAP_FAILED) {
+        shm_unlink(config.name.c_str());
+        return false;
+    }
+    base = p;
+
+    // конструкторы слотов проходят по всем страницам: первая заявка не ловит page fault
+    auto* h = new (base) GatewayHeader{};
+    std::memcpy(h->magic, kGatewayMagic.data(), std::min(kGatewayMagic.size(), sizeof(h->magic)));
+    h->version = kGatewayVersion;
+    h->clients = static_cast<std::uint32_t>(slotCount);
+    h->segmentSize = size;
+    h->ringCapacity = static_cast<std::uint32_t>(kGatewayRingCapacity);
+    h->messageSize = sizeof(GatewayRequest);
+    slots = gatewaySlots(base);
+    for (std::size_t i = 0; i < slotCount; ++i) new (&slots[i]) GatewaySlot();
+
+    clients.clear();
+    clients.resize(slotCount);
+    routes = FlatIndex<Route>(1 << 16);
+    retired.clear();
+
+    h->serverPid.store(static_cast<std::uint32_t>(getpid()), std::memory_order_release);
+    running = true;
+    worker = std::thread(&Gateway::loop, this);
+    return true;
+}
+
+void Gateway::stop() {
+    if (!running.exchange(false)) return;
+    if (worker.joinable()) worker.join();
+    for (auto& b : brokers) b.store(-1, std::memory_order_release);
+
+    static_cast<GatewayHeader*>(base)->serverPid.store(0, std::memory_order_release);
+    munmap(base, size);
+    shm_unlink(config.name.c_str());
+    base = nullptr;
+    slots = nullptr;
+}
+
+GatewayStats Gateway::stats() const {
+    return {requestCount.load(std::memory_order_relaxed), ackCount.load(std::memory_order_relaxed),
+            rejectCount.load(std::memory_order_relaxed), fillCount.load(std::memory_order_relaxed),
+            connectCount.load(std::memory_order_relaxed), backlogCount.load(std::memory_order_relaxed)};
+}
+
+bool Gateway::isClient(int brokerId) const {
+    for (std::size_t i = 0; i < slotCount; ++i)
+        if (brokers[i].load(std::memory_order_relaxed) == brokerId) return true;
+    return false;
+}
+
+// поток шарда: сделки клиентов шлюза - в очередь потока шлюза, остальные не трогаем
+void Gateway::onTrades(std::span<const Trade> trades) {
+    for (const Trade& tr : trades) {
+        if (!isClient(tr.buyerId) && !isClient(tr.sellerId)) continue;
+        while (!fills.tryPush(tr)) {
+            if (!running.load(std::memory_order_relaxed)) return;
+            std::this_thread::yield();
+        }
+    }
+}
+
+void Gateway::loop() {
+    if (config.cpu >= 0) pinCurrentThread(config.cpu);
+    unsigned idle = 0;
+    while (running.load(std::memory_order_relaxed)) {
+        if (poll()) {
+            idle = 0;
+            continue;
+        }
+        if (++idle < config.spin) cpuRelax();
+        else               std::this_thread::yield();
+    }
+}
+
+bool Gateway::poll() {
+    bool work = false;
+    for (std::uint32_t i = 0; i < slotCount; ++i) work |= pollSlot(i);
+
+    // сначала запросы, потом сделки: маршрут заявки уже записан, когда приходит её сделка
+    const std::int64_t now = gatewayNow();
+    const std::size_t n = fills.drain([&](const Trade& tr) {
+        routeFill(tr, tr.buyOrderId, OrderSide::Buy, now);
+        routeFill(tr, tr.sellOrderId, OrderSide::Sell, now);
+    }, kBatch);
+
+    const int t = exchange.tick();
+    while (!retired.empty() && retired.front().first + config.retireTicks <= t) {
+        routes.erase(retired.front().second);
+        retired.pop_front();
+    }
+    return work || n > 0;
+}
+
+bool Gateway::pollSlot(std::uint32_t index) {
+    GatewaySlot& s = slots[index];
+    Client& c = clients[index];
+    const GatewaySlotState state = s.state.load(std::memory_order_acquire);
+
+    if (state == GatewaySlotState::Closing) {
+        brokers[index].store(-1, std::memory_order_release);
+        c.active = false;
+        c.backlog.clear();
+        s.requests.reset();
+        s.responses.reset();
+        s.brokerId = 0;
+        s.pid = 0;
+        s.state.store(GatewaySlotState::Free, std::memory_order_release);
+        return true;
+    }
+    if (state != GatewaySlotState::Active) return false;
+
+    if (!c.active) {
+        c.active = true;
+        ++c.generation;
+        brokers[index].store(s.brokerId, std::memory_order_release);
+        connectCount.fetch_add(1, std::memory_order_relaxed);
+    }
+    while (!c.backlog.empty() && s.responses.tryPush(c.backlog.front())) c.backlog.pop_front();
+    // пока клиент не разбирает ответы, его запросы не читаем - давление доходит до него
+    if (!c.backlog.empty() || s.requests.empty()) return false;
+
+    const std::int64_t now = gatewayNow();
+    const std::size_t max = std::min(kBatch, s.responses.freeSpace());
+    return s.requests.drain([&](const GatewayRequest& r) { handle(index, r, now); }, max) > 0;
+}
+
+void Gateway::handle(std::uint32_t index, const GatewayRequest& r, std::int64_t now) {
+    requestCount.fetch_add(1, std::memory_order_relaxed);
+    GatewayResponse rsp{.clientOrderId = r.clientOrderId, .orderId = r.orderId, .price = r.price,
+                        .sentAt = r.sentAt, .handledAt = now, .quantity = r.quantity,
+                        .symbol = r.symbol, .side = r.side};
+    const auto reject = [&](GatewayReject reason) {
+        rsp.kind = GatewayResponseKind::Reject;
+        rsp.reason = reason;
+        rejectCount.fetch_add(1, std::memory_order_relaxed);
+        reply(index, rsp);
+    };
+
+    switch (r.kind) {
+        case GatewayRequestKind::New: {
+            if (!validNew(r)) return reject(GatewayReject::Malformed);
+            const int brokerId = brokers[index].load(std::memory_order_relaxed);
+            const std::size_t id = exchange.submitOrder({brokerId, r.type, r.side, 0, r.quantity, r.price,
+                                                         exchange.tick(), r.symbol});
+            if (!id) return reject(GatewayReject::Exchange);
+            routes.insert(id, {r.clientOrderId, r.sentAt, index, clients[index].generation, r.quantity});
+            rsp.kind = GatewayResponseKind::Ack;
+            rsp.orderId = id;
+            break;
+        }
+        case GatewayRequestKind::Cancel:
+        case GatewayRequestKind::Replace: {
+            // снимать и менять можно только свои заявки
+            const Route* route = routes.find(r.orderId);
+            if (!route || route->slot != index || route->generation != clients[index].generation)
+                return reject(GatewayReject::UnknownOrder);
+            const bool cancel = r.kind == GatewayRequestKind::Cancel || r.quantity <= 0;
+            const bool queued = r.kind == GatewayRequestKind::Cancel
+                ? exchange.cancelOrder(r.orderId, r.symbol)
+                : exchange.replaceOrder(r.orderId, r.quantity, r.price, r.symbol);
+            if (!queued) return reject(GatewayReject::Exchange);
+            // сделки, сведённые до снятия, ещё могут быть в пути: маршрут живёт retireTicks
+            if (cancel) retired.emplace_back(exchange.tick(), r.orderId);
+            else        routes.find(r.orderId)->remaining = r.quantity;
+            rsp.kind = r.kind == GatewayRequestKind::Cancel ? GatewayResponseKind::CancelAck
+                                                            : GatewayResponseKind::ReplaceAck;
+            break;
+        }
+        default:
+            return reject(GatewayReject::Malformed);
+    }
+    ackCount.fetch_add(1, std::memory_order_relaxed);
+    reply(index, rsp);
+}
+
+void Gateway::routeFill(const Trade& tr, std::size_t orderId, OrderSide side, std::int64_t now) {
+    Route* route = routes.find(orderId);
+    if (!route) return;
+    const Client& c = clients[route->slot];
+    if (!c.active || c.generation != route->generation) {
+        routes.erase(orderId);
+        return;
+    }
+    route->remaining -= tr.quantity;
+    const GatewayResponse rsp{.clientOrderId = route->clientOrderId, .orderId = orderId, .price = tr.price,
+                              .sentAt = route->sentAt, .handledAt = now, .quantity = tr.quantity,
+                              .remaining = route->remaining, .executedAt = tr.executedAt,
+                              .symbol = tr.symbol, .kind = GatewayResponseKind::Fill, .side = side};
+    const std::uint32_t slot = route->slot;
+    if (route->remaining <= 0) routes.erase(orderId);
+    fillCount.fetch_add(1, std::memory_order_relaxed);
+    reply(slot, rsp);
+}
+
+void Gateway::reply(std::uint32_t index, const GatewayResponse& response) {
+    Client& c = clients[index];
+    if (c.backlog.empty() && slots[index].responses.tryPush(response)) return;
+    c.backlog.push_back(response);
+    backlogCount.fetch_add(1, std::memory_order_relaxed);
+}
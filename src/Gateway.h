@@ -0,0 +1,110 @@
+#ifndef GATEWAY_H
+#define GATEWAY_H
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <span>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Exchange.h"
+#include "FlatIndex.h"
+#include "GatewayProtocol.h"
+#include "MpscRing.h"
+
+struct GatewayConfig {
+    std::string name = "/stock_gateway";    // имя сегмента для shm_open
+    std::size_t clients = 8;                // слотов, не больше kGatewayMaxClients
+    int cpu = -1;                           // ядро потока шлюза, -1 - не закреплять
+    unsigned spin = 64;                     // пустых обходов с pause перед yield; на своём ядре - больше
+    int retireTicks = 50;                   // сколько тиков после Cancel ждать сделок по заявке
+    std::size_t fillCapacity = 1 << 16;     // сделок клиентов между шардами и потоком шлюза
+};
+
+struct GatewayStats {
+    std::size_t requests{};
+    std::size_t acks{};
+    std::size_t rejects{};
+    std::size_t fills{};
+    std::size_t connects{};
+    std::size_t backlogged{};   // ответов, не поместившихся в кольцо клиента сразу
+};
+
+// Сервер шлюза: один поток опрашивает кольца запросов всех слотов и вызывает
+// submitOrder/cancelOrder/replaceOrder от имени брокера слота (brokerId из сообщений
+// не берётся). Сделки по заявкам клиентов шарды отдают через Exchange::setTradeSink
+// в MpscRing, а поток шлюза раскладывает их в кольца ответов - у каждого кольца
+// по-прежнему один писатель.
+class Gateway final {
+    static constexpr std::size_t kBatch = 256;
+
+    // заявка клиента, по которой ещё ждём сделок
+    struct Route {
+        std::uint64_t clientOrderId{};
+        std::int64_t sentAt{};
+        std::uint32_t slot{};
+        std::uint32_t generation{};     // подключение слота; чужие сделки после переподключения не уходят
+        std::int32_t remaining{};
+    };
+
+    struct Client {
+        std::uint32_t generation = 0;
+        bool active = false;
+        std::deque<GatewayResponse> backlog;    // кольцо ответов было полно
+    };
+
+    Exchange& exchange;
+    GatewayConfig config;
+
+    std::size_t slotCount;
+    void* base = nullptr;
+    std::size_t size = 0;
+    GatewaySlot* slots = nullptr;
+
+    // брокеры подключённых слотов, -1 - слот пуст; читают потоки шардов в sink
+    std::array<std::atomic<int>, kGatewayMaxClients> brokers;
+    MpscRing<Trade> fills;
+
+    // дальше - только поток шлюза
+    std::vector<Client> clients;
+    FlatIndex<Route> routes;
+    std::deque<std::pair<int, std::size_t>> retired;   // (тик Cancel, id заявки)
+
+    std::atomic<bool> running{false};
+    std::thread worker;
+
+    std::atomic<std::size_t> requestCount{0};
+    std::atomic<std::size_t> ackCount{0};
+    std::atomic<std::size_t> rejectCount{0};
+    std::atomic<std::size_t> fillCount{0};
+    std::atomic<std::size_t> connectCount{0};
+    std::atomic<std::size_t> backlogCount{0};
+
+    [[nodiscard]] bool isClient(int brokerId) const;
+    void onTrades(std::span<const Trade> trades);
+    void loop();
+    // один обход слотов и очереди сделок; false - работы не было
+    bool poll();
+    bool pollSlot(std::uint32_t index);
+    void handle(std::uint32_t index, const GatewayRequest& request, std::int64_t now);
+    void routeFill(const Trade& tr, std::size_t orderId, OrderSide side, std::int64_t now);
+    void reply(std::uint32_t index, const GatewayResponse& response);
+
+public:
+    // до Exchange::runLoop (ставит sink сделок); шлюз должен жить дольше runLoop
+    explicit Gateway(Exchange& exchange, const GatewayConfig& config = {});
+    ~Gateway();
+    Gateway(const Gateway&) = delete;
+    Gateway& operator=(const Gateway&) = delete;
+
+    // создаёт сегмент (старый с тем же именем заменяется) и поток шлюза; false - shm недоступна
+    bool start();
+    // останавливает поток и удаляет сегмент; подключённые клиенты видят serverPid == 0
+    void stop();
+    [[nodiscard]] GatewayStats stats() const;
+};
+
+#endif // GATEWAY_H
@@ -0,0 +1,95 @@
+#include "GatewayClient.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+GatewayClient::~GatewayClient() {
+    close();
+}
+
+bool GatewayClient::connect(const std::string& name, int brokerId) {
+    close();
+    const int fd = shm_open(name.c_str(), O_RDWR, 0);
+    if (fd < 0) return false;
+    struct stat st{};
+    if (fstat(fd, &st) != 0 || static_cast<std::size_t>(st.st_size) < sizeof(GatewayHeader)) {
+        ::close(fd);
+        return false;
+    }
+    size = static_cast<std::size_t>(st.st_size);
+    void* p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, 0);
+    ::close(fd);
+    if (p == MAP_FAILED) {
+        size = 0;
+        return false;
+    }
+    base = p;
+
+    const auto* h = static_cast<const GatewayHeader*>(base);
+    const bool valid = std::memcmp(h->magic, kGatewayMagic.data(), std::min(kGatewayMagic.size(), sizeof(h->magic))) == 0
+        && h->version == kGatewayVersion && h->segmentSize == size
+        && h->ringCapacity == kGatewayRingCapacity && h->messageSize == sizeof(GatewayRequest)
+        && gatewaySegmentSize(h->clients) == size
+        && h->serverPid.load(std::memory_order_acquire) != 0;
+    if (valid) {
+        GatewaySlot* slots = gatewaySlots(base);
+        for (std::uint32_t i = 0; i < h->clients && !slot; ++i) {
+            auto expected = GatewaySlotState::Free;
+            if (!slots[i].state.compare_exchange_strong(expected, GatewaySlotState::Claimed,
+                                                        std::memory_order_acq_rel))
+                continue;
+            slots[i].brokerId = brokerId;
+            slots[i].pid = static_cast<std::uint32_t>(getpid());
+            slots[i].state.store(GatewaySlotState::Active, std::memory_order_release);
+            slot = &slots[i];
+        }
+    }
+    if (!slot) {
+        munmap(base, size);
+        base = nullptr;
+        size = 0;
+        return false;
+    }
+    return true;
+}
+
+void GatewayClient::close() {
+    if (slot) slot->state.store(GatewaySlotState::Closing, std::memory_order_release);
+    if (base) munmap(base, size);
+    slot = nullptr;
+    base = nullptr;
+    size = 0;
+}
+
+bool GatewayClient::serverAlive() const {
+    return base && static_cast<const GatewayHeader*>(base)->serverPid.load(std::memory_order_acquire) != 0;
+}
+
+bool GatewayClient::send(const GatewayRequest& request) {
+    return slot && slot->requests.tryPush(request);
+}
+
+bool GatewayClient::sendNew(std::uint64_t clientOrderId, OrderSide side, OrderType type, int quantity, double price,
+                            Symbol symbol) {
+    return send({.clientOrderId = clientOrderId, .price = price, .sentAt = gatewayNow(), .quantity = quantity,
+                 .symbol = symbol, .kind = GatewayRequestKind::New, .side = side, .type = type});
+}
+
+bool GatewayClient::sendCancel(std::uint64_t clientOrderId, std::uint64_t orderId, Symbol symbol) {
+    return send({.clientOrderId = clientOrderId, .orderId = orderId, .sentAt = gatewayNow(), .symbol = symbol,
+                 .kind = GatewayRequestKind::Cancel});
+}
+
+bool GatewayClient::sendReplace(std::uint64_t clientOrderId, std::uint64_t orderId, int quantity, double price,
+                                Symbol symbol) {
+    return send({.clientOrderId = clientOrderId, .orderId = orderId, .price = price, .sentAt = gatewayNow(),
+                 .quantity = quantity, .symbol = symbol, .kind = GatewayRequestKind::Replace});
+}
+
+bool GatewayClient::poll(GatewayResponse& out) {
+    return slot && slot->responses.tryPop(out);
+}
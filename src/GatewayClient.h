@@ -0,0 +1,50 @@
+#ifndef GATEWAYCLIENT_H
+#define GATEWAYCLIENT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include "GatewayProtocol.h"
+
+// Клиент шлюза для стратегии в отдельном процессе: занимает слот в сегменте
+// Gateway и пишет запросы прямо в его кольцо. Без сокетов и системных вызовов
+// на пути заявки; ни одна операция не ждёт - при полном кольце send* вернёт false.
+// Объект используется из одного потока.
+class GatewayClient final {
+    void* base = nullptr;
+    std::size_t size = 0;
+    GatewaySlot* slot = nullptr;
+
+    bool send(const GatewayRequest& request);
+
+public:
+    GatewayClient() = default;
+    ~GatewayClient();
+    GatewayClient(const GatewayClient&) = delete;
+    GatewayClient& operator=(const GatewayClient&) = delete;
+
+    // false - нет сегмента, чужая версия, шлюз остановлен или все слоты заняты
+    bool connect(const std::string& name, int brokerId);
+    // освобождает слот; заявки на бирже остаются
+    void close();
+    [[nodiscard]] bool connected() const { return slot != nullptr; }
+    // шлюз жив (при остановке он обнуляет serverPid)
+    [[nodiscard]] bool serverAlive() const;
+
+    bool sendNew(std::uint64_t clientOrderId, OrderSide side, OrderType type, int quantity, double price,
+                 Symbol symbol = 0);
+    bool sendCancel(std::uint64_t clientOrderId, std::uint64_t orderId, Symbol symbol = 0);
+    bool sendReplace(std::uint64_t clientOrderId, std::uint64_t orderId, int quantity, double price,
+                     Symbol symbol = 0);
+
+    // false - ответов нет
+    bool poll(GatewayResponse& out);
+
+    // до max ответов за один сдвиг индекса кольца
+    template <class F>
+    std::size_t drain(F&& f, std::size_t max = kGatewayRingCapacity) {
+        return slot ? slot->responses.drain(std::forward<F>(f), max) : 0;
+    }
+};
+
+#endif // GATEWAYCLIENT_H
@@ -0,0 +1,101 @@
+#ifndef GATEWAYPROTOCOL_H
+#define GATEWAYPROTOCOL_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include "Order.h"
+#include "ShmRing.h"
+
+// Шлюз заявок через разделяемую память (см. Gateway, GatewayClient).
+// Сегмент POSIX shm: заголовок, затем слоты клиентов. У каждого слота два SPSC-кольца:
+// запросы клиент -> биржа и ответы биржа -> клиент. Сообщения - записи по 64 байта
+// без указателей; меняется раскладка любой из структур ниже - меняется kGatewayVersion.
+
+inline constexpr std::string_view kGatewayMagic = "STKGATE";
+inline constexpr std::uint32_t kGatewayVersion = 1;
+inline constexpr std::size_t kGatewayRingCapacity = 1 << 14;   // сообщений в каждом кольце слота
+inline constexpr std::size_t kGatewayMaxClients = 64;
+
+enum class GatewayRequestKind : std::uint8_t { New = 1, Cancel, Replace };
+
+// Reject: заявку не принял submitOrder (RiskGate или нет инструмента) либо запрос испорчен.
+// CancelAck/ReplaceAck - запрос поставлен в очередь шарда; если заявка уже исполнена,
+// он ничего не сделает (см. Exchange::cancelOrder).
+enum class GatewayResponseKind : std::uint8_t { Ack = 1, Reject, Fill, CancelAck, ReplaceAck };
+
+// UnknownOrder - Cancel/Replace по заявке, которую этот клиент не подавал или которая уже закрыта
+enum class GatewayReject : std::uint8_t { None, Exchange, Malformed, UnknownOrder };
+
+struct GatewayRequest {
+    std::uint64_t clientOrderId{};  // номер клиента, возвращается во всех ответах по заявке
+    std::uint64_t orderId{};        // Cancel/Replace: id биржи из Ack
+    double price{};
+    std::int64_t sentAt{};          // часы клиента (gatewayNow), возвращаются в ответе как есть
+    std::int32_t quantity{};
+    Symbol symbol{};
+    GatewayRequestKind kind{};
+    OrderSide side{};
+    OrderType type{};
+    std::uint8_t reserved[23]{};
+};
+static_assert(sizeof(GatewayRequest) == 64);
+
+struct GatewayResponse {
+    std::uint64_t clientOrderId{};
+    std::uint64_t orderId{};
+    double price{};                 // Fill - цена сделки
+    std::int64_t sentAt{};          // из запроса; у Fill - из New этой заявки
+    std::int64_t handledAt{};       // часы шлюза в момент ответа
+    std::int32_t quantity{};        // Fill - объём сделки
+    std::int32_t remaining{};       // Fill - остаток заявки
+    std::int32_t executedAt{};      // Fill - тик сделки
+    Symbol symbol{};
+    GatewayResponseKind kind{};
+    OrderSide side{};
+    GatewayReject reason{};
+    std::uint8_t reserved[7]{};
+};
+static_assert(sizeof(GatewayResponse) == 64);
+
+// Free -> Claimed (клиент занял слот CAS-ом) -> Active (brokerId записан) ->
+// Closing (клиент ушёл) -> Free (шлюз очистил кольца)
+enum class GatewaySlotState : std::uint32_t { Free, Claimed, Active, Closing };
+
+struct GatewaySlot {
+    alignas(64) std::atomic<GatewaySlotState> state{GatewaySlotState::Free};
+    std::int32_t brokerId{};
+    std::uint32_t pid{};
+    ShmRing<GatewayRequest, kGatewayRingCapacity> requests;
+    ShmRing<GatewayResponse, kGatewayRingCapacity> responses;
+};
+
+struct GatewayHeader {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t clients;
+    std::uint64_t segmentSize;
+    std::uint32_t ringCapacity;
+    std::uint32_t messageSize;
+    std::atomic<std::uint32_t> serverPid;   // 0 - шлюз остановлен
+    std::uint8_t reserved[28];
+};
+static_assert(sizeof(GatewayHeader) == 64);
+
+[[nodiscard]] constexpr std::size_t gatewaySegmentSize(std::size_t clients) {
+    return sizeof(GatewayHeader) + clients * sizeof(GatewaySlot);
+}
+
+[[nodiscard]] inline GatewaySlot* gatewaySlots(void* base) {
+    return reinterpret_cast<GatewaySlot*>(static_cast<std::byte*>(base) + sizeof(GatewayHeader));
+}
+
+// общие часы процессов хоста: steady_clock - это CLOCK_MONOTONIC, нс
+[[nodiscard]] inline std::int64_t gatewayNow() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+#endif // GATEWAYPROTOCOL_H
@@ -0,0 +1,120 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <thread>
+#include "MappedFile.h"
+#include "SpscRing.h"
+
+// Асинхронный журнал записей фиксированного размера.
+// Поток матчинга только кладёт запись в SPSC-кольцо (push никогда не ждёт:
+// при переполнении запись отбрасывается и учитывается в droppedCount,
+// как и запись, которую не удалось дописать в файл).
+// Фоновый поток пишет кольцо в MappedFile, периодически делает sync
+// и, если задан sink, отдаёт ему записи (например, печать в консоль).
+template <class Record>
+class Journal final {
+public:
+    using Sink = std::function<void(const Record&)>;
+
+    explicit Journal(std::size_t capacity = 1 << 16,
+                     std::chrono::milliseconds syncEvery = std::chrono::milliseconds(100))
+        : ring(capacity), syncInterval(syncEvery) {}
+
+    ~Journal() { stop(); }
+
+    Journal(const Journal&) = delete;
+    Journal& operator=(const Journal&) = delete;
+
+    bool open(const std::string& path, std::string_view magic, std::uint32_t version,
+              std::span<const std::byte> meta = {}) {
+        return file.open(path, magic, version, sizeof(Record), meta);
+    }
+
+    // вызывается из фонового потока
+    void setSink(Sink s) { sink = std::move(s); }
+
+    [[nodiscard]] bool isOpen() const { return file.isOpen(); }
+
+    void start() {
+        if (active.exchange(true)) return;
+        writer = std::thread([this] { run(); });
+    }
+
+    // дописывает всё, что осталось в кольце, и фиксирует файл
+    void stop() {
+        if (!active.exchange(false)) return;
+        writer.join();
+    }
+
+    // false - файл не удалось сбросить или закрыть
+    bool close() {
+        stop();
+        return file.close();
+    }
+
+    bool push(const Record& r) {
+        if (ring.tryPush(r)) return true;
+        dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    // Без потерь: при полном кольце ждёт фоновый поток, а когда его нет (до start,
+    // после stop) - сам дописывает кольцо в файл. Один поток-производитель, как у push.
+    void pushWait(const Record& r) {
+        while (!ring.tryPush(r)) {
+            if (active.load(std::memory_order_acquire)) std::this_thread::yield();
+            else                                        drainRing();
+        }
+    }
+
+    [[nodiscard]] std::size_t droppedCount() const { return dropped.load(std::memory_order_relaxed); }
+    [[nodiscard]] std::size_t writtenCount() const { return written.load(std::memory_order_relaxed); }
+
+private:
+    // кольцо - в файл и sink; его разбирает один поток
+    std::size_t drainRing() {
+        std::size_t n = 0;
+        Record r;
+        while (ring.tryPop(r)) {
+            if (file.isOpen() && !file.append(&r)) dropped.fetch_add(1, std::memory_order_relaxed);
+            if (sink) sink(r);
+            ++n;
+        }
+        if (n) written.fetch_add(n, std::memory_order_relaxed);
+        return n;
+    }
+
+    void run() {
+        auto lastSync = std::chrono::steady_clock::now();
+        while (true) {
+            const bool stopping = !active.load(std::memory_order_acquire);
+            const std::size_t n = drainRing();
+
+            const auto now = std::chrono::steady_clock::now();
+            if (file.isOpen() && now - lastSync >= syncInterval) {
+                file.sync();
+                lastSync = now;
+            }
+            if (stopping) break;
+            if (n == 0) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        if (file.isOpen()) file.sync();
+    }
+
+    SpscRing<Record> ring;
+    MappedFile file;
+    Sink sink;
+    std::chrono::milliseconds syncInterval;
+    std::thread writer;
+    std::atomic<bool> active{false};
+    std::atomic<std::size_t> dropped{0};
+    std::atomic<std::size_t> written{0};
+};
+
+#endif // JOURNAL_H
@@ -0,0 +1,28 @@
+#include "JournalRecord.h"
+
+JournalRecord toJournalRecord(const Trade& tr) {
+    JournalRecord r;
+    r.kind = JournalKind::Trade;
+    r.executedAt = tr.executedAt;
+    r.buyerId = tr.buyerId;
+    r.sellerId = tr.sellerId;
+    r.quantity = tr.quantity;
+    r.symbol = tr.symbol;
+    r.price = tr.price;
+    return r;
+}
+
+void printRecord(std::ostream& os, const JournalRecord& r) {
+    switch (r.kind) {
+        case JournalKind::Trade:
+            os << "[t=" << r.executedAt << "] TRADE: ";
+            if (r.symbol) os << "symbol=" << r.symbol << " ";
+            os << "buyer=" << r.buyerId
+               << " seller=" << r.sellerId
+               << " qty=" << r.quantity
+               << " price=" << r.price
+               << "\n";
+            return;
+    }
+    os << "[t=" << r.executedAt << "] UNKNOWN kind=" << static_cast<std::uint32_t>(r.kind) << "\n";
+}
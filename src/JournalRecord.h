@@ -0,0 +1,32 @@
+#ifndef JOURNALRECORD_H
+#define JOURNALRECORD_H
+
+#include <cstdint>
+#include <ostream>
+#include <string_view>
+#include "Order.h"
+
+enum class JournalKind : std::uint32_t { Trade = 1 };
+
+// Запись журнала сделок, 32 байта.
+struct JournalRecord final {
+    JournalKind kind{JournalKind::Trade};
+    std::int32_t executedAt{};
+    std::int32_t buyerId{};
+    std::int32_t sellerId{};
+    std::int32_t quantity{};
+    std::uint16_t symbol{};
+    std::uint16_t reserved{};
+    double price{};
+};
+static_assert(sizeof(JournalRecord) == 32);
+
+inline constexpr std::string_view kJournalMagic = "STKJRNL";
+inline constexpr std::uint32_t kJournalVersion = 1;
+
+JournalRecord toJournalRecord(const Trade& tr);
+
+// тот же формат, что раньше печатал runLoop
+void printRecord(std::ostream& os, const JournalRecord& r);
+
+#endif // JOURNALRECORD_H
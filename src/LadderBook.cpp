@@ -0,0 +1,442 @@
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include "LadderBook.h"
+
+namespace {
+
+std::int64_t floorTo64(std::int64_t v) {
+	return v - (((v % 64) + 64) % 64);
+}
+
+std::size_t roundUpTo64(std::size_t v) {
+	return (v + 63) & ~std::size_t{63};
+}
+
+} // namespace
+
+// ===== Level =====
+void LadderBook::Level::push(Pool& pool, Handle h) {
+	Node& n = pool[h];
+	n.prev = tail;
+	n.next = kNull;
+	if (tail != kNull) pool[tail].next = h;
+	else               head = h;
+	tail = h;
+	quantity += n.order.quantity;
+}
+
+void LadderBook::Level::unlink(Pool& pool, Handle h) {
+	Node& n = pool[h];
+	if (n.prev != kNull) pool[n.prev].next = n.next;
+	else                 head = n.next;
+	if (n.next != kNull) pool[n.next].prev = n.prev;
+	else                 tail = n.prev;
+	n.prev = n.next = kNull;
+	quantity -= n.order.quantity;
+}
+
+// ===== Side =====
+bool LadderBook::Side::reserve(std::int64_t tick) {
+	if (levels.empty()) {
+		base = floorTo64(tick - static_cast<std::int64_t>(kInitialLevels / 2));
+		levels.resize(kInitialLevels);
+		bits.resize(kInitialLevels / 64);
+		return true;
+	}
+
+	const auto size = static_cast<std::int64_t>(levels.size());
+	if (tick >= base && tick < base + size) return true;
+
+	const std::int64_t lo = std::min(base, tick);
+	const std::int64_t hi = std::max(base + size, tick + 1);
+	const auto need = static_cast<std::size_t>(hi - lo);
+	if (need > kMaxLevels) return false;
+
+	const std::size_t newSize = std::min(std::max(levels.size() * 2, roundUpTo64(need)), kMaxLevels);
+	// base и размер кратны 64, так что сдвиг битовой карты - целыми словами
+	const std::int64_t newBase = tick < base ? base + size - static_cast<std::int64_t>(newSize) : base;
+	const auto offset = static_cast<std::size_t>(base - newBase);
+
+	std::vector<Level> newLevels(newSize);
+	std::copy(levels.begin(), levels.end(), newLevels.begin() + static_cast<std::ptrdiff_t>(offset));
+	std::vector<std::uint64_t> newBits(newSize / 64);
+	std::copy(bits.begin(), bits.end(), newBits.begin() + static_cast<std::ptrdiff_t>(offset / 64));
+
+	levels.swap(newLevels);
+	bits.swap(newBits);
+	base = newBase;
+	if (best >= 0) best += static_cast<std::ptrdiff_t>(offset);
+	return true;
+}
+
+void LadderBook::Side::markNonEmpty(std::int64_t tick) {
+	const auto idx = static_cast<std::ptrdiff_t>(tick - base);
+	bits[static_cast<std::size_t>(idx) >> 6] |= std::uint64_t{1} << (idx & 63);
+	if (best < 0 || (bid ? idx > best : idx < best))
+		best = idx;
+}
+
+void LadderBook::Side::markEmpty(std::int64_t tick) {
+	const auto idx = static_cast<std::ptrdiff_t>(tick - base);
+	bits[static_cast<std::size_t>(idx) >> 6] &= ~(std::uint64_t{1} << (idx & 63));
+	if (idx == best)
+		best = bid ? scanDown(idx) : scanUp(idx);
+}
+
+std::ptrdiff_t LadderBook::Side::scanDown(std::ptrdiff_t from) const {
+	auto w = static_cast<std::size_t>(from) >> 6;
+	const unsigned bit = static_cast<unsigned>(from & 63);
+	std::uint64_t word = bits[w] & (bit == 63 ? ~std::uint64_t{0} : (std::uint64_t{1} << (bit + 1)) - 1);
+	while (word == 0) {
+		if (w == 0) return -1;
+		word = bits[--w];
+	}
+	return static_cast<std::ptrdiff_t>(w * 64 + 63 - static_cast<std::size_t>(std::countl_zero(word)));
+}
+
+std::ptrdiff_t LadderBook::Side::scanUp(std::ptrdiff_t from) const {
+	auto w = static_cast<std::size_t>(from) >> 6;
+	std::uint64_t word = bits[w] & (~std::uint64_t{0} << (from & 63));
+	while (word == 0) {
+		if (++w == bits.size()) return -1;
+		word = bits[w];
+	}
+	return static_cast<std::ptrdiff_t>(w * 64 + static_cast<std::size_t>(std::countr_zero(word)));
+}
+
+std::ptrdiff_t LadderBook::Side::next(std::ptrdiff_t idx) const {
+	if (bid) return idx == 0 ? -1 : scanDown(idx - 1);
+	return idx + 1 == static_cast<std::ptrdiff_t>(levels.size()) ? -1 : scanUp(idx + 1);
+}
+
+// ===== LadderBook =====
+LadderBook::LadderBook(int ticksPerUnit, SelfTradePolicy selfTrade)
+	: ticksPerUnit(ticksPerUnit), selfTrade(selfTrade) {}
+
+LadderBook::Handle LadderBook::allocNode(const Order& order, std::int64_t tick) {
+	const Handle h = nodes.allocate();
+	Node& n = nodes[h];
+	n.order = order;
+	n.tick = tick;
+	index.insert(order.id, h);
+	return h;
+}
+
+void LadderBook::freeNode(Handle h) {
+	index.erase(nodes[h].order.id);
+	nodes.release(h);
+}
+
+void LadderBook::remove(Handle h) {
+	const Node& n = nodes[h];
+	const bool buy = n.order.side == OrderSide::Buy;
+	if (n.order.type == OrderType::Market) {
+		(buy ? marketBids : marketAsks).unlink(nodes, h);
+	} else {
+		Side& side = buy ? bids : asks;
+		Level& lv = side.at(n.tick);
+		lv.unlink(nodes, h);
+		if (lv.empty()) side.markEmpty(n.tick);
+	}
+	freeNode(h);
+}
+
+bool LadderBook::addOrder(const Order& order) {
+	std::lock_guard<BookMutex> lk(m);
+	return addLocked(order);
+}
+
+void LadderBook::addOrders(std::span<const Order> orders) {
+	std::lock_guard<BookMutex> lk(m);
+	index.reserve(orders.size() + nodes.live());
+	for (const Order& o : orders) addLocked(o);
+}
+
+bool LadderBook::addLocked(const Order& order) {
+	if (order.quantity <= 0) return false;
+
+	if (order.type == OrderType::Market) {
+		const Handle h = allocNode(order, 0);
+		nodes[h].order.price = order.side == OrderSide::Buy ? 1e100 : 0.0;
+		(order.side == OrderSide::Buy ? marketBids : marketAsks).push(nodes, h);
+		return true;
+	}
+
+	const std::int64_t tick = std::llround(order.price * ticksPerUnit);
+	Side& side = order.side == OrderSide::Buy ? bids : asks;
+	if (!side.reserve(tick)) {
+		++rejected;
+		return false;
+	}
+
+	const Handle h = allocNode(order, tick);
+	nodes[h].order.price = static_cast<double>(tick) / ticksPerUnit;
+
+	Level& lv = side.at(tick);
+	const bool wasEmpty = lv.empty();
+	lv.push(nodes, h);
+	if (wasEmpty) side.markNonEmpty(tick);
+	return true;
+}
+
+bool LadderBook::tryMatchOne(int currentTime, Trade& out) {
+	std::lock_guard<BookMutex> lk(m);
+	return matchLocked(currentTime, out);
+}
+
+std::size_t LadderBook::matchAll(int currentTime, std::span<Trade> out) {
+	std::lock_guard<BookMutex> lk(m);
+	std::size_t n = 0;
+	while (n < out.size() && matchLocked(currentTime, out[n])) ++n;
+	return n;
+}
+
+bool LadderBook::matchLocked(int currentTime, Trade& out) {
+	bool bidMarket, askMarket;
+	Handle hb, ha;
+	while (true) {
+		bidMarket = !marketBids.empty();
+		askMarket = !marketAsks.empty();
+		if ((!bidMarket && bids.empty()) || (!askMarket && asks.empty())) return false;
+
+		if (!bidMarket && !askMarket && bids.bestTick() < asks.bestTick()) return false;
+
+		hb = (bidMarket ? marketBids : bids.bestLevel()).head;
+		ha = (askMarket ? marketAsks : asks.bestLevel()).head;
+		if (nodes[hb].order.brokerId != nodes[ha].order.brokerId) break;
+
+		// self-trade: снимаем одну из заявок по политике и смотрим дальше
+		++selfTradeCancelled;
+		telemetry::count(StatCounter::SelfTrades);
+		const bool bidIsOlder = nodes[hb].order.id < nodes[ha].order.id;
+		const Handle victim = bidIsOlder == (selfTrade == SelfTradePolicy::CancelOldest) ? hb : ha;
+		if (cancelLog) cancelLog->push_back(nodes[victim].order.id);
+		remove(victim);
+	}
+
+	Level& bl = bidMarket ? marketBids : bids.bestLevel();
+	Level& al = askMarket ? marketAsks : asks.bestLevel();
+	Node& buy  = nodes[hb];
+	Node& sell = nodes[ha];
+
+	const int qty = std::min(buy.order.quantity, sell.order.quantity);
+	if (qty <= 0) return false;
+
+	out.buyerId = buy.order.brokerId;
+	out.sellerId = sell.order.brokerId;
+	out.price = sell.order.price;
+	out.quantity = qty;
+	out.executedAt = currentTime;
+	out.symbol = buy.order.symbol;
+	out.buyOrderId = buy.order.id;
+	out.sellOrderId = sell.order.id;
+
+	buy.order.quantity -= qty;
+	bl.quantity -= qty;
+	sell.order.quantity -= qty;
+	al.quantity -= qty;
+
+	if (buy.order.quantity == 0) remove(hb);
+	if (sell.order.quantity == 0) remove(ha);
+	return true;
+}
+
+std::size_t LadderBook::auction(int currentTime, const AuctionRule& rule, std::vector<Trade>& out) {
+	std::lock_guard<BookMutex> lk(m);
+	AuctionScratch& s = scratch;
+	s.bids.clear();
+	s.asks.clear();
+	// цены-кандидаты - пересекающиеся уровни; при рыночных заявках встречной стороны - все
+	for (std::ptrdiff_t idx = bids.first(); idx >= 0; idx = bids.next(idx)) {
+		const std::int64_t tick = bids.tickAt(idx);
+		if (marketAsks.empty() && (asks.empty() || tick < asks.bestTick())) break;
+		s.bids.push_back({static_cast<double>(tick) / ticksPerUnit, bids.levelAt(idx).quantity});
+	}
+	for (std::ptrdiff_t idx = asks.first(); idx >= 0; idx = asks.next(idx)) {
+		const std::int64_t tick = asks.tickAt(idx);
+		if (marketBids.empty() && (bids.empty() || tick > bids.bestTick())) break;
+		s.asks.push_back({static_cast<double>(tick) / ticksPerUnit, asks.levelAt(idx).quantity});
+	}
+	const AuctionClearing c = clearingPrice(s.bids, marketBids.quantity, s.asks, marketAsks.quantity, rule.reference);
+	if (c.volume == 0) return 0;
+
+	// объём аукциона по заявкам стороны: рыночные, затем уровни от лучшего
+	const auto allocate = [&](const Level& market, const Side& side, std::vector<AuctionFill>& fills) {
+		fills.clear();
+		long long remaining = c.volume;
+		// уровень, исполняемый целиком, пишется прямо в fills; в s.level - только частичный
+		const auto take = [&](const Level& lv) {
+			const bool whole = lv.quantity <= remaining;
+			std::vector<AuctionFill>& to = whole ? fills : s.level;
+			if (!whole) s.level.clear();
+			for (Handle h = lv.head; h != kNull; h = nodes[h].next)
+				to.push_back({nodes[h].order.id, nodes[h].order.brokerId, nodes[h].order.quantity});
+			if (whole) remaining -= lv.quantity;
+			else       takeLevel(s.level, lv.quantity, remaining, rule.allocation, fills);
+		};
+		take(market);
+		for (std::ptrdiff_t idx = side.first(); idx >= 0 && remaining > 0; idx = side.next(idx))
+			take(side.levelAt(idx));
+	};
+	allocate(marketBids, bids, s.buys);
+	allocate(marketAsks, asks, s.sells);
+
+	const Symbol symbol = nodes[*index.find(s.buys.front().id)].order.symbol;
+	const std::size_t first = out.size();
+	const std::size_t n = pairFills(s.buys, s.sells, c.price, currentTime, symbol, out);
+	for (std::size_t k = first; k < out.size(); ++k) {
+		fillLocked(out[k].buyOrderId, out[k].quantity);
+		fillLocked(out[k].sellOrderId, out[k].quantity);
+	}
+	return n;
+}
+
+void LadderBook::fillLocked(std::size_t id, int qty) {
+	const Handle* hp = index.find(id);
+	if (!hp) return;
+	const Handle h = *hp;
+	Node& n = nodes[h];
+	const bool buy = n.order.side == OrderSide::Buy;
+	Level& lv = n.order.type == OrderType::Market ? (buy ? marketBids : marketAsks)
+	                                              : (buy ? bids : asks).at(n.tick);
+	n.order.quantity -= qty;
+	lv.quantity -= qty;
+	if (n.order.quantity <= 0) remove(h);
+}
+
+bool LadderBook::cancelOrder(std::size_t id) {
+	std::lock_guard<BookMutex> lk(m);
+	const Handle* h = index.find(id);
+	if (!h) return false;
+	remove(*h);
+	return true;
+}
+
+bool LadderBook::replaceOrder(std::size_t id, int newQty, double newPrice) {
+	std::lock_guard<BookMutex> lk(m);
+	const Handle* hp = index.find(id);
+	if (!hp) return false;
+	const Handle h = *hp;
+	if (newQty <= 0) {
+		remove(h);
+		return true;
+	}
+
+	Node& n = nodes[h];
+	const bool buy = n.order.side == OrderSide::Buy;
+	if (n.order.type == OrderType::Market) {
+		Level& lv = buy ? marketBids : marketAsks;
+		if (newQty <= n.order.quantity) {
+			lv.quantity -= n.order.quantity - newQty;
+			n.order.quantity = newQty;
+			return true;
+		}
+		lv.unlink(nodes, h);
+		n.order.quantity = newQty;
+		lv.push(nodes, h);
+		return true;
+	}
+
+	Side& side = buy ? bids : asks;
+	const std::int64_t tick = std::llround(newPrice * ticksPerUnit);
+	// уменьшение на месте: очередь уровня не меняется
+	if (tick == n.tick && newQty <= n.order.quantity) {
+		side.at(tick).quantity -= n.order.quantity - newQty;
+		n.order.quantity = newQty;
+		return true;
+	}
+	if (!side.reserve(tick)) {
+		++rejected;
+		return false;
+	}
+
+	Level& from = side.at(n.tick);
+	from.unlink(nodes, h);
+	if (from.empty()) side.markEmpty(n.tick);
+
+	n.tick = tick;
+	n.order.price = static_cast<double>(tick) / ticksPerUnit;
+	n.order.quantity = newQty;
+	Level& to = side.at(tick);
+	const bool wasEmpty = to.empty();
+	to.push(nodes, h);
+	if (wasEmpty) side.markNonEmpty(tick);
+	return true;
+}
+
+bool LadderBook::bestBidPrice(double& out) {
+	std::lock_guard<BookMutex> lk(m);
+	if (!marketBids.empty()) {
+		out = nodes[marketBids.head].order.price;
+		return true;
+	}
+	if (bids.empty()) return false;
+	out = static_cast<double>(bids.bestTick()) / ticksPerUnit;
+	return true;
+}
+
+bool LadderBook::bestAskPrice(double& out) {
+	std::lock_guard<BookMutex> lk(m);
+	if (!marketAsks.empty()) {
+		out = nodes[marketAsks.head].order.price;
+		return true;
+	}
+	if (asks.empty()) return false;
+	out = static_cast<double>(asks.bestTick()) / ticksPerUnit;
+	return true;
+}
+
+TopOfBook LadderBook::top() {
+	std::lock_guard<BookMutex> lk(m);
+	TopOfBook tb;
+	if (!marketBids.empty()) {
+		tb.hasBid = true;
+		tb.bid = nodes[marketBids.head].order.price;
+		tb.bidSize = marketBids.quantity;
+	} else if (!bids.empty()) {
+		tb.hasBid = true;
+		tb.bid = static_cast<double>(bids.bestTick()) / ticksPerUnit;
+		tb.bidSize = bids.bestLevel().quantity;
+	}
+	if (!marketAsks.empty()) {
+		tb.hasAsk = true;
+		tb.ask = nodes[marketAsks.head].order.price;
+		tb.askSize = marketAsks.quantity;
+	} else if (!asks.empty()) {
+		tb.hasAsk = true;
+		tb.ask = static_cast<double>(asks.bestTick()) / ticksPerUnit;
+		tb.askSize = asks.bestLevel().quantity;
+	}
+	return tb;
+}
+
+std::size_t LadderBook::depth(OrderSide side, std::span<BookLevel> out) {
+	std::lock_guard<BookMutex> lk(m);
+	const Side& s = side == OrderSide::Buy ? bids : asks;
+	std::size_t n = 0;
+	for (std::ptrdiff_t idx = s.first(); idx >= 0 && n < out.size(); idx = s.next(idx))
+		out[n++] = {static_cast<double>(s.tickAt(idx)) / ticksPerUnit, s.levelAt(idx).quantity};
+	return n;
+}
+
+std::size_t LadderBook::selfTradeCancels() {
+	std::lock_guard<BookMutex> lk(m);
+	return selfTradeCancelled;
+}
+
+void LadderBook::exportOrders(std::vector<Order>& out) {
+	std::lock_guard<BookMutex> lk(m);
+	const auto push = [&](const Level& level) {
+		for (Handle h = level.head; h != kNull; h = nodes[h].next) out.push_back(nodes[h].order);
+	};
+	push(marketBids);
+	for (std::ptrdiff_t idx = bids.first(); idx >= 0; idx = bids.next(idx)) push(bids.levelAt(idx));
+	push(marketAsks);
+	for (std::ptrdiff_t idx = asks.first(); idx >= 0; idx = asks.next(idx)) push(asks.levelAt(idx));
+}
+
+std::size_t LadderBook::rejectedCount() {
+	std::lock_guard<BookMutex> lk(m);
+	return rejected;
+}
@@ -0,0 +1,141 @@
+#ifndef LADDERBOOK_H
+#define LADDERBOOK_H
+
+#include <cstdint>
+#include <mutex>
+#include <vector>
+#include "Auction.h"
+#include "Book.h"
+#include "FlatIndex.h"
+#include "Order.h"
+#include "SlabPool.h"
+#include "Stats.h"
+
+// Стакан на непрерывном массиве ценовых уровней в целых тиках.
+// Каждый уровень - интрузивная FIFO-очередь заявок, непустые уровни
+// отмечены в битовой карте, лучший уровень хранится курсором, поэтому
+// лучшая цена читается за O(1). Узлы заявок живут в слэб-арене и
+// адресуются 32-битными хэндлами, id -> хэндл - плоская хэш-таблица.
+class LadderBook final : public Book {
+public:
+    // стартовые размеры малы: на бирже тысячи инструментов, окно и арена растут по мере надобности
+    static constexpr std::size_t kInitialLevels = 512;
+    static constexpr std::size_t kMaxLevels = std::size_t{1} << 20;
+
+    explicit LadderBook(int ticksPerUnit = 100, SelfTradePolicy selfTrade = SelfTradePolicy::CancelOldest);
+
+    bool addOrder(const Order& order) override;
+
+    void addOrders(std::span<const Order> orders) override;
+
+    bool tryMatchOne(int currentTime, Trade& out) override;
+
+    std::size_t matchAll(int currentTime, std::span<Trade> out) override;
+
+    std::size_t auction(int currentTime, const AuctionRule& rule, std::vector<Trade>& out) override;
+
+    bool cancelOrder(std::size_t id) override;
+
+    bool replaceOrder(std::size_t id, int newQty, double newPrice) override;
+
+    bool bestBidPrice(double& out) override;
+
+    bool bestAskPrice(double& out) override;
+
+    TopOfBook top() override;
+
+    std::size_t depth(OrderSide side, std::span<BookLevel> out) override;
+
+    std::size_t selfTradeCancels() override;
+
+    void exportOrders(std::vector<Order>& out) override;
+
+    // заявки, цена которых не помещается в окно kMaxLevels уровней
+    [[nodiscard]] std::size_t rejectedCount();
+
+private:
+    using Handle = std::uint32_t;
+
+    // ровно одна кэш-линия на заявку
+    struct alignas(64) Node {
+        Order order;
+        std::int64_t tick{};
+        Handle prev{};
+        Handle next{};
+    };
+    static_assert(sizeof(Node) == 64);
+
+    using Pool = SlabPool<Node, 256>;
+    static constexpr Handle kNull = Pool::kNull;
+
+    struct Level {
+        Handle head = kNull;
+        Handle tail = kNull;
+        std::int64_t quantity{};
+
+        [[nodiscard]] bool empty() const { return head == kNull; }
+        void push(Pool& pool, Handle h);
+        void unlink(Pool& pool, Handle h);
+    };
+
+    // Одна сторона стакана: окно уровней [base, base + levels.size()).
+    class Side {
+    public:
+        explicit Side(bool bid) : bid(bid) {}
+
+        bool reserve(std::int64_t tick);
+        Level& at(std::int64_t tick) { return levels[static_cast<std::size_t>(tick - base)]; }
+
+        void markNonEmpty(std::int64_t tick);
+        void markEmpty(std::int64_t tick);
+
+        [[nodiscard]] bool empty() const { return best < 0; }
+        [[nodiscard]] std::int64_t bestTick() const { return base + best; }
+        Level& bestLevel() { return levels[static_cast<std::size_t>(best)]; }
+
+        // обход непустых уровней от лучшего к худшему: first(), затем next(idx), -1 - конец
+        [[nodiscard]] std::ptrdiff_t first() const { return best; }
+        [[nodiscard]] std::ptrdiff_t next(std::ptrdiff_t idx) const;
+        [[nodiscard]] std::int64_t tickAt(std::ptrdiff_t idx) const { return base + idx; }
+        [[nodiscard]] const Level& levelAt(std::ptrdiff_t idx) const { return levels[static_cast<std::size_t>(idx)]; }
+
+    private:
+        std::ptrdiff_t scanDown(std::ptrdiff_t from) const;
+        std::ptrdiff_t scanUp(std::ptrdiff_t from) const;
+
+        bool bid;
+        std::int64_t base{};
+        std::vector<Level> levels;
+        std::vector<std::uint64_t> bits;
+        std::ptrdiff_t best = -1;
+    };
+
+    Handle allocNode(const Order& order, std::int64_t tick);
+    void freeNode(Handle h);
+    // снять заявку с её уровня и вернуть узел в пул
+    void remove(Handle h);
+
+    bool matchLocked(int currentTime, Trade& out);
+    bool addLocked(const Order& order);
+    // исполнить qty штук заявки id (аукцион)
+    void fillLocked(std::size_t id, int qty);
+
+    // рыночные заявки стоят впереди всех лимитных уровней своей стороны
+    Level marketBids;
+    Level marketAsks;
+    Side bids{true};
+    Side asks{false};
+
+    Pool nodes;
+    FlatIndex<Handle> index{64};
+
+    int ticksPerUnit;
+    SelfTradePolicy selfTrade;
+    std::size_t rejected = 0;
+    std::size_t selfTradeCancelled = 0;
+    AuctionScratch scratch;
+
+    BookMutex m;
+};
+
+#endif // LADDERBOOK_H
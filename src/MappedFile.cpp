@@ -0,0 +1,136 @@
+#include "MappedFile.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr std::size_t kGrowChunk = std::size_t{16} << 20;
+
+bool headerMatches(const MappedFileHeader& h, std::string_view magic, std::uint32_t version, std::uint32_t recordSize) {
+    return std::memcmp(h.magic, magic.data(), std::min(magic.size(), sizeof(h.magic))) == 0
+        && h.version == version && h.recordSize == recordSize;
+}
+
+} // namespace
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+bool MappedFile::remap(std::size_t bytes) {
+    if (base) munmap(base, mapped);
+    base = nullptr;
+    mapped = 0;
+    if (ftruncate(fd, static_cast<off_t>(bytes)) != 0) return false;
+    void* p = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (p == MAP_FAILED) return false;
+    base = static_cast<std::byte*>(p);
+    mapped = bytes;
+    return true;
+}
+
+bool MappedFile::open(const std::string& path, std::string_view magic, std::uint32_t version, std::uint32_t size,
+                      std::span<const std::byte> meta) {
+    close();
+    lost = 0;
+    std::uint8_t metaBytes[sizeof(MappedFileHeader::meta)]{};
+    if (meta.size() > sizeof(metaBytes)) return false;
+    std::memcpy(metaBytes, meta.data(), meta.size());
+    fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd < 0) return false;
+    recordSize = size;
+
+    struct stat st{};
+    fstat(fd, &st);
+    MappedFileHeader existing{};
+    const bool resume = static_cast<std::size_t>(st.st_size) >= sizeof(existing)
+        && pread(fd, &existing, sizeof(existing), 0) == static_cast<ssize_t>(sizeof(existing))
+        && headerMatches(existing, magic, version, size)
+        && std::memcmp(existing.meta, metaBytes, sizeof(metaBytes)) == 0;
+
+    count = resume ? existing.records : 0;
+    used = sizeof(MappedFileHeader) + count * recordSize;
+    if (!remap(std::max(used + kGrowChunk, static_cast<std::size_t>(st.st_size)))) {
+        close();
+        return false;
+    }
+
+    if (!resume) {
+        MappedFileHeader h{};
+        std::memcpy(h.magic, magic.data(), std::min(magic.size(), sizeof(h.magic)));
+        h.version = version;
+        h.recordSize = size;
+        std::memcpy(h.meta, metaBytes, sizeof(metaBytes));
+        std::memcpy(base, &h, sizeof(h));
+    }
+    return true;
+}
+
+bool MappedFile::append(const void* record) {
+    if (!base) return false;
+    if (used + recordSize > mapped && !remap(std::max(mapped * 2, used + kGrowChunk))) {
+        lost.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    std::memcpy(base + used, record, recordSize);
+    used += recordSize;
+    ++count;
+    return true;
+}
+
+bool MappedFile::sync() {
+    if (!base) return false;
+    reinterpret_cast<MappedFileHeader*>(base)->records = count;
+    return msync(base, used, MS_SYNC) == 0;
+}
+
+bool MappedFile::close() {
+    if (fd < 0) return true;
+    bool ok = sync();
+    if (base) ok = munmap(base, mapped) == 0 && ok;
+    // обрезаем запас, оставленный под рост; записи за счётчиком заголовка читатель и так не видит
+    ok = ftruncate(fd, static_cast<off_t>(used)) == 0 && ok;
+    ok = ::close(fd) == 0 && ok;
+    fd = -1;
+    base = nullptr;
+    mapped = used = 0;
+    count = 0;
+    return ok;
+}
+
+MappedFileReader::~MappedFileReader() {
+    if (base) munmap(const_cast<std::byte*>(base), size);
+}
+
+bool MappedFileReader::open(const std::string& path, std::string_view magic, std::uint32_t version, std::uint32_t recordSize) {
+    if (base) munmap(const_cast<std::byte*>(base), size);
+    base = nullptr;
+    size = 0;
+    count = 0;
+
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat st{};
+    fstat(fd, &st);
+    const auto bytes = static_cast<std::size_t>(st.st_size);
+    void* p = bytes >= sizeof(MappedFileHeader) ? mmap(nullptr, bytes, PROT_READ, MAP_SHARED, fd, 0) : MAP_FAILED;
+    ::close(fd);
+    if (p == MAP_FAILED) return false;
+
+    const auto* h = static_cast<const MappedFileHeader*>(p);
+    const std::size_t fit = (bytes - sizeof(MappedFileHeader)) / recordSize;
+    if (!headerMatches(*h, magic, version, recordSize) || h->records > fit) {
+        munmap(p, bytes);
+        return false;
+    }
+    base = static_cast<const std::byte*>(p);
+    size = bytes;
+    count = h->records;
+    return true;
+}
@@ -0,0 +1,84 @@
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+
+// Заголовок бинарных файлов движка (журнал сделок, запись потока заявок).
+struct MappedFileHeader {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t recordSize;
+    std::uint64_t records;      // сколько записей зафиксировано последним sync()
+    std::uint8_t meta[32];      // параметры формата, о которых знает только писатель (см. CaptureMeta)
+    std::uint8_t reserved[8];
+};
+static_assert(sizeof(MappedFileHeader) == 64);
+
+// Append-only файл записей фиксированного размера, отображённый в память.
+// Если файл уже существует с тем же заголовком, запись продолжается в его конец.
+class MappedFile final {
+    int fd = -1;
+    std::byte* base = nullptr;
+    std::size_t mapped = 0;
+    std::size_t used = 0;
+    std::uint32_t recordSize = 0;
+    std::uint64_t count = 0;
+    std::atomic<std::uint64_t> lost{0};
+
+    bool remap(std::size_t bytes);
+
+public:
+    MappedFile() = default;
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // meta (до 32 байт) пишется в заголовок; дописывать существующий файл можно только с тем же meta
+    bool open(const std::string& path, std::string_view magic, std::uint32_t version, std::uint32_t recordSize,
+              std::span<const std::byte> meta = {});
+    // false - файл не удалось расширить, запись учтена в lostRecords
+    bool append(const void* record);
+    // обновляет счётчик в заголовке и сбрасывает страницы на диск; false - ошибка msync
+    bool sync();
+    // false - не удалось сбросить, обрезать или закрыть файл
+    bool close();
+
+    [[nodiscard]] bool isOpen() const { return fd >= 0; }
+    [[nodiscard]] std::uint64_t records() const { return count; }
+    // записей, не попавших в файл с последнего open; читать можно из любого потока
+    [[nodiscard]] std::uint64_t lostRecords() const { return lost.load(std::memory_order_relaxed); }
+};
+
+// Чтение файла, записанного MappedFile, целиком через mmap.
+class MappedFileReader final {
+    const std::byte* base = nullptr;
+    std::size_t size = 0;
+    std::uint64_t count = 0;
+
+public:
+    MappedFileReader() = default;
+    ~MappedFileReader();
+    MappedFileReader(const MappedFileReader&) = delete;
+    MappedFileReader& operator=(const MappedFileReader&) = delete;
+
+    bool open(const std::string& path, std::string_view magic, std::uint32_t version, std::uint32_t recordSize);
+
+    // MappedFileHeader::meta открытого файла, иначе пусто
+    [[nodiscard]] std::span<const std::byte> meta() const {
+        if (!base) return {};
+        return {base + offsetof(MappedFileHeader, meta), sizeof(MappedFileHeader::meta)};
+    }
+
+    template <class Record>
+    [[nodiscard]] std::span<const Record> records() const {
+        if (!base) return {};
+        return {reinterpret_cast<const Record*>(base + sizeof(MappedFileHeader)), static_cast<std::size_t>(count)};
+    }
+};
+
+#endif // MAPPEDFILE_H
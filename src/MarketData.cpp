@@ -0,0 +1,102 @@
+#include "MarketData.h"
+
+#include <algorithm>
+
+DepthView::DepthView(const FeedRing& ring) : ring(ring), next(ring.lastPublished() + 1) {}
+
+DepthView::Levels& DepthView::at(Symbol symbol) {
+    if (symbol >= symbols.size()) symbols.resize(static_cast<std::size_t>(symbol) + 1);
+    return symbols[symbol];
+}
+
+void DepthView::resync() {
+    ++gapCount;
+    for (Levels& l : symbols) {
+        l.synced = false;
+        l.inSnapshot = false;
+        l.bids.clear();
+        l.asks.clear();
+    }
+    // догоняем с середины кольца, чтобы писатель не затёр нас снова сразу же
+    const std::uint64_t last = ring.lastPublished();
+    const std::uint64_t back = ring.capacity() / 2;
+    next = last > back ? last - back + 1 : 1;
+}
+
+std::size_t DepthView::poll(std::size_t max) {
+    std::size_t n = 0;
+    MdEvent e;
+    while (n < max) {
+        const auto r = ring.read(next, e);
+        if (r == FeedRing::Read::Empty) break;
+        if (r == FeedRing::Read::Gap) {
+            resync();
+            continue;
+        }
+        ++next;
+        ++n;
+        apply(e);
+    }
+    return n;
+}
+
+void DepthView::apply(const MdEvent& e) {
+    Levels& l = at(e.symbol);
+    auto& side = e.side == OrderSide::Buy ? l.bids : l.asks;
+    const auto better = [&e](const BookLevel& a, double price) {
+        return e.side == OrderSide::Buy ? a.price > price : a.price < price;
+    };
+
+    switch (e.kind) {
+        case MdKind::SnapshotBegin:
+            l.inSnapshot = true;
+            l.bids.clear();
+            l.asks.clear();
+            return;
+        case MdKind::SnapshotLevel:
+            if (l.inSnapshot) side.push_back({e.price, e.quantity});
+            return;
+        case MdKind::SnapshotEnd:
+            if (l.inSnapshot) l.synced = true;
+            l.inSnapshot = false;
+            return;
+        case MdKind::Trade:
+            l.lastTrade = e.price;
+            return;
+        default:
+            break;
+    }
+    if (!l.synced) return;
+
+    const auto it = std::lower_bound(side.begin(), side.end(), e.price, better);
+    const bool found = it != side.end() && it->price == e.price;
+    switch (e.kind) {
+        case MdKind::Add:
+            if (!found) side.insert(it, {e.price, e.quantity});
+            break;
+        case MdKind::Modify:
+            if (found) it->quantity = e.quantity;
+            break;
+        case MdKind::Delete:
+            if (found) side.erase(it);
+            break;
+        default:
+            break;
+    }
+}
+
+bool DepthView::synced(Symbol symbol) const {
+    return symbol < symbols.size() && symbols[symbol].synced;
+}
+
+std::size_t DepthView::depth(Symbol symbol, OrderSide side, std::span<BookLevel> out) const {
+    if (!synced(symbol)) return 0;
+    const auto& levels = side == OrderSide::Buy ? symbols[symbol].bids : symbols[symbol].asks;
+    const std::size_t n = std::min(out.size(), levels.size());
+    std::copy_n(levels.begin(), n, out.begin());
+    return n;
+}
+
+double DepthView::lastTradePrice(Symbol symbol) const {
+    return symbol < symbols.size() ? symbols[symbol].lastTrade : -1.0;
+}
@@ -0,0 +1,89 @@
+#ifndef MARKETDATA_H
+#define MARKETDATA_H
+
+#include <cstdint>
+#include <limits>
+#include <span>
+#include <vector>
+#include "Book.h"
+#include "BroadcastRing.h"
+#include "Order.h"
+
+// События L2-фида.
+// Add/Modify/Delete - уровень (side, price) появился в верхних N уровнях, сменил объём или ушёл из них;
+// Trade             - сделка по price, quantity;
+// SnapshotBegin, SnapshotLevel..., SnapshotEnd - полный срез верхних N уровней инструмента.
+enum class MdKind : std::uint8_t { Add = 1, Modify, Delete, Trade, SnapshotBegin, SnapshotLevel, SnapshotEnd };
+
+// 32 байта
+struct MdEvent final {
+    std::uint64_t seq{};        // номер в кольце шарда
+    double price{};
+    long long quantity{};       // объём уровня после изменения или объём сделки
+    Symbol symbol{};
+    MdKind kind{MdKind::Add};
+    OrderSide side{OrderSide::Buy};
+    std::int32_t tick{};
+};
+static_assert(sizeof(MdEvent) == 32);
+
+using FeedRing = BroadcastRing<MdEvent>;
+
+// Локальная копия верхних уровней стаканов у одного потребителя фида.
+// Подключается к кольцу шарда с текущего места; инструмент становится синхронным
+// после ближайшего снапшота. При разрыве последовательности (потребитель отстал
+// на целое кольцо) все инструменты снова ждут снапшота. Стакан биржи не трогается.
+class DepthView final {
+public:
+    explicit DepthView(const FeedRing& ring);
+
+    // Применить новые события (не больше max); возвращает число прочитанных.
+    std::size_t poll(std::size_t max = std::numeric_limits<std::size_t>::max());
+
+    [[nodiscard]] bool synced(Symbol symbol) const;
+    // до out.size() уровней, от лучшего; 0 - уровней нет или инструмент не синхронен
+    std::size_t depth(Symbol symbol, OrderSide side, std::span<BookLevel> out) const;
+    [[nodiscard]] double lastTradePrice(Symbol symbol) const;
+
+    [[nodiscard]] std::uint64_t gaps() const { return gapCount; }
+    [[nodiscard]] std::uint64_t nextSeq() const { return next; }
+
+private:
+    struct Levels {
+        bool synced = false;
+        bool inSnapshot = false;
+        std::vector<BookLevel> bids;    // по убыванию цены
+        std::vector<BookLevel> asks;    // по возрастанию
+        double lastTrade = -1.0;
+    };
+
+    Levels& at(Symbol symbol);
+    void apply(const MdEvent& e);
+    void resync();
+
+    const FeedRing& ring;
+    std::uint64_t next;
+    std::uint64_t gapCount = 0;
+    std::vector<Levels> symbols;
+};
+
+// Разница между прежними и новыми верхними уровнями одной стороны в виде событий Add/Modify/Delete.
+// Оба списка упорядочены от лучшего уровня к худшему.
+template <class Emit>
+void diffLevels(OrderSide side, std::span<const BookLevel> before, std::span<const BookLevel> after, Emit&& emit) {
+    const auto better = [side](double a, double b) { return side == OrderSide::Buy ? a > b : a < b; };
+    std::size_t i = 0, j = 0;
+    while (i < before.size() || j < after.size()) {
+        if (i < before.size() && j < after.size() && before[i].price == after[j].price) {
+            if (before[i].quantity != after[j].quantity) emit(MdKind::Modify, after[j]);
+            ++i;
+            ++j;
+        } else if (j < after.size() && (i == before.size() || better(after[j].price, before[i].price))) {
+            emit(MdKind::Add, after[j++]);
+        } else {
+            emit(MdKind::Delete, BookLevel{before[i++].price, 0});
+        }
+    }
+}
+
+#endif // MARKETDATA_H
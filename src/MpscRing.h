@@ -0,0 +1,91 @@
+#ifndef MPSCRING_H
+#define MPSCRING_H
+
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+// Ограниченная lock-free очередь: много писателей, один читатель.
+// Каждая ячейка хранит номер последовательности (схема Вьюкова), поэтому
+// писатели синхронизируются одним CAS по tail, а читатель не делает CAS вовсе.
+template <class T>
+class MpscRing final {
+    struct alignas(64) Cell {
+        std::atomic<std::size_t> seq;
+        T value;
+    };
+
+    std::unique_ptr<Cell[]> cells;
+    std::size_t mask;
+
+    alignas(64) std::atomic<std::size_t> tail{0};
+    alignas(64) std::size_t head = 0;
+
+public:
+    explicit MpscRing(std::size_t capacity)
+        : cells(std::make_unique<Cell[]>(std::bit_ceil(capacity < 2 ? std::size_t{2} : capacity))),
+          mask(std::bit_ceil(capacity < 2 ? std::size_t{2} : capacity) - 1) {
+        for (std::size_t i = 0; i <= mask; ++i)
+            cells[i].seq.store(i, std::memory_order_relaxed);
+    }
+
+    MpscRing(const MpscRing&) = delete;
+    MpscRing& operator=(const MpscRing&) = delete;
+
+    [[nodiscard]] std::size_t capacity() const { return mask + 1; }
+
+    // false - очередь заполнена
+    bool tryPush(const T& v) {
+        std::size_t pos = tail.load(std::memory_order_relaxed);
+        for (;;) {
+            Cell& c = cells[pos & mask];
+            const std::size_t seq = c.seq.load(std::memory_order_acquire);
+            const auto dif = static_cast<std::intptr_t>(seq) - static_cast<std::intptr_t>(pos);
+            if (dif == 0) {
+                if (tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    c.value = v;
+                    c.seq.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (dif < 0) {
+                return false;
+            } else {
+                pos = tail.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // только поток-читатель
+    bool tryPop(T& out) {
+        Cell& c = cells[head & mask];
+        const std::size_t seq = c.seq.load(std::memory_order_acquire);
+        if (static_cast<std::intptr_t>(seq) - static_cast<std::intptr_t>(head + 1) < 0)
+            return false;
+        out = c.value;
+        c.seq.store(head + mask + 1, std::memory_order_release);
+        ++head;
+        return true;
+    }
+
+    // только поток-читатель: забирает до max элементов, возвращает их число
+    template <class F>
+    std::size_t drain(F&& f, std::size_t max) {
+        std::size_t n = 0;
+        T v;
+        while (n < max && tryPop(v)) {
+            f(v);
+            ++n;
+        }
+        return n;
+    }
+
+    // только поток-читатель
+    [[nodiscard]] bool empty() const {
+        const std::size_t seq = cells[head & mask].seq.load(std::memory_order_acquire);
+        return static_cast<std::intptr_t>(seq) - static_cast<std::intptr_t>(head + 1) < 0;
+    }
+};
+
+#endif // MPSCRING_H
@@ -2,9 +2,13 @@
 #define ORDER_H
 
 #include <cstddef>
+#include <cstdint>
 
-enum class OrderType { Market, Limit };
-enum class OrderSide { Buy, Sell };
+enum class OrderType : std::uint8_t { Market, Limit };
+enum class OrderSide : std::uint8_t { Buy, Sell };
+
+// id инструмента; 0 - инструмент по умолчанию
+using Symbol = std::uint16_t;
 
 struct Trade final {
     int buyerId{};
@@ -12,16 +16,30 @@ struct Trade final {
     double price{};
     int quantity{};
     int executedAt{};
+    Symbol symbol{};
+    std::size_t buyOrderId{};   // какие заявки исполнились (для снятия резервов, см. RiskGate)
+    std::size_t sellOrderId{};
 };
 
+// Поля упорядочены по размеру, чтобы не было дыр выравнивания (32 байта, symbol занимает бывший хвост).
+// Конструктор сохраняет прежний порядок инициализации {brokerId, type, side, id, quantity, price, createdAt}.
 struct Order final {
-    int brokerId{};
-    OrderType type{OrderType::Limit};
-    OrderSide side{OrderSide::Buy};
     std::size_t id{};
-    int quantity{};
     double price{};
+    int brokerId{};
+    int quantity{};
     int createdAt{};
+    OrderType type{OrderType::Limit};
+    OrderSide side{OrderSide::Buy};
+    Symbol symbol{};
+
+    Order() = default;
+    Order(int brokerId, OrderType type, OrderSide side, std::size_t id, int quantity, double price, int createdAt,
+          Symbol symbol = 0)
+        : id(id), price(price), brokerId(brokerId), quantity(quantity), createdAt(createdAt), type(type), side(side),
+          symbol(symbol) {}
 };
 
+static_assert(sizeof(Order) == 32);
+
 #endif // ORDER_H
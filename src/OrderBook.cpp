@@ -1,30 +1,122 @@
 #include <mutex>
 #include "OrderBook.h"
 
-void OrderBook::addOrder(const Order& order) {
-	std::lock_guard<std::mutex> lk(m);
+namespace {
 
+template <class Map>
+void replaceIn(Map& side, FlatIndex<typename Map::iterator>& index, typename Map::iterator it,
+               int newQty, double newPrice) {
+	Order& o = it->second;
+	if (newQty <= 0) {
+		index.erase(o.id);
+		side.erase(it);
+		return;
+	}
+	// рыночная заявка хранится по предельной цене, её не трогаем
+	const double price = o.type == OrderType::Market ? it->first : newPrice;
+	if (price == it->first && newQty <= o.quantity) {
+		o.quantity = newQty;
+		return;
+	}
+	Order moved = o;
+	moved.price = price;
+	moved.quantity = newQty;
+	side.erase(it);
+	// multimap кладёт равные ключи в конец диапазона - в хвост очереди уровня
+	index.insert(moved.id, side.emplace(price, moved));
+}
+
+// исполнить qty штук заявки id (аукцион)
+template <class Map>
+void fillIn(Map& side, FlatIndex<typename Map::iterator>& index, std::size_t id, int qty) {
+	auto* pos = index.find(id);
+	if (!pos) return;
+	const auto it = *pos;
+	it->second.quantity -= qty;
+	if (it->second.quantity <= 0) {
+		index.erase(id);
+		side.erase(it);
+	}
+}
+
+// добавить заявку к последнему уровню out или открыть новый
+template <class It>
+void addLevel(It it, std::vector<BookLevel>& out) {
+	if (!out.empty() && out.back().price == it->first) out.back().quantity += it->second.quantity;
+	else                                               out.push_back({it->first, it->second.quantity});
+}
+
+// уровни стороны от begin, пока crosses(цена)
+template <class It, class Crosses>
+void collectCrossing(It it, It end, Crosses crosses, std::vector<BookLevel>& out) {
+	for (; it != end && crosses(it->first); ++it) addLevel(it, out);
+}
+
+// Доли заявок одного уровня (от it, пока same) с суммой quantity. Уровень, который
+// исполняется целиком, пишется прямо в fills; только последний частичный собирается
+// в level для распределения.
+template <class It, class Same>
+void takeOrders(It& it, It end, Same same, long long quantity, long long& remaining, AuctionAllocation allocation,
+                std::vector<AuctionFill>& level, std::vector<AuctionFill>& fills) {
+	if (quantity <= remaining) {
+		for (; it != end && same(it); ++it) fills.push_back({it->second.id, it->second.brokerId, it->second.quantity});
+		remaining -= quantity;
+		return;
+	}
+	level.clear();
+	for (; it != end && same(it); ++it) level.push_back({it->second.id, it->second.brokerId, it->second.quantity});
+	takeLevel(level, quantity, remaining, allocation, fills);
+}
+
+} // namespace
+
+OrderBook::OrderBook(SelfTradePolicy selfTrade) : selfTrade(selfTrade) {}
+
+bool OrderBook::addOrder(const Order& order) {
+	std::lock_guard<BookMutex> lk(m);
+	return addLocked(order, false);
+}
+
+void OrderBook::addOrders(std::span<const Order> orders) {
+	std::lock_guard<BookMutex> lk(m);
+	indexBid.reserve(bids.size() + orders.size());
+	indexAsk.reserve(asks.size() + orders.size());
+	for (const Order& o : orders) addLocked(o, true);
+}
+
+bool OrderBook::addLocked(const Order& order, bool append) {
 	Order o = order;
 	if (o.type == OrderType::Market) {
 		if (o.side == OrderSide::Buy)  o.price = 1e100;
 		else                           o.price = 0.0;
-		o.type = OrderType::Limit;
 	}
 
-	if (o.quantity <= 0) return;
+	if (o.quantity <= 0) return false;
 
+	// заявки из exportOrders идут от лучшей к худшей: вставка в конец за O(1)
 	if (o.side == OrderSide::Buy) {
-		auto it = bids.emplace(o.price, o);
-		indexBid[o.id] = it;
+		auto it = append ? bids.emplace_hint(bids.end(), o.price, o) : bids.emplace(o.price, o);
+		indexBid.insert(o.id, it);
 	} else {
-		auto it = asks.emplace(o.price, o);
-		indexAsk[o.id] = it;
+		auto it = append ? asks.emplace_hint(asks.end(), o.price, o) : asks.emplace(o.price, o);
+		indexAsk.insert(o.id, it);
 	}
+	return true;
 }
 
 bool OrderBook::tryMatchOne(int currentTime, Trade& out) {
-	std::lock_guard<std::mutex> lk(m);
+	std::lock_guard<BookMutex> lk(m);
+	return matchLocked(currentTime, out);
+}
+
+std::size_t OrderBook::matchAll(int currentTime, std::span<Trade> out) {
+	std::lock_guard<BookMutex> lk(m);
+	std::size_t n = 0;
+	while (n < out.size() && matchLocked(currentTime, out[n])) ++n;
+	return n;
+}
 
+bool OrderBook::matchLocked(int currentTime, Trade& out) {
 	if (bids.empty() || asks.empty()) return false;
 
 	auto itBid = bids.begin(); // max price
@@ -35,6 +127,28 @@ bool OrderBook::tryMatchOne(int currentTime, Trade& out) {
 
 	if (bidPrice < askPrice) return false;
 
+	// self-trade: снимаем одну из заявок по политике и смотрим дальше
+	while (itBid->second.brokerId == itAsk->second.brokerId) {
+		++selfTradeCancelled;
+		telemetry::count(StatCounter::SelfTrades);
+		const bool bidIsOlder = itBid->second.id < itAsk->second.id;
+		if (bidIsOlder == (selfTrade == SelfTradePolicy::CancelOldest)) {
+			if (cancelLog) cancelLog->push_back(itBid->second.id);
+			indexBid.erase(itBid->second.id);
+			bids.erase(itBid);
+		} else {
+			if (cancelLog) cancelLog->push_back(itAsk->second.id);
+			indexAsk.erase(itAsk->second.id);
+			asks.erase(itAsk);
+		}
+		if (bids.empty() || asks.empty()) return false;
+		itBid = bids.begin();
+		itAsk = asks.begin();
+		bidPrice = itBid->first;
+		askPrice = itAsk->first;
+		if (bidPrice < askPrice) return false;
+	}
+
 	Order& buy  = itBid->second;
 	Order& sell = itAsk->second;
 
@@ -46,6 +160,9 @@ bool OrderBook::tryMatchOne(int currentTime, Trade& out) {
 	out.price = askPrice;
 	out.quantity = qty;
 	out.executedAt = currentTime;
+	out.symbol = buy.symbol;
+	out.buyOrderId = buy.id;
+	out.sellOrderId = sell.id;
 
 	buy.quantity -= qty;
 	sell.quantity -= qty;
@@ -61,9 +178,120 @@ bool OrderBook::tryMatchOne(int currentTime, Trade& out) {
 	return true;
 }
 
+std::size_t OrderBook::auction(int currentTime, const AuctionRule& rule, std::vector<Trade>& out) {
+	std::lock_guard<BookMutex> lk(m);
+	AuctionScratch& s = scratch;
+	s.bids.clear();
+	s.asks.clear();
+
+	// рыночные хранятся по предельной цене и стоят первыми
+	long long marketBid = 0, marketAsk = 0;
+	auto bidLimit = bids.begin();
+	for (; bidLimit != bids.end() && bidLimit->second.type == OrderType::Market; ++bidLimit)
+		marketBid += bidLimit->second.quantity;
+	auto askLimit = asks.begin();
+	for (; askLimit != asks.end() && askLimit->second.type == OrderType::Market; ++askLimit)
+		marketAsk += askLimit->second.quantity;
+
+	// Встречный проход как при непрерывном исполнении даёт наибольший объём; цена с таким
+	// объёмом лежит между последними сведёнными ценами, и уровни глубже них не нужны.
+	// Лимитные уровни копятся по ходу этого же прохода, после него стороны дочитываются
+	// только до сведённых цен. Рыночные стоят по предельным ключам и пересекаются с чем угодно.
+	auto bi = bids.begin();
+	auto ai = asks.begin();
+	if (bi == bids.end() || ai == asks.end() || bi->first < ai->first) return 0;
+	bool bidLevels = bi == bidLimit, askLevels = ai == askLimit;
+	if (bidLevels) addLevel(bi, s.bids);
+	if (askLevels) addLevel(ai, s.asks);
+	int bidLeft = bi->second.quantity, askLeft = ai->second.quantity;
+	double lowBid = bi->first, highAsk = ai->first;
+	while (bi != bids.end() && ai != asks.end() && bi->first >= ai->first) {
+		lowBid = bi->first;
+		highAsk = ai->first;
+		const int q = std::min(bidLeft, askLeft);
+		bidLeft -= q;
+		askLeft -= q;
+		if (bidLeft == 0 && ++bi != bids.end()) {
+			bidLeft = bi->second.quantity;
+			bidLevels = bidLevels || bi == bidLimit;
+			if (bidLevels) addLevel(bi, s.bids);
+		}
+		if (askLeft == 0 && ++ai != asks.end()) {
+			askLeft = ai->second.quantity;
+			askLevels = askLevels || ai == askLimit;
+			if (askLevels) addLevel(ai, s.asks);
+		}
+	}
+	// последняя взятая заявка могла уже не пересекаться, тогда дальше пересечений нет
+	if (!s.bids.empty() && s.bids.back().price < highAsk)
+		s.bids.pop_back();
+	else if (bi != bids.end())
+		collectCrossing(bidLevels ? std::next(bi) : bidLimit, bids.end(), [&](double price) { return price >= highAsk; }, s.bids);
+	if (!s.asks.empty() && s.asks.back().price > lowBid)
+		s.asks.pop_back();
+	else if (ai != asks.end())
+		collectCrossing(askLevels ? std::next(ai) : askLimit, asks.end(), [&](double price) { return price <= lowBid; }, s.asks);
+	const AuctionClearing c = clearingPrice(s.bids, marketBid, s.asks, marketAsk, rule.reference);
+	if (c.volume == 0) return 0;
+
+	// объём аукциона по заявкам стороны: рыночные одним уровнем, затем лимитные уровни,
+	// суммы которых уже собраны выше
+	const auto allocate = [&](auto& side, auto limit, long long market,
+	                          const std::vector<BookLevel>& levels, std::vector<AuctionFill>& fills) {
+		fills.clear();
+		long long remaining = c.volume;
+		auto it = side.begin();
+		takeOrders(it, limit, [](auto) { return true; }, market, remaining, rule.allocation, s.level, fills);
+		for (std::size_t k = 0; k < levels.size() && remaining > 0; ++k) {
+			const double price = levels[k].price;
+			takeOrders(it, side.end(), [price](auto o) { return o->first == price; }, levels[k].quantity, remaining,
+			           rule.allocation, s.level, fills);
+		}
+	};
+	allocate(bids, bidLimit, marketBid, s.bids, s.buys);
+	allocate(asks, askLimit, marketAsk, s.asks, s.sells);
+
+	const Symbol symbol = (*indexBid.find(s.buys.front().id))->second.symbol;
+	const std::size_t first = out.size();
+	const std::size_t n = pairFills(s.buys, s.sells, c.price, currentTime, symbol, out);
+	for (std::size_t k = first; k < out.size(); ++k) {
+		fillIn(bids, indexBid, out[k].buyOrderId, out[k].quantity);
+		fillIn(asks, indexAsk, out[k].sellOrderId, out[k].quantity);
+	}
+	return n;
+}
+
+bool OrderBook::cancelOrder(std::size_t id) {
+	std::lock_guard<BookMutex> lk(m);
+	if (auto* it = indexBid.find(id)) {
+		bids.erase(*it);
+		indexBid.erase(id);
+		return true;
+	}
+	if (auto* it = indexAsk.find(id)) {
+		asks.erase(*it);
+		indexAsk.erase(id);
+		return true;
+	}
+	return false;
+}
+
+bool OrderBook::replaceOrder(std::size_t id, int newQty, double newPrice) {
+	std::lock_guard<BookMutex> lk(m);
+	if (auto* it = indexBid.find(id)) {
+		replaceIn(bids, indexBid, *it, newQty, newPrice);
+		return true;
+	}
+	if (auto* it = indexAsk.find(id)) {
+		replaceIn(asks, indexAsk, *it, newQty, newPrice);
+		return true;
+	}
+	return false;
+}
+
 bool OrderBook::bestBidPrice(double& out) {
 	{
-		std::lock_guard<std::mutex> lk(m);
+		std::lock_guard<BookMutex> lk(m);
 		if (bids.empty()) return false;
 		out = bids.begin()->first;
 		return true;
@@ -72,9 +300,64 @@ bool OrderBook::bestBidPrice(double& out) {
 
 bool OrderBook::bestAskPrice(double& out) {
 	{
-		std::lock_guard<std::mutex> lk(m);
+		std::lock_guard<BookMutex> lk(m);
 		if (asks.empty()) return false;
 		out = asks.begin()->first;
 		return true;
 	}
-}
\ No newline at end of file
+}
+
+namespace {
+
+template <class Map>
+std::size_t collectLevels(const Map& side, std::span<BookLevel> out) {
+	std::size_t n = 0;
+	for (const auto& [price, o] : side) {
+		if (o.type == OrderType::Market) continue;
+		if (n > 0 && out[n - 1].price == price) {
+			out[n - 1].quantity += o.quantity;
+			continue;
+		}
+		if (n == out.size()) break;
+		out[n++] = {price, o.quantity};
+	}
+	return n;
+}
+
+} // namespace
+
+std::size_t OrderBook::depth(OrderSide side, std::span<BookLevel> out) {
+	std::lock_guard<BookMutex> lk(m);
+	return side == OrderSide::Buy ? collectLevels(bids, out) : collectLevels(asks, out);
+}
+
+std::size_t OrderBook::selfTradeCancels() {
+	std::lock_guard<BookMutex> lk(m);
+	return selfTradeCancelled;
+}
+
+void OrderBook::exportOrders(std::vector<Order>& out) {
+	std::lock_guard<BookMutex> lk(m);
+	out.reserve(out.size() + bids.size() + asks.size());
+	// рыночные хранятся по предельной цене и так уже стоят первыми
+	for (const auto& [price, o] : bids) out.push_back(o);
+	for (const auto& [price, o] : asks) out.push_back(o);
+}
+
+TopOfBook OrderBook::top() {
+	std::lock_guard<BookMutex> lk(m);
+	TopOfBook tb;
+	if (!bids.empty()) {
+		tb.hasBid = true;
+		tb.bid = bids.begin()->first;
+		auto [from, to] = bids.equal_range(tb.bid);
+		for (auto it = from; it != to; ++it) tb.bidSize += it->second.quantity;
+	}
+	if (!asks.empty()) {
+		tb.hasAsk = true;
+		tb.ask = asks.begin()->first;
+		auto [from, to] = asks.equal_range(tb.ask);
+		for (auto it = from; it != to; ++it) tb.askSize += it->second.quantity;
+	}
+	return tb;
+}
@@ -2,27 +2,61 @@
 #define ORDERBOOK_H
 
 #include <map>
-#include <unordered_map>
 #include <mutex>
+#include "Auction.h"
+#include "Book.h"
+#include "FlatIndex.h"
 #include "Order.h"
+#include "Stats.h"
 
-class OrderBook final {
-    std::unordered_map<size_t, std::multimap<double, Order>::iterator> indexBid;
-    std::unordered_map<size_t, std::multimap<double, Order>::iterator> indexAsk;
+class OrderBook final : public Book {
+    using BidMap = std::multimap<double, Order, std::greater<>>;
+    using AskMap = std::multimap<double, Order>;
 
-    std::multimap<double, Order, std::greater<>> bids;          // лучшая цена первая
-    std::multimap<double, Order> asks;                          // лучшая (минимальная) цена первая
+    BidMap bids;          // лучшая цена первая
+    AskMap asks;          // лучшая (минимальная) цена первая
 
-    std::mutex m;
+    FlatIndex<BidMap::iterator> indexBid;
+    FlatIndex<AskMap::iterator> indexAsk;
+
+    SelfTradePolicy selfTrade;
+    std::size_t selfTradeCancelled = 0;
+    AuctionScratch scratch;
+
+    BookMutex m;
+
+    bool matchLocked(int currentTime, Trade& out);
+    // append - заявка не лучше уже стоящих на своей стороне (вставка с подсказкой в конец)
+    bool addLocked(const Order& order, bool append);
 
 public:
-    void addOrder(const Order& order);
+    explicit OrderBook(SelfTradePolicy selfTrade = SelfTradePolicy::CancelOldest);
+
+    bool addOrder(const Order& order) override;
+
+    void addOrders(std::span<const Order> orders) override;
+
+    bool tryMatchOne(int currentTime, Trade& out) override;
+
+    std::size_t matchAll(int currentTime, std::span<Trade> out) override;
+
+    std::size_t auction(int currentTime, const AuctionRule& rule, std::vector<Trade>& out) override;
+
+    bool cancelOrder(std::size_t id) override;
+
+    bool replaceOrder(std::size_t id, int newQty, double newPrice) override;
+
+    bool bestBidPrice(double& out) override;
+
+    bool bestAskPrice(double& out) override;
+
+    TopOfBook top() override;
 
-    bool tryMatchOne(int currentTime, Trade& out);
+    std::size_t depth(OrderSide side, std::span<BookLevel> out) override;
 
-    bool bestBidPrice(double& out);
+    std::size_t selfTradeCancels() override;
 
-    bool bestAskPrice(double& out);
+    void exportOrders(std::vector<Order>& out) override;
 };
 
 #endif // ORDERBOOK_H
@@ -0,0 +1,84 @@
+#ifndef POPULATION_H
+#define POPULATION_H
+
+#include <cstdint>
+#include <vector>
+#include "CounterRng.h"
+#include "Exchange.h"
+#include "Strategy.h"
+
+struct PopulationConfig {
+    int firstId = 0;                // брокеры firstId .. firstId + size - 1
+    std::size_t size = 0;
+    double cash = 0.0;              // начальный баланс каждого
+    int inventory = 0;              // позиция по symbol
+    Symbol symbol = 0;
+    FairPriceKind fairKind = FairPriceKind::Vwap;
+    std::uint64_t seed = 0;         // ключи ГСЧ брокеров - brokerKey(seed, id)
+};
+
+// Много брокеров одной стратегии без объекта Broker на каждого: состояние лежит
+// столбцами, стратегия известна при компиляции. Шаг читает срез рынка один раз,
+// считает заявки всей популяции одним циклом Strategy::generate и отправляет их.
+// Как и Broker, у брокера не больше одной своей заявки в стакане.
+// step вызывается из одного потока.
+template <class Strategy>
+class BrokerPopulation final {
+public:
+    // открывает на бирже счета всех брокеров (см. Exchange::registerAccount)
+    BrokerPopulation(Exchange& ex, const PopulationConfig& config, Strategy strategy = {})
+        : exchange(ex), config(config), strategy(strategy),
+          keys(config.size), resting(config.size), side(config.size), price(config.size), quantity(config.size) {
+        for (std::size_t i = 0; i < config.size; ++i) {
+            keys[i] = brokerKey(config.seed, brokerId(i));
+            exchange.registerAccount(brokerId(i), config.cash, config.inventory, config.symbol);
+        }
+    }
+
+    // решения шага в столбцы (без отправки)
+    void generate(int currentTime) {
+        const QuoteSnapshot q = exchange.quote(config.symbol);
+        const MarketView m{q, q.fairPrice(config.fairKind), currentTime, steps++};
+        strategy.generate(m, keys, OrderColumns{side, price, quantity});
+    }
+
+    // отправить решения последнего generate; возвращает число принятых заявок
+    std::size_t submit(int currentTime) {
+        std::size_t accepted = 0;
+        for (std::size_t i = 0; i < keys.size(); ++i) {
+            if (!side[i]) continue;
+            if (resting[i]) exchange.cancelOrder(resting[i], config.symbol);
+            resting[i] = exchange.submitOrder({brokerId(i), OrderType::Limit,
+                                               side[i] > 0 ? OrderSide::Buy : OrderSide::Sell, 0,
+                                               quantity[i], price[i], currentTime, config.symbol});
+            accepted += resting[i] != 0;
+        }
+        return accepted;
+    }
+
+    std::size_t step(int currentTime) {
+        generate(currentTime);
+        return submit(currentTime);
+    }
+
+    [[nodiscard]] std::size_t size() const { return keys.size(); }
+    [[nodiscard]] int brokerId(std::size_t i) const { return config.firstId + static_cast<int>(i); }
+    // id заявки брокера в стакане (0 - нет)
+    [[nodiscard]] std::size_t restingOrder(std::size_t i) const { return resting[i]; }
+    [[nodiscard]] const Strategy& rules() const { return strategy; }
+    [[nodiscard]] OrderColumns lastOrders() { return {side, price, quantity}; }
+
+private:
+    Exchange& exchange;
+    PopulationConfig config;
+    Strategy strategy;
+    std::uint64_t steps = 0;
+
+    std::vector<std::uint64_t> keys;
+    std::vector<std::size_t> resting;
+    std::vector<std::int8_t> side;
+    std::vector<double> price;
+    std::vector<int> quantity;
+};
+
+#endif // POPULATION_H
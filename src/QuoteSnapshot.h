@@ -0,0 +1,26 @@
+#ifndef QUOTESNAPSHOT_H
+#define QUOTESNAPSHOT_H
+
+#include <array>
+#include <cstdint>
+#include "FairPrice.h"
+
+// Согласованный срез вершины стакана, публикуемый потоком матчинга.
+struct QuoteSnapshot final {
+    std::uint64_t sequence{};   // 0 - ещё ничего не опубликовано
+    bool hasBid{};
+    bool hasAsk{};
+    double bid{};
+    double ask{};
+    long long bidSize{};
+    long long askSize{};
+    double lastPrice{-1.0};
+    int lastQuantity{};
+    std::array<double, 3> fair{-1.0, -1.0, -1.0};   // по FairPriceKind
+
+    [[nodiscard]] double fairPrice(FairPriceKind kind) const {
+        return fair[static_cast<std::size_t>(kind)];
+    }
+};
+
+#endif // QUOTESNAPSHOT_H
@@ -0,0 +1,70 @@
+#include "Replay.h"
+
+#include <chrono>
+#include <cstring>
+#include <vector>
+
+namespace {
+
+std::uint64_t mix(std::uint64_t h, const void* data, std::size_t n) {
+    const auto* p = static_cast<const unsigned char*>(data);
+    for (std::size_t i = 0; i < n; ++i) {
+        h ^= p[i];
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+} // namespace
+
+std::uint64_t tradeChecksum(std::uint64_t h, const Trade& tr) {
+    std::uint64_t priceBits;
+    std::memcpy(&priceBits, &tr.price, sizeof(priceBits));
+    h = mix(h, &tr.buyerId, sizeof(tr.buyerId));
+    h = mix(h, &tr.sellerId, sizeof(tr.sellerId));
+    h = mix(h, &priceBits, sizeof(priceBits));
+    h = mix(h, &tr.quantity, sizeof(tr.quantity));
+    h = mix(h, &tr.executedAt, sizeof(tr.executedAt));
+    return h;
+}
+
+bool captureMeta(const MappedFileReader& reader, CaptureMeta& out) {
+    const std::span<const std::byte> meta = reader.meta();
+    if (meta.size() < sizeof(CaptureMeta)) return false;
+    std::memcpy(&out, meta.data(), sizeof(out));
+    return true;
+}
+
+ReplayResult replay(std::span<const CaptureRecord> records, Book& book) {
+    ReplayResult res;
+    res.checksum = kChecksumSeed;
+    std::vector<Trade> buf(256);
+
+    const auto start = std::chrono::steady_clock::now();
+    for (const CaptureRecord& r : records) {
+        switch (r.kind) {
+            case CaptureKind::Order:
+                book.addOrder(r.order());
+                ++res.orders;
+                break;
+            case CaptureKind::Cancel:
+                book.cancelOrder(static_cast<std::size_t>(r.id));
+                ++res.amendments;
+                break;
+            case CaptureKind::Replace:
+                book.replaceOrder(static_cast<std::size_t>(r.id), r.quantity, r.price);
+                ++res.amendments;
+                break;
+            case CaptureKind::Match:
+                for (std::size_t n = buf.size(); n == buf.size();) {
+                    n = book.matchAll(r.tick, buf);
+                    for (std::size_t i = 0; i < n; ++i)
+                        res.checksum = tradeChecksum(res.checksum, buf[i]);
+                    res.trades += n;
+                }
+                break;
+        }
+    }
+    res.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return res;
+}
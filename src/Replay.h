@@ -0,0 +1,29 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <cstdint>
+#include <span>
+#include "Book.h"
+#include "Capture.h"
+#include "MappedFile.h"
+
+struct ReplayResult {
+    std::size_t orders{};
+    std::size_t amendments{};   // снятия и изменения заявок
+    std::size_t trades{};
+    std::uint64_t checksum{};
+    double seconds{};
+};
+
+inline constexpr std::uint64_t kChecksumSeed = 1469598103934665603ull;   // FNV-1a
+
+// FNV-1a по полям сделки; цена берётся побитово, так что сверка точная
+std::uint64_t tradeChecksum(std::uint64_t h, const Trade& tr);
+
+// параметры стакана из заголовка открытой записи потока; false - запись не открыта
+bool captureMeta(const MappedFileReader& reader, CaptureMeta& out);
+
+// Прогоняет записанный поток через стакан без пауз и потоков.
+ReplayResult replay(std::span<const CaptureRecord> records, Book& book);
+
+#endif // REPLAY_H
@@ -0,0 +1,206 @@
+#include "RiskEngine.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <ostream>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define RISK_HAS_AVX2 1
+#endif
+
+namespace {
+
+// указатели на столбцы одного пересчёта, чтобы ядра не ходили через vector
+struct MarkColumns {
+    const double* cash;
+    const double* startCash;
+    const double* inventory;        // позиции инструмента s - с s * rows
+    const double* startInventory;
+    const double* marks;
+    std::size_t symbols;
+    std::size_t rows;
+    double* equity;
+    double* pnl;
+    double* exposure;
+};
+
+constexpr auto kScale = static_cast<double>(kCashScale);
+
+// деньги из Cash - делением, как fromCash, чтобы результат совпадал до бита.
+// Каждая позиция оценивается по марке своего инструмента.
+void scalarKernel(const MarkColumns& c, std::size_t from, std::size_t n, RiskSums& s) {
+    for (std::size_t i = from; i < n; ++i) {
+        double equity = c.cash[i] / kScale;
+        double start = c.startCash[i] / kScale;
+        double exposure = 0;
+        for (std::size_t k = 0; k < c.symbols; ++k) {
+            const double mark = c.marks[k];
+            const double inv = c.inventory[k * c.rows + i];
+            equity += inv * mark;
+            start += c.startInventory[k * c.rows + i] * mark;
+            exposure += std::fabs(inv) * mark;
+            s.netPosition += inv;
+            s.longPosition += std::max(inv, 0.0);
+            s.shortPosition += std::max(-inv, 0.0);
+        }
+        const double pnl = equity - start;
+        c.equity[i] = equity;
+        c.pnl[i] = pnl;
+        c.exposure[i] = exposure;
+        s.equity += equity;
+        s.pnl += pnl;
+        s.grossExposure += exposure;
+    }
+}
+
+#ifdef RISK_HAS_AVX2
+double hsum(__m256d v) __attribute__((target("avx2")));
+double hsum(__m256d v) {
+    alignas(32) double lanes[4];
+    _mm256_store_pd(lanes, v);
+    return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+}
+
+// по 4 счёта за шаг, хвост досчитывается скалярно. Модуль позиции - сбросом знакового бита,
+// длинная и короткая части - max(v, 0) и max(-v, 0). Без FMA: результат тот же, что у скалярного.
+void avx2Kernel(const MarkColumns& c, std::size_t n, RiskSums& s) __attribute__((target("avx2")));
+void avx2Kernel(const MarkColumns& c, std::size_t n, RiskSums& s) {
+    const __m256d scale = _mm256_set1_pd(kScale);
+    const __m256d sign = _mm256_set1_pd(-0.0);
+    const __m256d zero = _mm256_setzero_pd();
+    __m256d eqSum = zero, pnlSum = zero, grossSum = zero, netSum = zero, longSum = zero, shortSum = zero;
+
+    std::size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256d equity = _mm256_div_pd(_mm256_loadu_pd(c.cash + i), scale);
+        __m256d start = _mm256_div_pd(_mm256_loadu_pd(c.startCash + i), scale);
+        __m256d exposure = zero;
+        for (std::size_t k = 0; k < c.symbols; ++k) {
+            const __m256d m = _mm256_set1_pd(c.marks[k]);
+            const __m256d inv = _mm256_loadu_pd(c.inventory + k * c.rows + i);
+            equity = _mm256_add_pd(equity, _mm256_mul_pd(inv, m));
+            start = _mm256_add_pd(start, _mm256_mul_pd(_mm256_loadu_pd(c.startInventory + k * c.rows + i), m));
+            exposure = _mm256_add_pd(exposure, _mm256_mul_pd(_mm256_andnot_pd(sign, inv), m));
+            netSum = _mm256_add_pd(netSum, inv);
+            longSum = _mm256_add_pd(longSum, _mm256_max_pd(inv, zero));
+            shortSum = _mm256_add_pd(shortSum, _mm256_max_pd(_mm256_sub_pd(zero, inv), zero));
+        }
+        const __m256d pnl = _mm256_sub_pd(equity, start);
+        _mm256_storeu_pd(c.equity + i, equity);
+        _mm256_storeu_pd(c.pnl + i, pnl);
+        _mm256_storeu_pd(c.exposure + i, exposure);
+        eqSum = _mm256_add_pd(eqSum, equity);
+        pnlSum = _mm256_add_pd(pnlSum, pnl);
+        grossSum = _mm256_add_pd(grossSum, exposure);
+    }
+
+    scalarKernel(c, i, n, s);
+    s.equity += hsum(eqSum);
+    s.pnl += hsum(pnlSum);
+    s.grossExposure += hsum(grossSum);
+    s.netPosition += hsum(netSum);
+    s.longPosition += hsum(longSum);
+    s.shortPosition += hsum(shortSum);
+}
+#endif
+
+void add(RiskSums& to, const RiskSums& s) {
+    to.equity += s.equity;
+    to.pnl += s.pnl;
+    to.grossExposure += s.grossExposure;
+    to.netPosition += s.netPosition;
+    to.longPosition += s.longPosition;
+    to.shortPosition += s.shortPosition;
+}
+
+bool cpuHasAvx2() {
+#ifdef RISK_HAS_AVX2
+    static const bool has = __builtin_cpu_supports("avx2");
+    return has;
+#else
+    return false;
+#endif
+}
+
+} // namespace
+
+RiskKernel resolveRiskKernel(RiskKernel kernel) {
+    if (kernel == RiskKernel::Scalar) return RiskKernel::Scalar;
+    return cpuHasAvx2() ? RiskKernel::Avx2 : RiskKernel::Scalar;
+}
+
+RiskSums markAccounts(RiskKernel kernel, const AccountColumns& in, std::span<const double> marks,
+                      RiskColumns& out, std::size_t first) {
+    const std::size_t n = in.size();
+    if (out.active.size() < first + n) {
+        out.active.resize(first + n);
+        out.equity.resize(first + n);
+        out.pnl.resize(first + n);
+        out.exposure.resize(first + n);
+    }
+    std::copy(in.active.begin(), in.active.end(), out.active.begin() + static_cast<std::ptrdiff_t>(first));
+    const MarkColumns c{in.cash.data(), in.startCash.data(), in.inventory.data(), in.startInventory.data(),
+                        marks.data(), std::min(in.symbols(), marks.size()), n,
+                        out.equity.data() + first, out.pnl.data() + first, out.exposure.data() + first};
+    RiskSums s;
+#ifdef RISK_HAS_AVX2
+    if (resolveRiskKernel(kernel) == RiskKernel::Avx2) {
+        avx2Kernel(c, n, s);
+        return s;
+    }
+#else
+    (void)kernel;
+#endif
+    scalarKernel(c, 0, n, s);
+    return s;
+}
+
+RiskEngine::RiskEngine(RiskKernel kernel) : kind(resolveRiskKernel(kernel)) {}
+
+RiskTotals RiskEngine::update(const AccountTable& accounts, std::span<const double> marks, int tick) {
+    const auto start = std::chrono::steady_clock::now();
+    const std::size_t blocks = accounts.blockCount();
+    const std::size_t rows = blocks * AccountTable::kChunk;
+    // строки за последним блоком (если таблица сменилась) - как у неоткрытых счетов
+    if (spare.active.size() > rows) spare.active.resize(rows);
+
+    RiskTotals t;
+    for (std::size_t c = 0; c < blocks; ++c) {
+        accounts.exportBlock(c, block);
+        add(t.sums, markAccounts(kind, block, marks, spare, c * AccountTable::kChunk));
+    }
+    {
+        std::lock_guard<std::mutex> lk(columnsMutex);
+        std::swap(spare, columns);
+    }
+    t.sequence = ++updates;
+    t.tick = tick;
+    t.accounts = accounts.size();
+    t.mark = marks.empty() ? 0.0 : marks[0];
+    t.computeNs = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+    published.store(t);
+    return t;
+}
+
+AccountRisk RiskEngine::account(int id) const {
+    std::lock_guard<std::mutex> lk(columnsMutex);
+    if (id < 0 || static_cast<std::size_t>(id) >= columns.active.size() || !columns.active[static_cast<std::size_t>(id)])
+        return {};
+    const auto i = static_cast<std::size_t>(id);
+    return {true, columns.equity[i], columns.pnl[i], columns.exposure[i]};
+}
+
+void printRiskReport(std::ostream& os, const RiskTotals& r) {
+    os << "[t=" << r.tick << "] RISK: accounts=" << r.accounts
+       << " mark=" << r.mark
+       << " equity=" << r.sums.equity
+       << " pnl=" << r.sums.pnl
+       << " gross=" << r.sums.grossExposure
+       << " net=" << r.sums.netPosition
+       << " long=" << r.sums.longPosition
+       << " short=" << r.sums.shortPosition
+       << " us=" << static_cast<double>(r.computeNs) / 1000.0
+       << "\n";
+}
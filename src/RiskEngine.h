@@ -0,0 +1,92 @@
+#ifndef RISKENGINE_H
+#define RISKENGINE_H
+
+#include <cstdint>
+#include <iosfwd>
+#include <mutex>
+#include <span>
+#include <vector>
+#include "AccountTable.h"
+#include "Seqlock.h"
+
+// Чем считать: Auto - AVX2, если процессор умеет, иначе скалярно.
+// Avx2 на процессоре без AVX2 тоже считается скалярно.
+enum class RiskKernel { Auto, Scalar, Avx2 };
+
+[[nodiscard]] RiskKernel resolveRiskKernel(RiskKernel kernel);
+
+// Итоги по всем счетам. Позиции - в штуках по всем инструментам, shortPosition положительна.
+struct RiskSums {
+    double equity{};            // cash + сумма inventory * mark по инструментам
+    double pnl{};               // капитал минус начальный портфель по тем же маркам
+    double grossExposure{};     // сумма |inventory| * mark
+    double netPosition{};
+    double longPosition{};
+    double shortPosition{};
+};
+
+struct RiskTotals {
+    std::uint64_t sequence{};   // номер пересчёта, 0 - ещё не считали
+    int tick{};
+    std::size_t accounts{};
+    double mark{};              // марка инструмента 0
+    RiskSums sums;
+    std::int64_t computeNs{};   // сколько занял пересчёт вместе со съёмом счетов
+};
+
+struct AccountRisk {
+    bool registered{};
+    double equity{};
+    double pnl{};
+    double exposure{};
+};
+
+// Оценка счетов столбцами, строка - id счёта.
+struct RiskColumns {
+    std::vector<std::uint8_t> active;
+    std::vector<double> equity;
+    std::vector<double> pnl;
+    std::vector<double> exposure;
+};
+
+// Векторное ядро: за один проход по столбцам балансов - оценка каждого счёта в строки
+// out с first и далее (out растёт при надобности) и суммы по всем. marks[s] - марка
+// инструмента s; позиции инструментов за концом marks не считаются.
+// У неоткрытых строк балансы нулевые, в суммы они ничего не вносят.
+RiskSums markAccounts(RiskKernel kernel, const AccountColumns& in, std::span<const double> marks,
+                      RiskColumns& out, std::size_t first = 0);
+
+// Оценка по рынку всех счетов биржи разом. Пересчитывает один поток (update):
+// балансы блока AccountTable снимаются в столбцы атомарными чтениями, и ядро тут же,
+// пока они в кэше, считает по ним капитал, PnL и экспозицию каждого счёта и итоги.
+// Итоги читаются без блокировок, оценка счёта - из столбцов последнего пересчёта
+// под коротким мьютексом.
+class RiskEngine final {
+public:
+    explicit RiskEngine(RiskKernel kernel = RiskKernel::Auto);
+
+    RiskEngine(const RiskEngine&) = delete;
+    RiskEngine& operator=(const RiskEngine&) = delete;
+
+    // marks[s] - марка инструмента s, у каждой позиции своя
+    RiskTotals update(const AccountTable& accounts, std::span<const double> marks, int tick);
+
+    [[nodiscard]] RiskTotals totals() const { return published.load(); }
+    [[nodiscard]] AccountRisk account(int id) const;
+    [[nodiscard]] RiskKernel kernel() const { return kind; }
+
+private:
+    RiskKernel kind;
+    std::uint64_t updates = 0;
+
+    AccountColumns block;       // съём балансов одного блока, только для update
+    // оценка пишется в spare, затем меняется местами с опубликованной
+    RiskColumns spare;
+    mutable std::mutex columnsMutex;
+    RiskColumns columns;
+    Seqlock<RiskTotals> published;
+};
+
+void printRiskReport(std::ostream& os, const RiskTotals& r);
+
+#endif // RISKENGINE_H
@@ -0,0 +1,218 @@
+#include "RiskGate.h"
+
+#include <cmath>
+#include <cstdlib>
+
+RiskGate::RiskGate(const AccountTable& accounts, const RiskLimits& defaults)
+    : accounts(accounts), defaults(defaults), linesPerEntry((accounts.symbols() + 3) / 4) {}
+
+RiskGate::~RiskGate() {
+    for (auto& c : chunks) delete c.load(std::memory_order_relaxed);
+}
+
+void RiskGate::setDefaultLimits(const RiskLimits& limits) {
+    defaults = limits;
+}
+
+void RiskGate::setLimits(int brokerId, const RiskLimits& limits) {
+    Entry* e = entry(brokerId, true);
+    if (!e) return;
+    e->maxOrderNotional.store(limits.maxOrderNotional, std::memory_order_relaxed);
+    e->maxPosition.store(limits.maxPosition, std::memory_order_relaxed);
+    e->maxOpenOrders.store(limits.maxOpenOrders, std::memory_order_relaxed);
+    e->maxOrdersPerSecond.store(limits.maxOrdersPerSecond, std::memory_order_relaxed);
+    e->custom.store(true, std::memory_order_release);
+}
+
+RiskLimits RiskGate::limits(int brokerId) const {
+    const Entry* e = find(brokerId);
+    if (!e || !e->custom.load(std::memory_order_acquire)) return defaults;
+    return {e->maxOrderNotional.load(std::memory_order_relaxed), e->maxPosition.load(std::memory_order_relaxed),
+            e->maxOpenOrders.load(std::memory_order_relaxed), e->maxOrdersPerSecond.load(std::memory_order_relaxed)};
+}
+
+RiskGate::Entry* RiskGate::entry(int id, bool create) {
+    if (id < 0 || static_cast<std::size_t>(id) >= AccountTable::kMaxAccounts) return nullptr;
+    const auto i = static_cast<std::size_t>(id);
+    Block* chunk = chunks[i / AccountTable::kChunk].load(std::memory_order_acquire);
+    if (!chunk) {
+        if (!create) return nullptr;
+        std::lock_guard<std::mutex> lk(allocMutex);
+        chunk = chunks[i / AccountTable::kChunk].load(std::memory_order_relaxed);
+        if (!chunk) {
+            chunk = new Block(linesPerEntry);
+            chunks[i / AccountTable::kChunk].store(chunk, std::memory_order_release);
+        }
+    }
+    return &chunk->entries[i % AccountTable::kChunk];
+}
+
+const RiskGate::Entry* RiskGate::find(int id) const {
+    if (id < 0 || static_cast<std::size_t>(id) >= AccountTable::kMaxAccounts) return nullptr;
+    const auto i = static_cast<std::size_t>(id);
+    const Block* chunk = chunks[i / AccountTable::kChunk].load(std::memory_order_acquire);
+    return chunk ? &chunk->entries[i % AccountTable::kChunk] : nullptr;
+}
+
+RiskGate::Pending* RiskGate::pending(int id, Symbol symbol) const {
+    if (id < 0 || static_cast<std::size_t>(id) >= AccountTable::kMaxAccounts || symbol >= accounts.symbols())
+        return nullptr;
+    const auto i = static_cast<std::size_t>(id);
+    Block* chunk = chunks[i / AccountTable::kChunk].load(std::memory_order_acquire);
+    if (!chunk) return nullptr;
+    PendingLine& line = chunk->pending[(i % AccountTable::kChunk) * linesPerEntry + symbol / 4];
+    return &line.symbols[symbol % 4];
+}
+
+RiskReject RiskGate::reject(RiskReject r) {
+    rejected[static_cast<std::size_t>(r)].fetch_add(1, std::memory_order_relaxed);
+    return r;
+}
+
+RiskReject RiskGate::admit(const Order& order, Cash unitPrice, std::int64_t nowSecond, bool& reserved) {
+    reserved = false;
+    Cash cash = 0;
+    long long inventory = 0;
+    if (!accounts.balance(order.brokerId, cash, inventory, order.symbol)) {
+        accepted.fetch_add(1, std::memory_order_relaxed);
+        return RiskReject::None;
+    }
+    Entry& e = *entry(order.brokerId, true);
+    Pending& p = *pending(order.brokerId, order.symbol);
+    const RiskLimits l = e.custom.load(std::memory_order_acquire) ? limits(order.brokerId) : defaults;
+    const bool buy = order.side == OrderSide::Buy;
+    const long long qty = order.quantity;
+
+    if (qty <= 0) return reject(RiskReject::Quantity);
+    if (buy && unitPrice <= 0) return reject(RiskReject::NoPrice);
+    if (l.maxOrderNotional > 0 && fromCash(unitPrice) * static_cast<double>(qty) > l.maxOrderNotional)
+        return reject(RiskReject::Notional);
+
+    if (l.maxOrdersPerSecond > 0) {
+        // окно в одну секунду: старшие биты - номер секунды, младшие 24 - заявок в ней
+        std::uint64_t cur = e.rate.load(std::memory_order_relaxed);
+        while (true) {
+            const auto second = static_cast<std::uint64_t>(nowSecond);
+            const std::uint64_t count = (cur >> 24) == second ? (cur & 0xFFFFFF) : 0;
+            if (count >= static_cast<std::uint64_t>(l.maxOrdersPerSecond)) return reject(RiskReject::Rate);
+            if (e.rate.compare_exchange_weak(cur, (second << 24) | (count + 1), std::memory_order_relaxed)) break;
+        }
+    }
+
+    const int open = e.openOrders.fetch_add(1, std::memory_order_relaxed) + 1;
+    if (l.maxOpenOrders > 0 && open > l.maxOpenOrders) {
+        e.openOrders.fetch_sub(1, std::memory_order_relaxed);
+        return reject(RiskReject::OpenOrders);
+    }
+
+    if (buy) {
+        const long long bought = p.buy.fetch_add(qty, std::memory_order_relaxed) + qty;
+        const Cash need = unitPrice * qty;
+        const Cash held = e.reservedCash.fetch_add(need, std::memory_order_relaxed) + need;
+        RiskReject r = RiskReject::None;
+        if (l.maxPosition > 0 && inventory + bought > l.maxPosition) r = RiskReject::Position;
+        else if (held > cash) r = RiskReject::Cash;
+        if (r != RiskReject::None) {
+            e.reservedCash.fetch_sub(need, std::memory_order_relaxed);
+            p.buy.fetch_sub(qty, std::memory_order_relaxed);
+            e.openOrders.fetch_sub(1, std::memory_order_relaxed);
+            return reject(r);
+        }
+    } else {
+        const long long held = p.sell.fetch_add(qty, std::memory_order_relaxed) + qty;
+        RiskReject r = RiskReject::None;
+        if (held > inventory) r = RiskReject::Inventory;
+        else if (l.maxPosition > 0 && std::llabs(inventory - held) > l.maxPosition) r = RiskReject::Position;
+        if (r != RiskReject::None) {
+            p.sell.fetch_sub(qty, std::memory_order_relaxed);
+            e.openOrders.fetch_sub(1, std::memory_order_relaxed);
+            return reject(r);
+        }
+    }
+    reserved = true;
+    accepted.fetch_add(1, std::memory_order_relaxed);
+    return RiskReject::None;
+}
+
+void RiskGate::unadmit(const Order& order, Cash unitPrice) {
+    release(order.brokerId, order.symbol, order.side, order.quantity, unitPrice, true);
+    accepted.fetch_sub(1, std::memory_order_relaxed);
+}
+
+void RiskGate::release(int brokerId, Symbol symbol, OrderSide side, int qty, Cash unitPrice, bool closed) {
+    Entry* e = entry(brokerId, false);
+    Pending* p = pending(brokerId, symbol);
+    if (!e || !p) return;
+    if (side == OrderSide::Buy) {
+        e->reservedCash.fetch_sub(unitPrice * qty, std::memory_order_relaxed);
+        p->buy.fetch_sub(qty, std::memory_order_relaxed);
+    } else {
+        p->sell.fetch_sub(qty, std::memory_order_relaxed);
+    }
+    if (closed) e->openOrders.fetch_sub(1, std::memory_order_relaxed);
+}
+
+bool RiskGate::resize(int brokerId, Symbol symbol, OrderSide side, int oldQty, Cash oldUnit, int newQty, Cash newUnit,
+                      bool force) {
+    Entry* e = entry(brokerId, false);
+    Pending* p = pending(brokerId, symbol);
+    if (!e || !p) return true;
+    Cash cash = 0;
+    long long inventory = 0;
+    accounts.balance(brokerId, cash, inventory, symbol);
+
+    if (side == OrderSide::Buy) {
+        const Cash delta = newUnit * newQty - oldUnit * oldQty;
+        const Cash held = e->reservedCash.fetch_add(delta, std::memory_order_relaxed) + delta;
+        if (!force && delta > 0 && held > cash) {
+            e->reservedCash.fetch_sub(delta, std::memory_order_relaxed);
+            reject(RiskReject::Cash);
+            return false;
+        }
+        p->buy.fetch_add(newQty - oldQty, std::memory_order_relaxed);
+    } else {
+        const long long delta = newQty - oldQty;
+        const long long held = p->sell.fetch_add(delta, std::memory_order_relaxed) + delta;
+        if (!force && delta > 0 && held > inventory) {
+            p->sell.fetch_sub(delta, std::memory_order_relaxed);
+            reject(RiskReject::Inventory);
+            return false;
+        }
+    }
+    return true;
+}
+
+void RiskGate::restore(int brokerId, Symbol symbol, OrderSide side, int qty, Cash unitPrice) {
+    Entry* e = entry(brokerId, true);
+    Pending* p = pending(brokerId, symbol);
+    if (!e || !p) return;
+    e->openOrders.fetch_add(1, std::memory_order_relaxed);
+    if (side == OrderSide::Buy) {
+        p->buy.fetch_add(qty, std::memory_order_relaxed);
+        e->reservedCash.fetch_add(unitPrice * qty, std::memory_order_relaxed);
+    } else {
+        p->sell.fetch_add(qty, std::memory_order_relaxed);
+    }
+}
+
+Cash RiskGate::reservedCash(int brokerId) const {
+    const Entry* e = find(brokerId);
+    return e ? e->reservedCash.load(std::memory_order_relaxed) : 0;
+}
+
+long long RiskGate::reservedInventory(int brokerId, Symbol symbol) const {
+    const Pending* p = pending(brokerId, symbol);
+    return p ? p->sell.load(std::memory_order_relaxed) : 0;
+}
+
+int RiskGate::openOrders(int brokerId) const {
+    const Entry* e = find(brokerId);
+    return e ? e->openOrders.load(std::memory_order_relaxed) : 0;
+}
+
+RiskGateStats RiskGate::stats() const {
+    RiskGateStats s;
+    s.accepted = accepted.load(std::memory_order_relaxed);
+    for (std::size_t i = 0; i < kRiskRejectKinds; ++i) s.rejected[i] = rejected[i].load(std::memory_order_relaxed);
+    return s;
+}
@@ -0,0 +1,56 @@
+#ifndef SEQLOCK_H
+#define SEQLOCK_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <type_traits>
+
+// Публикация небольшой структуры без блокировок для читателей.
+// Данные лежат в атомарных словах, поэтому гонки нет и формально;
+// читатель повторяет чтение, если застал запись на полпути.
+template <class T>
+class Seqlock final {
+    static_assert(std::is_trivially_copyable_v<T>);
+    static constexpr std::size_t kWords = (sizeof(T) + 7) / 8;
+
+    alignas(64) std::atomic<std::uint64_t> seq{0};
+    std::atomic<std::uint64_t> words[kWords]{};
+    std::mutex writeMutex;      // писатели сериализуются, читатели её не трогают
+
+public:
+    void store(const T& v) {
+        std::uint64_t buf[kWords]{};
+        std::memcpy(buf, &v, sizeof(T));
+
+        std::lock_guard<std::mutex> lk(writeMutex);
+        const std::uint64_t s = seq.load(std::memory_order_relaxed);
+        seq.store(s + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        for (std::size_t i = 0; i < kWords; ++i)
+            words[i].store(buf[i], std::memory_order_relaxed);
+        seq.store(s + 2, std::memory_order_release);
+    }
+
+    // version - номер публикации, 0 если store ещё не вызывался
+    [[nodiscard]] T load(std::uint64_t* version = nullptr) const {
+        std::uint64_t buf[kWords];
+        while (true) {
+            const std::uint64_t s1 = seq.load(std::memory_order_acquire);
+            if (s1 & 1) continue;
+            for (std::size_t i = 0; i < kWords; ++i)
+                buf[i] = words[i].load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (seq.load(std::memory_order_relaxed) == s1) {
+                if (version) *version = s1 / 2;
+                break;
+            }
+        }
+        T v;
+        std::memcpy(&v, buf, sizeof(T));
+        return v;
+    }
+};
+
+#endif // SEQLOCK_H
@@ -0,0 +1,95 @@
+#ifndef SHMRING_H
+#define SHMRING_H
+
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+// SpscRing для разделяемой памяти: ячейки лежат внутри самого объекта, указателей нет,
+// поэтому кольцо можно отобразить в два процесса по разным адресам.
+// Раскладка фиксирована (индексы 64-битные, каждая сторона на своей кэш-линии):
+// меняется она - меняется версия протокола того, кто кольцо разделяет.
+template <class T, std::size_t Capacity>
+class ShmRing final {
+    static_assert(std::has_single_bit(Capacity), "Capacity must be a power of two");
+    static_assert(std::is_trivially_copyable_v<T>);
+    static_assert(std::atomic<std::uint64_t>::is_always_lock_free, "atomics must work across processes");
+
+    static constexpr std::uint64_t kMask = Capacity - 1;
+
+    alignas(64) std::atomic<std::uint64_t> tail{0};     // пишет производитель
+    std::uint64_t cachedHead = 0;
+    alignas(64) std::atomic<std::uint64_t> head{0};     // пишет потребитель
+    std::uint64_t cachedTail = 0;
+    alignas(64) T cells[Capacity];
+
+public:
+    ShmRing() = default;
+    ShmRing(const ShmRing&) = delete;
+    ShmRing& operator=(const ShmRing&) = delete;
+
+    [[nodiscard]] static constexpr std::size_t capacity() { return Capacity; }
+
+    // только производитель; false - кольцо заполнено
+    bool tryPush(const T& v) {
+        const std::uint64_t t = tail.load(std::memory_order_relaxed);
+        if (t - cachedHead > kMask) {
+            cachedHead = head.load(std::memory_order_acquire);
+            if (t - cachedHead > kMask) return false;
+        }
+        cells[t & kMask] = v;
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    // только потребитель
+    bool tryPop(T& out) {
+        const std::uint64_t h = head.load(std::memory_order_relaxed);
+        if (h == cachedTail) {
+            cachedTail = tail.load(std::memory_order_acquire);
+            if (h == cachedTail) return false;
+        }
+        out = cells[h & kMask];
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    // только потребитель: до max элементов, head публикуется один раз на пачку
+    template <class F>
+    std::size_t drain(F&& f, std::size_t max) {
+        const std::uint64_t h = head.load(std::memory_order_relaxed);
+        if (h == cachedTail) {
+            cachedTail = tail.load(std::memory_order_acquire);
+            if (h == cachedTail) return 0;
+        }
+        const std::size_t n = static_cast<std::size_t>(cachedTail - h) < max
+            ? static_cast<std::size_t>(cachedTail - h) : max;
+        for (std::size_t i = 0; i < n; ++i) f(cells[(h + i) & kMask]);
+        head.store(h + n, std::memory_order_release);
+        return n;
+    }
+
+    // только производитель: сколько элементов точно поместится
+    [[nodiscard]] std::size_t freeSpace() {
+        const std::uint64_t t = tail.load(std::memory_order_relaxed);
+        cachedHead = head.load(std::memory_order_acquire);
+        return Capacity - static_cast<std::size_t>(t - cachedHead);
+    }
+
+    // только потребитель
+    [[nodiscard]] bool empty() const {
+        return head.load(std::memory_order_relaxed) == tail.load(std::memory_order_acquire);
+    }
+
+    // когда ни одна сторона кольцом не пользуется (слот освобождён)
+    void reset() {
+        tail.store(0, std::memory_order_relaxed);
+        head.store(0, std::memory_order_relaxed);
+        cachedHead = 0;
+        cachedTail = 0;
+    }
+};
+
+#endif // SHMRING_H
@@ -0,0 +1,47 @@
+#include "Simulation.h"
+
+#include <algorithm>
+#include "Broker.h"
+#include "Exchange.h"
+
+Simulation::Simulation(Exchange& ex) : exchange(ex), clock(ex.tick()) {
+    events.push({clock, kExchange});
+}
+
+void Simulation::add(std::shared_ptr<Broker> broker, int everyTicks, int offset) {
+    Broker* b = broker.get();
+    add([b](int t) { b->step(t); }, everyTicks, offset);
+    agents.back().keepAlive = std::move(broker);
+}
+
+void Simulation::add(Step step, int everyTicks, int offset) {
+    agents.push_back({std::move(step), nullptr, std::max(1, everyTicks)});
+    events.push({clock + std::max(0, offset), static_cast<std::uint32_t>(agents.size() - 1)});
+}
+
+int Simulation::run(int ticks) {
+    const long long end = clock + std::max(0, ticks);
+    while (!events.empty() && events.top().tick < end) {
+        const Event e = events.top();
+        events.pop();
+        if (e.rank == kExchange) {
+            if (!exchange.advanceTick()) break;
+            clock = e.tick + 1;
+            events.push({clock, kExchange});
+            continue;
+        }
+        Agent& a = agents[e.rank];
+        a.step(static_cast<int>(e.tick));
+        ++stepsDone;
+        events.push({e.tick + a.everyTicks, e.rank});
+    }
+    return exchange.tick();
+}
+
+int Simulation::now() const {
+    return static_cast<int>(clock);
+}
+
+std::uint64_t Simulation::steps() const {
+    return stepsDone;
+}
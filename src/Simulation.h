@@ -0,0 +1,62 @@
+#ifndef SIMULATION_H
+#define SIMULATION_H
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <queue>
+#include <vector>
+
+class Broker;
+class Exchange;
+
+// Безголовая симуляция на виртуальных часах: биржа и брокеры шагают по общему
+// тику через очередь событий, в одном потоке, без sleep. В тике сначала шагают
+// брокеры, у которых наступил срок (в порядке добавления), затем биржа сводит
+// стаканы, берёт комиссию и переводит часы (Exchange::advanceTick).
+// Один и тот же набор брокеров с теми же seed даёт побитно тот же прогон,
+// а час рыночного времени считается так быстро, как позволяет процессор.
+// runLoop биржи на время симуляции запускать нельзя.
+class Simulation final {
+public:
+    using Step = std::function<void(int currentTime)>;
+
+    explicit Simulation(Exchange& ex);
+
+    // шаг раз в everyTicks тиков, первый - через offset тиков от текущего;
+    // currentTime в step - номер тика биржи
+    void add(std::shared_ptr<Broker> broker, int everyTicks = 1, int offset = 0);
+    // произвольный участник, например BrokerPopulation::step
+    void add(Step step, int everyTicks = 1, int offset = 0);
+
+    // прогнать ticks тиков; возвращает тик биржи после прогона
+    int run(int ticks);
+
+    [[nodiscard]] int now() const;
+    // шагов участников за всё время
+    [[nodiscard]] std::uint64_t steps() const;
+
+private:
+    // tick и rank задают порядок: в тике участники по rank, биржа (kExchange) последней
+    struct Event {
+        long long tick{};
+        std::uint32_t rank{};
+
+        bool operator>(const Event& o) const { return tick != o.tick ? tick > o.tick : rank > o.rank; }
+    };
+    static constexpr std::uint32_t kExchange = ~std::uint32_t{0};
+
+    struct Agent {
+        Step step;
+        std::shared_ptr<Broker> keepAlive;
+        int everyTicks{};
+    };
+
+    Exchange& exchange;
+    std::vector<Agent> agents;
+    std::priority_queue<Event, std::vector<Event>, std::greater<>> events;
+    long long clock;
+    std::uint64_t stepsDone = 0;
+};
+
+#endif // SIMULATION_H
@@ -0,0 +1,47 @@
+#ifndef SLABPOOL_H
+#define SLABPOOL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Арена объектов фиксированного размера: память выделяется слэбами по
+// SlabSize штук и не возвращается, освобождённые ячейки идут в free list.
+// Хэндлы (индексы) стабильны, в установившемся режиме аллокаций нет.
+template <class T, std::size_t SlabSize = 4096>
+class SlabPool final {
+    static_assert((SlabSize & (SlabSize - 1)) == 0, "SlabSize must be a power of two");
+
+    std::vector<std::unique_ptr<T[]>> slabs;
+    std::vector<std::uint32_t> freeList;
+    std::uint32_t bump = 0;     // следующая ни разу не выданная ячейка
+
+public:
+    using Handle = std::uint32_t;
+    static constexpr Handle kNull = UINT32_MAX;
+
+    Handle allocate() {
+        if (!freeList.empty()) {
+            const Handle h = freeList.back();
+            freeList.pop_back();
+            return h;
+        }
+        if (bump == slabs.size() * SlabSize) {
+            slabs.push_back(std::make_unique<T[]>(SlabSize));
+            // release() не должен аллоцировать
+            freeList.reserve(slabs.size() * SlabSize);
+        }
+        return bump++;
+    }
+
+    void release(Handle h) { freeList.push_back(h); }
+
+    T& operator[](Handle h) { return slabs[h / SlabSize][h % SlabSize]; }
+    const T& operator[](Handle h) const { return slabs[h / SlabSize][h % SlabSize]; }
+
+    [[nodiscard]] std::size_t capacity() const { return slabs.size() * SlabSize; }
+    [[nodiscard]] std::size_t live() const { return bump - freeList.size(); }
+};
+
+#endif // SLABPOOL_H
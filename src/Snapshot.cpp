@@ -0,0 +1,129 @@
+#include "Snapshot.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr std::size_t kAlign = 64;
+
+std::size_t alignUp(std::size_t n) {
+    return (n + kAlign - 1) & ~(kAlign - 1);
+}
+
+bool writeAll(int fd, const void* data, std::size_t bytes, off_t offset) {
+    const auto* p = static_cast<const std::byte*>(data);
+    while (bytes > 0) {
+        const ssize_t n = ::pwrite(fd, p, bytes, offset);
+        if (n <= 0) return false;
+        p += n;
+        bytes -= static_cast<std::size_t>(n);
+        offset += n;
+    }
+    return true;
+}
+
+} // namespace
+
+bool writeSnapshot(const std::string& path, const SnapshotData& data) {
+    struct Part {
+        SnapshotSection kind;
+        std::uint32_t recordSize;
+        const void* records;
+        std::size_t count;
+    };
+    const Part parts[kSnapshotSections] = {
+        {SnapshotSection::Instruments, sizeof(SnapshotInstrument), data.instruments.data(), data.instruments.size()},
+        {SnapshotSection::Orders, sizeof(SnapshotOrder), data.orders.data(), data.orders.size()},
+        {SnapshotSection::Accounts, sizeof(AccountRecord), data.accounts.data(), data.accounts.size()},
+        {SnapshotSection::FairWindow, sizeof(FairWindowEntry), data.window.data(), data.window.size()},
+        {SnapshotSection::Positions, sizeof(PositionRecord), data.positions.data(), data.positions.size()},
+    };
+
+    SnapshotSectionEntry table[kSnapshotSections]{};
+    std::size_t offset = alignUp(sizeof(SnapshotHeader) + sizeof(table));
+    for (std::uint32_t i = 0; i < kSnapshotSections; ++i) {
+        table[i] = {static_cast<std::uint32_t>(parts[i].kind), parts[i].recordSize, offset, parts[i].count, 0};
+        offset = alignUp(offset + parts[i].recordSize * parts[i].count);
+    }
+
+    SnapshotHeader h{};
+    std::memcpy(h.magic, kSnapshotMagic.data(), std::min(kSnapshotMagic.size(), sizeof(h.magic)));
+    h.version = kSnapshotVersion;
+    h.sections = kSnapshotSections;
+    h.fileSize = offset;
+    h.nextId = data.nextId;
+    h.tick = data.tick;
+
+    const std::string tmp = path + ".tmp";
+    const int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return false;
+    bool ok = ftruncate(fd, static_cast<off_t>(offset)) == 0
+        && writeAll(fd, &h, sizeof(h), 0)
+        && writeAll(fd, table, sizeof(table), sizeof(h));
+    for (std::uint32_t i = 0; ok && i < kSnapshotSections; ++i)
+        ok = writeAll(fd, parts[i].records, parts[i].recordSize * parts[i].count, static_cast<off_t>(table[i].offset));
+    ok = ok && fsync(fd) == 0;
+    ::close(fd);
+    if (ok) ok = std::rename(tmp.c_str(), path.c_str()) == 0;
+    if (!ok) ::unlink(tmp.c_str());
+    return ok;
+}
+
+SnapshotReader::~SnapshotReader() {
+    close();
+}
+
+bool SnapshotReader::open(const std::string& path) {
+    close();
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat st{};
+    if (fstat(fd, &st) != 0 || static_cast<std::size_t>(st.st_size) < sizeof(SnapshotHeader)) {
+        ::close(fd);
+        return false;
+    }
+    size = static_cast<std::size_t>(st.st_size);
+    void* p = mmap(nullptr, size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+    ::close(fd);
+    if (p == MAP_FAILED) {
+        size = 0;
+        return false;
+    }
+    base = static_cast<const std::byte*>(p);
+
+    const SnapshotHeader& h = header();
+    const bool valid = std::memcmp(h.magic, kSnapshotMagic.data(), std::min(kSnapshotMagic.size(), sizeof(h.magic))) == 0
+        && h.version == kSnapshotVersion && h.fileSize == size
+        && sizeof(SnapshotHeader) + h.sections * sizeof(SnapshotSectionEntry) <= size;
+    if (!valid) {
+        close();
+        return false;
+    }
+    const auto* table = reinterpret_cast<const SnapshotSectionEntry*>(base + sizeof(SnapshotHeader));
+    for (std::uint32_t i = 0; i < h.sections; ++i)
+        if (table[i].offset + table[i].count * table[i].recordSize > size) {
+            close();
+            return false;
+        }
+    return true;
+}
+
+void SnapshotReader::close() {
+    if (base) munmap(const_cast<std::byte*>(base), size);
+    base = nullptr;
+    size = 0;
+}
+
+const SnapshotSectionEntry* SnapshotReader::find(SnapshotSection kind, std::uint32_t recordSize) const {
+    if (!base) return nullptr;
+    const auto* table = reinterpret_cast<const SnapshotSectionEntry*>(base + sizeof(SnapshotHeader));
+    for (std::uint32_t i = 0; i < header().sections; ++i)
+        if (table[i].kind == static_cast<std::uint32_t>(kind) && table[i].recordSize == recordSize) return &table[i];
+    return nullptr;
+}
@@ -0,0 +1,113 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "AccountTable.h"
+#include "FairPrice.h"
+#include "Order.h"
+
+// Снапшот биржи: стоящие заявки с резервами, счета и их позиции по инструментам, оценки справедливой цены,
+// nextId и тик. Файл читается через mmap без разбора: заголовок, таблица секций,
+// затем секции - плотные массивы записей фиксированного размера с выравниванием 64.
+// Меняется раскладка любой записи - меняется kSnapshotVersion.
+
+inline constexpr std::string_view kSnapshotMagic = "STKSNAP";
+inline constexpr std::uint32_t kSnapshotVersion = 2;
+
+enum class SnapshotSection : std::uint32_t { Instruments = 1, Orders, Accounts, FairWindow, Positions };
+inline constexpr std::uint32_t kSnapshotSections = 5;
+
+struct SnapshotHeader {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t sections;
+    std::uint64_t fileSize;     // обрезанный файл не читается
+    std::uint64_t nextId;
+    std::int32_t tick;
+    std::uint32_t reserved0;
+    std::uint8_t reserved[24];
+};
+static_assert(sizeof(SnapshotHeader) == 64);
+
+struct SnapshotSectionEntry {
+    std::uint32_t kind;         // SnapshotSection
+    std::uint32_t recordSize;
+    std::uint64_t offset;
+    std::uint64_t count;
+    std::uint64_t reserved;
+};
+static_assert(sizeof(SnapshotSectionEntry) == 32);
+
+// инструмент: его заявки и окно VWAP - диапазоны в секциях Orders и FairWindow
+struct SnapshotInstrument {
+    std::uint32_t symbol{};
+    std::int32_t lastQuantity{};
+    double lastPrice{};
+    FairPriceState fair;
+    std::uint64_t ordersBegin{};
+    std::uint64_t ordersCount{};
+    std::uint64_t windowBegin{};
+    std::uint64_t windowCount{};
+};
+static_assert(sizeof(SnapshotInstrument) == 96);
+
+// заявка в порядке очереди стакана и её резерв в RiskGate
+struct SnapshotOrder {
+    Order order;
+    Cash unit{};
+    std::int32_t remaining{};
+    std::uint8_t reserved{};
+    std::uint8_t market{};
+    std::uint8_t pad[2]{};
+};
+static_assert(sizeof(SnapshotOrder) == 48);
+
+// Состояние, снятое с биржи в память; в файл пишется уже без остановки матчинга.
+struct SnapshotData {
+    std::int32_t tick{};
+    std::uint64_t nextId{};
+    std::vector<SnapshotInstrument> instruments;
+    std::vector<SnapshotOrder> orders;
+    std::vector<AccountRecord> accounts;
+    std::vector<PositionRecord> positions;
+    std::vector<FairWindowEntry> window;
+};
+
+// Пишет во временный файл рядом и переименовывает: старый снапшот заменяется целиком или никак.
+bool writeSnapshot(const std::string& path, const SnapshotData& data);
+
+// Чтение снапшота через mmap; секции - span поверх отображённого файла.
+class SnapshotReader final {
+    const std::byte* base = nullptr;
+    std::size_t size = 0;
+
+    [[nodiscard]] const SnapshotSectionEntry* find(SnapshotSection kind, std::uint32_t recordSize) const;
+
+public:
+    SnapshotReader() = default;
+    ~SnapshotReader();
+    SnapshotReader(const SnapshotReader&) = delete;
+    SnapshotReader& operator=(const SnapshotReader&) = delete;
+
+    // false - нет файла, чужой формат, другая версия или файл обрезан
+    bool open(const std::string& path);
+    void close();
+
+    [[nodiscard]] const SnapshotHeader& header() const {
+        return *reinterpret_cast<const SnapshotHeader*>(base);
+    }
+
+    template <class Record>
+    [[nodiscard]] std::span<const Record> section(SnapshotSection kind) const {
+        const SnapshotSectionEntry* s = find(kind, sizeof(Record));
+        if (!s) return {};
+        return {reinterpret_cast<const Record*>(base + s->offset), static_cast<std::size_t>(s->count)};
+    }
+};
+
+#endif // SNAPSHOT_H
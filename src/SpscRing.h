@@ -0,0 +1,61 @@
+#ifndef SPSCRING_H
+#define SPSCRING_H
+
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <memory>
+
+// Ограниченная очередь один писатель - один читатель.
+// Каждая сторона кэширует индекс другой, чтобы не читать чужую кэш-линию на каждой операции.
+template <class T>
+class SpscRing final {
+    std::unique_ptr<T[]> buf;
+    std::size_t mask;
+
+    alignas(64) std::atomic<std::size_t> tail{0};   // пишет производитель
+    std::size_t cachedHead = 0;
+    alignas(64) std::atomic<std::size_t> head{0};   // пишет потребитель
+    std::size_t cachedTail = 0;
+
+public:
+    explicit SpscRing(std::size_t capacity)
+        : buf(std::make_unique<T[]>(std::bit_ceil(capacity < 2 ? std::size_t{2} : capacity))),
+          mask(std::bit_ceil(capacity < 2 ? std::size_t{2} : capacity) - 1) {}
+
+    SpscRing(const SpscRing&) = delete;
+    SpscRing& operator=(const SpscRing&) = delete;
+
+    [[nodiscard]] std::size_t capacity() const { return mask + 1; }
+
+    // только производитель; false - очередь заполнена
+    bool tryPush(const T& v) {
+        const std::size_t t = tail.load(std::memory_order_relaxed);
+        if (t - cachedHead > mask) {
+            cachedHead = head.load(std::memory_order_acquire);
+            if (t - cachedHead > mask) return false;
+        }
+        buf[t & mask] = v;
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    // только потребитель
+    bool tryPop(T& out) {
+        const std::size_t h = head.load(std::memory_order_relaxed);
+        if (h == cachedTail) {
+            cachedTail = tail.load(std::memory_order_acquire);
+            if (h == cachedTail) return false;
+        }
+        out = buf[h & mask];
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    // только потребитель
+    [[nodiscard]] bool empty() const {
+        return head.load(std::memory_order_relaxed) == tail.load(std::memory_order_acquire);
+    }
+};
+
+#endif // SPSCRING_H
@@ -0,0 +1,135 @@
+#include "Stats.h"
+
+#include <algorithm>
+#include <memory>
+#include <ostream>
+#include <vector>
+
+void LatencyHistogram::addTo(std::array<std::uint64_t, kBuckets>& acc, std::uint64_t& sum,
+                             std::uint64_t& mn, std::uint64_t& mx) const {
+    for (std::size_t i = 0; i < kBuckets; ++i) acc[i] += buckets[i].load(std::memory_order_relaxed);
+    sum += total.load(std::memory_order_relaxed);
+    mn = std::min(mn, lo.load(std::memory_order_relaxed));
+    mx = std::max(mx, hi.load(std::memory_order_relaxed));
+}
+
+namespace {
+
+// блоки живут до конца процесса: потоки могут завершаться и после статических деструкторов
+struct Registry {
+    std::mutex m;
+    std::vector<std::unique_ptr<telemetry::ThreadBlock>> blocks;
+    std::vector<telemetry::ThreadBlock*> idle;
+};
+
+Registry& registry() {
+    static Registry* r = new Registry;
+    return *r;
+}
+
+struct Lease {
+    telemetry::ThreadBlock* block = nullptr;
+
+    ~Lease() {
+        if (!block) return;
+        Registry& r = registry();
+        std::lock_guard<std::mutex> lk(r.m);
+        r.idle.push_back(block);
+    }
+};
+
+#if STOCK_STATS
+LatencySummary summarize(const std::array<std::uint64_t, LatencyHistogram::kBuckets>& buckets,
+                         std::uint64_t sum, std::uint64_t mn, std::uint64_t mx) {
+    LatencySummary s;
+    for (const std::uint64_t n : buckets) s.count += n;
+    if (!s.count) return s;
+    s.min = mn;
+    s.max = mx;
+    s.mean = static_cast<double>(sum) / static_cast<double>(s.count);
+
+    const auto quantile = [&](double q) {
+        const auto rank = static_cast<std::uint64_t>(q * static_cast<double>(s.count - 1)) + 1;
+        std::uint64_t seen = 0;
+        for (std::size_t i = 0; i < buckets.size(); ++i) {
+            seen += buckets[i];
+            if (seen >= rank) return std::clamp(LatencyHistogram::valueOf(i), mn, mx);
+        }
+        return mx;
+    };
+    s.p50 = quantile(0.50);
+    s.p90 = quantile(0.90);
+    s.p99 = quantile(0.99);
+    s.p999 = quantile(0.999);
+    return s;
+}
+#endif
+
+const char* counterName(std::size_t i) {
+    static constexpr const char* names[kStatCounters] = {
+        "orders", "trades", "self_trades", "book_lock_immediate", "book_lock_contended",
+        "exchange_lock_immediate", "exchange_lock_contended", "auctions"};
+    return names[i];
+}
+
+const char* latencyName(std::size_t i) {
+    static constexpr const char* names[kStatLatencies] = {"submit_to_book", "book_to_trade", "fair_price", "settlement"};
+    return names[i];
+}
+
+} // namespace
+
+namespace telemetry {
+
+ThreadBlock& acquireBlock() {
+    thread_local Lease lease;
+    if (lease.block) return *lease.block;
+
+    Registry& r = registry();
+    std::lock_guard<std::mutex> lk(r.m);
+    if (!r.idle.empty()) {
+        lease.block = r.idle.back();
+        r.idle.pop_back();
+    } else {
+        r.blocks.push_back(std::make_unique<ThreadBlock>());
+        lease.block = r.blocks.back().get();
+    }
+    return *lease.block;
+}
+
+StatsSnapshot snapshot() {
+    StatsSnapshot s;
+#if STOCK_STATS
+    s.enabled = true;
+    Registry& r = registry();
+    std::lock_guard<std::mutex> lk(r.m);
+
+    for (const auto& b : r.blocks)
+        for (std::size_t i = 0; i < kStatCounters; ++i) s.counters[i] += b->counters[i].load(std::memory_order_relaxed);
+
+    auto buckets = std::make_unique<std::array<std::uint64_t, LatencyHistogram::kBuckets>>();
+    for (std::size_t l = 0; l < kStatLatencies; ++l) {
+        buckets->fill(0);
+        std::uint64_t sum = 0, mn = ~std::uint64_t{0}, mx = 0;
+        for (const auto& b : r.blocks) b->latencies[l].addTo(*buckets, sum, mn, mx);
+        s.latencies[l] = summarize(*buckets, sum, mn, mx);
+    }
+#endif
+    return s;
+}
+
+void print(std::ostream& os, const StatsSnapshot& s) {
+    if (!s.enabled) return;
+    os << "STATS:";
+    for (std::size_t i = 0; i < kStatCounters; ++i) os << " " << counterName(i) << "=" << s.counters[i];
+    os << "\n";
+    for (std::size_t i = 0; i < kStatLatencies; ++i) {
+        const LatencySummary& l = s.latencies[i];
+        if (!l.count) continue;
+        os << "LATENCY " << latencyName(i) << ": n=" << l.count
+           << " mean=" << l.mean << "ns p50=" << l.p50 << " p90=" << l.p90 << " p99=" << l.p99
+           << " p999=" << l.p999 << " max=" << l.max << "\n";
+    }
+}
+
+} // namespace telemetry
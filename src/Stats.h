@@ -0,0 +1,181 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iosfwd>
+#include <mutex>
+
+// Встроенная телеметрия движка. Выключается при сборке: -DSTOCK_STATS=OFF в CMake
+// (STOCK_STATS=0) - тогда все вызовы ниже пустые, а snapshot() возвращает нули.
+// Блоки счётчиков - на поток, а не на биржу: если в процессе несколько Exchange
+// (тесты, параллельные прогоны stock_sweep), их числа складываются вместе.
+#ifndef STOCK_STATS
+#define STOCK_STATS 1
+#endif
+
+enum class StatCounter : std::uint8_t {
+    Orders,                 // заявок принято в submitOrder/trySubmitOrder
+    Trades,
+    SelfTrades,             // заявок снято защитой от self-trade
+    BookLockImmediate,      // мьютекс стакана взят сразу
+    BookLockContended,      // ... пришлось ждать
+    ExchangeLockImmediate,
+    ExchangeLockContended,
+    Auctions,               // аукционов, давших сделки (см. MatchingMode::Auction)
+};
+inline constexpr std::size_t kStatCounters = 8;
+
+enum class StatLatency : std::uint8_t {
+    SubmitToBook,           // submitOrder -> заявка в стакане
+    BookToTrade,            // первая несведённая заявка инструмента -> сделка по нему
+    FairPrice,              // вызов fairPriceEstimate
+    Settlement,             // расчёт пачки сделок (счета, журнал, фид, история)
+};
+inline constexpr std::size_t kStatLatencies = 4;
+
+struct LatencySummary {
+    std::uint64_t count{};
+    std::uint64_t min{};
+    std::uint64_t max{};
+    double mean{};
+    std::uint64_t p50{};
+    std::uint64_t p90{};
+    std::uint64_t p99{};
+    std::uint64_t p999{};
+};
+
+struct StatsSnapshot {
+    bool enabled{};
+    std::array<std::uint64_t, kStatCounters> counters{};
+    std::array<LatencySummary, kStatLatencies> latencies{};
+
+    [[nodiscard]] std::uint64_t counter(StatCounter c) const { return counters[static_cast<std::size_t>(c)]; }
+    [[nodiscard]] const LatencySummary& latency(StatLatency l) const { return latencies[static_cast<std::size_t>(l)]; }
+};
+
+// Гистограмма в духе HDR: значения до 16 нс - точно, дальше 16 ступеней на каждую
+// степень двойки (ошибка не больше 1/16). Пишет один поток, читать можно из любого.
+class LatencyHistogram final {
+public:
+    static constexpr std::size_t kSub = 16;
+    static constexpr std::size_t kBuckets = (64 - 3) * kSub;
+
+    static std::size_t bucketOf(std::uint64_t v) {
+        if (v < kSub) return static_cast<std::size_t>(v);
+        const int e = 63 - __builtin_clzll(v);
+        return static_cast<std::size_t>(e - 3) * kSub + ((v >> (e - 4)) & (kSub - 1));
+    }
+    // нижняя граница ведра
+    static std::uint64_t valueOf(std::size_t bucket) {
+        if (bucket < kSub) return bucket;
+        const std::size_t e = bucket / kSub + 3;
+        return (kSub + bucket % kSub) << (e - 4);
+    }
+
+    void record(std::uint64_t v) {
+        bump(buckets[bucketOf(v)], 1);
+        bump(total, v);
+        if (v < lo.load(std::memory_order_relaxed)) lo.store(v, std::memory_order_relaxed);
+        if (v > hi.load(std::memory_order_relaxed)) hi.store(v, std::memory_order_relaxed);
+    }
+
+    // прибавить к накопителю: вёдра, сумма, min, max
+    void addTo(std::array<std::uint64_t, kBuckets>& acc, std::uint64_t& sum, std::uint64_t& mn, std::uint64_t& mx) const;
+
+private:
+    // один писатель: хватает load + store, без lock-префикса
+    static void bump(std::atomic<std::uint64_t>& a, std::uint64_t n) {
+        a.store(a.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+    std::array<std::atomic<std::uint64_t>, kBuckets> buckets{};
+    std::atomic<std::uint64_t> total{0};
+    std::atomic<std::uint64_t> lo{~std::uint64_t{0}};
+    std::atomic<std::uint64_t> hi{0};
+};
+
+namespace telemetry {
+
+// Счётчики и гистограммы одного потока. Блок берётся при первой записи и
+// возвращается в общий пул при завершении потока вместе с накопленным.
+struct ThreadBlock {
+    std::array<std::atomic<std::uint64_t>, kStatCounters> counters{};
+    std::array<LatencyHistogram, kStatLatencies> latencies{};
+};
+
+ThreadBlock& acquireBlock();
+
+inline ThreadBlock& local() {
+    thread_local ThreadBlock* block = nullptr;
+    if (!block) [[unlikely]] block = &acquireBlock();
+    return *block;
+}
+
+inline std::int64_t now() {
+#if STOCK_STATS
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+#else
+    return 0;
+#endif
+}
+
+inline void count(StatCounter c, std::uint64_t n = 1) {
+#if STOCK_STATS
+    auto& a = local().counters[static_cast<std::size_t>(c)];
+    a.store(a.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+#else
+    (void)c;
+    (void)n;
+#endif
+}
+
+// since - значение now() в начале интервала
+inline void record(StatLatency l, std::int64_t since) {
+#if STOCK_STATS
+    const std::int64_t d = now() - since;
+    local().latencies[static_cast<std::size_t>(l)].record(d > 0 ? static_cast<std::uint64_t>(d) : 0);
+#else
+    (void)l;
+    (void)since;
+#endif
+}
+
+// сумма по всем потокам процесса, живым и завершившимся, - всех бирж сразу
+StatsSnapshot snapshot();
+
+void print(std::ostream& os, const StatsSnapshot& s);
+
+} // namespace telemetry
+
+// Мьютекс, считающий захваты сразу и с ожиданием. Для condition_variable не годится,
+// там остаётся std::mutex.
+#if STOCK_STATS
+template <StatCounter Immediate, StatCounter Contended>
+class CountingMutex final {
+    std::mutex m;
+
+public:
+    void lock() {
+        if (m.try_lock()) {
+            telemetry::count(Immediate);
+            return;
+        }
+        telemetry::count(Contended);
+        m.lock();
+    }
+    bool try_lock() { return m.try_lock(); }
+    void unlock() { m.unlock(); }
+};
+#else
+template <StatCounter, StatCounter>
+using CountingMutex = std::mutex;
+#endif
+
+using BookMutex = CountingMutex<StatCounter::BookLockImmediate, StatCounter::BookLockContended>;
+using ExchangeMutex = CountingMutex<StatCounter::ExchangeLockImmediate, StatCounter::ExchangeLockContended>;
+
+#endif // STATS_H
@@ -0,0 +1,66 @@
+#include "Strategy.h"
+
+#include <algorithm>
+#include "CounterRng.h"
+
+namespace {
+
+// одно решение на всех: правило зависит только от среза рынка
+void fillAll(const OrderColumns& out, std::int8_t side, double price, int quantity) {
+    std::ranges::fill(out.side, side);
+    std::ranges::fill(out.price, price);
+    std::ranges::fill(out.quantity, quantity);
+}
+
+} // namespace
+
+// Три числа на брокера за шаг: сторона, сдвиг цены, количество. Итерации независимы,
+// ветвлений нет - компилятор векторизует цикл целиком.
+void PlayerStrategy::generate(const MarketView& m, std::span<const std::uint64_t> keys, const OrderColumns& out) const {
+    const double fair = m.fair > 0 ? m.fair : 100.0;
+    const double lo = fair * (1.0 - spread);
+    const double width = fair * 2.0 * spread;
+    const double range = quantityRange;
+    const std::uint64_t base = m.step * 3;
+
+    const std::size_t n = keys.size();
+    const std::uint64_t* key = keys.data();
+    std::int8_t* side = out.side.data();
+    double* price = out.price.data();
+    int* quantity = out.quantity.data();
+    for (std::size_t i = 0; i < n; ++i) {
+        const double u0 = unitRandom(counterRandom(key[i], base));
+        const double u1 = unitRandom(counterRandom(key[i], base + 1));
+        const double u2 = unitRandom(counterRandom(key[i], base + 2));
+        side[i] = static_cast<std::int8_t>(u0 < 0.5 ? 1 : -1);
+        price[i] = lo + u1 * width;
+        quantity[i] = minQuantity + static_cast<int>(u2 * range);
+    }
+}
+
+void BigWinStrategy::generate(const MarketView& m, std::span<const std::uint64_t>, const OrderColumns& out) const {
+    const QuoteSnapshot& q = m.quote;
+    if (m.fair <= 0 || !q.hasBid || !q.hasAsk)
+        fillAll(out, 0, 0.0, 0);
+    else if (q.ask < m.fair * (1.0 - threshold))
+        fillAll(out, 1, q.ask, quantity);
+    else if (q.bid > m.fair * (1.0 + threshold))
+        fillAll(out, -1, q.bid, quantity);
+    else
+        fillAll(out, 0, 0.0, 0);
+}
+
+void AnalystStrategy::generate(const MarketView& m, std::span<const std::uint64_t>, const OrderColumns& out) const {
+    const QuoteSnapshot& q = m.quote;
+    if (m.fair <= 0 || !q.hasBid || !q.hasAsk) {
+        fillAll(out, 0, 0.0, 0);
+        return;
+    }
+    const double mid = 0.5 * (q.bid + q.ask);
+    if (mid < m.fair)
+        fillAll(out, 1, q.ask, quantity);
+    else if (mid > m.fair)
+        fillAll(out, -1, q.bid, quantity);
+    else
+        fillAll(out, 0, 0.0, 0);
+}
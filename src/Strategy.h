@@ -0,0 +1,52 @@
+#ifndef STRATEGY_H
+#define STRATEGY_H
+
+#include <cstdint>
+#include <span>
+#include "QuoteSnapshot.h"
+
+// Решающие правила стратегий брокеров, отдельно от отправки заявок.
+// Одно правило считает заявки сразу для многих брокеров одного типа:
+// Broker::step вызывает его для одного, BrokerPopulation - для всей популяции.
+
+// что стратегия видит на шаге; один срез на всех
+struct MarketView {
+    QuoteSnapshot quote;
+    double fair{-1.0};          // quote.fairPrice(kind) для выбранной оценки
+    int currentTime{};
+    std::uint64_t step{};       // номер шага - счётчик для counterRandom
+};
+
+// Решения шага по столбцам, i - номер брокера.
+// side: 0 - не котировать, 1 - покупка, -1 - продажа.
+struct OrderColumns {
+    std::span<std::int8_t> side;
+    std::span<double> price;
+    std::span<int> quantity;
+};
+
+// Случайная котировка вокруг справедливой цены (без неё - вокруг 100).
+struct PlayerStrategy {
+    double spread = 0.07;       // цена в fair * (1 +- spread)
+    int minQuantity = 3;
+    int quantityRange = 8;      // количество в [minQuantity, minQuantity + quantityRange)
+
+    void generate(const MarketView& m, std::span<const std::uint64_t> keys, const OrderColumns& out) const;
+};
+
+// Берёт вершину, только если она дальше threshold от справедливой цены.
+struct BigWinStrategy {
+    double threshold = 0.03;
+    int quantity = 3;
+
+    void generate(const MarketView& m, std::span<const std::uint64_t> keys, const OrderColumns& out) const;
+};
+
+// Сравнивает середину спреда со справедливой ценой и берёт вершину.
+struct AnalystStrategy {
+    int quantity = 2;
+
+    void generate(const MarketView& m, std::span<const std::uint64_t> keys, const OrderColumns& out) const;
+};
+
+#endif // STRATEGY_H
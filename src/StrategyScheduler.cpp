@@ -0,0 +1,148 @@
+#include "StrategyScheduler.h"
+#include "Broker.h"
+
+#include <algorithm>
+
+namespace {
+
+// на сколько максимум засыпает рабочий без готовых задач: за это время соседи могут накопить работу
+constexpr auto kIdleNap = std::chrono::microseconds(200);
+
+} // namespace
+
+StrategyScheduler::StrategyScheduler(const SchedulerConfig& config) : mode(config.mode) {
+    std::size_t n = config.threads;
+    if (n == 0) n = std::max(1u, std::thread::hardware_concurrency());
+    for (std::size_t i = 0; i < n; ++i) workers.push_back(std::make_unique<Worker>());
+}
+
+StrategyScheduler::~StrategyScheduler() {
+    stop();
+}
+
+void StrategyScheduler::add(std::shared_ptr<Broker> broker, std::chrono::microseconds interval, int priority) {
+    auto task = std::make_unique<Task>();
+    task->broker = std::move(broker);
+    task->interval = interval;
+    task->priority = priority;
+    task->seq = tasks.size();
+
+    Worker& w = *workers[task->seq % workers.size()];
+    std::lock_guard<std::mutex> lk(w.m);
+    w.waiting.push_back(task.get());
+    tasks.push_back(std::move(task));
+}
+
+void StrategyScheduler::start() {
+    if (running.exchange(true)) return;
+    const auto now = Clock::now();
+    for (auto& w : workers) {
+        std::lock_guard<std::mutex> lk(w->m);
+        for (Task* t : w->waiting) t->due = now;
+    }
+    for (std::size_t i = 0; i < workers.size(); ++i)
+        threads.emplace_back([this, i] { run(i); });
+}
+
+void StrategyScheduler::stop() {
+    running = false;
+    for (auto& t : threads) t.join();
+    threads.clear();
+
+    // задачи возвращаются в waiting, чтобы start можно было вызвать снова
+    for (auto& w : workers) {
+        std::lock_guard<std::mutex> lk(w->m);
+        w->waiting.insert(w->waiting.end(), w->ready.begin(), w->ready.end());
+        w->ready.clear();
+    }
+}
+
+std::uint64_t StrategyScheduler::steps() const {
+    std::uint64_t total = 0;
+    for (const auto& w : workers) total += w->steps.load(std::memory_order_relaxed);
+    return total;
+}
+
+std::size_t StrategyScheduler::threadCount() const {
+    return workers.size();
+}
+
+std::size_t StrategyScheduler::brokerCount() const {
+    return tasks.size();
+}
+
+bool StrategyScheduler::laterDue(const Task* a, const Task* b) {
+    return a->due > b->due;
+}
+
+bool StrategyScheduler::ranksBelow(const Task* a, const Task* b) const {
+    if (mode == ScheduleMode::RoundRobin)
+        return a->steps != b->steps ? a->steps > b->steps : a->seq > b->seq;
+    return a->priority != b->priority ? a->priority < b->priority : a->due > b->due;
+}
+
+void StrategyScheduler::promote(Worker& w, Clock::time_point now) {
+    while (!w.waiting.empty() && w.waiting.front()->due <= now) {
+        std::pop_heap(w.waiting.begin(), w.waiting.end(), &StrategyScheduler::laterDue);
+        w.ready.push_back(w.waiting.back());
+        w.waiting.pop_back();
+        std::push_heap(w.ready.begin(), w.ready.end(), rankCmp());
+    }
+}
+
+StrategyScheduler::Task* StrategyScheduler::popReady(Worker& w) {
+    if (w.ready.empty()) return nullptr;
+    std::pop_heap(w.ready.begin(), w.ready.end(), rankCmp());
+    Task* t = w.ready.back();
+    w.ready.pop_back();
+    return t;
+}
+
+StrategyScheduler::Task* StrategyScheduler::take(std::size_t self) {
+    const auto now = Clock::now();
+    {
+        Worker& w = *workers[self];
+        std::lock_guard<std::mutex> lk(w.m);
+        promote(w, now);
+        if (Task* t = popReady(w)) return t;
+    }
+    // кража: не ждём занятого соседа, берём у следующего
+    for (std::size_t k = 1; k < workers.size(); ++k) {
+        Worker& victim = *workers[(self + k) % workers.size()];
+        std::unique_lock<std::mutex> lk(victim.m, std::try_to_lock);
+        if (!lk.owns_lock()) continue;
+        promote(victim, now);
+        if (Task* t = popReady(victim)) return t;
+    }
+    return nullptr;
+}
+
+void StrategyScheduler::run(std::size_t self) {
+    Worker& w = *workers[self];
+
+    while (running.load(std::memory_order_relaxed)) {
+        Task* t = take(self);
+        if (!t) {
+            Clock::time_point wake = Clock::now() + kIdleNap;
+            {
+                std::lock_guard<std::mutex> lk(w.m);
+                if (!w.waiting.empty()) wake = std::min(wake, w.waiting.front()->due);
+            }
+            std::this_thread::sleep_until(wake);
+            continue;
+        }
+
+        t->broker->step(static_cast<int>(t->steps));
+        ++t->steps;
+        w.steps.fetch_add(1, std::memory_order_relaxed);
+
+        // отставший брокер не догоняет пачкой шагов, а продолжает с текущего момента
+        const auto now = Clock::now();
+        t->due += t->interval;
+        if (t->due + t->interval < now) t->due = now;
+
+        std::lock_guard<std::mutex> lk(w.m);
+        w.waiting.push_back(t);
+        std::push_heap(w.waiting.begin(), w.waiting.end(), &StrategyScheduler::laterDue);
+    }
+}
@@ -0,0 +1,87 @@
+#ifndef STRATEGYSCHEDULER_H
+#define STRATEGYSCHEDULER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class Broker;
+
+// Priority   - из готовых к шагу брокеров первым идёт брокер с большим priority;
+// RoundRobin - priority игнорируется, первым идёт тот, кто сделал меньше шагов.
+enum class ScheduleMode { Priority, RoundRobin };
+
+struct SchedulerConfig {
+    std::size_t threads = 0;    // 0 - по числу ядер
+    ScheduleMode mode = ScheduleMode::Priority;
+};
+
+// Пул потоков, вызывающий Broker::step вместо отдельного потока на брокера.
+// У каждого рабочего своя очередь брокеров: куча ожидающих по времени следующего
+// шага и куча готовых. Рабочий без готовых брокеров забирает их у соседей,
+// после шага брокер остаётся у того, кто его выполнил. Один брокер никогда
+// не шагает в двух потоках сразу; currentTime в step - номер его шага.
+class StrategyScheduler final {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    explicit StrategyScheduler(const SchedulerConfig& config = {});
+    ~StrategyScheduler();
+
+    StrategyScheduler(const StrategyScheduler&) = delete;
+    StrategyScheduler& operator=(const StrategyScheduler&) = delete;
+
+    // до start: шаг раз в interval (0 - как можно чаще)
+    void add(std::shared_ptr<Broker> broker,
+             std::chrono::microseconds interval = std::chrono::milliseconds(20), int priority = 0);
+
+    void start();
+    void stop();
+
+    [[nodiscard]] std::uint64_t steps() const;
+    [[nodiscard]] std::size_t threadCount() const;
+    [[nodiscard]] std::size_t brokerCount() const;
+
+private:
+    struct Task {
+        std::shared_ptr<Broker> broker;
+        Clock::duration interval{};
+        int priority{};
+        std::size_t seq{};
+        Clock::time_point due{};
+        std::uint64_t steps{};
+    };
+
+    struct Worker {
+        std::mutex m;
+        std::vector<Task*> waiting;     // куча: раньше due - выше
+        std::vector<Task*> ready;       // куча: порядок зависит от ScheduleMode
+        alignas(64) std::atomic<std::uint64_t> steps{0};
+    };
+
+    // сравнения для куч: вершина - самый ранний due / самый приоритетный готовый
+    static bool laterDue(const Task* a, const Task* b);
+    bool ranksBelow(const Task* a, const Task* b) const;
+    auto rankCmp() const {
+        return [this](const Task* a, const Task* b) { return ranksBelow(a, b); };
+    }
+
+    // переложить наступившие задачи из waiting в ready; вызывается под w.m
+    void promote(Worker& w, Clock::time_point now);
+    Task* popReady(Worker& w);
+    // своя очередь, затем чужие
+    Task* take(std::size_t self);
+    void run(std::size_t self);
+
+    ScheduleMode mode;
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::vector<std::unique_ptr<Task>> tasks;
+    std::vector<std::thread> threads;
+    std::atomic<bool> running{false};
+};
+
+#endif // STRATEGYSCHEDULER_H
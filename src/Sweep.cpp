@@ -0,0 +1,135 @@
+#include "Sweep.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <ostream>
+#include <thread>
+#include "Broker.h"
+#include "Exchange.h"
+#include "Population.h"
+#include "Simulation.h"
+
+SweepResult runSweepOne(const SweepRun& run) {
+    const auto start = std::chrono::steady_clock::now();
+
+    ExchangeConfig config;
+    config.book = run.book;
+    // заявки в симуляции идут мимо очереди, отчёты никто не читает
+    config.ingressCapacity = 1 << 10;
+    config.riskReportTicks = 0;
+    Exchange ex(config);
+    ex.setConsoleOutput(false);
+    ex.setFee(run.fee, run.feeEveryTicks);
+
+    // те же брокеры, что в stock_app
+    const PlayerStrategy player{.spread = run.playerSpread};
+    const std::array<std::shared_ptr<Broker>, kSweepBrokers> brokers{
+        std::make_shared<PlayerBroker>(1, 8000, 50, ex, run.seed, player),
+        std::make_shared<PlayerBroker>(2, 12000, 50, ex, run.seed, player),
+        std::make_shared<AnalystBroker>(3, 10000, 50, ex),
+        std::make_shared<BigWinBroker>(4, 20000, 100, ex, run.bigWinThreshold),
+    };
+    for (const auto& br : brokers) ex.registerBroker(br);
+
+    Simulation sim(ex);
+    for (const auto& br : brokers) sim.add(br);
+    std::unique_ptr<BrokerPopulation<PlayerStrategy>> population;
+    if (run.population) {
+        population = std::make_unique<BrokerPopulation<PlayerStrategy>>(
+            ex, PopulationConfig{.firstId = static_cast<int>(kSweepBrokers) + 1, .size = run.population,
+                                 .cash = 10000, .inventory = 50, .seed = run.seed},
+            player);
+        sim.add([&population](int t) { population->step(t); });
+    }
+    sim.run(run.ticks);
+
+    SweepResult r;
+    r.run = run;
+    r.vwap = -1.0;
+    r.lastPrice = -1.0;
+    double notional = 0;
+    for (const Trade& tr : ex.tradesBetween(0, ex.tick() + 1)) {
+        ++r.trades;
+        r.volume += tr.quantity;
+        notional += tr.price * tr.quantity;
+        r.lastPrice = tr.price;
+    }
+    if (r.volume > 0) r.vwap = notional / static_cast<double>(r.volume);
+
+    double named = 0;
+    for (std::size_t i = 0; i < kSweepBrokers; ++i) {
+        r.pnl[i] = ex.accountRisk(brokers[i]->id()).pnl;
+        named += r.pnl[i];
+    }
+    r.populationPnl = run.population ? ex.riskTotals().sums.pnl - named : 0.0;
+    r.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return r;
+}
+
+std::vector<SweepResult> runSweep(std::span<const SweepRun> runs, unsigned threads) {
+    std::vector<SweepResult> results(runs.size());
+    if (!threads) threads = std::max(1u, std::thread::hardware_concurrency());
+    threads = static_cast<unsigned>(std::min<std::size_t>(threads, runs.size()));
+
+    // прогоны раздаются по одному: длинные не копятся у одного потока
+    std::atomic<std::size_t> next{0};
+    const auto worker = [&] {
+        for (std::size_t i = next.fetch_add(1); i < runs.size(); i = next.fetch_add(1))
+            results[i] = runSweepOne(runs[i]);
+    };
+    std::vector<std::thread> pool;
+    for (unsigned i = 1; i < threads; ++i) pool.emplace_back(worker);
+    worker();
+    for (auto& t : pool) t.join();
+    return results;
+}
+
+namespace {
+
+const char* bookName(BookKind kind) {
+    return kind == BookKind::Map ? "map" : "ladder";
+}
+
+constexpr const char* kBrokerColumns[kSweepBrokers] = {"pnl_player", "pnl_player2", "pnl_analyst", "pnl_bigwin"};
+
+} // namespace
+
+void writeSweepCsv(std::ostream& os, std::span<const SweepResult> results) {
+    const auto precision = os.precision(10);
+    os << "run,seed,ticks,book,bigwin_threshold,player_spread,fee,fee_every,population,"
+          "trades,volume,vwap,last_price";
+    for (const char* c : kBrokerColumns) os << "," << c;
+    os << ",pnl_population,seconds\n";
+    for (std::size_t i = 0; i < results.size(); ++i) {
+        const SweepResult& r = results[i];
+        os << i << "," << r.run.seed << "," << r.run.ticks << "," << bookName(r.run.book) << ","
+           << r.run.bigWinThreshold << "," << r.run.playerSpread << "," << r.run.fee << ","
+           << r.run.feeEveryTicks << "," << r.run.population << ","
+           << r.trades << "," << r.volume << "," << r.vwap << "," << r.lastPrice;
+        for (const double p : r.pnl) os << "," << p;
+        os << "," << r.populationPnl << "," << r.seconds << "\n";
+    }
+    os.precision(precision);
+}
+
+void writeSweepJson(std::ostream& os, std::span<const SweepResult> results) {
+    const auto precision = os.precision(10);
+    os << "[\n";
+    for (std::size_t i = 0; i < results.size(); ++i) {
+        const SweepResult& r = results[i];
+        os << "  {\"run\": " << i << ", \"seed\": " << r.run.seed << ", \"ticks\": " << r.run.ticks
+           << ", \"book\": \"" << bookName(r.run.book) << "\""
+           << ", \"bigwin_threshold\": " << r.run.bigWinThreshold << ", \"player_spread\": " << r.run.playerSpread
+           << ", \"fee\": " << r.run.fee << ", \"fee_every\": " << r.run.feeEveryTicks
+           << ", \"population\": " << r.run.population
+           << ", \"trades\": " << r.trades << ", \"volume\": " << r.volume
+           << ", \"vwap\": " << r.vwap << ", \"last_price\": " << r.lastPrice;
+        for (std::size_t b = 0; b < kSweepBrokers; ++b) os << ", \"" << kBrokerColumns[b] << "\": " << r.pnl[b];
+        os << ", \"pnl_population\": " << r.populationPnl << ", \"seconds\": " << r.seconds << "}"
+           << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    os << "]\n";
+    os.precision(precision);
+}
@@ -0,0 +1,54 @@
+#ifndef SWEEP_H
+#define SWEEP_H
+
+#include <array>
+#include <cstdint>
+#include <iosfwd>
+#include <span>
+#include <vector>
+#include "Book.h"
+
+// Перебор параметров стратегий: каждый прогон - своя биржа с брокерами stock_app
+// (и, по желанию, популяцией игроков) на виртуальных часах (см. Simulation).
+// Прогоны ничего не делят, поэтому идут параллельно на всех ядрах,
+// а результат прогона зависит только от его параметров.
+
+// параметры одного прогона
+struct SweepRun {
+    std::uint64_t seed = 0;         // ГСЧ игроков (brokerKey(seed, id))
+    int ticks = 3000;               // тик 20 мс: минута рыночного времени
+    double bigWinThreshold = 0.03;  // BigWinStrategy::threshold
+    double playerSpread = 0.07;     // PlayerStrategy::spread - полоса цен игроков
+    double fee = 0.5;               // Exchange::setFee
+    int feeEveryTicks = 50;
+    std::size_t population = 0;     // игроков-популяции сверх четырёх брокеров stock_app
+    BookKind book = BookKind::Ladder;
+};
+
+// брокеры stock_app, их id - индекс + 1
+enum class SweepBroker { Player, Player2, Analyst, BigWin };
+inline constexpr std::size_t kSweepBrokers = 4;
+
+struct SweepResult {
+    SweepRun run;
+    std::size_t trades{};
+    long long volume{};
+    double vwap{};                  // -1 - сделок не было
+    double lastPrice{};             // -1 - сделок не было
+    std::array<double, kSweepBrokers> pnl{};    // по SweepBroker, по рынку на конец прогона
+    double populationPnl{};         // суммарно по популяции
+    double seconds{};               // время прогона
+};
+
+SweepResult runSweepOne(const SweepRun& run);
+
+// Прогоны на threads потоках (0 - по числу ядер); результаты - в порядке runs,
+// при любом числе потоков те же.
+std::vector<SweepResult> runSweep(std::span<const SweepRun> runs, unsigned threads = 0);
+
+// таблица результатов: строка заголовка и по строке на прогон
+void writeSweepCsv(std::ostream& os, std::span<const SweepResult> results);
+// массив объектов с теми же полями
+void writeSweepJson(std::ostream& os, std::span<const SweepResult> results);
+
+#endif // SWEEP_H
@@ -7,4 +7,5 @@ public:
 
 	void step(int t) override {
 	}
+
 };
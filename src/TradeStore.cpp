@@ -0,0 +1,143 @@
+#include "TradeStore.h"
+#include "JournalRecord.h"
+#include "MappedFile.h"
+
+#include <algorithm>
+
+TradeStore::TradeStore(const TradeStoreConfig& config) : config(config) {
+    seconds.width = std::max(1, config.ticksPerSecond);
+    minutes.width = seconds.width * 60;
+}
+
+TradeStore::~TradeStore() = default;
+
+void TradeStore::setSpill(MappedFile* file) {
+    spill = file;
+}
+
+std::shared_ptr<TradeStore::Chunk> TradeStore::newChunk() {
+    if (spare) {
+        spare->size.store(0, std::memory_order_relaxed);
+        return std::move(spare);
+    }
+    // колонки не обнуляем: читатели видят только [0, size)
+    return std::shared_ptr<Chunk>(new Chunk);
+}
+
+void TradeStore::append(std::span<const Trade> trades) {
+    if (trades.empty()) return;
+    symbol = trades.front().symbol;
+
+    std::size_t i = 0;
+    while (i < trades.size()) {
+        Chunk* c = nullptr;
+        {
+            std::lock_guard<std::mutex> lk(chunksMutex);
+            if (chunks.empty() || chunks.back()->size.load(std::memory_order_relaxed) == kRows) {
+                evictOld(trades[i].executedAt);
+                chunks.push_back(newChunk());
+            }
+            c = chunks.back().get();
+        }
+        std::uint32_t n = c->size.load(std::memory_order_relaxed);
+        for (; i < trades.size() && n < kRows; ++i, ++n) {
+            const Trade& tr = trades[i];
+            c->price[n] = tr.price;
+            c->quantity[n] = tr.quantity;
+            c->buyer[n] = tr.buyerId;
+            c->seller[n] = tr.sellerId;
+            c->time[n] = tr.executedAt;
+        }
+        c->size.store(n, std::memory_order_release);
+    }
+
+    std::lock_guard<std::mutex> lk(barsMutex);
+    for (const Trade& tr : trades) {
+        addToBars(seconds, tr);
+        addToBars(minutes, tr);
+    }
+}
+
+// вызывается под chunksMutex; последний (текущий) блок не трогается
+void TradeStore::evictOld(int newest) {
+    if (config.retentionTicks <= 0) return;
+    std::size_t drop = 0;
+    while (drop < chunks.size()) {
+        const Chunk& c = *chunks[drop];
+        const std::uint32_t n = c.size.load(std::memory_order_relaxed);
+        if (n == 0 || c.time[n - 1] >= newest - config.retentionTicks) break;
+        ++drop;
+    }
+    for (std::size_t k = 0; k < drop; ++k) {
+        if (spill) spillChunk(*chunks[k]);
+        evictedRows.fetch_add(chunks[k]->size.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        // блок, который никто не читает, пойдёт под новые сделки
+        if (chunks[k].use_count() == 1) spare = std::move(chunks[k]);
+    }
+    chunks.erase(chunks.begin(), chunks.begin() + static_cast<std::ptrdiff_t>(drop));
+}
+
+void TradeStore::spillChunk(const Chunk& c) {
+    const std::uint32_t n = c.size.load(std::memory_order_relaxed);
+    for (std::uint32_t k = 0; k < n; ++k) {
+        const JournalRecord r = toJournalRecord({c.buyer[k], c.seller[k], c.price[k], c.quantity[k], c.time[k], symbol});
+        spill->append(&r);
+    }
+}
+
+void TradeStore::addToBars(Series& s, const Trade& tr) {
+    const int start = tr.executedAt - tr.executedAt % s.width;
+    if (s.open && start != s.current.start) {
+        s.closed.push_back(s.current);
+        if (s.closed.size() > config.barHistory) s.closed.pop_front();
+        s.open = false;
+    }
+    if (!s.open) {
+        s.current = {start, tr.price, tr.price, tr.price, tr.price, 0, 0};
+        s.open = true;
+    }
+    s.current.high = std::max(s.current.high, tr.price);
+    s.current.low = std::min(s.current.low, tr.price);
+    s.current.close = tr.price;
+    s.current.volume += tr.quantity;
+    ++s.current.trades;
+}
+
+std::vector<Trade> TradeStore::query(int fromTick, int toTick) const {
+    std::vector<std::shared_ptr<Chunk>> view;
+    {
+        std::lock_guard<std::mutex> lk(chunksMutex);
+        view = chunks;
+    }
+
+    std::vector<Trade> out;
+    for (const auto& c : view) {
+        const std::uint32_t n = c->size.load(std::memory_order_acquire);
+        if (n == 0) continue;
+        // блоки упорядочены по времени: пропускаем непересекающиеся целиком
+        if (c->time[n - 1] < fromTick) continue;
+        if (c->time[0] >= toTick) break;
+
+        const auto* first = c->time.data();
+        const auto* lo = std::lower_bound(first, first + n, fromTick);
+        const auto* hi = std::lower_bound(lo, first + n, toTick);
+        for (auto k = static_cast<std::size_t>(lo - first); k < static_cast<std::size_t>(hi - first); ++k)
+            out.push_back({c->buyer[k], c->seller[k], c->price[k], c->quantity[k], c->time[k], symbol});
+    }
+    return out;
+}
+
+std::vector<Bar> TradeStore::bars(BarPeriod period) const {
+    std::lock_guard<std::mutex> lk(barsMutex);
+    const Series& s = period == BarPeriod::Second ? seconds : minutes;
+    std::vector<Bar> out(s.closed.begin(), s.closed.end());
+    if (s.open) out.push_back(s.current);
+    return out;
+}
+
+std::size_t TradeStore::retained() const {
+    std::lock_guard<std::mutex> lk(chunksMutex);
+    std::size_t total = 0;
+    for (const auto& c : chunks) total += c->size.load(std::memory_order_relaxed);
+    return total;
+}
@@ -0,0 +1,99 @@
+#ifndef TRADESTORE_H
+#define TRADESTORE_H
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <vector>
+#include "Order.h"
+
+class MappedFile;
+
+enum class BarPeriod { Second, Minute };
+
+// Свеча OHLCV; start - первый тик интервала.
+struct Bar {
+    int start{};
+    double open{};
+    double high{};
+    double low{};
+    double close{};
+    long long volume{};
+    int trades{};
+};
+
+struct TradeStoreConfig {
+    int retentionTicks = 0;         // сколько тиков истории держать в памяти, 0 - всё
+    int ticksPerSecond = 50;        // ширина секундной свечи в тиках
+    std::size_t barHistory = 1440;  // закрытых свечей каждого периода
+};
+
+// Сделки одного инструмента в колонках фиксированными блоками по kRows.
+// Пишет один поток (матчинг); читатели под мьютексом только копируют список
+// блоков и дальше читают колонки без блокировок: заполненная часть блока
+// не меняется, её длину публикует атомарный size. Старые блоки вытесняются
+// по retentionTicks, при открытом spill - дописываются в файл (формат журнала сделок).
+class TradeStore final {
+public:
+    static constexpr std::size_t kRows = 4096;
+
+    explicit TradeStore(const TradeStoreConfig& config = {});
+    ~TradeStore();
+
+    TradeStore(const TradeStore&) = delete;
+    TradeStore& operator=(const TradeStore&) = delete;
+
+    // только писатель; время сделок не убывает
+    void append(std::span<const Trade> trades);
+    // куда дописывать вытесненные блоки; nullptr - просто выбрасывать
+    void setSpill(MappedFile* file);
+
+    // сделки с executedAt в [fromTick, toTick), читаются только пересекающиеся блоки
+    [[nodiscard]] std::vector<Trade> query(int fromTick, int toTick) const;
+    // закрытые свечи и текущая последней
+    [[nodiscard]] std::vector<Bar> bars(BarPeriod period) const;
+
+    [[nodiscard]] std::size_t retained() const;
+    [[nodiscard]] std::size_t evicted() const { return evictedRows.load(std::memory_order_relaxed); }
+
+private:
+    struct Chunk {
+        std::array<double, kRows> price;
+        std::array<std::int32_t, kRows> quantity;
+        std::array<std::int32_t, kRows> buyer;
+        std::array<std::int32_t, kRows> seller;
+        std::array<std::int32_t, kRows> time;
+        std::atomic<std::uint32_t> size{0};
+    };
+
+    struct Series {
+        int width{};
+        bool open = false;
+        Bar current;
+        std::deque<Bar> closed;
+    };
+
+    std::shared_ptr<Chunk> newChunk();
+    void evictOld(int newest);
+    void spillChunk(const Chunk& c);
+    void addToBars(Series& s, const Trade& tr);
+
+    TradeStoreConfig config;
+    Symbol symbol{};
+
+    mutable std::mutex chunksMutex;     // только список блоков
+    std::vector<std::shared_ptr<Chunk>> chunks;
+    std::shared_ptr<Chunk> spare;       // вытесненный блок для повторного использования
+    MappedFile* spill = nullptr;
+    std::atomic<std::size_t> evictedRows{0};
+
+    mutable std::mutex barsMutex;
+    Series seconds;
+    Series minutes;
+};
+
+#endif // TRADESTORE_H
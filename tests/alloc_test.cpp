@@ -0,0 +1,62 @@
+#include <gtest/gtest.h>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include "../src/LadderBook.h"
+
+// Отдельный бинарник: глобальный operator new подменён счётчиком.
+namespace {
+std::atomic<std::size_t> allocations{0};
+
+void* countedAlloc(std::size_t n, std::size_t align) {
+	allocations.fetch_add(1, std::memory_order_relaxed);
+	void* p = align <= alignof(std::max_align_t)
+	          ? std::malloc(n ? n : 1)
+	          : std::aligned_alloc(align, (n + align - 1) / align * align);
+	if (!p) throw std::bad_alloc();
+	return p;
+}
+}
+
+void* operator new(std::size_t n) { return countedAlloc(n, alignof(std::max_align_t)); }
+void* operator new(std::size_t n, std::align_val_t al) { return countedAlloc(n, static_cast<std::size_t>(al)); }
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+void operator delete(void* p, std::align_val_t) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept { std::free(p); }
+
+namespace {
+// один раунд: depth заявок встают в стакан, затем встречные заявки их съедают
+void churn(LadderBook& book, std::size_t& nextId, int depth) {
+	for (int i = 0; i < depth; ++i)
+		book.addOrder({1 + i % 7, OrderType::Limit, OrderSide::Buy, nextId++, 1 + i % 5, 90.0 + (i % 500) * 0.01, 0});
+	for (int i = 0; i < depth; ++i)
+		book.addOrder({8 + i % 7, OrderType::Limit, OrderSide::Sell, nextId++, 1 + i % 5, 89.0, 0});
+	Trade tr;
+	while (book.tryMatchOne(0, tr)) {}
+}
+}
+
+TEST(Allocations, LadderBookSteadyStateIsAllocationFree) {
+	LadderBook book;
+	std::size_t nextId = 1;
+
+	for (int round = 0; round < 3; ++round)
+		churn(book, nextId, 20000);
+
+	const std::size_t before = allocations.load();
+	for (int round = 0; round < 10; ++round)
+		churn(book, nextId, 20000);
+	const std::size_t after = allocations.load();
+
+	double bid{}, ask{};
+	EXPECT_FALSE(book.bestBidPrice(bid));
+	EXPECT_FALSE(book.bestAskPrice(ask));
+	EXPECT_EQ(after - before, 0u) << "allocations per order must be zero in steady state";
+}
+
+TEST(Allocations, CounterSeesAllocations) {
+	const std::size_t before = allocations.load();
+	auto p = std::make_unique<int>(1);
+	EXPECT_GT(allocations.load(), before);
+}
@@ -1,8 +1,48 @@
 #include <gtest/gtest.h>
+#include <array>
+#include <chrono>
+#include <climits>
+#include <cmath>
+#include <iostream>
+#include <numeric>
+#include <algorithm>
+#include <filesystem>
+#include <random>
+#include <set>
+#include <sstream>
+#include <unordered_map>
 #include <thread>
+#include <vector>
+#include <unistd.h>
 #include "../src/Exchange.h"
 #include "../src/Broker.h"
 #include "../src/TestBroker.h"
+#include "../src/OrderBook.h"
+#include "../src/LadderBook.h"
+#include "../src/FairPrice.h"
+#include "../src/MpscRing.h"
+#include "../src/Seqlock.h"
+#include "../src/FlatIndex.h"
+#include "../src/SlabPool.h"
+#include "../src/SpscRing.h"
+#include "../src/JournalRecord.h"
+#include "../src/MappedFile.h"
+#include "../src/Replay.h"
+#include "../src/AccountTable.h"
+#include "../src/StrategyScheduler.h"
+#include "../src/MarketData.h"
+#include "../src/TradeStore.h"
+#include "../src/RiskEngine.h"
+#include "../src/RiskGate.h"
+#include "../src/Stats.h"
+#include "../src/CounterRng.h"
+#include "../src/Population.h"
+#include "../src/Simulation.h"
+#include "../src/Snapshot.h"
+#include "../src/Auction.h"
+#include "../src/Gateway.h"
+#include "../src/GatewayClient.h"
+#include "../src/Sweep.h"
 
 class ExchangeTest : public ::testing::Test {
 protected:
@@ -187,10 +227,2664 @@ TEST(Integration, MultiBrokerMarketLives) {
 	EXPECT_GT(ex.fairPriceEstimate(), 0);
 }
 
+TEST(LadderBook, PriceTimePriority) {
+	LadderBook book;
 
+	book.addOrder({1, OrderType::Limit, OrderSide::Sell, 1, 5, 101, 0});
+	book.addOrder({2, OrderType::Limit, OrderSide::Sell, 2, 5, 100, 0});
+	book.addOrder({3, OrderType::Limit, OrderSide::Sell, 3, 5, 100, 0});
+	book.addOrder({4, OrderType::Limit, OrderSide::Buy,  4, 12, 101, 0});
 
+	Trade tr;
+	ASSERT_TRUE(book.tryMatchOne(0, tr));
+	EXPECT_EQ(tr.sellerId, 2);
+	EXPECT_EQ(tr.price, 100);
+	ASSERT_TRUE(book.tryMatchOne(0, tr));
+	EXPECT_EQ(tr.sellerId, 3);
+	ASSERT_TRUE(book.tryMatchOne(0, tr));
+	EXPECT_EQ(tr.sellerId, 1);
+	EXPECT_EQ(tr.quantity, 2);
+	EXPECT_EQ(tr.price, 101);
+	EXPECT_FALSE(book.tryMatchOne(0, tr));
 
+	double bid{}, ask{};
+	EXPECT_FALSE(book.bestBidPrice(bid));
+	ASSERT_TRUE(book.bestAskPrice(ask));
+	EXPECT_EQ(ask, 101);
+}
+
+TEST(LadderBook, BestPriceMovesWhenLevelEmpties) {
+	LadderBook book;
+
+	book.addOrder({1, OrderType::Limit, OrderSide::Buy, 1, 1, 99.5, 0});
+	book.addOrder({1, OrderType::Limit, OrderSide::Buy, 2, 1, 97.25, 0});
+	book.addOrder({2, OrderType::Limit, OrderSide::Sell, 3, 1, 90, 0});
+
+	Trade tr;
+	ASSERT_TRUE(book.tryMatchOne(0, tr));
+	double bid{};
+	ASSERT_TRUE(book.bestBidPrice(bid));
+	EXPECT_EQ(bid, 97.25);
+}
+
+TEST(LadderBook, WindowGrowsToFarPrices) {
+	LadderBook book;
+
+	book.addOrder({1, OrderType::Limit, OrderSide::Buy, 1, 1, 100, 0});
+	book.addOrder({1, OrderType::Limit, OrderSide::Buy, 2, 1, 1, 0});
+	book.addOrder({2, OrderType::Limit, OrderSide::Sell, 3, 1, 5000, 0});
+	book.addOrder({2, OrderType::Limit, OrderSide::Sell, 4, 1, 1e9, 0});
+
+	EXPECT_EQ(book.rejectedCount(), 1u);
+
+	double bid{}, ask{};
+	ASSERT_TRUE(book.bestBidPrice(bid));
+	ASSERT_TRUE(book.bestAskPrice(ask));
+	EXPECT_EQ(bid, 100);
+	EXPECT_EQ(ask, 5000);
+
+	book.addOrder({2, OrderType::Limit, OrderSide::Sell, 5, 2, 1, 0});
+	Trade tr;
+	ASSERT_TRUE(book.tryMatchOne(0, tr));
+	ASSERT_TRUE(book.tryMatchOne(0, tr));
+	EXPECT_EQ(tr.price, 1);
+	EXPECT_FALSE(book.bestBidPrice(bid));
+}
+
+TEST(LadderBook, MatchesMapBookOnSameFlow) {
+	OrderBook mapBook;
+	LadderBook ladder;
+
+	std::mt19937 rng(7);
+	std::uniform_int_distribution<int> tick(9300, 10700);
+	std::uniform_int_distribution<int> qty(1, 10);
+	std::uniform_int_distribution<int> broker(1, 8);
+
+	for (std::size_t id = 1; id <= 20000; ++id) {
+		Order o{broker(rng), OrderType::Limit, (rng() & 1) ? OrderSide::Buy : OrderSide::Sell,
+		        id, qty(rng), tick(rng) / 100.0, static_cast<int>(id)};
+		mapBook.addOrder(o);
+		ladder.addOrder(o);
+
+		Trade a, b;
+		while (true) {
+			const bool ma = mapBook.tryMatchOne(0, a);
+			const bool mb = ladder.tryMatchOne(0, b);
+			ASSERT_EQ(ma, mb);
+			if (!ma) break;
+			ASSERT_EQ(a.buyerId, b.buyerId);
+			ASSERT_EQ(a.sellerId, b.sellerId);
+			ASSERT_EQ(a.quantity, b.quantity);
+			ASSERT_EQ(a.price, b.price);
+		}
+
+		double pa{}, pb{};
+		ASSERT_EQ(mapBook.bestBidPrice(pa), ladder.bestBidPrice(pb));
+		EXPECT_EQ(pa, pb);
+		ASSERT_EQ(mapBook.bestAskPrice(pa), ladder.bestAskPrice(pb));
+		EXPECT_EQ(pa, pb);
+	}
+}
+
+TEST(LadderBook, ExchangeRunsOnLadder) {
+	Exchange ex(ExchangeConfig{.book = BookKind::Ladder});
+	ex.setFee(0.0, 0);
+
+	ex.submitOrder({1, OrderType::Limit, OrderSide::Buy,  0, 5, 100, 0});
+	ex.submitOrder({2, OrderType::Limit, OrderSide::Sell, 0, 5,  99, 0});
+
+	double bid{}, ask{};
+	EXPECT_TRUE(ex.bestBidPrice(bid));
+	EXPECT_TRUE(ex.bestAskPrice(ask));
+
+	std::thread t([&]{ ex.runLoop(); });
+	std::this_thread::sleep_for(std::chrono::milliseconds(50));
+	ex.stop();
+	t.join();
+
+	EXPECT_EQ(ex.fairPriceEstimate(), 99);
+}
+
+TEST(FairPrice, EmptyUntilFirstTrade) {
+	FairPrice fp(10, 0.5);
+	EXPECT_LT(fp.value(FairPriceKind::Vwap), 0);
+	EXPECT_LT(fp.value(FairPriceKind::WindowVwap), 0);
+	EXPECT_LT(fp.value(FairPriceKind::Ewma), 0);
+}
+
+TEST(FairPrice, CumulativeWindowAndEwma) {
+	FairPrice fp(10, 0.5);
+
+	fp.onTrade({1, 2, 100, 1, 0});
+	fp.onTrade({1, 2, 110, 3, 5});
+	EXPECT_DOUBLE_EQ(fp.value(FairPriceKind::Vwap), 107.5);
+	EXPECT_DOUBLE_EQ(fp.value(FairPriceKind::WindowVwap), 107.5);
+	EXPECT_DOUBLE_EQ(fp.value(FairPriceKind::Ewma), 105);
+
+	// сделка на t=0 выпадает из окна [3, 12]
+	fp.onTrade({1, 2, 120, 1, 12});
+	EXPECT_DOUBLE_EQ(fp.value(FairPriceKind::Vwap), (100 + 330 + 120) / 5.0);
+	EXPECT_DOUBLE_EQ(fp.value(FairPriceKind::WindowVwap), (330 + 120) / 4.0);
+	EXPECT_DOUBLE_EQ(fp.value(FairPriceKind::Ewma), 112.5);
+
+	fp.onTrade({1, 2, 90, 2, 100});
+	EXPECT_DOUBLE_EQ(fp.value(FairPriceKind::WindowVwap), 90);
+}
+
+TEST(FairPrice, WindowExpiresWithoutTrades) {
+	FairPrice fp(10, 0.5);
+	fp.onTrade({1, 2, 100, 1, 0});
+	fp.onTrade({1, 2, 110, 1, 4});
+	EXPECT_FALSE(fp.advance(9));
+	EXPECT_DOUBLE_EQ(fp.value(FairPriceKind::WindowVwap), 105);
+	EXPECT_TRUE(fp.advance(10));     // t=0 выпала из окна [1, 10]
+	EXPECT_DOUBLE_EQ(fp.value(FairPriceKind::WindowVwap), 110);
+	EXPECT_TRUE(fp.advance(20));
+	EXPECT_LT(fp.value(FairPriceKind::WindowVwap), 0);
+	EXPECT_DOUBLE_EQ(fp.value(FairPriceKind::Vwap), 105);
+	EXPECT_DOUBLE_EQ(fp.value(FairPriceKind::Ewma), 105);
+
+	// новая сделка открывает окно заново
+	fp.onTrade({1, 2, 90, 2, 25});
+	EXPECT_DOUBLE_EQ(fp.value(FairPriceKind::WindowVwap), 90);
+}
+
+TEST(FairPrice, ExchangeWindowExpiresOnIdleTicks) {
+	Exchange ex(ExchangeConfig{.fairWindowTicks = 5});
+	ex.setFee(0.0, 0);
+	ex.submitOrder({1, OrderType::Limit, OrderSide::Buy,  0, 5, 100, 0});
+	ex.submitOrder({2, OrderType::Limit, OrderSide::Sell, 0, 5, 100, 0});
+	ex.advanceTick();
+	EXPECT_DOUBLE_EQ(ex.fairPriceEstimate(FairPriceKind::WindowVwap), 100);
+
+	for (int i = 0; i < 5; ++i) ex.advanceTick();
+	EXPECT_LT(ex.fairPriceEstimate(FairPriceKind::WindowVwap), 0);
+	EXPECT_LT(ex.quote().fairPrice(FairPriceKind::WindowVwap), 0);
+	EXPECT_DOUBLE_EQ(ex.fairPriceEstimate(FairPriceKind::Vwap), 100);
+}
+
+TEST(FairPrice, ExchangePublishesAllEstimators) {
+	Exchange ex(ExchangeConfig{.fairWindowTicks = 1000, .fairEwmaAlpha = 1.0});
+	ex.setFee(0.0, 0);
+
+	ex.submitOrder({1, OrderType::Limit, OrderSide::Buy,  0, 5, 100, 0});
+	ex.submitOrder({2, OrderType::Limit, OrderSide::Sell, 0, 5,  99, 0});
+
+	std::thread t([&]{ ex.runLoop(); });
+	std::this_thread::sleep_for(std::chrono::milliseconds(50));
+	ex.stop();
+	t.join();
+
+	EXPECT_EQ(ex.fairPriceEstimate(), 99);
+	EXPECT_EQ(ex.fairPriceEstimate(FairPriceKind::WindowVwap), 99);
+	EXPECT_EQ(ex.fairPriceEstimate(FairPriceKind::Ewma), 99);
+}
+
+TEST(MpscRing, ManyProducersNothingLostOrReordered) {
+	constexpr int kProducers = 4;
+	constexpr int kPerProducer = 50000;
+	MpscRing<std::pair<int, int>> ring(1024);
+
+	std::vector<std::thread> producers;
+	for (int p = 0; p < kProducers; ++p)
+		producers.emplace_back([&, p] {
+			for (int i = 0; i < kPerProducer; ++i)
+				while (!ring.tryPush({p, i})) std::this_thread::yield();
+		});
+
+	std::vector<int> next(kProducers, 0);
+	int received = 0;
+	while (received < kProducers * kPerProducer) {
+		std::pair<int, int> v;
+		if (!ring.tryPop(v)) {
+			std::this_thread::yield();
+			continue;
+		}
+		ASSERT_EQ(v.second, next[v.first]);
+		++next[v.first];
+		++received;
+	}
+	for (auto& t : producers) t.join();
+	EXPECT_TRUE(ring.empty());
+}
+
+TEST(MpscRing, FullRingRejects) {
+	MpscRing<int> ring(4);
+	for (int i = 0; i < 4; ++i) EXPECT_TRUE(ring.tryPush(i));
+	EXPECT_FALSE(ring.tryPush(4));
+
+	int v{};
+	ASSERT_TRUE(ring.tryPop(v));
+	EXPECT_EQ(v, 0);
+	EXPECT_TRUE(ring.tryPush(4));
+}
+
+TEST(ExchangeIngress, OverflowIsCounted) {
+	Exchange ex(ExchangeConfig{.ingressCapacity = 4});
+	ex.setFee(0.0, 0);
+
+	std::thread t([&]{ ex.runLoop(); });
+	std::this_thread::sleep_for(std::chrono::milliseconds(5));
+
+	int rejected = 0;
+	for (int i = 0; i < 64; ++i)
+		if (!ex.trySubmitOrder({1, OrderType::Limit, OrderSide::Buy, 0, 1, 100, 0})) ++rejected;
+
+	ex.stop();
+	t.join();
+
+	const IngressStats st = ex.ingressStats();
+	EXPECT_EQ(st.overflows, static_cast<std::size_t>(rejected));
+	EXPECT_EQ(st.drained, static_cast<std::size_t>(64 - rejected));
+}
+
+TEST(ExchangeIngress, SubmitRacingStopIsNeverStranded) {
+	// заявки, принятые во время остановки, попадают в стакан: либо последним проходом, либо напрямую
+	for (int round = 0; round < 20; ++round) {
+		Exchange ex(ExchangeConfig{.ingressCapacity = 16});
+		ex.setFee(0.0, 0);
+		std::thread loop([&]{ ex.runLoop(); });
+
+		std::atomic<long long> accepted{0};
+		std::atomic<bool> done{false};
+		std::vector<std::thread> threads;
+		for (int p = 0; p < 3; ++p)
+			threads.emplace_back([&, p] {
+				while (!done.load(std::memory_order_relaxed))
+					if (ex.submitOrder({p + 1, OrderType::Limit, OrderSide::Buy, 0, 1, 100, 0})) ++accepted;
+			});
+		std::this_thread::sleep_for(std::chrono::milliseconds(2));
+		ex.stop();
+		loop.join();
+		done = true;
+		for (auto& t : threads) t.join();
+
+		ASSERT_EQ(ex.quote().bidSize, accepted.load()) << "round " << round;
+	}
+}
+
+TEST(ExchangeIngress, SubmitThroughputByProducerCount) {
+	constexpr int kPerProducer = 100000;
+
+	for (const int producers : {1, 2, 4}) {
+		Exchange ex(ExchangeConfig{.book = BookKind::Ladder});
+		ex.setFee(0.0, 0);
+		std::thread loop([&]{ ex.runLoop(); });
+		std::this_thread::sleep_for(std::chrono::milliseconds(5));
+
+		const auto start = std::chrono::steady_clock::now();
+		std::vector<std::thread> threads;
+		for (int p = 0; p < producers; ++p)
+			threads.emplace_back([&, p] {
+				for (int i = 0; i < kPerProducer; ++i)
+					ex.submitOrder({p + 1, OrderType::Limit, (i & 1) ? OrderSide::Buy : OrderSide::Sell,
+					                0, 1, 100, 0});
+			});
+		for (auto& t : threads) t.join();
+		const double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		ex.stop();
+		loop.join();
+
+		const IngressStats st = ex.ingressStats();
+		EXPECT_EQ(st.drained, static_cast<std::size_t>(producers) * kPerProducer);
+		EXPECT_EQ(st.overflows, 0u);
+
+		const double rate = producers * kPerProducer / sec;
+		std::cout << "[ingress] producers=" << producers << " orders/s=" << static_cast<long long>(rate)
+		          << " stalls=" << st.stalls << "\n";
+		RecordProperty("orders_per_sec_" + std::to_string(producers), static_cast<int>(rate));
+	}
+}
+
+TEST(Seqlock, ReadersNeverSeeTornSnapshot) {
+	struct Pair { long long a; long long b; double c; };
+	Seqlock<Pair> lock;
+	std::atomic<bool> done{false};
+
+	std::thread writer([&] {
+		for (long long i = 1; i <= 200000; ++i)
+			lock.store({i, -i, static_cast<double>(i) * 2});
+		done = true;
+	});
+
+	std::vector<std::thread> readers;
+	std::atomic<int> torn{0};
+	for (int r = 0; r < 3; ++r)
+		readers.emplace_back([&] {
+			while (!done) {
+				const Pair p = lock.load();
+				if (p.a != -p.b || p.c != static_cast<double>(p.a) * 2) ++torn;
+			}
+		});
+
+	writer.join();
+	for (auto& t : readers) t.join();
+	EXPECT_EQ(torn.load(), 0);
+
+	std::uint64_t version = 0;
+	EXPECT_EQ(lock.load(&version).a, 200000);
+	EXPECT_EQ(version, 200000u);
+}
+
+TEST(QuoteSnapshot, PublishedBeforeAndDuringRun) {
+	Exchange ex(ExchangeConfig{.book = BookKind::Ladder});
+	ex.setFee(0.0, 0);
+
+	EXPECT_EQ(ex.quote().sequence, 0u);
+
+	ex.submitOrder({1, OrderType::Limit, OrderSide::Buy,  0, 5, 100, 0});
+	ex.submitOrder({1, OrderType::Limit, OrderSide::Buy,  0, 2, 100, 0});
+	ex.submitOrder({2, OrderType::Limit, OrderSide::Sell, 0, 4, 101, 0});
+
+	QuoteSnapshot q = ex.quote();
+	EXPECT_GT(q.sequence, 0u);
+	ASSERT_TRUE(q.hasBid && q.hasAsk);
+	EXPECT_EQ(q.bid, 100);
+	EXPECT_EQ(q.bidSize, 7);
+	EXPECT_EQ(q.ask, 101);
+	EXPECT_EQ(q.askSize, 4);
+	EXPECT_LT(q.lastPrice, 0);
+
+	std::thread t([&]{ ex.runLoop(); });
+	std::this_thread::sleep_for(std::chrono::milliseconds(5));
+	ex.submitOrder({3, OrderType::Limit, OrderSide::Sell, 0, 6, 100, 0});
+	std::this_thread::sleep_for(std::chrono::milliseconds(60));
+	ex.stop();
+	t.join();
+
+	q = ex.quote();
+	EXPECT_EQ(q.bidSize, 1);
+	EXPECT_EQ(q.lastPrice, 100);
+	EXPECT_EQ(q.lastQuantity, 1);
+	EXPECT_EQ(q.fairPrice(FairPriceKind::Vwap), 100);
+}
+
+TEST(FlatIndex, MatchesUnorderedMap) {
+	FlatIndex<int> idx(16);
+	std::unordered_map<std::size_t, int> ref;
+	std::mt19937 rng(3);
+	std::uniform_int_distribution<std::size_t> key(1, 5000);
+
+	for (int i = 0; i < 200000; ++i) {
+		const std::size_t k = key(rng);
+		if (rng() % 3 == 0) {
+			EXPECT_EQ(idx.erase(k), ref.erase(k) == 1);
+		} else {
+			idx.insert(k, i);
+			ref[k] = i;
+		}
+	}
+	ASSERT_EQ(idx.size(), ref.size());
+	for (std::size_t k = 1; k <= 5000; ++k) {
+		const int* v = idx.find(k);
+		auto it = ref.find(k);
+		ASSERT_EQ(v != nullptr, it != ref.end());
+		if (v) {
+			EXPECT_EQ(*v, it->second);
+		}
+	}
+	EXPECT_EQ(idx.find(0), nullptr);
+}
+
+TEST(SlabPool, HandlesAreStableAndReused) {
+	SlabPool<long long, 4> pool;
+	std::vector<SlabPool<long long, 4>::Handle> hs;
+	for (int i = 0; i < 10; ++i) {
+		hs.push_back(pool.allocate());
+		pool[hs.back()] = i;
+	}
+	const long long* third = &pool[hs[3]];
+	for (int i = 0; i < 10; ++i) EXPECT_EQ(pool[hs[i]], i);
+	EXPECT_EQ(third, &pool[hs[3]]);
+
+	pool.release(hs[5]);
+	EXPECT_EQ(pool.live(), 9u);
+	EXPECT_EQ(pool.allocate(), hs[5]);
+	EXPECT_EQ(pool.capacity(), 12u);
+}
+
+namespace {
+// задержка submit -> trade: встречная заявка отправляется, пока цикл матчинга ждёт
+std::vector<double> submitToTradeLatencyUs(WakeMode mode, int samples) {
+	Exchange ex(ExchangeConfig{.wake = mode});
+	ex.setFee(0.0, 0);
+	std::thread loop([&]{ ex.runLoop(); });
+	std::this_thread::sleep_for(std::chrono::milliseconds(5));
+
+	std::vector<double> us;
+	for (int i = 0; i < samples; ++i) {
+		ex.submitOrder({1, OrderType::Limit, OrderSide::Buy, 0, 1, 100, 0});
+		const std::size_t before = ex.tradeCount();
+		// даём матчеру уснуть, чтобы мерить именно пробуждение
+		std::this_thread::sleep_for(std::chrono::microseconds(200 + (i * 977) % 3000));
+
+		const auto start = std::chrono::steady_clock::now();
+		ex.submitOrder({2, OrderType::Limit, OrderSide::Sell, 0, 1, 100, 0});
+		while (ex.tradeCount() == before) std::this_thread::yield();
+		us.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count());
+	}
+
+	ex.stop();
+	loop.join();
+	std::sort(us.begin(), us.end());
+	return us;
+}
+
+double percentile(const std::vector<double>& sorted, double p) {
+	return sorted[static_cast<std::size_t>(p * static_cast<double>(sorted.size() - 1))];
+}
+}
+
+TEST(ExchangeWakeup, SubmitToTradeLatencyByMode) {
+	const std::pair<WakeMode, const char*> modes[] = {
+		{WakeMode::Poll, "poll"}, {WakeMode::Event, "event"}, {WakeMode::Spin, "spin"}};
+
+	for (const auto& [mode, name] : modes) {
+		const auto us = submitToTradeLatencyUs(mode, 60);
+		ASSERT_EQ(us.size(), 60u);
+		std::cout << "[latency] mode=" << name
+		          << " p50=" << percentile(us, 0.50) << "us"
+		          << " p90=" << percentile(us, 0.90) << "us"
+		          << " p99=" << percentile(us, 0.99) << "us\n";
+		RecordProperty(std::string("p50_us_") + name, static_cast<int>(percentile(us, 0.50)));
+		RecordProperty(std::string("p99_us_") + name, static_cast<int>(percentile(us, 0.99)));
+	}
+}
+
+TEST(ExchangeWakeup, TickClockRunsIndependentlyOfWakeups) {
+	Exchange ex(ExchangeConfig{.tick = std::chrono::milliseconds(5)});
+	ex.setFee(0.0, 0);
+	std::thread loop([&]{ ex.runLoop(); });
+
+	ex.submitOrder({1, OrderType::Limit, OrderSide::Buy, 0, 1, 100, 0});
+	// без заявок матчер спит, а часы всё равно идут: за 60 мс около 12 тиков по 5 мс
+	const int idleFrom = ex.tick();
+	const auto sleepStart = std::chrono::steady_clock::now();
+	std::this_thread::sleep_for(std::chrono::milliseconds(60));
+	const auto slept = std::chrono::steady_clock::now() - sleepStart;
+	const int idleTicks = ex.tick() - idleFrom;
+	EXPECT_GE(idleTicks, 6);
+	EXPECT_LE(idleTicks, static_cast<int>(slept / std::chrono::milliseconds(5)) + 2);
+
+	const std::size_t before = ex.tradeCount();
+	ex.submitOrder({2, OrderType::Limit, OrderSide::Sell, 0, 1, 100, 0});
+	while (ex.tradeCount() == before) std::this_thread::yield();
+
+	ex.stop();
+	loop.join();
+	EXPECT_EQ(ex.tradeCount(), 1u);
+	EXPECT_GE(ex.tradesBetween(0, INT_MAX).front().executedAt, idleFrom + idleTicks);
+}
+
+TEST(MatchAll, SweepsManyLevelsInOnePass) {
+	for (const BookKind kind : {BookKind::Map, BookKind::Ladder}) {
+		auto book = makeBook(kind, 100);
+		for (int i = 0; i < 50; ++i)
+			book->addOrder({2, OrderType::Limit, OrderSide::Sell, static_cast<std::size_t>(i + 1), 2, 100.0 + i, 0});
+		book->addOrder({1, OrderType::Limit, OrderSide::Buy, 100, 90, 200, 0});
+
+		std::vector<Trade> out(16);
+		std::size_t total = 0, n = 0;
+		double vol = 0;
+		while ((n = book->matchAll(7, out)) > 0) {
+			EXPECT_LE(n, out.size());
+			for (std::size_t i = 0; i < n; ++i) {
+				EXPECT_EQ(out[i].executedAt, 7);
+				vol += out[i].quantity;
+			}
+			total += n;
+		}
+		EXPECT_EQ(total, 45u);
+		EXPECT_EQ(vol, 90);
+
+		double ask{};
+		ASSERT_TRUE(book->bestAskPrice(ask));
+		EXPECT_EQ(ask, 145);
+	}
+}
+
+TEST(MatchAll, SelfTradePolicies) {
+	for (const BookKind kind : {BookKind::Map, BookKind::Ladder}) {
+		auto oldest = makeBook(kind, 100, SelfTradePolicy::CancelOldest);
+		auto newest = makeBook(kind, 100, SelfTradePolicy::CancelNewest);
+		for (Book* b : {oldest.get(), newest.get()}) {
+			b->addOrder({1, OrderType::Limit, OrderSide::Sell, 1, 5, 100, 0});
+			b->addOrder({2, OrderType::Limit, OrderSide::Sell, 2, 5, 101, 0});
+			b->addOrder({1, OrderType::Limit, OrderSide::Buy,  3, 5, 101, 0});
+		}
+
+		std::vector<Trade> out(8);
+		// снята старая продажа брокера 1, покупка сводится с брокером 2
+		ASSERT_EQ(oldest->matchAll(0, out), 1u);
+		EXPECT_EQ(out[0].sellerId, 2);
+		EXPECT_EQ(out[0].price, 101);
+		EXPECT_EQ(oldest->selfTradeCancels(), 1u);
+
+		// снята новая покупка, продажи остались
+		EXPECT_EQ(newest->matchAll(0, out), 0u);
+		EXPECT_EQ(newest->selfTradeCancels(), 1u);
+		double bid{}, ask{};
+		EXPECT_FALSE(newest->bestBidPrice(bid));
+		ASSERT_TRUE(newest->bestAskPrice(ask));
+		EXPECT_EQ(ask, 100);
+	}
+}
+
+TEST(MatchAll, ExchangeCountsSelfTradeCancels) {
+	Exchange ex;
+	ex.setFee(0.0, 0);
+	ex.submitOrder({1, OrderType::Limit, OrderSide::Buy,  0, 5, 100, 0});
+	ex.submitOrder({1, OrderType::Limit, OrderSide::Sell, 0, 5,  99, 0});
+
+	std::thread t([&]{ ex.runLoop(); });
+	std::this_thread::sleep_for(std::chrono::milliseconds(30));
+	ex.stop();
+	t.join();
+
+	EXPECT_EQ(ex.tradeCount(), 0u);
+	EXPECT_EQ(ex.selfTradeCancels(), 1u);
+	// CancelOldest: покупка снята, продажа осталась
+	const QuoteSnapshot q = ex.quote();
+	EXPECT_FALSE(q.hasBid);
+	EXPECT_TRUE(q.hasAsk);
+}
+
+TEST(SpscRing, PreservesOrderAcrossThreads) {
+	SpscRing<int> ring(64);
+	constexpr int kCount = 200000;
+
+	std::thread producer([&] {
+		for (int i = 0; i < kCount; ++i)
+			while (!ring.tryPush(i)) std::this_thread::yield();
+	});
+
+	for (int expected = 0; expected < kCount;) {
+		int v{};
+		if (!ring.tryPop(v)) {
+			std::this_thread::yield();
+			continue;
+		}
+		ASSERT_EQ(v, expected++);
+	}
+	producer.join();
+	EXPECT_TRUE(ring.empty());
+}
+
+TEST(Journal, PrintsLegacyTradeFormat) {
+	std::ostringstream os;
+	printRecord(os, toJournalRecord({3, 4, 101.5, 7, 12}));
+	EXPECT_EQ(os.str(), "[t=12] TRADE: buyer=3 seller=4 qty=7 price=101.5\n");
+}
+
+TEST(Journal, ExchangeWritesBinaryJournal) {
+	const auto path = (std::filesystem::temp_directory_path() / "stock_journal_test.bin").string();
+	std::filesystem::remove(path);
+	{
+		Exchange ex;
+		ex.setFee(0.0, 0);
+		ex.setConsoleOutput(false);
+		ASSERT_TRUE(ex.openJournal(path));
+
+		ex.submitOrder({1, OrderType::Limit, OrderSide::Sell, 0, 2, 100, 0});
+		ex.submitOrder({2, OrderType::Limit, OrderSide::Sell, 0, 3, 101, 0});
+		ex.submitOrder({3, OrderType::Limit, OrderSide::Buy,  0, 5, 102, 0});
+
+		std::thread t([&]{ ex.runLoop(); });
+		while (ex.tradeCount() < 2) std::this_thread::yield();
+		ex.stop();
+		t.join();
+		EXPECT_EQ(ex.journalDropped(), 0u);
+	}
+
+	MappedFileReader reader;
+	ASSERT_TRUE(reader.open(path, kJournalMagic, kJournalVersion, sizeof(JournalRecord)));
+	const auto recs = reader.records<JournalRecord>();
+	ASSERT_EQ(recs.size(), 2u);
+	EXPECT_EQ(recs[0].sellerId, 1);
+	EXPECT_EQ(recs[0].quantity, 2);
+	EXPECT_EQ(recs[0].price, 100);
+	EXPECT_EQ(recs[1].sellerId, 2);
+	EXPECT_EQ(recs[1].buyerId, 3);
+	EXPECT_EQ(recs[1].price, 101);
+	std::filesystem::remove(path);
+}
+
+TEST(Journal, PushWaitLosesNothingWhenRingIsFull) {
+	const auto path = (std::filesystem::temp_directory_path() / "stock_journal_wait.bin").string();
+	std::filesystem::remove(path);
+	{
+		Journal<long long> j(64);
+		ASSERT_TRUE(j.open(path, "TESTWAI", 1));
+		// без фонового потока кольцо разбирает сам производитель
+		long long v = 0;
+		for (; v < 1000; ++v) j.pushWait(v);
+		j.start();
+		for (; v < 20000; ++v) j.pushWait(v);
+		EXPECT_TRUE(j.close());
+		EXPECT_EQ(j.droppedCount(), 0u);
+	}
+	MappedFileReader reader;
+	ASSERT_TRUE(reader.open(path, "TESTWAI", 1, sizeof(long long)));
+	const auto recs = reader.records<long long>();
+	ASSERT_EQ(recs.size(), 20000u);
+	for (std::size_t i = 0; i < recs.size(); ++i) ASSERT_EQ(recs[i], static_cast<long long>(i));
+	std::filesystem::remove(path);
+}
+
+TEST(Journal, AppendsToExistingFile) {
+	const auto path = (std::filesystem::temp_directory_path() / "stock_mapped_append.bin").string();
+	std::filesystem::remove(path);
+	for (int session = 0; session < 2; ++session) {
+		MappedFile f;
+		ASSERT_TRUE(f.open(path, "TESTMAG", 1, sizeof(long long)));
+		for (long long i = 0; i < 1000; ++i) {
+			const long long v = session * 1000 + i;
+			ASSERT_TRUE(f.append(&v));
+		}
+		EXPECT_TRUE(f.close());
+		EXPECT_EQ(f.lostRecords(), 0u);
+		EXPECT_EQ(std::filesystem::file_size(path), sizeof(MappedFileHeader) + (session + 1) * 1000 * sizeof(long long));
+	}
+
+	MappedFileReader reader;
+	ASSERT_TRUE(reader.open(path, "TESTMAG", 1, sizeof(long long)));
+	const auto recs = reader.records<long long>();
+	ASSERT_EQ(recs.size(), 2000u);
+	for (long long i = 0; i < 2000; ++i) EXPECT_EQ(recs[static_cast<std::size_t>(i)], i);
+	EXPECT_FALSE(reader.open(path, "OTHER", 1, sizeof(long long)));
+	std::filesystem::remove(path);
+}
+
+TEST(Replay, CapturedSessionReplaysBitExact) {
+	const auto dir = std::filesystem::temp_directory_path();
+	const auto capturePath = (dir / "stock_replay_capture.bin").string();
+	const auto journalPath = (dir / "stock_replay_journal.bin").string();
+	std::filesystem::remove(capturePath);
+	std::filesystem::remove(journalPath);
+
+	{
+		// не значения по умолчанию: replay должен взять их из заголовка записи
+		Exchange ex(ExchangeConfig{.book = BookKind::Ladder, .ticksPerUnit = 20, .selfTrade = SelfTradePolicy::CancelNewest});
+		ex.setFee(0.0, 0);
+		ex.setConsoleOutput(false);
+		ASSERT_TRUE(ex.openCapture(capturePath));
+		ASSERT_TRUE(ex.openJournal(journalPath));
+
+		// стартовый стакан кладётся напрямую и тоже попадает в запись
+		ex.submitOrder({9, OrderType::Limit, OrderSide::Sell, 0, 20, 100, 0});
+		ex.submitOrder({9, OrderType::Limit, OrderSide::Buy,  0, 20,  99, 0});
+
+		auto p1 = std::make_shared<PlayerBroker>(1, 10000, 50, ex);
+		auto p2 = std::make_shared<PlayerBroker>(2, 10000, 50, ex);
+		auto a  = std::make_shared<AnalystBroker>(3, 10000, 50, ex);
+		ex.registerBroker(p1);
+		ex.registerBroker(p2);
+		ex.registerBroker(a);
+
+		std::atomic<bool> alive{true};
+		std::thread exT([&]{ ex.runLoop(); });
+		auto run = [&](std::shared_ptr<Broker> br) {
+			for (int t = 0; alive; ++t) {
+				br->step(t);
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			}
+		};
+		std::thread t1(run, p1), t2(run, p2), t3(run, a);
+		std::this_thread::sleep_for(std::chrono::milliseconds(300));
+		alive = false;
+		t1.join(); t2.join(); t3.join();
+		ex.stop();
+		exT.join();
+		EXPECT_EQ(ex.journalDropped(), 0u);
+	}
+
+	MappedFileReader journal;
+	ASSERT_TRUE(journal.open(journalPath, kJournalMagic, kJournalVersion, sizeof(JournalRecord)));
+	std::uint64_t live = kChecksumSeed;
+	for (const JournalRecord& r : journal.records<JournalRecord>())
+		live = tradeChecksum(live, {r.buyerId, r.sellerId, r.price, r.quantity, r.executedAt});
+	ASSERT_GT(journal.records<JournalRecord>().size(), 0u);
+
+	MappedFileReader capture;
+	ASSERT_TRUE(capture.open(capturePath, kCaptureMagic, kCaptureVersion, sizeof(CaptureRecord)));
+	const auto records = capture.records<CaptureRecord>();
+	for (std::size_t i = 0; i < records.size(); ++i) ASSERT_EQ(records[i].seq, i + 1);
+
+	CaptureMeta meta;
+	ASSERT_TRUE(captureMeta(capture, meta));
+	EXPECT_EQ(meta.ticksPerUnit, 20);
+	EXPECT_EQ(meta.book, BookKind::Ladder);
+	EXPECT_EQ(meta.selfTrade, SelfTradePolicy::CancelNewest);
+
+	for (int run = 0; run < 2; ++run) {
+		auto book = makeBook(meta.book, meta.ticksPerUnit, meta.selfTrade);
+		const ReplayResult r = replay(records, *book);
+		EXPECT_EQ(r.trades, journal.records<JournalRecord>().size());
+		EXPECT_EQ(r.checksum, live);
+	}
+
+	std::filesystem::remove(capturePath);
+	std::filesystem::remove(journalPath);
+}
+
+TEST(MultiInstrument, BooksAreIsolated) {
+	Exchange ex(ExchangeConfig{.instruments = 2});
+	ex.setFee(0.0, 0);
+	ex.submitOrder({1, OrderType::Limit, OrderSide::Buy,  0, 5, 100, 0, 0});
+	ex.submitOrder({2, OrderType::Limit, OrderSide::Sell, 0, 5,  99, 0, 1});
+
+	std::thread t([&]{ ex.runLoop(); });
+	std::this_thread::sleep_for(std::chrono::milliseconds(30));
+	ex.stop();
+	t.join();
+
+	EXPECT_EQ(ex.tradeCount(), 0u);
+	double px{};
+	EXPECT_TRUE(ex.bestBidPrice(px, 0));
+	EXPECT_EQ(px, 100);
+	EXPECT_FALSE(ex.bestAskPrice(px, 0));
+	EXPECT_FALSE(ex.bestBidPrice(px, 1));
+	EXPECT_TRUE(ex.bestAskPrice(px, 1));
+	EXPECT_EQ(px, 99);
+	EXPECT_TRUE(ex.quote(1).hasAsk);
+	EXPECT_FALSE(ex.quote(1).hasBid);
+}
+
+TEST(MultiInstrument, StopMatchesQueuedOrders) {
+	// Poll с длинным тиком: до остановки матчеры заявок не увидят
+	Exchange ex(ExchangeConfig{.wake = WakeMode::Poll, .tick = std::chrono::milliseconds(300), .instruments = 2, .shards = 2});
+	ex.setFee(0.0, 0);
+	ex.setConsoleOutput(false);
+	std::thread t([&]{ ex.runLoop(); });
+	std::this_thread::sleep_for(std::chrono::milliseconds(30));
+	for (Symbol s = 0; s < 2; ++s) {
+		ex.submitOrder({1, OrderType::Limit, OrderSide::Buy,  0, 5, 100, 0, s});
+		ex.submitOrder({2, OrderType::Limit, OrderSide::Sell, 0, 5,  99, 0, s});
+	}
+	ex.stop();
+	t.join();
+
+	EXPECT_EQ(ex.tradeCount(), 2u);
+	for (Symbol s = 0; s < 2; ++s) {
+		const QuoteSnapshot q = ex.quote(s);
+		EXPECT_FALSE(q.hasBid) << s;
+		EXPECT_FALSE(q.hasAsk) << s;
+		EXPECT_GT(q.lastPrice, 0) << s;
+	}
+}
+
+TEST(MultiInstrument, UnknownSymbolIsRejected) {
+	Exchange ex(ExchangeConfig{.instruments = 2});
+	ex.setFee(0.0, 0);
+	EXPECT_FALSE(ex.trySubmitOrder({1, OrderType::Limit, OrderSide::Buy, 0, 5, 100, 0, 2}));
+	ex.submitOrder({1, OrderType::Limit, OrderSide::Buy, 0, 5, 100, 0, 7});
+	EXPECT_EQ(ex.ingressStats().rejected, 2u);
+	double px{};
+	EXPECT_FALSE(ex.bestBidPrice(px, 7));
+	EXPECT_LT(ex.fairPriceEstimate(FairPriceKind::Vwap, 7), 0);
+}
+
+TEST(MultiInstrument, SettlementAcrossShards) {
+	constexpr int kSymbols = 64;
+	constexpr int kProducers = 4;
+	constexpr int kPairs = 5000;
+
+	// бумаги у продавца только по инструменту 0, остальные он продаёт в минус - без RiskGate
+	Exchange ex(ExchangeConfig{.instruments = kSymbols, .shards = 4, .preTradeRisk = false});
+	ex.setFee(0.0, 0);
+	ASSERT_EQ(ex.shardCount(), 4u);
+	const auto buyer  = std::make_shared<TestBroker>(1, 1e9, 0, ex);
+	const auto seller = std::make_shared<TestBroker>(2, 0, 1000000, ex);
+	ex.registerBroker(buyer);
+	ex.registerBroker(seller);
+
+	std::thread loop([&]{ ex.runLoop(); });
+	std::this_thread::sleep_for(std::chrono::milliseconds(5));
+
+	// один и тот же брокер торгует во всех шардах одновременно
+	std::vector<std::thread> producers;
+	for (int p = 0; p < kProducers; ++p)
+		producers.emplace_back([&, p] {
+			for (int i = 0; i < kPairs; ++i) {
+				const auto sym = static_cast<Symbol>((p * kPairs + i) % kSymbols);
+				ex.submitOrder({2, OrderType::Limit, OrderSide::Sell, 0, 1, 100, 0, sym});
+				ex.submitOrder({1, OrderType::Limit, OrderSide::Buy,  0, 1, 100, 0, sym});
+			}
+		});
+	for (auto& t : producers) t.join();
+
+	constexpr auto kTotal = static_cast<std::size_t>(kProducers) * kPairs;
+	const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+	while (ex.tradeCount() < kTotal && std::chrono::steady_clock::now() < deadline)
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	ex.stop();
+	loop.join();
+
+	ASSERT_EQ(ex.tradeCount(), kTotal);
+	// позиции - по инструменту сделки, деньги - общие. Сделки по кругу: первые kTotal % kSymbols
+	// инструментов получили на одну больше
+	const auto traded = [](int s) { return static_cast<long long>(kTotal / kSymbols + (s < static_cast<int>(kTotal % kSymbols))); };
+	EXPECT_EQ(buyer->inventory(), traded(0));
+	EXPECT_EQ(seller->inventory(), 1000000 - traded(0));
+	EXPECT_DOUBLE_EQ(buyer->cash(), 1e9 - 100.0 * kTotal);
+	EXPECT_DOUBLE_EQ(seller->cash(), 100.0 * kTotal);
+	for (int s = 1; s < kSymbols; ++s) {
+		EXPECT_EQ(ex.account(1, static_cast<Symbol>(s)).inventory, traded(s));
+		EXPECT_EQ(ex.account(2, static_cast<Symbol>(s)).inventory, -traded(s));
+	}
+	for (int s = 0; s < kSymbols; ++s) {
+		EXPECT_EQ(ex.quote(static_cast<Symbol>(s)).lastPrice, 100);
+		EXPECT_EQ(ex.fairPriceEstimate(FairPriceKind::Vwap, static_cast<Symbol>(s)), 100);
+	}
+}
+
+TEST(MultiInstrument, TradesCarrySymbol) {
+	LadderBook book;
+	book.addOrder({1, OrderType::Limit, OrderSide::Buy,  1, 5, 100, 0, 42});
+	book.addOrder({2, OrderType::Limit, OrderSide::Sell, 2, 5, 100, 0, 42});
+	Trade tr;
+	ASSERT_TRUE(book.tryMatchOne(0, tr));
+	EXPECT_EQ(tr.symbol, 42);
+	EXPECT_EQ(toJournalRecord(tr).symbol, 42);
+}
+
+TEST(CancelReplace, CancelRemovesOrder) {
+	for (const BookKind kind : {BookKind::Map, BookKind::Ladder}) {
+		auto book = makeBook(kind, 100);
+		book->addOrder({1, OrderType::Limit, OrderSide::Buy, 1, 5, 100, 0});
+		book->addOrder({1, OrderType::Limit, OrderSide::Buy, 2, 5,  99, 0});
+
+		EXPECT_TRUE(book->cancelOrder(1));
+		EXPECT_FALSE(book->cancelOrder(1));
+		EXPECT_FALSE(book->cancelOrder(42));
+
+		double bid{};
+		ASSERT_TRUE(book->bestBidPrice(bid));
+		EXPECT_EQ(bid, 99);
+		EXPECT_TRUE(book->cancelOrder(2));
+		EXPECT_FALSE(book->bestBidPrice(bid));
+	}
+}
+
+TEST(CancelReplace, QuantityDownKeepsPriority) {
+	for (const BookKind kind : {BookKind::Map, BookKind::Ladder}) {
+		auto book = makeBook(kind, 100);
+		book->addOrder({1, OrderType::Limit, OrderSide::Sell, 1, 5, 100, 0});
+		book->addOrder({2, OrderType::Limit, OrderSide::Sell, 2, 5, 100, 0});
+		ASSERT_TRUE(book->replaceOrder(1, 3, 100));
+		EXPECT_EQ(book->top().askSize, 8);
+
+		book->addOrder({3, OrderType::Limit, OrderSide::Buy, 3, 3, 100, 0});
+		Trade tr;
+		ASSERT_TRUE(book->tryMatchOne(0, tr));
+		EXPECT_EQ(tr.sellerId, 1);
+		EXPECT_EQ(tr.quantity, 3);
+	}
+}
+
+TEST(CancelReplace, QuantityUpOrNewPriceLosesPriority) {
+	for (const BookKind kind : {BookKind::Map, BookKind::Ladder}) {
+		auto book = makeBook(kind, 100);
+		book->addOrder({1, OrderType::Limit, OrderSide::Sell, 1, 5, 100, 0});
+		book->addOrder({2, OrderType::Limit, OrderSide::Sell, 2, 5, 100, 0});
+		ASSERT_TRUE(book->replaceOrder(1, 6, 100));
+
+		book->addOrder({3, OrderType::Limit, OrderSide::Buy, 3, 1, 100, 0});
+		Trade tr;
+		ASSERT_TRUE(book->tryMatchOne(0, tr));
+		EXPECT_EQ(tr.sellerId, 2);
+
+		// цена ушла на другой уровень, старый уровень опустел
+		ASSERT_TRUE(book->replaceOrder(2, 4, 101));
+		ASSERT_TRUE(book->replaceOrder(1, 6, 102));
+		double ask{};
+		ASSERT_TRUE(book->bestAskPrice(ask));
+		EXPECT_EQ(ask, 101);
+		EXPECT_EQ(book->top().askSize, 4);
+
+		ASSERT_TRUE(book->replaceOrder(2, 0, 101));
+		ASSERT_TRUE(book->bestAskPrice(ask));
+		EXPECT_EQ(ask, 102);
+		EXPECT_FALSE(book->replaceOrder(2, 1, 101));
+	}
+}
+
+TEST(CancelReplace, ExchangeCommandsGoThroughIngress) {
+	Exchange ex;
+	ex.setFee(0.0, 0);
+	const size_t resting = ex.submitOrder({1, OrderType::Limit, OrderSide::Sell, 0, 5, 101, 0});
+	ASSERT_NE(resting, 0u);
+
+	std::thread t([&]{ ex.runLoop(); });
+	std::this_thread::sleep_for(std::chrono::milliseconds(5));
+
+	// цену подвинули под покупку, затем сняли остаток
+	EXPECT_TRUE(ex.replaceOrder(resting, 5, 100));
+	ex.submitOrder({2, OrderType::Limit, OrderSide::Buy, 0, 2, 100, 0});
+	EXPECT_TRUE(ex.cancelOrder(resting));
+	EXPECT_TRUE(ex.cancelOrder(resting));
+	EXPECT_FALSE(ex.cancelOrder(resting, 3));
+
+	const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+	while (ex.ingressStats().drained < 4 && std::chrono::steady_clock::now() < deadline)
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	std::this_thread::sleep_for(std::chrono::milliseconds(5));
+	ex.stop();
+	t.join();
+
+	EXPECT_EQ(ex.tradeCount(), 1u);
+	EXPECT_EQ(ex.ingressStats().missed, 1u);
+	const QuoteSnapshot q = ex.quote();
+	EXPECT_FALSE(q.hasAsk);
+	EXPECT_FALSE(q.hasBid);
+	EXPECT_EQ(q.lastPrice, 100);
+}
+
+TEST(CancelReplace, PlayerKeepsAtMostOneRestingOrder) {
+	Exchange ex;
+	ex.setFee(0.0, 0);
+	ex.setConsoleOutput(false);
+	const auto player = std::make_shared<PlayerBroker>(1, 1e6, 1000, ex);
+	ex.registerBroker(player);
+
+	for (int t = 0; t < 100; ++t) player->step(t);
+
+	// один брокер не торгует сам с собой, в стакане остаётся только последняя заявка
+	const QuoteSnapshot q = ex.quote();
+	EXPECT_NE(q.hasBid, q.hasAsk);
+	EXPECT_LE(q.hasBid ? q.bidSize : q.askSize, 10);
+}
+
+TEST(AccountTable, SettleAndSnapshot) {
+	AccountTable accounts;
+	ASSERT_TRUE(accounts.open(1, toCash(1000), 0));
+	ASSERT_TRUE(accounts.open(2, toCash(0), 10));
+	EXPECT_FALSE(accounts.open(-1, 0, 0));
+	EXPECT_FALSE(accounts.open(static_cast<int>(AccountTable::kMaxAccounts), 0, 0));
+
+	accounts.settle(1, 2, toCash(100.25 * 4), 4);
+	// незарегистрированная сторона пропускается, таблица не растёт
+	accounts.settle(1, 77, toCash(10), 1);
+
+	const AccountSnapshot b = accounts.snapshot(1);
+	ASSERT_TRUE(b.registered);
+	EXPECT_DOUBLE_EQ(b.cash, 1000 - 401 - 10);
+	EXPECT_EQ(b.inventory, 5);
+	const AccountSnapshot s = accounts.snapshot(2);
+	EXPECT_DOUBLE_EQ(s.cash, 401);
+	EXPECT_EQ(s.inventory, 6);
+	EXPECT_FALSE(accounts.snapshot(77).registered);
+	EXPECT_EQ(accounts.size(), 2u);
+
+	accounts.chargeAll(toCash(0.5));
+	EXPECT_DOUBLE_EQ(accounts.snapshot(1).cash, 588.5);
+	EXPECT_DOUBLE_EQ(accounts.snapshot(2).cash, 400.5);
+}
+
+TEST(AccountTable, ConcurrentSettlementIsExact) {
+	constexpr int kThreads = 4;
+	constexpr int kTrades = 100000;
+	AccountTable accounts;
+	accounts.open(1, 0, 0);
+	accounts.open(5000, 0, 0);
+
+	std::vector<std::thread> ts;
+	for (int t = 0; t < kThreads; ++t)
+		ts.emplace_back([&] {
+			for (int i = 0; i < kTrades; ++i) accounts.settle(1, 5000, toCash(99.99), 1);
+		});
+	for (auto& t : ts) t.join();
+
+	EXPECT_EQ(accounts.snapshot(1).inventory, kThreads * kTrades);
+	EXPECT_EQ(accounts.snapshot(5000).inventory, -kThreads * kTrades);
+	EXPECT_DOUBLE_EQ(accounts.snapshot(5000).cash, 99.99 * kThreads * kTrades);
+}
+
+TEST(AccountTable, PositionsAreKeptPerSymbol) {
+	AccountTable accounts(3);
+	ASSERT_TRUE(accounts.open(1, toCash(1000), 0));
+	ASSERT_TRUE(accounts.open(2, 0, 10, 2));
+	EXPECT_FALSE(accounts.open(3, 0, 10, 3));      // нет такого инструмента
+
+	accounts.settle(1, 2, toCash(4 * 25.0), 4, 2);
+	accounts.settle(2, 1, toCash(30.0), 1, 0);
+	EXPECT_EQ(accounts.snapshot(1, 0).inventory, -1);
+	EXPECT_EQ(accounts.snapshot(1, 2).inventory, 4);
+	EXPECT_EQ(accounts.snapshot(2, 0).inventory, 1);
+	EXPECT_EQ(accounts.snapshot(2, 1).inventory, 0);
+	EXPECT_EQ(accounts.snapshot(2, 2).inventory, 6);
+	// деньги - общие на счёт
+	EXPECT_DOUBLE_EQ(accounts.snapshot(1, 1).cash, 1000 - 100 + 30);
+	EXPECT_FALSE(accounts.snapshot(1, 3).registered);
+
+	// переоткрытие обнуляет позиции по всем инструментам
+	accounts.open(2, toCash(5), 0);
+	EXPECT_EQ(accounts.snapshot(2, 0).inventory, 0);
+	EXPECT_EQ(accounts.snapshot(2, 2).inventory, 0);
+
+	// в снапшот идут только ненулевые позиции
+	std::vector<AccountRecord> records;
+	std::vector<PositionRecord> positions;
+	accounts.exportRecords(records, positions);
+	ASSERT_EQ(records.size(), 2u);
+	ASSERT_EQ(positions.size(), 2u);
+	AccountTable copy(3);
+	for (const AccountRecord& r : records) ASSERT_TRUE(copy.restore(r));
+	for (const PositionRecord& p : positions) ASSERT_TRUE(copy.restore(p));
+	EXPECT_EQ(copy.snapshot(1, 0).inventory, -1);
+	EXPECT_EQ(copy.snapshot(1, 2).inventory, 4);
+	EXPECT_DOUBLE_EQ(copy.snapshot(1).cash, 930);
+	EXPECT_DOUBLE_EQ(copy.snapshot(2).cash, 5);
+}
+
+TEST(AccountTable, ExchangeChargesFeesThroughTable) {
+	Exchange ex(ExchangeConfig{.tick = std::chrono::milliseconds(1)});
+	ex.setFee(1.0, 1);
+	const auto b = std::make_shared<TestBroker>(1, 100.0, 10, ex);
+	EXPECT_EQ(b->cash(), 100.0);
+	ex.registerBroker(b);
+	// сделка с незарегистрированным брокером и комиссии не должны ронять цикл
+	ex.submitOrder({1, OrderType::Limit, OrderSide::Sell, 0, 2, 10, 0});
+	ex.submitOrder({9, OrderType::Limit, OrderSide::Buy,  0, 2, 10, 0});
+
+	std::thread t([&]{ ex.runLoop(); });
+	std::this_thread::sleep_for(std::chrono::milliseconds(30));
+	ex.stop();
+	t.join();
+
+	EXPECT_EQ(ex.tradeCount(), 1u);
+	EXPECT_EQ(b->inventory(), 8);
+	EXPECT_LT(b->cash(), 120.0);
+	// целое число списанных комиссий
+	EXPECT_DOUBLE_EQ(b->cash(), std::round(b->cash()));
+	EXPECT_FALSE(ex.account(9).registered);
+}
+
+namespace {
+
+// считает свои шаги и пишет id в общий журнал порядка
+class CountingBroker final : public Broker {
+public:
+	CountingBroker(int id, Exchange& ex, std::vector<int>* order = nullptr, std::mutex* orderMutex = nullptr)
+		: Broker(id, 0, 0, ex), order(order), orderMutex(orderMutex) {}
+
+	void step(int) override {
+		steps.fetch_add(1, std::memory_order_relaxed);
+		// один брокер не должен шагать в двух потоках сразу
+		if (inStep.exchange(true)) overlapped = true;
+		if (order) {
+			std::lock_guard<std::mutex> lk(*orderMutex);
+			order->push_back(_id);
+		}
+		inStep = false;
+	}
+
+	std::atomic<int> steps{0};
+	std::atomic<bool> inStep{false};
+	std::atomic<bool> overlapped{false};
+
+private:
+	std::vector<int>* order;
+	std::mutex* orderMutex;
+};
+
+} // namespace
+
+TEST(StrategyScheduler, HonoursIntervals) {
+	Exchange ex;
+	StrategyScheduler sched(SchedulerConfig{.threads = 2});
+	const auto fast = std::make_shared<CountingBroker>(1, ex);
+	const auto slow = std::make_shared<CountingBroker>(2, ex);
+	sched.add(fast, std::chrono::milliseconds(2));
+	sched.add(slow, std::chrono::milliseconds(20));
+
+	sched.start();
+	std::this_thread::sleep_for(std::chrono::milliseconds(200));
+	sched.stop();
+
+	EXPECT_GE(slow->steps, 5);
+	EXPECT_LE(slow->steps, 12);
+	EXPECT_GT(fast->steps, 3 * slow->steps);
+	EXPECT_EQ(sched.steps(), static_cast<std::uint64_t>(fast->steps + slow->steps));
+}
+
+TEST(StrategyScheduler, PriorityGoesFirst) {
+	Exchange ex;
+	std::vector<int> order;
+	std::mutex orderMutex;
+	StrategyScheduler sched(SchedulerConfig{.threads = 1});
+	for (int id = 1; id <= 4; ++id)
+		sched.add(std::make_shared<CountingBroker>(id, ex, &order, &orderMutex), std::chrono::seconds(10), id);
+
+	sched.start();
+	std::this_thread::sleep_for(std::chrono::milliseconds(20));
+	sched.stop();
+
+	EXPECT_EQ(order, (std::vector<int>{4, 3, 2, 1}));
+}
+
+TEST(StrategyScheduler, RoundRobinIsFairAcrossManyBrokers) {
+	constexpr int kBrokers = 10000;
+	Exchange ex;
+	StrategyScheduler sched(SchedulerConfig{.threads = 2, .mode = ScheduleMode::RoundRobin});
+	std::vector<std::shared_ptr<CountingBroker>> brokers;
+	for (int id = 0; id < kBrokers; ++id) {
+		brokers.push_back(std::make_shared<CountingBroker>(id, ex));
+		// приоритеты в этом режиме не важны
+		sched.add(brokers.back(), std::chrono::microseconds(0), id % 7);
+	}
+
+	sched.start();
+	std::this_thread::sleep_for(std::chrono::milliseconds(100));
+	sched.stop();
+
+	int lo = INT_MAX, hi = 0;
+	for (const auto& b : brokers) {
+		lo = std::min(lo, b->steps.load());
+		hi = std::max(hi, b->steps.load());
+		EXPECT_FALSE(b->overlapped);
+	}
+	EXPECT_GE(lo, 1);
+	// кражи между рабочими дают разброс не больше пары кругов
+	EXPECT_LE(hi - lo, 3);
+}
+
+TEST(StrategyScheduler, DrivesRealStrategies) {
+	Exchange ex;
+	ex.setFee(0.0, 0);
+	ex.setConsoleOutput(false);
+	StrategyScheduler sched;
+	for (int id = 1; id <= 200; ++id) {
+		auto p = std::make_shared<PlayerBroker>(id, 1e6, 1000, ex);
+		ex.registerBroker(p);
+		sched.add(p, std::chrono::milliseconds(1));
+	}
+	std::thread loop([&]{ ex.runLoop(); });
+	sched.start();
+	std::this_thread::sleep_for(std::chrono::milliseconds(200));
+	sched.stop();
+	ex.stop();
+	loop.join();
+
+	EXPECT_GT(sched.steps(), 200u);
+	EXPECT_GT(ex.tradeCount(), 0u);
+}
+
+TEST(BroadcastRing, EveryConsumerSeesEveryMessage) {
+	BroadcastRing<long long> ring(8);
+	long long v{};
+	EXPECT_EQ(ring.read(1, v), BroadcastRing<long long>::Read::Empty);
+	for (long long i = 1; i <= 5; ++i) ring.publish(i * 10);
+
+	// два независимых читателя
+	for (int reader = 0; reader < 2; ++reader)
+		for (std::uint64_t n = 1; n <= 5; ++n) {
+			ASSERT_EQ(ring.read(n, v), BroadcastRing<long long>::Read::Ok);
+			EXPECT_EQ(v, static_cast<long long>(n) * 10);
+		}
+	EXPECT_EQ(ring.read(6, v), BroadcastRing<long long>::Read::Empty);
+
+	for (long long i = 6; i <= 20; ++i) ring.publish(i * 10);
+	EXPECT_EQ(ring.read(3, v), BroadcastRing<long long>::Read::Gap);
+	ASSERT_EQ(ring.read(20, v), BroadcastRing<long long>::Read::Ok);
+	EXPECT_EQ(v, 200);
+}
+
+TEST(BroadcastRing, ConcurrentReadersNeverSeeTornValues) {
+	struct Pair { long long a; long long b; };
+	BroadcastRing<Pair> ring(1024);
+	constexpr long long kCount = 200000;
+	std::atomic<bool> bad{false};
+
+	std::vector<std::thread> readers;
+	for (int r = 0; r < 3; ++r)
+		readers.emplace_back([&] {
+			std::uint64_t next = 1;
+			long long last = 0;
+			Pair p{};
+			while (last < kCount) {
+				const auto res = ring.read(next, p);
+				if (res == BroadcastRing<Pair>::Read::Empty) { std::this_thread::yield(); continue; }
+				if (res == BroadcastRing<Pair>::Read::Gap) { next = ring.lastPublished(); continue; }
+				if (p.a != -p.b || p.a <= last) bad = true;
+				last = p.a;
+				++next;
+			}
+		});
+	for (long long i = 1; i <= kCount; ++i) ring.publish({i, -i});
+	for (auto& t : readers) t.join();
+	EXPECT_FALSE(bad);
+}
+
+TEST(MarketData, DiffLevelsRebuildsTarget) {
+	std::mt19937 rng(3);
+	for (int round = 0; round < 200; ++round) {
+		for (const OrderSide side : {OrderSide::Buy, OrderSide::Sell}) {
+			auto make = [&] {
+				std::vector<BookLevel> v;
+				for (int p = 90; p <= 110; ++p)
+					if (rng() % 3 == 0) v.push_back({static_cast<double>(p), 1 + static_cast<long long>(rng() % 4)});
+				if (side == OrderSide::Buy) std::reverse(v.begin(), v.end());
+				return v;
+			};
+			const auto before = make();
+			const auto after = make();
+
+			std::vector<BookLevel> view = before;
+			diffLevels(side, before, after, [&](MdKind kind, const BookLevel& l) {
+				auto it = std::find_if(view.begin(), view.end(), [&](const BookLevel& x) { return x.price == l.price; });
+				if (kind == MdKind::Delete) view.erase(it);
+				else if (kind == MdKind::Modify) it->quantity = l.quantity;
+				else view.push_back(l);
+			});
+			std::sort(view.begin(), view.end(), [&](const BookLevel& a, const BookLevel& b) {
+				return side == OrderSide::Buy ? a.price > b.price : a.price < b.price;
+			});
+			ASSERT_EQ(view, after);
+		}
+	}
+}
+
+TEST(MarketData, LateJoinerSyncsFromSnapshotAndTracksDepth) {
+	Exchange ex(ExchangeConfig{.tick = std::chrono::milliseconds(1), .feedDepth = 3, .feedSnapshotTicks = 2});
+	ex.setFee(0.0, 0);
+	ex.setConsoleOutput(false);
+	ex.submitOrder({1, OrderType::Limit, OrderSide::Buy,  0, 5, 99, 0});
+	ex.submitOrder({1, OrderType::Limit, OrderSide::Buy,  0, 2, 99, 0});
+	ex.submitOrder({1, OrderType::Limit, OrderSide::Buy,  0, 1, 98, 0});
+	ex.submitOrder({2, OrderType::Limit, OrderSide::Sell, 0, 4, 101, 0});
+	ASSERT_NE(ex.marketData(), nullptr);
+	EXPECT_EQ(ex.marketData(5), nullptr);
+
+	std::thread loop([&]{ ex.runLoop(); });
+	std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+	// подключаемся после старта: ждём снапшот
+	DepthView view(*ex.marketData());
+	EXPECT_FALSE(view.synced(0));
+	const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+	while (!view.synced(0) && std::chrono::steady_clock::now() < deadline) {
+		view.poll();
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	ASSERT_TRUE(view.synced(0));
+
+	std::array<BookLevel, 5> levels{};
+	ASSERT_EQ(view.depth(0, OrderSide::Buy, levels), 2u);
+	EXPECT_EQ(levels[0], (BookLevel{99, 7}));
+	EXPECT_EQ(levels[1], (BookLevel{98, 1}));
+
+	// сделка съедает 99 целиком, на стороне покупок остаётся 98
+	ex.submitOrder({3, OrderType::Limit, OrderSide::Sell, 0, 7, 99, 0});
+	ex.submitOrder({1, OrderType::Limit, OrderSide::Buy,  0, 3, 97, 0});
+	std::size_t n = 0;
+	while (std::chrono::steady_clock::now() < deadline) {
+		view.poll();
+		n = view.depth(0, OrderSide::Buy, levels);
+		if (n == 2 && levels[0].price == 98) break;
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	ex.stop();
+	loop.join();
+
+	ASSERT_EQ(n, 2u);
+	EXPECT_EQ(levels[0], (BookLevel{98, 1}));
+	EXPECT_EQ(levels[1], (BookLevel{97, 3}));
+	EXPECT_EQ(view.lastTradePrice(0), 99);
+	ASSERT_EQ(view.depth(0, OrderSide::Sell, levels), 1u);
+	EXPECT_EQ(levels[0], (BookLevel{101, 4}));
+	EXPECT_EQ(view.gaps(), 0u);
+}
+
+TEST(MarketData, GapTriggersResyncFromSnapshot) {
+	Exchange ex(ExchangeConfig{.tick = std::chrono::milliseconds(1), .feedDepth = 5,
+	                           .feedCapacity = 64, .feedSnapshotTicks = 1});
+	ex.setFee(0.0, 0);
+	ex.setConsoleOutput(false);
+	std::thread loop([&]{ ex.runLoop(); });
+	DepthView view(*ex.marketData());
+
+	// намного больше событий, чем помещается в кольцо, пока читатель не читает
+	for (int i = 0; i < 500; ++i)
+		ex.submitOrder({1 + i % 2, OrderType::Limit, (i % 2) ? OrderSide::Buy : OrderSide::Sell, 0, 1,
+		                (i % 2) ? 90.0 + i % 5 : 110.0 - i % 5, 0});
+	std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+	std::array<BookLevel, 5> levels{};
+	const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+	while (std::chrono::steady_clock::now() < deadline) {
+		view.poll();
+		if (view.gaps() > 0 && view.synced(0)) break;
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	ex.stop();
+	loop.join();
+
+	EXPECT_GT(view.gaps(), 0u);
+	ASSERT_TRUE(view.synced(0));
+	ASSERT_EQ(view.depth(0, OrderSide::Buy, levels), 5u);
+	EXPECT_EQ(levels[0], (BookLevel{94, 50}));
+	ASSERT_EQ(view.depth(0, OrderSide::Sell, levels), 5u);
+	EXPECT_EQ(levels[0], (BookLevel{106, 50}));
+}
+
+TEST(TradeStore, RangeQuerySpansChunks) {
+	TradeStore store;
+	std::vector<Trade> batch;
+	const int total = static_cast<int>(TradeStore::kRows) * 3 + 17;
+	for (int i = 0; i < total; ++i) batch.push_back({1, 2, 100.0 + i % 7, 1 + i % 3, i / 10, 0});
+	store.append(std::span(batch).first(1000));
+	store.append(std::span(batch).subspan(1000));
+	EXPECT_EQ(store.retained(), static_cast<std::size_t>(total));
+
+	// граница внутри блока и переход через границу блоков
+	const auto got = store.query(400, 500);
+	ASSERT_EQ(got.size(), 1000u);
+	for (std::size_t i = 0; i < got.size(); ++i) {
+		const Trade& want = batch[4000 + i];
+		EXPECT_EQ(got[i].executedAt, want.executedAt);
+		EXPECT_EQ(got[i].price, want.price);
+		EXPECT_EQ(got[i].quantity, want.quantity);
+	}
+	EXPECT_TRUE(store.query(total, total + 100).empty());
+	EXPECT_EQ(store.query(0, total).size(), static_cast<std::size_t>(total));
+}
+
+TEST(TradeStore, RetentionEvictsToSpillFile) {
+	const auto path = (std::filesystem::temp_directory_path() / "stock_trade_spill.bin").string();
+	std::filesystem::remove(path);
+	{
+		MappedFile spill;
+		ASSERT_TRUE(spill.open(path, kJournalMagic, kJournalVersion, sizeof(JournalRecord)));
+		TradeStore store({.retentionTicks = 10});
+		store.setSpill(&spill);
+		std::vector<Trade> batch;
+		for (int i = 0; i < static_cast<int>(TradeStore::kRows) * 4; ++i) batch.push_back({1, 2, 50.0, 1, i, 3});
+		store.append(batch);
+
+		// держим только блоки, попадающие в окно, плюс текущий
+		EXPECT_EQ(store.evicted(), TradeStore::kRows * 2);
+		EXPECT_EQ(store.retained(), TradeStore::kRows * 2);
+		EXPECT_TRUE(store.query(0, static_cast<int>(TradeStore::kRows)).empty());
+		spill.sync();
+	}
+	MappedFileReader reader;
+	ASSERT_TRUE(reader.open(path, kJournalMagic, kJournalVersion, sizeof(JournalRecord)));
+	const auto records = reader.records<JournalRecord>();
+	ASSERT_EQ(records.size(), TradeStore::kRows * 2);
+	for (std::size_t i = 0; i < records.size(); ++i) {
+		EXPECT_EQ(records[i].executedAt, static_cast<int>(i));
+		EXPECT_EQ(records[i].symbol, 3);
+	}
+	std::filesystem::remove(path);
+}
+
+TEST(TradeStore, BarsAreBuiltIncrementally) {
+	TradeStore store({.ticksPerSecond = 10, .barHistory = 3});
+	// по одной сделке на тик, цена растёт внутри секунды
+	for (int t = 0; t < 60; ++t) {
+		const Trade tr{1, 2, 100.0 + t % 10, 2, t, 0};
+		store.append(std::span(&tr, 1));
+	}
+	const auto secs = store.bars(BarPeriod::Second);
+	ASSERT_EQ(secs.size(), 4u);     // 3 закрытых и текущая
+	EXPECT_EQ(secs.front().start, 20);
+	const Bar& last = secs.back();
+	EXPECT_EQ(last.start, 50);
+	EXPECT_EQ(last.open, 100.0);
+	EXPECT_EQ(last.high, 109.0);
+	EXPECT_EQ(last.low, 100.0);
+	EXPECT_EQ(last.close, 109.0);
+	EXPECT_EQ(last.volume, 20);
+	EXPECT_EQ(last.trades, 10);
+
+	const auto mins = store.bars(BarPeriod::Minute);
+	ASSERT_EQ(mins.size(), 1u);
+	EXPECT_EQ(mins[0].volume, 120);
+	EXPECT_EQ(mins[0].trades, 60);
+}
+
+TEST(TradeStore, ExchangeKeepsHistoryPerInstrument) {
+	Exchange ex(ExchangeConfig{.instruments = 2});
+	ex.setFee(0.0, 0);
+	ex.submitOrder({1, OrderType::Limit, OrderSide::Buy,  0, 5, 100, 0, 1});
+	ex.submitOrder({2, OrderType::Limit, OrderSide::Sell, 0, 3, 100, 0, 1});
+	ex.setConsoleOutput(false);
+	std::thread loop([&]{ ex.runLoop(); });
+	const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+	while (ex.tradeCount() == 0 && std::chrono::steady_clock::now() < deadline)
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	ex.stop();
+	loop.join();
+
+	EXPECT_TRUE(ex.tradesBetween(0, INT_MAX, 0).empty());
+	const auto trades = ex.tradesBetween(0, INT_MAX, 1);
+	ASSERT_EQ(trades.size(), 1u);
+	EXPECT_EQ(trades[0].quantity, 3);
+	EXPECT_EQ(trades[0].symbol, 1);
+	const auto bars = ex.bars(BarPeriod::Second, 1);
+	ASSERT_EQ(bars.size(), 1u);
+	EXPECT_EQ(bars[0].volume, 3);
+	EXPECT_TRUE(ex.bars(BarPeriod::Minute, 7).empty());
+}
+
+TEST(RiskEngine, KernelsAgreeWithDefinition) {
+	std::mt19937 rng(7);
+	std::uniform_real_distribution<double> money(-1000, 100000);
+	std::uniform_int_distribution<int> position(-500, 500);
+	constexpr std::size_t kRows = 1003;     // хвост не кратен ширине вектора
+	const std::array<double, 3> marks{37.25, 101.5, 0.75};
+	AccountColumns in;
+	for (std::size_t i = 0; i < kRows; ++i) {
+		const bool open = i % 7 != 3;
+		in.active.push_back(open);
+		// деньги в колонках - в единицах Cash, как их отдаёт AccountTable
+		in.cash.push_back(open ? static_cast<double>(toCash(money(rng))) : 0.0);
+		in.startCash.push_back(open ? static_cast<double>(toCash(money(rng))) : 0.0);
+	}
+	for (std::size_t k = 0; k < marks.size(); ++k)
+		for (std::size_t i = 0; i < kRows; ++i) {
+			const bool open = in.active[i];
+			in.inventory.push_back(open ? position(rng) : 0.0);
+			in.startInventory.push_back(open ? position(rng) : 0.0);
+		}
+	ASSERT_EQ(in.symbols(), marks.size());
+	const double scale = static_cast<double>(kCashScale);
+
+	// оценка по определению: каждая позиция - по марке своего инструмента
+	std::vector<double> equity(kRows), pnl(kRows), exposure(kRows);
+	RiskSums expected;
+	for (std::size_t i = 0; i < kRows; ++i) {
+		double start = in.startCash[i] / scale;
+		equity[i] = in.cash[i] / scale;
+		for (std::size_t k = 0; k < marks.size(); ++k) {
+			const double inv = in.inventory[k * kRows + i];
+			equity[i] += inv * marks[k];
+			start += in.startInventory[k * kRows + i] * marks[k];
+			exposure[i] += std::fabs(inv) * marks[k];
+			expected.netPosition += inv;
+			(inv > 0 ? expected.longPosition : expected.shortPosition) += std::fabs(inv);
+		}
+		pnl[i] = equity[i] - start;
+		expected.equity += equity[i];
+		expected.pnl += pnl[i];
+		expected.grossExposure += exposure[i];
+	}
+
+	for (const RiskKernel kernel : {RiskKernel::Scalar, RiskKernel::Avx2}) {
+		RiskColumns out;
+		const RiskSums s = markAccounts(kernel, in, marks, out);
+		ASSERT_EQ(out.equity.size(), in.size());
+		// оценка каждого счёта - те же операции в том же порядке, совпадает точно
+		for (std::size_t i = 0; i < in.size(); ++i) {
+			EXPECT_EQ(out.active[i], in.active[i]);
+			EXPECT_EQ(out.equity[i], equity[i]) << i;
+			EXPECT_EQ(out.pnl[i], pnl[i]) << i;
+			EXPECT_EQ(out.exposure[i], exposure[i]) << i;
+		}
+		// суммы - с точностью до порядка сложения
+		EXPECT_NEAR(s.equity, expected.equity, 1e-6);
+		EXPECT_NEAR(s.pnl, expected.pnl, 1e-6);
+		EXPECT_NEAR(s.grossExposure, expected.grossExposure, 1e-6);
+		EXPECT_EQ(s.netPosition, expected.netPosition);
+		EXPECT_EQ(s.longPosition, expected.longPosition);
+		EXPECT_EQ(s.shortPosition, expected.shortPosition);
+	}
+	// без марки инструмента его позиции не оцениваются
+	RiskColumns out;
+	const RiskSums first = markAccounts(RiskKernel::Scalar, in, std::span(marks).first(1), out);
+	EXPECT_EQ(out.equity[0], in.cash[0] / scale + in.inventory[0] * marks[0]);
+	EXPECT_EQ(out.exposure[0], std::fabs(in.inventory[0]) * marks[0]);
+	EXPECT_EQ(first.netPosition, std::accumulate(in.inventory.begin(), in.inventory.begin() + kRows, 0.0));
+}
+
+TEST(RiskEngine, MarksAccountTableToMarket) {
+	const std::array<double, 1> mark{60.0};
+	AccountTable table;
+	table.open(3, toCash(1000), 10);
+	table.open(2000, toCash(500), 0);
+	table.settle(2000, 3, toCash(4 * 50.0), 4);     // 3 продал 4 по 50
+
+	RiskEngine engine;
+	EXPECT_EQ(engine.totals().sequence, 0u);
+	const RiskTotals t = engine.update(table, mark, 7);
+	EXPECT_EQ(t.sequence, 1u);
+	EXPECT_EQ(t.tick, 7);
+	EXPECT_EQ(t.accounts, 2u);
+	EXPECT_DOUBLE_EQ(t.sums.equity, 1200 + 6 * 60.0 + 300 + 4 * 60.0);
+	EXPECT_DOUBLE_EQ(t.sums.netPosition, 10);
+	EXPECT_DOUBLE_EQ(t.sums.pnl, 0.0);     // сколько один потерял против марки, столько другой нашёл
+	EXPECT_EQ(engine.totals().sequence, 1u);
+
+	// балансы перечитываются на каждом пересчёте, новый счёт подхватывается
+	table.settle(3, 2000, toCash(50.0), 1);
+	table.open(5, toCash(10), -2);
+	EXPECT_EQ(engine.update(table, mark, 8).sums.netPosition, 8);
+	EXPECT_EQ(engine.update(table, mark, 9).accounts, 3u);
+	EXPECT_DOUBLE_EQ(engine.account(5).exposure, 120.0);
+	table.settle(2000, 3, toCash(50.0), 1);
+	EXPECT_DOUBLE_EQ(engine.update(table, mark, 10).sums.equity, 1200 + 6 * 60.0 + 300 + 4 * 60.0 + 10 - 120.0);
+
+	// оценка счёта - на момент пересчёта, а не по живому балансу
+	table.settle(3, 2000, toCash(60.0), 1);
+	EXPECT_DOUBLE_EQ(engine.account(3).exposure, 6 * 60.0);
+	table.settle(2000, 3, toCash(60.0), 1);
+
+	const AccountRisk seller = engine.account(3);
+	ASSERT_TRUE(seller.registered);
+	EXPECT_DOUBLE_EQ(seller.equity, 1200 + 6 * 60.0);
+	EXPECT_DOUBLE_EQ(seller.pnl, 200 - 4 * 60.0);     // продал дешевле марки
+	EXPECT_DOUBLE_EQ(seller.exposure, 6 * 60.0);
+	EXPECT_DOUBLE_EQ(engine.account(2000).pnl, 4 * 10.0);
+	EXPECT_FALSE(engine.account(4).registered);
+	EXPECT_FALSE(engine.account(1 << 30).registered);
+}
+
+TEST(RiskEngine, ExchangePublishesTotalsEveryTick) {
+	Exchange ex(ExchangeConfig{.tick = std::chrono::milliseconds(1)});
+	ex.setFee(0.0, 0);
+	ex.setConsoleOutput(false);
+	auto a = std::make_shared<TestBroker>(1, 1000, 10, ex);
+	auto b = std::make_shared<TestBroker>(2, 1000, 10, ex);
+	ex.registerBroker(a);
+	ex.registerBroker(b);
+	ex.submitOrder({1, OrderType::Limit, OrderSide::Buy,  0, 2, 100, 0});
+	ex.submitOrder({2, OrderType::Limit, OrderSide::Sell, 0, 2, 100, 0});
+
+	std::thread loop([&]{ ex.runLoop(); });
+	const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+	while (ex.riskTotals().mark != 100.0 && std::chrono::steady_clock::now() < deadline)
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	ex.stop();
+	loop.join();
+
+	const RiskTotals t = ex.riskTotals();
+	EXPECT_EQ(t.mark, 100.0);
+	EXPECT_EQ(t.accounts, 2u);
+	EXPECT_DOUBLE_EQ(t.sums.equity, 2 * (1000 + 10 * 100.0));
+	EXPECT_DOUBLE_EQ(t.sums.pnl, 0.0);
+	EXPECT_DOUBLE_EQ(a->risk().equity, 800 + 12 * 100.0);
+	EXPECT_DOUBLE_EQ(b->risk().exposure, 8 * 100.0);
+}
+
+TEST(RiskEngine, MarksEachPositionAtItsInstrument) {
+	Exchange ex(ExchangeConfig{.instruments = 2, .shards = 2});
+	ex.setFee(0.0, 0);
+	ex.setConsoleOutput(false);
+	ex.registerAccount(1, 10000, 0);
+	ex.registerAccount(2, 0, 10);           // бумаги инструмента 0
+	ex.registerAccount(3, 0, 5, 1);         // бумаги инструмента 1
+	// бумаг инструмента 1 у брокера 2 нет
+	EXPECT_EQ(ex.submitOrder({2, OrderType::Limit, OrderSide::Sell, 0, 1, 50, 0, 1}), 0u);
+	ex.submitOrder({2, OrderType::Limit, OrderSide::Sell, 0, 4, 100, 0, 0});
+	ex.submitOrder({1, OrderType::Limit, OrderSide::Buy, 0, 4, 100, 0, 0});
+	ex.submitOrder({3, OrderType::Limit, OrderSide::Sell, 0, 2, 50, 0, 1});
+	ex.submitOrder({1, OrderType::Limit, OrderSide::Buy, 0, 2, 50, 0, 1});
+	ASSERT_TRUE(ex.advanceTick());
+
+	EXPECT_EQ(ex.account(1, 0).inventory, 4);
+	EXPECT_EQ(ex.account(1, 1).inventory, 2);
+	EXPECT_EQ(ex.account(2, 0).inventory, 6);
+	EXPECT_EQ(ex.account(3, 1).inventory, 3);
+	EXPECT_EQ(ex.account(3, 0).inventory, 0);
+	EXPECT_DOUBLE_EQ(ex.account(1).cash, 10000 - 400 - 100);
+
+	// каждая позиция - по последней сделке своего инструмента: 100 и 50
+	const RiskTotals t = ex.riskTotals();
+	EXPECT_EQ(t.mark, 100.0);
+	EXPECT_DOUBLE_EQ(t.sums.equity, (9500 + 4 * 100.0 + 2 * 50.0) + (400 + 6 * 100.0) + (100 + 3 * 50.0));
+	EXPECT_DOUBLE_EQ(t.sums.grossExposure, 4 * 100.0 + 2 * 50.0 + 6 * 100.0 + 3 * 50.0);
+	EXPECT_DOUBLE_EQ(t.sums.pnl, 0.0);
+	EXPECT_DOUBLE_EQ(ex.accountRisk(1).exposure, 4 * 100.0 + 2 * 50.0);
+	EXPECT_DOUBLE_EQ(ex.accountRisk(3).equity, 100 + 3 * 50.0);
+	EXPECT_DOUBLE_EQ(ex.accountRisk(3).pnl, 0.0);
+}
+
+TEST(RiskGate, ReservesCashAndInventory) {
+	AccountTable table;
+	table.open(1, toCash(1000), 5);
+	RiskGate gate(table);
+	bool reserved = false;
+
+	const Order buy{1, OrderType::Limit, OrderSide::Buy, 1, 6, 100, 0};
+	EXPECT_EQ(gate.admit(buy, toCash(100), 0, reserved), RiskReject::None);
+	EXPECT_TRUE(reserved);
+	EXPECT_EQ(gate.reservedCash(1), toCash(600));
+	// на вторую такую же денег уже не хватает
+	EXPECT_EQ(gate.admit(buy, toCash(100), 0, reserved), RiskReject::Cash);
+	EXPECT_EQ(gate.reservedCash(1), toCash(600));
+
+	const Order sell{1, OrderType::Limit, OrderSide::Sell, 2, 4, 120, 0};
+	EXPECT_EQ(gate.admit(sell, toCash(120), 0, reserved), RiskReject::None);
+	EXPECT_EQ(gate.admit(sell, toCash(120), 0, reserved), RiskReject::Inventory);
+	EXPECT_EQ(gate.reservedInventory(1), 4);
+	EXPECT_EQ(gate.openOrders(1), 2);
+
+	// частичное исполнение, затем снятие остатка
+	gate.release(1, 0, OrderSide::Buy, 2, toCash(100), false);
+	EXPECT_EQ(gate.reservedCash(1), toCash(400));
+	gate.release(1, 0, OrderSide::Buy, 4, toCash(100), true);
+	gate.release(1, 0, OrderSide::Sell, 4, toCash(120), true);
+	EXPECT_EQ(gate.reservedCash(1), 0);
+	EXPECT_EQ(gate.reservedInventory(1), 0);
+	EXPECT_EQ(gate.openOrders(1), 0);
+
+	// без счёта - без проверок и резерва
+	const Order stranger{9, OrderType::Limit, OrderSide::Sell, 3, 1000, 1, 0};
+	EXPECT_EQ(gate.admit(stranger, toCash(1), 0, reserved), RiskReject::None);
+	EXPECT_FALSE(reserved);
+
+	const RiskGateStats st = gate.stats();
+	EXPECT_EQ(st.accepted, 3u);
+	EXPECT_EQ(st.rejectedBy(RiskReject::Cash), 1u);
+	EXPECT_EQ(st.rejectedBy(RiskReject::Inventory), 1u);
+}
+
+TEST(RiskGate, ChecksPositionOfOrderSymbol) {
+	AccountTable table(2);
+	table.open(1, toCash(1000), 10);        // бумаги только инструмента 0
+	RiskGate gate(table, {.maxPosition = 12});
+	bool reserved = false;
+	const auto order = [](OrderSide side, int qty, Symbol symbol) {
+		return Order{1, OrderType::Limit, side, 0, qty, 10, 0, symbol};
+	};
+
+	// бумаги одного инструмента не продаются под видом другого
+	EXPECT_EQ(gate.admit(order(OrderSide::Sell, 1, 1), toCash(10), 0, reserved), RiskReject::Inventory);
+	EXPECT_EQ(gate.admit(order(OrderSide::Sell, 6, 0), toCash(10), 0, reserved), RiskReject::None);
+	EXPECT_EQ(gate.reservedInventory(1, 0), 6);
+	EXPECT_EQ(gate.reservedInventory(1, 1), 0);
+	// лимит позиции - по инструменту заявки
+	EXPECT_EQ(gate.admit(order(OrderSide::Buy, 3, 0), toCash(10), 0, reserved), RiskReject::Position);
+	EXPECT_EQ(gate.admit(order(OrderSide::Buy, 12, 1), toCash(10), 0, reserved), RiskReject::None);
+	EXPECT_EQ(gate.admit(order(OrderSide::Buy, 1, 1), toCash(10), 0, reserved), RiskReject::Position);
+
+	gate.release(1, 1, OrderSide::Buy, 12, toCash(10), true);
+	gate.release(1, 0, OrderSide::Sell, 6, toCash(10), true);
+	EXPECT_EQ(gate.reservedCash(1), 0);
+	EXPECT_EQ(gate.reservedInventory(1, 0), 0);
+	EXPECT_EQ(gate.openOrders(1), 0);
+}
+
+TEST(RiskGate, EnforcesLimits) {
+	AccountTable table;
+	table.open(1, toCash(1'000'000), 100);
+	RiskGate gate(table, {.maxOrderNotional = 5000});
+	gate.setLimits(2, {.maxOpenOrders = 1});
+	table.open(2, toCash(1'000'000), 100);
+	bool reserved = false;
+	const auto buy = [](int broker, int qty, double price) {
+		return Order{broker, OrderType::Limit, OrderSide::Buy, 0, qty, price, 0};
+	};
+
+	EXPECT_EQ(gate.admit(buy(1, 60, 100), toCash(100), 0, reserved), RiskReject::Notional);
+	EXPECT_EQ(gate.admit(buy(1, 50, 100), toCash(100), 0, reserved), RiskReject::None);
+
+	// у брокера 2 свои лимиты вместо общих
+	EXPECT_EQ(gate.admit(buy(2, 60, 100), toCash(100), 0, reserved), RiskReject::None);
+	EXPECT_EQ(gate.admit(buy(2, 1, 100), toCash(100), 0, reserved), RiskReject::OpenOrders);
+
+	gate.setLimits(1, {.maxPosition = 150, .maxOrdersPerSecond = 2});
+	EXPECT_EQ(gate.admit(buy(1, 10, 1), toCash(1), 7, reserved), RiskReject::Position);   // 100 + 50 + 10
+	gate.release(1, 0, OrderSide::Buy, 50, toCash(100), true);
+	// отклонённая по позиции заявка тоже израсходовала частоту
+	EXPECT_EQ(gate.admit(buy(1, 10, 1), toCash(1), 7, reserved), RiskReject::None);
+	EXPECT_EQ(gate.admit(buy(1, 10, 1), toCash(1), 7, reserved), RiskReject::Rate);
+	EXPECT_EQ(gate.admit(buy(1, 10, 1), toCash(1), 8, reserved), RiskReject::None);     // новая секунда
+	EXPECT_EQ(gate.admit(buy(1, 1, 0), 0, 8, reserved), RiskReject::NoPrice);
+}
+
+TEST(RiskGate, RejectsNonPositiveQuantity) {
+	AccountTable table;
+	table.open(1, 0, 10);
+	RiskGate gate(table);
+	bool reserved = false;
+	const auto sell = [](int qty) { return Order{1, OrderType::Limit, OrderSide::Sell, 0, qty, 100, 0}; };
+
+	EXPECT_EQ(gate.admit(sell(11), toCash(100), 0, reserved), RiskReject::Inventory);
+	// отрицательный объём уменьшил бы резерв и открыл продажу сверх бумаг
+	EXPECT_EQ(gate.admit(sell(-1000), toCash(100), 0, reserved), RiskReject::Quantity);
+	EXPECT_EQ(gate.admit(sell(0), toCash(100), 0, reserved), RiskReject::Quantity);
+	EXPECT_EQ(gate.admit({1, OrderType::Limit, OrderSide::Buy, 0, -5, 100, 0}, toCash(100), 0, reserved),
+	          RiskReject::Quantity);
+	EXPECT_FALSE(reserved);
+	EXPECT_EQ(gate.reservedInventory(1), 0);
+	EXPECT_EQ(gate.reservedCash(1), 0);
+	EXPECT_EQ(gate.openOrders(1), 0);
+	EXPECT_EQ(gate.stats().rejectedBy(RiskReject::Quantity), 3u);
+
+	// тот же сценарий через биржу: ни одна заявка не проходит, счёт не меняется
+	Exchange ex;
+	ex.setFee(0.0, 0);
+	ex.setConsoleOutput(false);
+	ex.registerAccount(1, 0, 10);
+	ex.registerAccount(2, 100000, 1000);
+	ex.submitOrder({2, OrderType::Limit, OrderSide::Buy, 0, 1000, 103, 0});
+	ex.submitOrder({2, OrderType::Limit, OrderSide::Sell, 0, 1000, 104, 0});
+	EXPECT_EQ(ex.submitOrder({1, OrderType::Limit, OrderSide::Sell, 0, -1000, 103, 0}), 0u);
+	EXPECT_EQ(ex.submitOrder({1, OrderType::Limit, OrderSide::Sell, 0, 500, 103, 0}), 0u);
+	EXPECT_EQ(ex.submitOrder({1, OrderType::Limit, OrderSide::Buy, 0, 900, 99, 0}), 0u);
+	ASSERT_TRUE(ex.advanceTick());
+	EXPECT_EQ(ex.tradeCount(), 0u);
+	EXPECT_EQ(ex.account(1).cash, 0);
+	EXPECT_EQ(ex.account(1).inventory, 10);
+	EXPECT_EQ(ex.riskGate().openOrders(1), 0);
+}
+
+TEST(RiskGate, BookRefusalReleasesReservation) {
+	// лестница не берёт цену дальше kMaxLevels тиков от уже стоящих
+	Exchange ex(ExchangeConfig{.book = BookKind::Ladder});
+	ex.setFee(0.0, 0);
+	ex.setConsoleOutput(false);
+	ex.registerAccount(1, 1e7, 0);
+	const RiskGate& gate = ex.riskGate();
+
+	ASSERT_NE(ex.submitOrder({1, OrderType::Limit, OrderSide::Buy, 0, 1, 100, 0}), 0u);
+	ASSERT_NE(ex.submitOrder({1, OrderType::Limit, OrderSide::Buy, 0, 1, 20000, 0}), 0u);
+	ASSERT_TRUE(ex.advanceTick());
+	EXPECT_EQ(gate.openOrders(1), 1);
+	EXPECT_EQ(gate.reservedCash(1), toCash(100));
+	EXPECT_EQ(ex.ingressStats().rejected, 1u);
+
+	// то же у стакана любой реализации при объёме <= 0, если проверка риска выключена
+	for (const BookKind kind : {BookKind::Map, BookKind::Ladder}) {
+		Exchange bare(ExchangeConfig{.book = kind, .preTradeRisk = false});
+		bare.registerAccount(1, 1000, 0);
+		EXPECT_NE(bare.submitOrder({1, OrderType::Limit, OrderSide::Buy, 0, 0, 100, 0}), 0u);
+		EXPECT_EQ(bare.riskGate().openOrders(1), 0);
+		EXPECT_EQ(bare.ingressStats().rejected, 1u);
+	}
+}
+
+TEST(RiskGate, MarketBuyReservesSweepDepth) {
+	Exchange ex;
+	ex.setFee(0.0, 0);
+	ex.setConsoleOutput(false);
+	ex.registerAccount(1, 1000, 0);
+	ex.registerAccount(2, 0, 100);
+	ex.registerAccount(3, 1100, 0);
+	ex.submitOrder({2, OrderType::Limit, OrderSide::Sell, 0, 5, 100, 0});
+	ex.submitOrder({2, OrderType::Limit, OrderSide::Sell, 0, 5, 110, 0});
+	const RiskGate& gate = ex.riskGate();
+
+	// 10 штук проходят оба уровня: 1050, резерв по худшей цене - 1100
+	EXPECT_EQ(ex.submitOrder({1, OrderType::Market, OrderSide::Buy, 0, 10, 0, 0}), 0u);
+	EXPECT_EQ(ex.riskGateStats().rejectedBy(RiskReject::Cash), 1u);
+	// пять укладываются в первый уровень
+	ASSERT_NE(ex.submitOrder({1, OrderType::Market, OrderSide::Buy, 0, 5, 0, 0}), 0u);
+	EXPECT_EQ(gate.reservedCash(1), toCash(500));
+	ASSERT_TRUE(ex.advanceTick());
+	EXPECT_EQ(ex.account(1).cash, 500);
+	EXPECT_EQ(gate.reservedCash(1), 0);
+
+	ASSERT_NE(ex.submitOrder({3, OrderType::Market, OrderSide::Buy, 0, 5, 0, 0}), 0u);
+	EXPECT_EQ(gate.reservedCash(3), toCash(550));
+	ASSERT_TRUE(ex.advanceTick());
+	EXPECT_EQ(ex.account(3).cash, 550);
+	EXPECT_EQ(ex.account(3).inventory, 5);
+	EXPECT_EQ(gate.reservedCash(3), 0);
+	EXPECT_EQ(gate.openOrders(3), 0);
+}
+
+TEST(RiskGate, ExchangeReleasesOnFillCancelAndSelfTrade) {
+	Exchange ex;
+	ex.setFee(0.0, 0);
+	auto a = std::make_shared<TestBroker>(1, 1000, 0, ex);
+	auto b = std::make_shared<TestBroker>(2, 0, 10, ex);
+	ex.registerBroker(a);
+	ex.registerBroker(b);
+	const RiskGate& gate = ex.riskGate();
+
+	EXPECT_EQ(ex.submitOrder({2, OrderType::Limit, OrderSide::Sell, 0, 11, 90, 0}), 0u);    // бумаг только 10
+	EXPECT_EQ(ex.submitOrder({1, OrderType::Limit, OrderSide::Buy, 0, 11, 100, 0}), 0u);   // 1100 > 1000
+	const size_t buyId = ex.submitOrder({1, OrderType::Limit, OrderSide::Buy, 0, 8, 100, 0});
+	ASSERT_NE(buyId, 0u);
+	ex.submitOrder({2, OrderType::Limit, OrderSide::Sell, 0, 3, 90, 0});
+	EXPECT_EQ(ex.riskGateStats().rejectedBy(RiskReject::Inventory), 1u);
+
+	ex.setConsoleOutput(false);
+	std::thread loop([&]{ ex.runLoop(); });
+	const auto waitFor = [](auto pred) {
+		const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+		while (!pred() && std::chrono::steady_clock::now() < deadline)
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	};
+	waitFor([&] { return ex.tradeCount() == 1; });
+
+	// 3 исполнено по 90: снимается резерв по цене заявки, платится цена сделки
+	waitFor([&] { return gate.reservedCash(1) == toCash(500); });
+	EXPECT_EQ(gate.reservedCash(1), toCash(500));
+	EXPECT_EQ(gate.reservedInventory(2), 0);
+	EXPECT_EQ(gate.openOrders(2), 0);
+	EXPECT_DOUBLE_EQ(a->cash(), 1000 - 270);
+
+	// увеличение сверх денег отклоняется, заявка остаётся прежней
+	ex.replaceOrder(buyId, 8, 100);
+	ex.cancelOrder(buyId);
+	waitFor([&] { return gate.openOrders(1) == 0; });
+	EXPECT_EQ(gate.reservedCash(1), 0);
+	EXPECT_GE(ex.riskGateStats().rejectedBy(RiskReject::Cash), 2u);
+
+	// self-trade: стакан снимает старшую заявку, её резерв освобождается
+	ex.submitOrder({2, OrderType::Limit, OrderSide::Sell, 0, 2, 50, 0});
+	ex.submitOrder({2, OrderType::Limit, OrderSide::Buy, 0, 1, 60, 0});
+	waitFor([&] { return ex.selfTradeCancels() == 1 && gate.openOrders(2) == 1; });
+	ex.stop();
+	loop.join();
+	EXPECT_EQ(gate.openOrders(2), 1);
+	EXPECT_EQ(gate.reservedInventory(2), 0);
+	EXPECT_EQ(gate.reservedCash(2), toCash(60));
+}
+
+TEST(Stats, HistogramBucketsKeepRelativePrecision) {
+	for (std::uint64_t v : {0ull, 1ull, 15ull, 16ull, 17ull, 100ull, 1000ull, 123456ull, 1ull << 40}) {
+		const std::size_t b = LatencyHistogram::bucketOf(v);
+		ASSERT_LT(b, LatencyHistogram::kBuckets);
+		const std::uint64_t lo = LatencyHistogram::valueOf(b);
+		EXPECT_LE(lo, v);
+		EXPECT_LE(v - lo, v / 16);
+		EXPECT_EQ(LatencyHistogram::bucketOf(lo), b);
+	}
+	EXPECT_EQ(LatencyHistogram::bucketOf(~std::uint64_t{0}), LatencyHistogram::kBuckets - 1);
+}
+
+TEST(Stats, CountersAndLatenciesAggregateAcrossThreads) {
+	if (!telemetry::snapshot().enabled) GTEST_SKIP();
+	const StatsSnapshot before = telemetry::snapshot();
+	std::vector<std::thread> threads;
+	for (int t = 0; t < 4; ++t)
+		threads.emplace_back([] {
+			for (int i = 0; i < 1000; ++i) {
+				telemetry::count(StatCounter::SelfTrades);
+				telemetry::record(StatLatency::FairPrice, telemetry::now() - 1000);
+			}
+		});
+	for (auto& t : threads) t.join();
+
+	// потоки завершились, накопленное ими не теряется
+	const StatsSnapshot after = telemetry::snapshot();
+	EXPECT_EQ(after.counter(StatCounter::SelfTrades) - before.counter(StatCounter::SelfTrades), 4000u);
+	const LatencySummary& l = after.latency(StatLatency::FairPrice);
+	EXPECT_EQ(l.count - before.latency(StatLatency::FairPrice).count, 4000u);
+	EXPECT_GE(l.p50, 1000u * 15 / 16);
+	EXPECT_LE(l.p50, l.p99);
+	EXPECT_LE(l.p99, l.max);
+}
+
+TEST(Stats, CountingMutexSeesContention) {
+	if (!telemetry::snapshot().enabled) GTEST_SKIP();
+	BookMutex m;
+	const StatsSnapshot before = telemetry::snapshot();
+	m.lock();
+	std::thread waiter([&] { std::lock_guard<BookMutex> lk(m); });
+	std::this_thread::sleep_for(std::chrono::milliseconds(20));
+	m.unlock();
+	waiter.join();
+	{ std::lock_guard<BookMutex> lk(m); }
+
+	const StatsSnapshot after = telemetry::snapshot();
+	EXPECT_EQ(after.counter(StatCounter::BookLockContended) - before.counter(StatCounter::BookLockContended), 1u);
+	EXPECT_GE(after.counter(StatCounter::BookLockImmediate) - before.counter(StatCounter::BookLockImmediate), 2u);
+}
+
+TEST(Stats, ExchangeRecordsHotPath) {
+	Exchange ex;
+	const StatsSnapshot before = telemetry::snapshot();
+	if (!before.enabled) GTEST_SKIP();
+	ex.setFee(0.0, 0);
+	auto a = std::make_shared<TestBroker>(1, 1000, 0, ex);
+	auto b = std::make_shared<TestBroker>(2, 0, 10, ex);
+	ex.registerBroker(a);
+	ex.registerBroker(b);
+	ex.setConsoleOutput(false);
+	std::thread loop([&]{ ex.runLoop(); });
+	ex.submitOrder({1, OrderType::Limit, OrderSide::Buy, 0, 5, 100, 0});
+	ex.submitOrder({2, OrderType::Limit, OrderSide::Sell, 0, 5, 100, 0});
+	const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+	while (ex.tradeCount() < 1 && std::chrono::steady_clock::now() < deadline)
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	ex.stop();
+	loop.join();
+
+	const StatsSnapshot after = telemetry::snapshot();
+	EXPECT_EQ(after.counter(StatCounter::Orders) - before.counter(StatCounter::Orders), 2u);
+	EXPECT_EQ(after.counter(StatCounter::Trades) - before.counter(StatCounter::Trades), 1u);
+	EXPECT_EQ(after.latency(StatLatency::SubmitToBook).count - before.latency(StatLatency::SubmitToBook).count, 2u);
+	EXPECT_GT(after.latency(StatLatency::BookToTrade).count, before.latency(StatLatency::BookToTrade).count);
+	EXPECT_GT(after.latency(StatLatency::Settlement).count, before.latency(StatLatency::Settlement).count);
+	EXPECT_GT(after.counter(StatCounter::BookLockImmediate), before.counter(StatCounter::BookLockImmediate));
+
+	std::ostringstream out;
+	telemetry::print(out, after);
+	EXPECT_NE(out.str().find("submit_to_book"), std::string::npos);
+}
+
+TEST(Stats, ExchangeStatsFollowBuildFlag) {
+	// идёт в обеих сборках: при STOCK_STATS=OFF сделки проходят, а телеметрия пустая
+	Exchange ex;
+	ex.setFee(0.0, 0);
+	ex.setConsoleOutput(false);
+	ex.submitOrder({1, OrderType::Limit, OrderSide::Buy, 0, 5, 100, 0});
+	ex.submitOrder({2, OrderType::Limit, OrderSide::Sell, 0, 5, 100, 0});
+	ASSERT_TRUE(ex.advanceTick());
+	EXPECT_EQ(ex.tradeCount(), 1u);
+
+	const StatsSnapshot s = ex.stats();
+	EXPECT_EQ(s.enabled, STOCK_STATS != 0);
+	std::ostringstream out;
+	telemetry::print(out, s);
+	if (STOCK_STATS) {
+		EXPECT_GE(s.counter(StatCounter::Orders), 2u);
+		EXPECT_GE(s.counter(StatCounter::Trades), 1u);
+		EXPECT_NE(out.str().find("STATS:"), std::string::npos);
+	} else {
+		for (std::size_t i = 0; i < kStatCounters; ++i) EXPECT_EQ(s.counters[i], 0u);
+		for (std::size_t i = 0; i < kStatLatencies; ++i) EXPECT_EQ(s.latencies[i].count, 0u);
+		EXPECT_TRUE(out.str().empty());
+	}
+}
+
+TEST(CounterRng, PureFunctionOfKeyAndCounter) {
+	EXPECT_EQ(counterRandom(42, 7), counterRandom(42, 7));
+	EXPECT_NE(counterRandom(42, 7), counterRandom(42, 8));
+	EXPECT_NE(brokerKey(0, 1), brokerKey(0, 2));
+	EXPECT_NE(brokerKey(0, 1), brokerKey(1, 1));
+
+	double sum = 0;
+	for (std::uint64_t i = 0; i < 100000; ++i) {
+		const double u = unitRandom(counterRandom(brokerKey(3, 5), i));
+		ASSERT_GE(u, 0.0);
+		ASSERT_LT(u, 1.0);
+		sum += u;
+	}
+	EXPECT_NEAR(sum / 100000, 0.5, 0.01);
+}
+
+TEST(Population, BatchMatchesSingleBrokerRule) {
+	Exchange ex;
+	BrokerPopulation<PlayerStrategy> pop(ex, {.firstId = 10, .size = 256, .cash = 1e6, .inventory = 1000, .seed = 7});
+	pop.generate(0);
+	pop.generate(1);
+	const OrderColumns batch = pop.lastOrders();
+
+	const QuoteSnapshot q = ex.quote();
+	const MarketView m{q, q.fairPrice(FairPriceKind::Vwap), 1, 1};
+	std::size_t buys = 0;
+	std::set<double> prices;
+	for (std::size_t i = 0; i < pop.size(); ++i) {
+		const std::uint64_t key = brokerKey(7, pop.brokerId(i));
+		std::int8_t side = 0;
+		double price = 0;
+		int qty = 0;
+		pop.rules().generate(m, {&key, 1}, {{&side, 1}, {&price, 1}, {&qty, 1}});
+		EXPECT_EQ(batch.side[i], side);
+		EXPECT_EQ(batch.price[i], price);
+		EXPECT_EQ(batch.quantity[i], qty);
+		EXPECT_GE(qty, 3);
+		EXPECT_LT(qty, 11);
+		buys += side > 0;
+		prices.insert(price);
+	}
+	// у каждого брокера свой поток: решения не совпадают
+	EXPECT_GT(prices.size(), pop.size() - 2);
+	EXPECT_GT(buys, pop.size() / 4);
+	EXPECT_LT(buys, pop.size() * 3 / 4);
+}
+
+TEST(Population, KeepsOneRestingOrderPerBroker) {
+	Exchange ex;
+	ex.setFee(0.0, 0);
+	BrokerPopulation<PlayerStrategy> pop(ex, {.firstId = 100, .size = 50, .cash = 1e6, .inventory = 1000});
+	EXPECT_EQ(ex.account(100).cash, 1e6);
+	EXPECT_EQ(ex.account(149).inventory, 1000);
+
+	EXPECT_EQ(pop.step(0), 50u);
+	EXPECT_EQ(pop.step(1), 50u);
+	for (std::size_t i = 0; i < pop.size(); ++i) {
+		EXPECT_NE(pop.restingOrder(i), 0u);
+		EXPECT_EQ(ex.riskGate().openOrders(pop.brokerId(i)), 1);
+	}
+}
+
+TEST(Population, OrdersGoToConfiguredSymbol) {
+	Exchange ex(ExchangeConfig{.instruments = 2});
+	ex.setFee(0.0, 0);
+	BrokerPopulation<PlayerStrategy> pop(ex, {.firstId = 100, .size = 50, .cash = 1e6, .inventory = 1000, .symbol = 1});
+
+	EXPECT_EQ(pop.step(0), 50u);
+	std::set<std::size_t> ids;
+	for (std::size_t i = 0; i < pop.size(); ++i) ids.insert(pop.restingOrder(i));
+	EXPECT_EQ(ids.size(), pop.size());
+	double price = 0;
+	EXPECT_FALSE(ex.bestBidPrice(price, 0));
+	EXPECT_FALSE(ex.bestAskPrice(price, 0));
+	EXPECT_TRUE(ex.bestBidPrice(price, 1) || ex.bestAskPrice(price, 1));
+}
+
+namespace {
+
+struct SimulationRun {
+	std::vector<Trade> trades;
+	std::vector<AccountSnapshot> accounts;
+	int tick{};
+};
+
+SimulationRun simulate(int ticks) {
+	Exchange ex(ExchangeConfig{.instruments = 2});
+	ex.setFee(0.5, 50);
+	ex.setConsoleOutput(false);
+	Simulation sim(ex);
+	for (int id = 1; id <= 4; ++id) {
+		auto p = std::make_shared<PlayerBroker>(id, 1e5, 500, ex, 11);
+		ex.registerBroker(p);
+		sim.add(p, id);
+	}
+	auto a = std::make_shared<AnalystBroker>(5, 1e5, 500, ex);
+	auto b = std::make_shared<BigWinBroker>(6, 1e5, 500, ex, 0.02);
+	ex.registerBroker(a);
+	ex.registerBroker(b);
+	sim.add(a, 3);
+	sim.add(b, 5, 1);
+	auto pop = std::make_shared<BrokerPopulation<PlayerStrategy>>(
+		ex, PopulationConfig{.firstId = 100, .size = 200, .cash = 1e5, .inventory = 500, .symbol = 1, .seed = 3});
+	sim.add([pop](int t) { pop->step(t); }, 2);
+
+	SimulationRun r;
+	r.tick = sim.run(ticks);
+	for (Symbol s = 0; s < 2; ++s) {
+		const auto tr = ex.tradesBetween(0, INT_MAX, s);
+		r.trades.insert(r.trades.end(), tr.begin(), tr.end());
+	}
+	for (int id : {1, 2, 3, 4, 5, 6, 100, 150, 299}) r.accounts.push_back(ex.account(id));
+	return r;
+}
+
+} // namespace
+
+TEST(Simulation, SameSeedsReproduceRunExactly) {
+	const auto start = std::chrono::steady_clock::now();
+	const SimulationRun first = simulate(3000);     // минута рыночного времени при тике 20 мс
+	EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(30));
+	const SimulationRun second = simulate(3000);
+
+	EXPECT_EQ(first.tick, 3000);
+	ASSERT_GT(first.trades.size(), 100u);
+	ASSERT_EQ(first.trades.size(), second.trades.size());
+	for (std::size_t i = 0; i < first.trades.size(); ++i) {
+		const Trade& x = first.trades[i];
+		const Trade& y = second.trades[i];
+		ASSERT_EQ(x.price, y.price) << i;
+		ASSERT_EQ(x.quantity, y.quantity) << i;
+		ASSERT_EQ(x.buyerId, y.buyerId) << i;
+		ASSERT_EQ(x.sellerId, y.sellerId) << i;
+		ASSERT_EQ(x.executedAt, y.executedAt) << i;
+		ASSERT_EQ(x.buyOrderId, y.buyOrderId) << i;
+	}
+	for (std::size_t i = 0; i < first.accounts.size(); ++i) {
+		EXPECT_EQ(first.accounts[i].cash, second.accounts[i].cash);
+		EXPECT_EQ(first.accounts[i].inventory, second.accounts[i].inventory);
+	}
+}
+
+TEST(Simulation, SequencesStepsMatchingAndFeesByTick) {
+	Exchange ex;
+	ex.setFee(1.0, 10);
+	ex.setConsoleOutput(false);
+	auto a = std::make_shared<TestBroker>(1, 1000, 10, ex);
+	auto b = std::make_shared<TestBroker>(2, 1000, 10, ex);
+	ex.registerBroker(a);
+	ex.registerBroker(b);
+
+	Simulation sim(ex);
+	std::vector<int> seen;
+	sim.add([&](int t) { seen.push_back(t); }, 4, 1);
+	// заявки шага тика 5 сводятся в конце того же тика
+	sim.add([&](int t) {
+		if (t != 5) return;
+		ex.submitOrder({1, OrderType::Limit, OrderSide::Buy, 0, 2, 100, t});
+		ex.submitOrder({2, OrderType::Limit, OrderSide::Sell, 0, 2, 100, t});
+		EXPECT_EQ(ex.tradeCount(), 0u);
+	});
+
+	EXPECT_EQ(sim.run(6), 6);
+	EXPECT_EQ(ex.tradeCount(), 1u);
+	EXPECT_EQ(ex.tradesBetween(0, INT_MAX).front().executedAt, 5);
+	EXPECT_EQ(sim.run(94), 100);
+	EXPECT_EQ(sim.now(), 100);
+	EXPECT_EQ(seen.size(), 25u);
+	EXPECT_EQ(seen[1], 5);
+	// комиссия на тиках 0, 10, ..., 90
+	EXPECT_DOUBLE_EQ(a->cash(), 1000 - 200 - 10);
+	EXPECT_EQ(b->inventory(), 8);
+	EXPECT_EQ(sim.steps(), 125u);
+}
+
+TEST(Snapshot, RestoresBooksAccountsAndFairPrice) {
+	for (const BookKind kind : {BookKind::Map, BookKind::Ladder}) {
+		const std::string path = (std::filesystem::temp_directory_path() / "stock_snapshot_test.snap").string();
+		size_t lastId = 0;
+		{
+			Exchange ex(ExchangeConfig{.book = kind, .instruments = 2});
+			ex.setFee(0.0, 0);
+			for (int id = 1; id <= 3; ++id) ex.registerBroker(std::make_shared<TestBroker>(id, 10000, 100, ex));
+			ex.registerAccount(4, 0, 100, 1);       // бумаги инструмента 1
+			Simulation sim(ex);
+			ex.submitOrder({1, OrderType::Limit, OrderSide::Buy, 0, 5, 100, 0});
+			ex.submitOrder({2, OrderType::Limit, OrderSide::Sell, 0, 2, 100, 0});
+			sim.run(1);
+			// очередь на 99: сначала 1, потом 3; на 101 по инструменту 1 - продажа 4
+			ex.submitOrder({1, OrderType::Limit, OrderSide::Buy, 0, 4, 99, 0});
+			ex.submitOrder({3, OrderType::Limit, OrderSide::Buy, 0, 6, 99, 0});
+			ASSERT_NE(ex.submitOrder({4, OrderType::Limit, OrderSide::Sell, 0, 7, 101, 0, 1}), 0u);
+			lastId = ex.submitOrder({3, OrderType::Limit, OrderSide::Sell, 0, 1, 103, 0});
+			sim.run(1);
+			ASSERT_TRUE(ex.saveSnapshot(path));
+		}
+
+		Exchange ex(ExchangeConfig{.book = kind, .instruments = 2});
+		ex.setFee(0.0, 0);
+		ASSERT_TRUE(ex.loadSnapshot(path));
+		std::filesystem::remove(path);
+		auto b1 = std::make_shared<TestBroker>(1, 10000, 100, ex);
+		ex.registerBroker(b1);
+
+		EXPECT_EQ(ex.tick(), 2);
+		EXPECT_DOUBLE_EQ(b1->cash(), 10000 - 200);
+		EXPECT_EQ(b1->inventory(), 102);
+		EXPECT_EQ(ex.account(2).inventory, 98);
+		EXPECT_EQ(ex.account(4, 1).inventory, 100);
+		EXPECT_EQ(ex.account(4, 0).inventory, 0);
+		EXPECT_DOUBLE_EQ(ex.fairPriceEstimate(), 100.0);
+		const QuoteSnapshot q = ex.quote();
+		EXPECT_DOUBLE_EQ(q.bid, 100);
+		EXPECT_EQ(q.bidSize, 3);
+		EXPECT_DOUBLE_EQ(q.ask, 103);
+		EXPECT_DOUBLE_EQ(ex.quote(1).ask, 101);
+		// резервы стоящих заявок: 3 * 100 + 4 * 99 у первого, бумаги продавцов - по своим инструментам
+		EXPECT_EQ(ex.riskGate().reservedCash(1), toCash(300 + 396));
+		EXPECT_EQ(ex.riskGate().reservedInventory(4, 1), 7);
+		EXPECT_EQ(ex.riskGate().reservedInventory(3, 0), 1);
+		EXPECT_EQ(ex.riskGate().openOrders(1), 2);
+		EXPECT_GT(ex.submitOrder({2, OrderType::Limit, OrderSide::Sell, 0, 8, 99, 0}), lastId);
+
+		// очередь уровня 99 сохранилась: 3 по 100, затем 4 брокеру 1, затем 1 брокеру 3
+		Simulation sim(ex);
+		sim.run(1);
+		const auto trades = ex.tradesBetween(0, INT_MAX);
+		ASSERT_EQ(trades.size(), 3u);
+		EXPECT_EQ(trades[0].buyerId, 1);
+		EXPECT_EQ(trades[0].quantity, 3);
+		EXPECT_EQ(trades[1].buyerId, 1);
+		EXPECT_EQ(trades[1].quantity, 4);
+		EXPECT_EQ(trades[2].buyerId, 3);
+		EXPECT_EQ(trades[2].quantity, 1);
+		EXPECT_EQ(ex.riskGate().reservedCash(1), 0);
+	}
+}
+
+TEST(Snapshot, RealClockContinuesFromRestoredTick) {
+	const std::string path = (std::filesystem::temp_directory_path() / "stock_snapshot_clock.snap").string();
+	{
+		Exchange ex;
+		ex.setFee(0.0, 0);
+		ex.registerAccount(1, 10000, 0);
+		ex.registerAccount(2, 0, 100);
+		ex.submitOrder({2, OrderType::Limit, OrderSide::Sell, 0, 3, 100, 0});
+		for (int i = 0; i < 500; ++i) ex.advanceTick();
+		ASSERT_TRUE(ex.saveSnapshot(path));
+	}
+
+	Exchange ex(ExchangeConfig{.tick = std::chrono::milliseconds(1)});
+	ex.setFee(0.0, 0);
+	ex.setConsoleOutput(false);
+	ASSERT_TRUE(ex.loadSnapshot(path));
+	std::filesystem::remove(path);
+	ASSERT_EQ(ex.tick(), 500);
+
+	std::thread loop([&] { ex.runLoop(); });
+	ex.submitOrder({1, OrderType::Limit, OrderSide::Buy, 0, 3, 100, 0});
+	const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+	while (ex.tradeCount() < 1 && std::chrono::steady_clock::now() < deadline)
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	ex.stop();
+	loop.join();
+
+	// часы не сбросились в 0: сделка датирована после восстановленного тика
+	const int now = ex.tick();
+	EXPECT_GE(now, 500);
+	EXPECT_TRUE(ex.tradesBetween(0, 500).empty());
+	const auto trades = ex.tradesBetween(500, now + 1);
+	ASSERT_EQ(trades.size(), 1u);
+	EXPECT_GE(trades[0].executedAt, 500);
+	EXPECT_EQ(trades[0].quantity, 3);
+}
+
+TEST(Snapshot, ConsistentWhileMatching) {
+	const std::string path = (std::filesystem::temp_directory_path() / "stock_snapshot_live.snap").string();
+	constexpr int kBrokers = 8;
+	{
+		Exchange ex(ExchangeConfig{.instruments = 4, .shards = 2});
+		ex.setFee(0.0, 0);
+		ex.setConsoleOutput(false);
+		for (int id = 1; id <= kBrokers; ++id) ex.registerAccount(id, 1e6, 1000);
+		std::thread loop([&] { ex.runLoop(); });
+		std::atomic<bool> flowing{true};
+		std::vector<std::thread> producers;
+		for (int id = 1; id <= kBrokers; ++id)
+			producers.emplace_back([&, id] {
+				for (int i = 0; flowing; ++i)
+					ex.submitOrder({id, OrderType::Limit, (i + id) % 2 ? OrderSide::Buy : OrderSide::Sell, 0,
+					                1 + i % 3, 100.0 + (i % 5) - 2, 0, static_cast<Symbol>(i % 4)});
+			});
+		while (ex.tradeCount() < 1000) std::this_thread::yield();
+		ASSERT_TRUE(ex.saveSnapshot(path));
+		flowing = false;
+		for (auto& t : producers) t.join();
+		ex.stop();
+		loop.join();
+	}
+
+	SnapshotReader reader;
+	ASSERT_TRUE(reader.open(path));
+	EXPECT_EQ(reader.header().version, kSnapshotVersion);
+	const auto accounts = reader.section<AccountRecord>(SnapshotSection::Accounts);
+	ASSERT_EQ(accounts.size(), static_cast<std::size_t>(kBrokers));
+	// снято на границе: бумаги каждого инструмента и деньги сходятся,
+	// а резервы совпадают с заявками в стаканах
+	std::array<long long, 4> inventory{};
+	Cash cash = 0;
+	for (const AccountRecord& a : accounts) cash += a.cash;
+	for (const PositionRecord& p : reader.section<PositionRecord>(SnapshotSection::Positions)) {
+		ASSERT_LT(p.symbol, inventory.size());
+		inventory[p.symbol] += p.inventory;
+	}
+	EXPECT_EQ(inventory, (std::array<long long, 4>{1000LL * kBrokers, 0, 0, 0}));
+	EXPECT_EQ(cash, toCash(1e6) * kBrokers);
+	for (const SnapshotOrder& o : reader.section<SnapshotOrder>(SnapshotSection::Orders)) {
+		EXPECT_TRUE(o.reserved);
+		EXPECT_EQ(o.remaining, o.order.quantity);
+	}
+	reader.close();
+
+	Exchange restored(ExchangeConfig{.instruments = 4, .shards = 2});
+	EXPECT_TRUE(restored.loadSnapshot(path));
+	EXPECT_FALSE(Exchange(ExchangeConfig{.instruments = 1}).loadSnapshot(path));
+	std::filesystem::remove(path);
+}
+
+TEST(Snapshot, RejectsForeignAndTruncatedFiles) {
+	const std::string path = (std::filesystem::temp_directory_path() / "stock_snapshot_bad.snap").string();
+	{
+		Exchange ex;
+		ex.submitOrder({1, OrderType::Limit, OrderSide::Buy, 0, 5, 100, 0});
+		ASSERT_TRUE(ex.saveSnapshot(path));
+	}
+	SnapshotReader reader;
+	EXPECT_TRUE(reader.open(path));
+	reader.close();
+	std::filesystem::resize_file(path, std::filesystem::file_size(path) - 8);
+	EXPECT_FALSE(reader.open(path));
+	EXPECT_FALSE(Exchange().loadSnapshot(path));
+	std::filesystem::remove(path);
+	EXPECT_FALSE(reader.open(path));
+}
+
+namespace {
+
+std::string gatewayName(const char* test) {
+	return "/stock_gw_" + std::string(test) + "_" + std::to_string(getpid());
+}
+
+// ответ клиенту шлюза или пустой ответ (kind == 0) через 2 с
+GatewayResponse nextResponse(GatewayClient& client) {
+	GatewayResponse r{};
+	const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+	while (!client.poll(r) && std::chrono::steady_clock::now() < deadline) std::this_thread::yield();
+	return r;
+}
+
+} // namespace
+
+TEST(Gateway, RoundTripsOrdersCancelsAndFills) {
+	Exchange ex;
+	ex.setFee(0.0, 0);
+	ex.setConsoleOutput(false);
+	ex.registerAccount(1, 10000, 0);
+	ex.registerAccount(2, 0, 10);
+	Gateway gateway(ex, {.name = gatewayName("roundtrip"), .clients = 2});
+	ASSERT_TRUE(gateway.start());
+	std::thread loop([&] { ex.runLoop(); });
+
+	GatewayClient buyer, seller;
+	ASSERT_TRUE(buyer.connect(gatewayName("roundtrip"), 1));
+	ASSERT_TRUE(seller.connect(gatewayName("roundtrip"), 2));
+	EXPECT_FALSE(GatewayClient().connect(gatewayName("roundtrip"), 3));   // слотов два
+
+	ASSERT_TRUE(seller.sendNew(11, OrderSide::Sell, OrderType::Limit, 10, 100));
+	const GatewayResponse sellAck = nextResponse(seller);
+	ASSERT_EQ(sellAck.kind, GatewayResponseKind::Ack);
+	EXPECT_EQ(sellAck.clientOrderId, 11u);
+	EXPECT_NE(sellAck.orderId, 0u);
+	EXPECT_GE(sellAck.handledAt, sellAck.sentAt);
+
+	ASSERT_TRUE(buyer.sendNew(21, OrderSide::Buy, OrderType::Limit, 4, 100));
+	const GatewayResponse buyAck = nextResponse(buyer);
+	ASSERT_EQ(buyAck.kind, GatewayResponseKind::Ack);
+	const GatewayResponse buyFill = nextResponse(buyer);
+	ASSERT_EQ(buyFill.kind, GatewayResponseKind::Fill);
+	EXPECT_EQ(buyFill.clientOrderId, 21u);
+	EXPECT_EQ(buyFill.orderId, buyAck.orderId);
+	EXPECT_EQ(buyFill.quantity, 4);
+	EXPECT_EQ(buyFill.remaining, 0);
+	EXPECT_DOUBLE_EQ(buyFill.price, 100);
+	const GatewayResponse sellFill = nextResponse(seller);
+	ASSERT_EQ(sellFill.kind, GatewayResponseKind::Fill);
+	EXPECT_EQ(sellFill.clientOrderId, 11u);
+	EXPECT_EQ(sellFill.side, OrderSide::Sell);
+	EXPECT_EQ(sellFill.remaining, 6);
+
+	// чужую заявку снять нельзя, свою - можно
+	ASSERT_TRUE(buyer.sendCancel(22, sellAck.orderId));
+	const GatewayResponse foreign = nextResponse(buyer);
+	EXPECT_EQ(foreign.kind, GatewayResponseKind::Reject);
+	EXPECT_EQ(foreign.reason, GatewayReject::UnknownOrder);
+	ASSERT_TRUE(seller.sendCancel(12, sellAck.orderId));
+	EXPECT_EQ(nextResponse(seller).kind, GatewayResponseKind::CancelAck);
+
+	ASSERT_TRUE(buyer.sendNew(23, OrderSide::Buy, OrderType::Limit, 0, 100));
+	EXPECT_EQ(nextResponse(buyer).reason, GatewayReject::Malformed);
+	ASSERT_TRUE(buyer.sendNew(24, OrderSide::Buy, OrderType::Limit, 1, 100, 7));    // нет инструмента
+	EXPECT_EQ(nextResponse(buyer).reason, GatewayReject::Exchange);
+	ASSERT_TRUE(buyer.sendNew(25, OrderSide::Buy, OrderType::Limit, 1000, 100));    // денег не хватит
+	EXPECT_EQ(nextResponse(buyer).reason, GatewayReject::Exchange);
+
+	gateway.stop();
+	EXPECT_FALSE(buyer.serverAlive());
+	ex.stop();
+	loop.join();
+	EXPECT_EQ(ex.account(1).inventory, 4);
+	EXPECT_EQ(ex.account(2).inventory, 6);
+	const GatewayStats st = gateway.stats();
+	EXPECT_EQ(st.requests, 7u);
+	EXPECT_EQ(st.fills, 2u);
+	EXPECT_EQ(st.connects, 2u);
+}
+
+TEST(Gateway, BackPressureLosesNoResponsesAndSlotsAreReused) {
+	Exchange ex;
+	ex.setFee(0.0, 0);
+	ex.setConsoleOutput(false);
+	ex.registerAccount(1, 1e9, 0);
+	ex.registerAccount(2, 1e9, 0);
+	Gateway gateway(ex, {.name = gatewayName("pressure"), .clients = 1});
+	ASSERT_TRUE(gateway.start());
+	std::thread loop([&] { ex.runLoop(); });
+
+	GatewayClient client;
+	ASSERT_TRUE(client.connect(gatewayName("pressure"), 1));
+	// ответы не читаем: шлюз заполняет кольцо ответов и перестаёт брать запросы,
+	// так что клиент упирается в полное кольцо запросов
+	std::uint64_t sent = 0;
+	const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+	while (std::chrono::steady_clock::now() < deadline) {
+		if (client.sendNew(sent + 1, OrderSide::Buy, OrderType::Limit, 1, 1.0 + static_cast<double>(sent % 100) * 0.01))
+			++sent;
+		else if (gateway.stats().requests == kGatewayRingCapacity)
+			break;
+		else
+			std::this_thread::yield();
+	}
+	EXPECT_EQ(sent, 2 * kGatewayRingCapacity);
+	EXPECT_EQ(gateway.stats().backlogged, 0u);
+
+	std::uint64_t acks = 0;
+	bool ordered = true;
+	while (acks < sent) {
+		const GatewayResponse r = nextResponse(client);
+		if (r.kind != GatewayResponseKind::Ack) break;
+		ordered = ordered && r.clientOrderId == acks + 1;
+		++acks;
+	}
+	EXPECT_EQ(acks, sent);
+	EXPECT_TRUE(ordered);
+
+	// закрытый слот шлюз освобождает, и его занимает следующий клиент
+	client.close();
+	GatewayClient next;
+	const auto reconnect = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+	while (!next.connect(gatewayName("pressure"), 2) && std::chrono::steady_clock::now() < reconnect)
+		std::this_thread::yield();
+	ASSERT_TRUE(next.connected());
+	ASSERT_TRUE(next.sendNew(1, OrderSide::Buy, OrderType::Limit, 1, 1.0));
+	EXPECT_EQ(nextResponse(next).kind, GatewayResponseKind::Ack);
+
+	gateway.stop();
+	ex.stop();
+	loop.join();
+	EXPECT_EQ(gateway.stats().connects, 2u);
+}
+
+TEST(Auction, ClearingPriceMaximizesVolumeThenBalance) {
+	const std::vector<BookLevel> bids{{102, 5}, {101, 10}, {100, 10}};
+	const std::vector<BookLevel> asks{{99, 8}, {100, 7}, {101, 20}};
+	// по 100 и 101 исполняется 15, но по 100 дисбаланс меньше
+	const AuctionClearing c = clearingPrice(bids, 0, asks, 0, -1);
+	EXPECT_EQ(c.price, 100);
+	EXPECT_EQ(c.volume, 15);
+	EXPECT_EQ(c.imbalance, 10);
+
+	// равные объём и дисбаланс - решает опорная цена
+	const std::vector<BookLevel> bid{{101, 10}};
+	const std::vector<BookLevel> ask{{100, 10}};
+	EXPECT_EQ(clearingPrice(bid, 0, ask, 0, 100.9).price, 101);
+	EXPECT_EQ(clearingPrice(bid, 0, ask, 0, 100.2).price, 100);
+	// рыночная покупка берёт всё предложение до цены, где его хватает
+	EXPECT_EQ(clearingPrice({}, 12, asks, 0, -1).price, 100);
+	EXPECT_EQ(clearingPrice(bid, 0, std::vector<BookLevel>{{102, 3}}, 0, -1).volume, 0);
+
+	// одни рыночные заявки сводятся по последней сделке, без неё - никак
+	const AuctionClearing m = clearingPrice({}, 5, {}, 3, 100);
+	EXPECT_EQ(m.price, 100);
+	EXPECT_EQ(m.volume, 3);
+	EXPECT_EQ(m.imbalance, 2);
+	EXPECT_EQ(clearingPrice({}, 5, {}, 3, -1).volume, 0);
+	EXPECT_EQ(clearingPrice({}, 5, {}, 0, 100).volume, 0);
+}
 
+TEST(Auction, BooksAllocateMarginalLevelByTimeOrProRata) {
+	for (const BookKind kind : {BookKind::Map, BookKind::Ladder}) {
+		for (const AuctionAllocation allocation : {AuctionAllocation::TimePriority, AuctionAllocation::ProRata}) {
+			auto book = makeBook(kind, 100);
+			book->addOrder({1, OrderType::Limit, OrderSide::Buy, 1, 5, 102, 0});
+			book->addOrder({3, OrderType::Limit, OrderSide::Buy, 2, 6, 100, 0});
+			book->addOrder({4, OrderType::Limit, OrderSide::Buy, 3, 4, 100, 0});
+			book->addOrder({5, OrderType::Limit, OrderSide::Sell, 4, 8, 99, 0});
+			book->addOrder({6, OrderType::Limit, OrderSide::Sell, 5, 4, 100, 0});
+			book->addOrder({7, OrderType::Limit, OrderSide::Sell, 6, 20, 101, 0});
 
+			std::vector<Trade> out;
+			ASSERT_GT(book->auction(9, {allocation, -1}, out), 0u);
+			std::unordered_map<std::size_t, int> bought;
+			int volume = 0;
+			for (const Trade& tr : out) {
+				EXPECT_EQ(tr.price, 100);
+				EXPECT_EQ(tr.executedAt, 9);
+				bought[tr.buyOrderId] += tr.quantity;
+				volume += tr.quantity;
+			}
+			EXPECT_EQ(volume, 12);
+			EXPECT_EQ(bought[1], 5);
+			// на уровне 100 делятся 7 штук из 10: по времени 6 + 1, пропорционально 4.2 + 2.8 -> 5 + 2
+			const bool time = allocation == AuctionAllocation::TimePriority;
+			EXPECT_EQ(bought[2], time ? 6 : 5);
+			EXPECT_EQ(bought[3], time ? 1 : 2);
+
+			const TopOfBook top = book->top();
+			EXPECT_EQ(top.bid, 100);
+			EXPECT_EQ(top.bidSize, 3);
+			EXPECT_EQ(top.ask, 101);
+			EXPECT_EQ(book->auction(10, {allocation, -1}, out), 0u);
+		}
+	}
+}
+
+TEST(Auction, SameBrokerIsNotCrossedWithItself) {
+	for (const BookKind kind : {BookKind::Map, BookKind::Ladder}) {
+		auto book = makeBook(kind, 100);
+		// первой идёт рыночная покупка брокера 1, первой по времени - его же продажа
+		book->addOrder({1, OrderType::Market, OrderSide::Buy, 1, 5, 0, 0});
+		book->addOrder({3, OrderType::Limit, OrderSide::Buy, 2, 5, 101, 0});
+		book->addOrder({1, OrderType::Limit, OrderSide::Sell, 3, 5, 100, 0});
+		book->addOrder({2, OrderType::Limit, OrderSide::Sell, 4, 5, 100, 0});
+
+		std::vector<Trade> out;
+		book->auction(0, {}, out);
+		int volume = 0;
+		for (const Trade& tr : out) {
+			EXPECT_NE(tr.buyerId, tr.sellerId);
+			volume += tr.quantity;
+		}
+		EXPECT_EQ(volume, 10);
+	}
+}
+
+TEST(Auction, MarketOrdersClearAtLastPrice) {
+	for (const BookKind kind : {BookKind::Map, BookKind::Ladder}) {
+		auto book = makeBook(kind, 100);
+		book->addOrder({1, OrderType::Market, OrderSide::Buy, 1, 5, 0, 0});
+		book->addOrder({2, OrderType::Market, OrderSide::Sell, 2, 3, 0, 0});
+
+		std::vector<Trade> out;
+		EXPECT_EQ(book->auction(0, {AuctionAllocation::TimePriority, -1}, out), 0u);
+		ASSERT_EQ(book->auction(1, {AuctionAllocation::TimePriority, 101.5}, out), 1u);
+		EXPECT_EQ(out[0].price, 101.5);
+		EXPECT_EQ(out[0].quantity, 3);
+		EXPECT_EQ(out[0].buyOrderId, 1u);
+	}
+}
+
+TEST(Auction, MissedCallTickRunsOnNextPass) {
+	// часы runLoop могут шагнуть через тик аукциона; снимок пустой биржи на тике 7 делает то же
+	const std::string path = (std::filesystem::temp_directory_path() / "stock_auction_skip.snap").string();
+	{
+		Exchange ex;
+		for (int t = 0; t < 7; ++t) ASSERT_TRUE(ex.advanceTick());
+		ASSERT_TRUE(ex.saveSnapshot(path));
+	}
 
+	Exchange ex(ExchangeConfig{.matching = MatchingMode::Auction, .auctionTicks = 5});
+	ex.setFee(0.0, 0);
+	ex.setConsoleOutput(false);
+	ex.registerAccount(1, 10000, 0);
+	ex.registerAccount(2, 0, 100);
+	ASSERT_TRUE(ex.advanceTick());
+	ex.submitOrder({1, OrderType::Limit, OrderSide::Buy, 0, 4, 100, 1});
+	ex.submitOrder({2, OrderType::Limit, OrderSide::Sell, 0, 4, 100, 1});
+	ASSERT_TRUE(ex.advanceTick());
+	EXPECT_EQ(ex.tradeCount(), 0u);
 
+	ASSERT_TRUE(ex.loadSnapshot(path));
+	std::filesystem::remove(path);
+	ASSERT_EQ(ex.tick(), 7);
+	ASSERT_TRUE(ex.advanceTick());
+	EXPECT_EQ(ex.tradeCount(), 1u);
+	const auto trades = ex.tradesBetween(0, INT_MAX);
+	ASSERT_EQ(trades.size(), 1u);
+	EXPECT_EQ(trades[0].executedAt, 7);
+
+	// следующий аукцион - снова на тике, кратном 5
+	ex.submitOrder({1, OrderType::Limit, OrderSide::Buy, 0, 1, 100, 8});
+	ex.submitOrder({2, OrderType::Limit, OrderSide::Sell, 0, 1, 100, 8});
+	ASSERT_TRUE(ex.advanceTick());
+	ASSERT_TRUE(ex.advanceTick());
+	EXPECT_EQ(ex.tradeCount(), 1u);
+	ASSERT_TRUE(ex.advanceTick());
+	EXPECT_EQ(ex.tradeCount(), 2u);
+}
+
+TEST(Auction, ExchangeAccumulatesUntilTheCall) {
+	Exchange ex(ExchangeConfig{.matching = MatchingMode::Auction, .auctionTicks = 5});
+	ex.setFee(0.0, 0);
+	ex.setConsoleOutput(false);
+	for (int id = 1; id <= 3; ++id) ex.registerAccount(id, 10000, 100);
+	EXPECT_EQ(ex.matchingMode(), MatchingMode::Auction);
+
+	ASSERT_TRUE(ex.advanceTick());
+	ex.submitOrder({1, OrderType::Limit, OrderSide::Buy, 0, 10, 101, 1});
+	ex.submitOrder({2, OrderType::Limit, OrderSide::Sell, 0, 4, 100, 1});
+	ex.submitOrder({3, OrderType::Limit, OrderSide::Sell, 0, 6, 99, 1});
+	for (int t = 1; t < 5; ++t) ASSERT_TRUE(ex.advanceTick());
+	// до аукциона стакан пересечён и виден таким в котировках
+	EXPECT_EQ(ex.tradeCount(), 0u);
+	const QuoteSnapshot q = ex.quote();
+	EXPECT_GT(q.bid, q.ask);
+
+	ASSERT_TRUE(ex.advanceTick());
+	const auto trades = ex.tradesBetween(0, INT_MAX);
+	ASSERT_EQ(trades.size(), 2u);
+	for (const Trade& tr : trades) {
+		EXPECT_EQ(tr.price, 100);
+		EXPECT_EQ(tr.executedAt, 5);
+	}
+	EXPECT_EQ(ex.account(1).inventory, 110);
+	EXPECT_EQ(ex.riskGate().openOrders(1), 0);
+
+	// обратно в непрерывный режим: сделка на том же тике, без ожидания аукциона
+	ex.setMatchingMode(MatchingMode::Continuous);
+	ex.submitOrder({1, OrderType::Limit, OrderSide::Buy, 0, 2, 100, 6});
+	ex.submitOrder({2, OrderType::Limit, OrderSide::Sell, 0, 1, 100, 6});
+	ASSERT_TRUE(ex.advanceTick());
+	EXPECT_EQ(ex.tradeCount(), 3u);
+}
+
+TEST(Sweep, ParallelRunsMatchSequentialAndSeedsDiffer) {
+	std::vector<SweepRun> runs;
+	for (std::uint64_t seed = 1; seed <= 4; ++seed)
+		for (const double threshold : {0.01, 0.05})
+			runs.push_back({.seed = seed, .ticks = 1000, .bigWinThreshold = threshold, .population = seed == 4 ? 50u : 0u});
+
+	const std::vector<SweepResult> one = runSweep(runs, 1);
+	const std::vector<SweepResult> many = runSweep(runs, 4);
+	ASSERT_EQ(one.size(), runs.size());
+	ASSERT_EQ(many.size(), runs.size());
+	for (std::size_t i = 0; i < runs.size(); ++i) {
+		EXPECT_EQ(one[i].run.seed, runs[i].seed) << i;
+		EXPECT_GT(one[i].trades, 0u) << i;
+		EXPECT_EQ(one[i].trades, many[i].trades) << i;
+		EXPECT_EQ(one[i].volume, many[i].volume) << i;
+		EXPECT_EQ(one[i].vwap, many[i].vwap) << i;
+		EXPECT_EQ(one[i].pnl, many[i].pnl) << i;
+		EXPECT_EQ(one[i].populationPnl, many[i].populationPnl) << i;
+	}
+	EXPECT_NE(one[0].vwap, one[2].vwap);
+	EXPECT_NE(one[6].populationPnl, 0.0);
+
+	std::ostringstream csv;
+	writeSweepCsv(csv, one);
+	const std::string table = csv.str();
+	EXPECT_EQ(std::count(table.begin(), table.end(), '\n'), static_cast<std::ptrdiff_t>(runs.size() + 1));
+	std::ostringstream json;
+	writeSweepJson(json, one);
+	EXPECT_EQ(json.str().front(), '[');
+	EXPECT_NE(json.str().find("\"pnl_bigwin\""), std::string::npos);
+}
+
+TEST(Exchange, ConsoleGoesToItsOwnStream) {
+	ExchangeConfig config;
+	config.riskReportTicks = 1;
+	Exchange ex(config);
+	std::ostringstream out;
+	ex.setConsole(out);
+	ex.registerBroker(std::make_shared<TestBroker>(1, 1000, 10, ex));
+	ex.registerBroker(std::make_shared<TestBroker>(2, 1000, 10, ex));
+	ex.submitOrder({1, OrderType::Limit, OrderSide::Buy, 0, 2, 100, 0});
+	ex.submitOrder({2, OrderType::Limit, OrderSide::Sell, 0, 2, 100, 0});
+	ASSERT_TRUE(ex.advanceTick());
+	EXPECT_NE(out.str().find("RISK"), std::string::npos);
+
+	ex.setConsoleOutput(false);
+	const std::size_t before = out.str().size();
+	ASSERT_TRUE(ex.advanceTick());
+	EXPECT_EQ(out.str().size(), before);
+}
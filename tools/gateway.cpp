@@ -0,0 +1,63 @@
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <iostream>
+#include <string>
+#include <thread>
+#include "../src/Exchange.h"
+#include "../src/Gateway.h"
+#include "../src/Stats.h"
+
+namespace {
+
+std::atomic<bool> interrupted{false};
+
+void onSignal(int) {
+	interrupted = true;
+}
+
+} // namespace
+
+// Биржа, принимающая заявки только через шлюз в разделяемой памяти:
+// stock_gateway [name] [seconds] [clients]
+// seconds = 0 - до SIGINT/SIGTERM. Счета брокеров 1..kGatewayMaxClients открываются заранее.
+int main(int argc, char** argv) {
+	if (argc > 4) {
+		std::cerr << "usage: " << argv[0] << " [name] [seconds] [clients]\n";
+		return 2;
+	}
+	GatewayConfig gc;
+	if (argc > 1) gc.name = argv[1];
+	const int seconds = argc > 2 ? std::stoi(argv[2]) : 0;
+	if (argc > 3) gc.clients = static_cast<std::size_t>(std::stoi(argv[3]));
+
+	ExchangeConfig config;
+	config.riskReportTicks = 0;
+	Exchange ex(config);
+	ex.setConsoleOutput(false);
+	for (int id = 1; id <= static_cast<int>(kGatewayMaxClients); ++id)
+		ex.registerAccount(id, 1e12, 1'000'000'000);
+
+	Gateway gateway(ex, gc);
+	if (!gateway.start()) {
+		std::cerr << "cannot create shared memory segment " << gc.name << "\n";
+		return 1;
+	}
+	std::signal(SIGINT, onSignal);
+	std::signal(SIGTERM, onSignal);
+	std::thread exchangeThread([&] { ex.runLoop(); });
+	std::cout << "gateway " << gc.name << " clients=" << gc.clients << std::endl;
+
+	const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(seconds);
+	while (!interrupted && (seconds == 0 || std::chrono::steady_clock::now() < deadline))
+		std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+	gateway.stop();
+	ex.stop();
+	exchangeThread.join();
+
+	const GatewayStats s = gateway.stats();
+	std::cout << "GATEWAY: requests=" << s.requests << " acks=" << s.acks << " rejects=" << s.rejects
+	          << " fills=" << s.fills << " connects=" << s.connects << " backlogged=" << s.backlogged << "\n";
+	telemetry::print(std::cout, ex.stats());
+}
@@ -0,0 +1,93 @@
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../src/GatewayClient.h"
+
+// Нагрузочный клиент шлюза: stock_gateway_load [name] [orders] [window] [brokerId]
+// Держит до window заявок в пути; каждую после Ack снимает, так что стакан не растёт.
+// Круговая задержка - от записи запроса в кольцо до чтения ответа, по Ack и CancelAck.
+int main(int argc, char** argv) {
+	if (argc > 5) {
+		std::cerr << "usage: " << argv[0] << " [name] [orders] [window] [brokerId]\n";
+		return 2;
+	}
+	const std::string name = argc > 1 ? argv[1] : "/stock_gateway";
+	const std::uint64_t orders = argc > 2 ? std::stoull(argv[2]) : 1'000'000;
+	const std::uint64_t window = argc > 3 ? std::stoull(argv[3]) : 64;
+	const int brokerId = argc > 4 ? std::stoi(argv[4]) : 1;
+
+	GatewayClient client;
+	if (!client.connect(name, brokerId)) {
+		std::cerr << "cannot connect to gateway " << name << "\n";
+		return 1;
+	}
+
+	std::vector<std::int64_t> rtt;
+	rtt.reserve(orders * 2);
+	std::vector<GatewayResponse> cancels;   // Ack, на которые ещё не ушёл Cancel
+	std::uint64_t sent = 0, done = 0, inFlight = 0, rejects = 0, fills = 0;
+
+	const std::int64_t start = gatewayNow();
+	while (done < orders) {
+		while (!cancels.empty() && client.sendCancel(cancels.back().clientOrderId, cancels.back().orderId))
+			cancels.pop_back();
+		while (sent < orders && inFlight < window) {
+			// покупки ниже 100, продажи выше: заявки не пересекаются
+			const bool buy = (sent & 1) == 0;
+			const double price = (buy ? 90.0 : 110.0) + static_cast<double>(sent % 50) * 0.01;
+			if (!client.sendNew(sent + 1, buy ? OrderSide::Buy : OrderSide::Sell, OrderType::Limit, 1, price))
+				break;
+			++sent;
+			++inFlight;
+		}
+
+		const std::size_t n = client.drain([&](const GatewayResponse& r) {
+			const std::int64_t now = gatewayNow();
+			switch (r.kind) {
+				case GatewayResponseKind::Ack:
+					rtt.push_back(now - r.sentAt);
+					cancels.push_back(r);
+					break;
+				case GatewayResponseKind::CancelAck:
+					rtt.push_back(now - r.sentAt);
+					--inFlight;
+					++done;
+					break;
+				case GatewayResponseKind::Reject:
+					++rejects;
+					--inFlight;
+					++done;
+					break;
+				case GatewayResponseKind::Fill:
+					++fills;
+					break;
+				default:
+					break;
+			}
+		});
+		if (n == 0) {
+			if (!client.serverAlive()) {
+				std::cerr << "gateway stopped\n";
+				break;
+			}
+			// на машине с одним-двумя ядрами спин отнимал бы время у шлюза и биржи
+			std::this_thread::yield();
+		}
+	}
+	const double seconds = static_cast<double>(gatewayNow() - start) / 1e9;
+	client.close();
+
+	std::sort(rtt.begin(), rtt.end());
+	const auto pct = [&](double q) {
+		return rtt.empty() ? std::int64_t{0} : rtt[std::min(rtt.size() - 1, static_cast<std::size_t>(q * static_cast<double>(rtt.size())))];
+	};
+	std::cout << "orders=" << done << " rejects=" << rejects << " fills=" << fills
+	          << " seconds=" << seconds
+	          << " orders/s=" << static_cast<long long>(seconds > 0 ? static_cast<double>(done) / seconds : 0)
+	          << "\nRTT ns: p50=" << pct(0.5) << " p90=" << pct(0.9) << " p99=" << pct(0.99)
+	          << " p99.9=" << pct(0.999) << " max=" << (rtt.empty() ? 0 : rtt.back()) << "\n";
+	return done == orders ? 0 : 1;
+}
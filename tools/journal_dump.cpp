@@ -0,0 +1,20 @@
+#include <iostream>
+#include "../src/JournalRecord.h"
+#include "../src/MappedFile.h"
+
+// Печатает бинарный журнал сделок в текстовом виде: stock_journal_dump <file>
+int main(int argc, char** argv) {
+	if (argc != 2) {
+		std::cerr << "usage: " << argv[0] << " <journal>\n";
+		return 2;
+	}
+
+	MappedFileReader reader;
+	if (!reader.open(argv[1], kJournalMagic, kJournalVersion, sizeof(JournalRecord))) {
+		std::cerr << "cannot read journal " << argv[1] << "\n";
+		return 1;
+	}
+
+	for (const JournalRecord& r : reader.records<JournalRecord>())
+		printRecord(std::cout, r);
+}
@@ -0,0 +1,41 @@
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include "../src/Book.h"
+#include "../src/MappedFile.h"
+#include "../src/Replay.h"
+
+// Воспроизводит записанный поток заявок на максимальной скорости:
+// stock_replay <capture> [map|ladder] [repeat]
+// Шаг цены и правило самосделок - как у биржи, писавшей поток; стакан - её же, если не задан.
+int main(int argc, char** argv) {
+	if (argc < 2 || argc > 4) {
+		std::cerr << "usage: " << argv[0] << " <capture> [map|ladder] [repeat]\n";
+		return 2;
+	}
+
+	const int repeat = argc > 3 ? std::stoi(argv[3]) : 1;
+
+	MappedFileReader reader;
+	CaptureMeta meta;
+	if (!reader.open(argv[1], kCaptureMagic, kCaptureVersion, sizeof(CaptureRecord)) || !captureMeta(reader, meta)) {
+		std::cerr << "cannot read capture " << argv[1] << "\n";
+		return 1;
+	}
+	const BookKind kind = argc > 2 ? (std::string(argv[2]) == "map" ? BookKind::Map : BookKind::Ladder) : meta.book;
+	const auto records = reader.records<CaptureRecord>();
+
+	for (int i = 0; i < repeat; ++i) {
+		auto book = makeBook(kind, meta.ticksPerUnit, meta.selfTrade);
+		const ReplayResult r = replay(records, *book);
+		std::cout << "book=" << (kind == BookKind::Map ? "map" : "ladder")
+		          << " orders=" << r.orders
+		          << " amendments=" << r.amendments
+		          << " trades=" << r.trades
+		          << " seconds=" << r.seconds
+		          << " orders/s=" << static_cast<long long>(r.seconds > 0 ? r.orders / r.seconds : 0)
+		          << " trades/s=" << static_cast<long long>(r.seconds > 0 ? r.trades / r.seconds : 0)
+		          << " checksum=" << std::hex << std::setw(16) << std::setfill('0') << r.checksum << std::dec
+		          << "\n";
+	}
+}
@@ -0,0 +1,95 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../src/Sweep.h"
+
+namespace {
+
+// "0.01,0.03,0.05" -> {0.01, 0.03, 0.05}
+std::vector<double> parseList(const std::string& s) {
+	std::vector<double> out;
+	std::stringstream in(s);
+	for (std::string item; std::getline(in, item, ',');)
+		if (!item.empty()) out.push_back(std::stod(item));
+	return out;
+}
+
+} // namespace
+
+// Перебор параметров стратегий параллельными прогонами на виртуальных часах:
+// stock_sweep [--seconds S] [--seeds N] [--threshold a,b,..] [--spread a,b,..] [--fee a,b,..]
+//             [--fee-every N] [--population N] [--book map|ladder] [--threads N] [--json] [--out file]
+// Прогоны - все сочетания threshold x spread x fee x seed (seed 1..N); таблица в CSV
+// (--json - в JSON) в stdout или в файл, итог по времени - в stderr.
+int main(int argc, char** argv) {
+	SweepRun base;
+	int seconds = 60;
+	std::uint64_t seeds = 4;
+	std::vector<double> thresholds{base.bigWinThreshold}, spreads{base.playerSpread}, fees{base.fee};
+	unsigned threads = 0;
+	bool json = false;
+	std::string out;
+
+	for (int i = 1; i < argc; ++i) {
+		const std::string a = argv[i];
+		const bool hasValue = i + 1 < argc;
+		if (a == "--seconds" && hasValue)          seconds = std::stoi(argv[++i]);
+		else if (a == "--seeds" && hasValue)       seeds = std::stoull(argv[++i]);
+		else if (a == "--threshold" && hasValue)   thresholds = parseList(argv[++i]);
+		else if (a == "--spread" && hasValue)      spreads = parseList(argv[++i]);
+		else if (a == "--fee" && hasValue)         fees = parseList(argv[++i]);
+		else if (a == "--fee-every" && hasValue)   base.feeEveryTicks = std::stoi(argv[++i]);
+		else if (a == "--population" && hasValue)  base.population = std::stoull(argv[++i]);
+		else if (a == "--book" && hasValue)        base.book = std::string(argv[++i]) == "map" ? BookKind::Map : BookKind::Ladder;
+		else if (a == "--threads" && hasValue)     threads = static_cast<unsigned>(std::stoul(argv[++i]));
+		else if (a == "--json")                    json = true;
+		else if (a == "--out" && hasValue)         out = argv[++i];
+		else {
+			std::cerr << "usage: " << argv[0] << " [--seconds S] [--seeds N] [--threshold a,b,..] [--spread a,b,..]"
+			          << " [--fee a,b,..] [--fee-every N] [--population N] [--book map|ladder] [--threads N]"
+			          << " [--json] [--out file]\n";
+			return 2;
+		}
+	}
+	// тик биржи 20 мс - 50 тиков на секунду рыночного времени
+	base.ticks = seconds * 50;
+
+	std::vector<SweepRun> runs;
+	for (const double threshold : thresholds)
+		for (const double spread : spreads)
+			for (const double fee : fees)
+				for (std::uint64_t seed = 1; seed <= seeds; ++seed) {
+					SweepRun r = base;
+					r.bigWinThreshold = threshold;
+					r.playerSpread = spread;
+					r.fee = fee;
+					r.seed = seed;
+					runs.push_back(r);
+				}
+
+	const unsigned used = threads ? threads : std::max(1u, std::thread::hardware_concurrency());
+	const auto start = std::chrono::steady_clock::now();
+	const std::vector<SweepResult> results = runSweep(runs, used);
+	const std::chrono::duration<double> wall = std::chrono::steady_clock::now() - start;
+
+	std::ofstream file;
+	if (!out.empty()) {
+		file.open(out);
+		if (!file) {
+			std::cerr << "cannot write " << out << "\n";
+			return 1;
+		}
+	}
+	std::ostream& os = out.empty() ? std::cout : file;
+	if (json) writeSweepJson(os, results);
+	else      writeSweepCsv(os, results);
+
+	std::cerr << "SWEEP: runs=" << runs.size() << " threads=" << used << " wall=" << wall.count() << "s"
+	          << " runs/s=" << (wall.count() > 0 ? static_cast<double>(runs.size()) / wall.count() : 0) << "\n";
+}